@@ -15,6 +15,8 @@
 #define UBI_H
 
 /* Include files ------------------------------------------------------------------------------- */
+#include <zephyr/kernel.h>
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -36,6 +38,20 @@
  */
 struct ubi_device;
 
+/**
+ * \brief Forward declaration of the UBI volume table transaction structure.
+ *
+ * This opaque structure holds volume table changes staged for a single commit.
+ */
+struct ubi_vol_txn;
+
+/**
+ * \brief Forward declaration of the UBI sealed volume structure.
+ *
+ * This opaque structure holds the immutable LEB mapping of a sealed static volume.
+ */
+struct ubi_sealed_volume;
+
 /* Types and type definitions ------------------------------------------------------------------ */
 
 /**
@@ -45,12 +61,20 @@ struct ubi_device;
 
 /**
  * \brief Memory technology device (MTD) for UBI.
+ *
+ * Further partitions, e.g. on other flash chips, may be concatenated after the first one into a
+ * single PEB namespace shared by wear-leveling. All partitions use the same write and erase block
+ * sizes and their list must not change once the device is formatted.
  */
 struct ubi_mtd {
 	uint8_t partition_id; /*!< Partition identifier from FIXED_PARTITION_ID macro. */
 
 	size_t write_block_size; /*!< Write block size in bytes. */
 	size_t erase_block_size; /*!< Erase block size in bytes. */
+
+	const uint8_t *concat_ids; /*!< Partitions concatenated after the first one, may be NULL. */
+	size_t concat_count; /*!< Number of concatenated partitions. */
+	bool striped; /*!< PEBs alternate between partitions and consecutive LEBs take turns. */
 };
 
 /**
@@ -64,6 +88,7 @@ struct ubi_device_info {
 	size_t bad_leb_count; /*!< Number of bad physical erase blocks. */
 
 	size_t leb_total_count; /*!< Total number of logical erase blocks. */
+	size_t reserved_leb_count; /*!< Number of logical erase blocks excluded from allocation. */
 	size_t leb_size; /*!< Size of each logical erase block in bytes. */
 
 	size_t volumes_count; /*!< Number of created volumes. */
@@ -83,9 +108,55 @@ enum ubi_volume_type {
 struct ubi_volume_config {
 	unsigned char name[UBI_VOLUME_NAME_MAX_LEN]; /*!< Volume name. */
 	enum ubi_volume_type type; /*!< Volume type. */
+	bool autoresize; /*!< Dynamic volume absorbs all unallocated LEBs at next attach. */
+	bool compressed; /*!< Data of whole LEB writes is stored compressed. */
+	bool encrypted; /*!< LEB data is encrypted with the key set by \ref ubi_volume_set_key. */
+	bool durable_unmap; /*!< LEB unmaps are journaled and survive reboot before erase. */
 	size_t leb_count; /*!< Number of logical erase blocks. */
 };
 
+/**
+ * \brief Classes of requests waiting for a UBI device.
+ *
+ * Waiting requests are dispatched by earliest deadline, which is arrival time plus latency
+ * target of the class. Target grows from urgent to scrub, so a request of a background class
+ * waits behind later foreground requests only until it ages past them.
+ */
+enum ubi_io_class {
+	UBI_IO_CLASS_URGENT = 0, /*!< Latency critical reads, e.g. configuration, target 0 ms. */
+	UBI_IO_CLASS_NORMAL = 1, /*!< Foreground reads and writes, target 10 ms. */
+	UBI_IO_CLASS_ERASE = 2, /*!< Background erase of dirty PEBs, target 100 ms. */
+	UBI_IO_CLASS_WEAR_LEVELING = 3, /*!< Background wear-leveling moves, target 500 ms. */
+	UBI_IO_CLASS_SCRUB = 4, /*!< Background scrubbing, target 1000 ms. */
+	UBI_IO_CLASS_COUNT = 5, /*!< Number of classes. */
+};
+
+/**
+ * \brief Statistics of one class of device requests.
+ */
+struct ubi_io_class_stats {
+	size_t queue_depth; /*!< Number of requests waiting now. */
+	size_t max_queue_depth; /*!< Highest number of requests waiting at once. */
+	uint32_t nr_of_dispatches; /*!< Number of times the device was granted to the class. */
+	uint64_t total_wait_us; /*!< Sum of waiting times in microseconds. */
+	uint32_t max_wait_us; /*!< Longest waiting time in microseconds. */
+};
+
+/**
+ * \brief Write quota of a UBI volume.
+ *
+ * Rates are token buckets refilled continuously, zero rate means no limit. Every LEB write
+ * consumes one PEB, which costs one erase when it is reclaimed.
+ */
+struct ubi_volume_quota {
+	uint32_t pebs_per_sec; /*!< PEBs the volume may consume per second. */
+	uint32_t peb_burst; /*!< PEBs the volume may consume at once, zero for one second worth. */
+	uint32_t bytes_per_sec; /*!< Data bytes the volume may write per second. */
+	uint32_t byte_burst; /*!< Bytes the volume may write at once, zero for one second worth. */
+	size_t reserved_pebs; /*!< Free PEBs kept for writes of this volume only. */
+	bool is_blocking; /*!< Over quota writes wait for refill instead of failing with -EAGAIN. */
+};
+
 /** \} name ubi_structs */
 
 /* Module interface variables and constants ---------------------------------------------------- */
@@ -102,10 +173,18 @@ struct ubi_volume_config {
 /**
  * \brief Initialize the UBI subsystem with a given memory device.
  *
- * \param[in] mtd 		Pointer to memory technology device.
+ * Device and volume headers are kept on the first partition. Concatenated partitions extend the
+ * PEB namespace one after another. With \ref ubi_mtd.striped PEBs are numbered in turns across
+ * all partitions, so each partition contributes as many PEBs as the smallest one, and LEB n of a
+ * volume prefers a free PEB of partition n modulo partition count. Consecutive LEBs then sit on
+ * different chips, and concurrent readers and writers of neighbouring LEBs use separate buses.
+ *
+ * \param[in] mtd 		Pointer to memory technology device, \ref ubi_mtd.concat_ids is
+ * 				referenced until the device is deinitialized.
  * \param[out] ubi		Pointer to UBI device instance.
  *
- * \return 0 on success, or negative error code.
+ * \return 0 on success, -EINVAL if partitions differ from the formatted layout, -ENODEV if a
+ * partition is not ready, or negative error code.
  */
 int ubi_device_init(const struct ubi_mtd *mtd, struct ubi_device **ubi);
 
@@ -128,6 +207,39 @@ int ubi_device_get_info(struct ubi_device *ubi, struct ubi_device_info *info);
  */
 int ubi_device_erase_peb(struct ubi_device *ubi);
 
+/**
+ * \brief Trigger erase operation on a batch of physical erase blocks.
+ *
+ * Dirty PEBs with lowest erase counters are selected. Physically adjacent PEBs are erased by one
+ * flash erase call, then EC headers are programmed back to back. PEBs which fail to erase or
+ * program are moved to bad PEBs.
+ *
+ * Device lock is released while flash is erased and programmed, so reads and writes of other
+ * threads proceed meanwhile. Erases are split by CONFIG_UBI_ERASE_CHUNK_SIZE.
+ *
+ * \param[in] ubi 		Pointer to UBI device instance.
+ * \param max_count 		Maximum number of PEBs to erase.
+ * \param[out] erased 		Number of erased PEBs, may be NULL.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_device_erase_pebs(struct ubi_device *ubi, size_t max_count, size_t *erased);
+
+/**
+ * \brief Perform pending maintenance within a time budget.
+ *
+ * Dirty PEBs are erased in batches sized by measured cost of the slowest PEB erase and EC
+ * header program, so the call returns before the budget expires. Until a PEB erase was measured
+ * the cost is CONFIG_UBI_ERASE_PEB_WORST_US, so a shorter budget does no work.
+ *
+ * \param[in] ubi 		Pointer to UBI device instance.
+ * \param budget 		Time budget or deadline, K_NO_WAIT does no work, K_FOREVER all.
+ * \param[out] remaining 	Number of dirty PEBs still pending, may be NULL.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_device_maintain(struct ubi_device *ubi, k_timeout_t budget, size_t *remaining);
+
 /**
  * \brief Deinitialize the UBI subsystem and release resources.
  *
@@ -137,6 +249,20 @@ int ubi_device_erase_peb(struct ubi_device *ubi);
  */
 int ubi_device_deinit(struct ubi_device *ubi);
 
+/**
+ * \brief Get request statistics of one class.
+ *
+ * LEB reads which find the mapping without the device lock never wait and are not counted.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param io_class 		Class of requests.
+ * \param[out] stats 		Pointer to class statistics.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_device_get_io_stats(struct ubi_device *ubi, enum ubi_io_class io_class,
+			    struct ubi_io_class_stats *stats);
+
 #if defined(CONFIG_UBI_TEST_API_ENABLE)
 
 /**
@@ -156,21 +282,42 @@ int ubi_device_get_peb_ec(struct ubi_device *ubi, size_t **peb_ec, size_t *len);
 
 /**
  * \defgroup ubi_volumes UBI Volume Management
- * \brief Functions to create, resize, remove and get statistics for volumes.
+ * \brief Functions to create, resize, rename, remove and get statistics for volumes.
  * \{
  */
 
 /**
  * \brief Create a new UBI volume.
  *
+ * At most one dynamic volume may request autoresize. On next attach it grows over all LEBs
+ * which are neither allocated by other volumes nor lost to bad PEBs, and the request is cleared.
+ * Encrypted volume requires CONFIG_UBI_CRYPTO_ENABLE.
+ *
  * \param[in] ubi 		Pointer to UBI device.
  * \param[in] vol_cfg 		Pointer to volume instance.
  * \param[out] vol_id 		Assigned volume ID (output).
  *
- * \return 0 on success, or negative error code.
+ * \return 0 on success, -EEXIST if another volume requests autoresize, -ENOTSUP if encryption
+ * is disabled, or negative error code.
  */
 int ubi_volume_create(struct ubi_device *ubi, const struct ubi_volume_config *vol_cfg, int *vol_id);
 
+/**
+ * \brief Create a read-only snapshot of an UBI volume.
+ *
+ * Snapshot shares PEBs with the source volume, so no data is copied. A LEB rewritten in source
+ * volume is copied on write, while snapshot keeps the old PEB. Snapshot reserves as many LEBs
+ * as the source volume and is released with \ref ubi_volume_remove.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param src_id 		Source volume ID.
+ * \param[in] name 		Snapshot volume name.
+ * \param[out] dst_id 		Assigned snapshot volume ID (output).
+ *
+ * \return 0 on success, -EEXIST if name is taken, or negative error code.
+ */
+int ubi_volume_snapshot(struct ubi_device *ubi, int src_id, const char *name, int *dst_id);
+
 /**
  * \brief Resize an existing UBI volume.
  *
@@ -192,6 +339,64 @@ int ubi_volume_resize(struct ubi_device *ubi, int vol_id, const struct ubi_volum
  */
 int ubi_volume_remove(struct ubi_device *ubi, int vol_id);
 
+/**
+ * \brief Unmap all LEBs of an UBI volume.
+ *
+ * Volume keeps its size and configuration. A single volume header write records the current
+ * sequence number as lower bound of the volume, so every PEB written before is stale at once and
+ * the wipe survives power cuts without erasing anything. Released PEBs are handed over to erase
+ * without reading them, see ubi_leb_unmap_range(). LEB writes in flight are waited for.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ *
+ * \return 0 on success, -EROFS for snapshot or sealed volume, -EBUSY if volume has snapshots, or
+ * negative error code.
+ */
+int ubi_volume_wipe(struct ubi_device *ubi, int vol_id);
+
+/**
+ * \brief Rename an UBI volume.
+ *
+ * Only the volume table is rewritten, data of the volume is not touched.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID to rename.
+ * \param[in] name 		New volume name.
+ *
+ * \return 0 on success, -EEXIST if name is taken, or negative error code.
+ */
+int ubi_volume_rename(struct ubi_device *ubi, int vol_id, const char *name);
+
+/**
+ * \brief Swap names of two UBI volumes.
+ *
+ * Both names are exchanged in one volume table revision, so after a power cut either both or
+ * none of the volumes are renamed. Suits A/B image slots addressed by name.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id_1 		First volume ID.
+ * \param vol_id_2 		Second volume ID.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_volume_swap_names(struct ubi_device *ubi, int vol_id_1, int vol_id_2);
+
+/**
+ * \brief Seal a static UBI volume once its contents are committed.
+ *
+ * Sealed flag is stored in the volume table. Writes, maps and unmaps of a sealed volume fail
+ * with -EROFS. Its LEBs may be read without the device lock through \ref ubi_sealed_open.
+ * Sealing a sealed volume succeeds without change. Encrypted volumes cannot be sealed, since
+ * their key may change while sealed handles are open.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Static volume ID.
+ *
+ * \return 0 on success, -ENOTSUP if volume is encrypted, or negative error code.
+ */
+int ubi_volume_seal(struct ubi_device *ubi, int vol_id);
+
 /**
  * \brief Get information about a UBI volume.
  *
@@ -205,8 +410,164 @@ int ubi_volume_remove(struct ubi_device *ubi, int vol_id);
 int ubi_volume_get_info(struct ubi_device *ubi, int vol_id, struct ubi_volume_config *vol_cfg,
 			size_t *alloc_lebs);
 
+/**
+ * \brief Get compression ratio of a UBI volume.
+ *
+ * Sizes are summed over VID headers of mapped LEBs, LEBs written by offset count as empty.
+ * LEBs of one repeated byte count as stored in zero bytes.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param[out] data_size 	Size of LEB data before compression.
+ * \param[out] stored_size 	Size of LEB data as stored on flash.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_volume_get_compression(struct ubi_device *ubi, int vol_id, size_t *data_size,
+			       size_t *stored_size);
+
+/**
+ * \brief Set class of LEB requests of a UBI volume.
+ *
+ * Class is kept in RAM only, volumes start as \ref UBI_IO_CLASS_NORMAL after attach. Per call
+ * variants of LEB functions override it.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param io_class 		Class of requests.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_volume_set_io_class(struct ubi_device *ubi, int vol_id, enum ubi_io_class io_class);
+
+/**
+ * \brief Set write quota of a UBI volume.
+ *
+ * Quota is kept in RAM only, volumes start without quota after attach. Writes of other volumes
+ * do not take free PEBs reserved by the quota, they reclaim dirty PEBs or fail with -ENOSPC.
+ * Writes failing with -ENOSPC are not charged. Writes in a volume table transaction are charged as well, but cannot wait for refill while
+ * the device is held, so they fail with -EAGAIN even under blocking quota.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param[in] quota 		Pointer to quota, or NULL to remove limits.
+ *
+ * \return 0 on success, -ENOSPC if PEBs cannot be reserved, or negative error code.
+ */
+int ubi_volume_set_quota(struct ubi_device *ubi, int vol_id, const struct ubi_volume_quota *quota);
+
+/**
+ * \brief Set key of an encrypted UBI volume.
+ *
+ * Key is kept in RAM only and must be set after every attach, LEBs of an encrypted volume are
+ * neither read nor written without it. Snapshots need the key of their source volume. Removing
+ * the volume destroys the copy of UBI only. Data left in dirty PEBs becomes unreadable once the
+ * application destroys every copy of the key it keeps, UBI neither stores nor erases it.
+ * Sequence numbers of encrypted writes are reserved in the unmap journal, which takes one PEB
+ * at the first encrypted write. Requires CONFIG_UBI_CRYPTO_ENABLE.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param[in] key 		AES key, or NULL to forget the key.
+ * \param key_len 		Size of the key in bytes, 16 or 32.
+ *
+ * \return 0 on success, -ENOTSUP if volume is not encrypted or encryption is disabled, or
+ * negative error code.
+ */
+int ubi_volume_set_key(struct ubi_device *ubi, int vol_id, const uint8_t *key, size_t key_len);
+
 /** \} name ubi_volumes */
 
+/**
+ * \defgroup ubi_vol_txn UBI Volume Transactions
+ * \brief Functions to batch volume table changes into one atomic revision.
+ *
+ * Operations are staged in RAM and checked against the staged table, so a volume created in a
+ * transaction may be resized or renamed by later operations of the same transaction. Commit
+ * writes the table once, both banks hold either the old or the new revision after a power cut.
+ * Device is locked for the calling thread from begin until commit or abort, begin waits for LEB
+ * writes and PEB erases in flight first.
+ * \{
+ */
+
+/**
+ * \brief Begin a volume table transaction.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param[out] txn 		Pointer to transaction instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_vol_txn_begin(struct ubi_device *ubi, struct ubi_vol_txn **txn);
+
+/**
+ * \brief Stage creation of a new UBI volume.
+ *
+ * \param[in] txn 		Pointer to transaction instance.
+ * \param[in] vol_cfg 		Pointer to volume parameters.
+ * \param[out] vol_id 		Assigned volume ID, valid after successful commit.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_vol_txn_create(struct ubi_vol_txn *txn, const struct ubi_volume_config *vol_cfg,
+		       int *vol_id);
+
+/**
+ * \brief Stage resize of an UBI volume.
+ *
+ * \param[in] txn 		Pointer to transaction instance.
+ * \param vol_id 		Volume ID to resize.
+ * \param[in] vol_cfg 		Pointer to new volume parameters.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_vol_txn_resize(struct ubi_vol_txn *txn, int vol_id,
+		       const struct ubi_volume_config *vol_cfg);
+
+/**
+ * \brief Stage removal of an UBI volume.
+ *
+ * \param[in] txn 		Pointer to transaction instance.
+ * \param vol_id 		Volume ID to remove.
+ *
+ * \return 0 on success, -EBUSY if volume has snapshots, or negative error code.
+ */
+int ubi_vol_txn_remove(struct ubi_vol_txn *txn, int vol_id);
+
+/**
+ * \brief Stage rename of an UBI volume.
+ *
+ * \param[in] txn 		Pointer to transaction instance.
+ * \param vol_id 		Volume ID to rename.
+ * \param[in] name 		New volume name.
+ *
+ * \return 0 on success, -EEXIST if name is taken, or negative error code.
+ */
+int ubi_vol_txn_rename(struct ubi_vol_txn *txn, int vol_id, const char *name);
+
+/**
+ * \brief Commit staged operations as one volume table revision.
+ *
+ * Transaction instance is released whatever the result. Once the volume table is written the
+ * commit cannot fail, so RAM always matches the table on flash.
+ *
+ * \param[in] txn 		Pointer to transaction instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_vol_txn_commit(struct ubi_vol_txn *txn);
+
+/**
+ * \brief Drop staged operations and release the transaction.
+ *
+ * \param[in] txn 		Pointer to transaction instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_vol_txn_abort(struct ubi_vol_txn *txn);
+
+/** \} name ubi_vol_txn */
+
 /**
  * \defgroup ubi_io UBI LEBs Management
  * \brief Functions to map/unmap, check if mapped, write/read and get size of
@@ -217,19 +578,72 @@ int ubi_volume_get_info(struct ubi_device *ubi, int vol_id, struct ubi_volume_co
 /**
  * \brief Write data to a logical erase block (LEB).
  *
+ * Flash is programmed without holding the device lock. Writes to one volume are serialized,
+ * writes to other volumes and reads proceed meanwhile. Old PEB stays mapped until new one is
+ * fully programmed. Data of a compressed volume is stored compressed if that saves at least
+ * one write block, reads decompress it transparently. Data of an encrypted volume is encrypted
+ * after compression, chunk by chunk on its way to flash. Data of one repeated byte is recorded in
+ * the VID header only and the data area is left unprogrammed, reads synthesize it. Encrypted
+ * volumes store such data as any other.
+ *
  * \param[in] ubi 		Pointer to UBI device.
  * \param vol_id 		Volume ID.
  * \param lnum 			Logical block number.
  * \param[in] buf 		Buffer containing data to write.
  * \param len 			Size of the \p buf in bytes.
  *
- * \return 0 on success, or negative error code.
+ * \return 0 on success, -EPERM if key of an encrypted volume is not set, -EAGAIN if sequence
+ * numbers of an encrypted volume wait for erases while the device is held by the caller, or
+ * negative error code.
  */
 int ubi_leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf, size_t len);
 
+/**
+ * \brief Write data to a logical erase block (LEB) as a request of a given class.
+ *
+ * Same as \ref ubi_leb_write, class of the volume is overridden for this call.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param lnum 			Logical block number.
+ * \param[in] buf 		Buffer containing data to write.
+ * \param len 			Size of the \p buf in bytes.
+ * \param io_class 		Class of the request.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_leb_write_class(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf,
+			size_t len, enum ubi_io_class io_class);
+
+/**
+ * \brief Write data at an offset of a logical erase block (LEB).
+ *
+ * Unlike \ref ubi_leb_write the LEB is not moved to a new physical erase block, data is programmed
+ * in place. Unmapped LEB is mapped on demand. The target area must be erased since last map,
+ * both \p offset and \p len must be multiples of 16 bytes. Size reported by
+ * \ref ubi_leb_get_size is not updated. LEB holding compressed data, or a repeated byte other
+ * than 0xFF recorded by \ref ubi_leb_write, cannot be written in place.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param lnum 			Logical block number.
+ * \param offset 		Offset in bytes within the LEB.
+ * \param[in] buf 		Buffer containing data to write.
+ * \param len 			Size of the \p buf in bytes.
+ *
+ * \return 0 on success, -ENOTSUP if LEB holds compressed or pattern data, -EPERM if key of an
+ * encrypted volume is not set, or negative error code.
+ */
+int ubi_leb_write_offset(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset,
+			 const void *buf, size_t len);
+
 /**
  * \brief Read data from a logical erase block (LEB).
  *
+ * Data of an encrypted volume is decrypted in place, write blocks never programmed since map
+ * read as erased. LEBs stored compressed read past their data size as raw ones, zero padding up
+ * to write block size and erased bytes past it.
+ *
  * \param[in] ubi 		Pointer to UBI device.
  * \param vol_id 		Volume ID.
  * \param lnum 			Logical block number.
@@ -237,11 +651,31 @@ int ubi_leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *b
  * \param[out] buf 		Output buffer.
  * \param size			Size of the \p buf in bytes.
  *
- * \return 0 on success, or negative error code.
+ * \return 0 on success, -EPERM if key of an encrypted volume is not set, or negative error
+ * code.
  */
 int ubi_leb_read(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset, void *buf,
 		 size_t size);
 
+/**
+ * \brief Read data from a logical erase block (LEB) as a request of a given class.
+ *
+ * Same as \ref ubi_leb_read, class of the volume is overridden for this call. Class matters
+ * only when a writer changes the mapping meanwhile and the read waits for the device lock.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param lnum 			Logical block number.
+ * \param offset 		Offset in the block to read from.
+ * \param[out] buf 		Output buffer.
+ * \param size			Size of the \p buf in bytes.
+ * \param io_class 		Class of the request.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_leb_read_class(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset, void *buf,
+		       size_t size, enum ubi_io_class io_class);
+
 /**
  * \brief Map a logical erase block (LEB) to a physical block.
  *
@@ -256,14 +690,39 @@ int ubi_leb_map(struct ubi_device *ubi, int vol_id, size_t lnum);
 /**
  * \brief Unmap a logical erase block (LEB).
  *
+ * Unmapped LEB stays unmapped across reboot once its PEB is erased. On a volume with
+ * \ref ubi_volume_config.durable_unmap the unmap is first recorded in the unmap journal, one PEB
+ * kept out of allocation, so it survives reboot at once at the cost of a small flash program.
+ * A full journal is renewed after all dirty PEBs are erased. LEB writes in flight are waited for.
+ *
  * \param[in] ubi 		Pointer to UBI device.
  * \param vol_id 		Volume ID.
  * \param lnum 			Logical block number.
  *
- * \return 0 on success, or negative error code.
+ * \return 0 on success, -EAGAIN if a full journal waits for erases while the device is held by
+ * the caller, or negative error code.
  */
 int ubi_leb_unmap(struct ubi_device *ubi, int vol_id, size_t lnum);
 
+/**
+ * \brief Unmap a range of logical erase blocks (LEBs).
+ *
+ * Mapped LEBs of the range are released under a single device lock acquisition and unmapped LEBs
+ * are skipped. No flash is read, released PEBs are queued for erase ahead of other dirty PEBs and
+ * their erase counters are read once they are erased. Durability is the same as of
+ * ubi_leb_unmap(), a journaled range takes a single record.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param first 		First logical block number of the range.
+ * \param count 		Number of logical blocks in the range.
+ *
+ * \return 0 on success, -EACCES if range exceeds the volume, -EROFS for snapshot or sealed
+ * volume, -ENOSPC if no PEB is left for the unmap journal, -EAGAIN as ubi_leb_unmap(), or
+ * negative error code.
+ */
+int ubi_leb_unmap_range(struct ubi_device *ubi, int vol_id, size_t first, size_t count);
+
 /**
  * \brief Check if a logical erase block (LEB) is mapped.
  *
@@ -288,6 +747,67 @@ int ubi_leb_is_mapped(struct ubi_device *ubi, int vol_id, size_t lnum, bool *is_
  */
 int ubi_leb_get_size(struct ubi_device *ubi, int vol_id, size_t lnum, size_t *size);
 
+/**
+ * \brief Get sequence number of mapped LEB.
+ *
+ * Sequence number is assigned when LEB is written or mapped and grows monotonically across
+ * the whole device, so it orders LEBs by time of their last mapping.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID.
+ * \param lnum 			Logical block number.
+ * \param[out] sqnum		Sequence number of mapped LEB.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_leb_get_sqnum(struct ubi_device *ubi, int vol_id, size_t lnum, uint64_t *sqnum);
+
 /** \} name ubi_io */
 
+/**
+ * \defgroup ubi_sealed UBI Sealed Volumes
+ * \brief Functions to read sealed volumes without the device lock.
+ *
+ * A handle holds a reference to the immutable LEB mapping of a sealed volume. Reads through it
+ * never wait for erases or writes of other volumes. Volume removal fails with -EBUSY while a
+ * handle is open. Handles must be closed before the device is deinitialized.
+ * \{
+ */
+
+/**
+ * \brief Open a sealed UBI volume for lock-free reads.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Sealed volume ID.
+ * \param[out] sealed 		Pointer to sealed volume handle.
+ *
+ * \return 0 on success, -EINVAL if volume is not sealed, or negative error code.
+ */
+int ubi_sealed_open(struct ubi_device *ubi, int vol_id, struct ubi_sealed_volume **sealed);
+
+/**
+ * \brief Read data from a logical erase block of a sealed volume.
+ *
+ * \param[in] sealed 		Pointer to sealed volume handle.
+ * \param lnum 			Logical block number.
+ * \param offset 		Offset within the LEB.
+ * \param[out] buf 		Buffer to store read data.
+ * \param size 			Size of the \p buf in bytes.
+ *
+ * \return 0 on success, -ENOENT if LEB is not mapped, or negative error code.
+ */
+int ubi_sealed_read(struct ubi_sealed_volume *sealed, size_t lnum, size_t offset, void *buf,
+		    size_t size);
+
+/**
+ * \brief Close a sealed volume handle.
+ *
+ * \param[in] sealed 		Pointer to sealed volume handle.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_sealed_close(struct ubi_sealed_volume *sealed);
+
+/** \} name ubi_sealed */
+
 #endif /* UBI_H */
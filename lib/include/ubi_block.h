@@ -0,0 +1,112 @@
+/**
+ * \file    ubi_block.h
+ *
+ * \brief   Unsorted Block Images (UBI) block device interface.
+ *
+ * \author  Kamil Kielbasa
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ */
+
+/* Include guard ------------------------------------------------------------------------------- */
+#ifndef UBI_BLOCK_H
+#define UBI_BLOCK_H
+
+/* Include files ------------------------------------------------------------------------------- */
+#include "ubi.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines ------------------------------------------------------------------------------------- */
+/* Forward declarations ------------------------------------------------------------------------ */
+
+/**
+ * \brief Forward declaration of the UBI block device structure.
+ *
+ * This opaque structure represents a Zephyr disk backed by a single UBI volume.
+ */
+struct ubi_block;
+
+/* Types and type definitions ------------------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_block_structs UBI Block Device Data Structures
+ * \{
+ */
+
+/**
+ * \brief Block device informations.
+ */
+struct ubi_block_info {
+	size_t sector_size; /*!< Size of each sector in bytes. */
+	size_t sector_count; /*!< Total number of sectors. */
+	size_t sectors_per_leb; /*!< Number of sectors stored in one logical erase block. */
+
+	size_t leb_reads; /*!< Number of LEB reads issued to UBI. */
+	size_t leb_writes; /*!< Number of LEB writes (cache flushes) issued to UBI. */
+	size_t cache_hits; /*!< Number of sector accesses served by the LEB cache. */
+};
+
+/** \} name ubi_block_structs */
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Extern variables and constant declarations -------------------------------------------------- */
+/* Module interface function declarations ------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_block UBI Block Device
+ * \brief Functions to expose a UBI volume as a Zephyr disk (disk_access).
+ *
+ * Sectors are mapped linearly onto LEBs of the volume. Writes are collected in a one-LEB
+ * read-modify-write cache which is written back as a whole LEB when another LEB is written,
+ * on \ref DISK_IOCTL_CTRL_SYNC, or on \ref ubi_block_sync.
+ * \{
+ */
+
+/**
+ * \brief Create a block device on top of a UBI volume and register it as a disk.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID backing the block device.
+ * \param[in] disk_name		Disk name used with the disk_access API.
+ * \param[out] block		Pointer to UBI block device instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_block_create(struct ubi_device *ubi, int vol_id, const char *disk_name,
+		     struct ubi_block **block);
+
+/**
+ * \brief Write back the LEB cache of a block device.
+ *
+ * \param[in] block 		Pointer to UBI block device instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_block_sync(struct ubi_block *block);
+
+/**
+ * \brief Get information about a block device.
+ *
+ * \param[in] block 		Pointer to UBI block device instance.
+ * \param[out] info 		Pointer to block device informations.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_block_get_info(struct ubi_block *block, struct ubi_block_info *info);
+
+/**
+ * \brief Flush, unregister and release a block device.
+ *
+ * \param[in] block 		Pointer to UBI block device instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_block_destroy(struct ubi_block *block);
+
+/** \} name ubi_block */
+
+#endif /* UBI_BLOCK_H */
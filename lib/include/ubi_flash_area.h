@@ -0,0 +1,150 @@
+/**
+ * \file    ubi_flash_area.h
+ *
+ * \brief   Unsorted Block Images (UBI) virtual flash area interface.
+ *
+ * \author  Kamil Kielbasa
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ */
+
+/* Include guard ------------------------------------------------------------------------------- */
+#ifndef UBI_FLASH_AREA_H
+#define UBI_FLASH_AREA_H
+
+/* Include files ------------------------------------------------------------------------------- */
+#include "ubi.h"
+
+#include <zephyr/storage/flash_map.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Defines ------------------------------------------------------------------------------------- */
+/* Forward declarations ------------------------------------------------------------------------ */
+
+/**
+ * \brief Forward declaration of the UBI virtual flash area structure.
+ *
+ * This opaque structure represents a flash area backed by a single static UBI volume.
+ */
+struct ubi_flash_area;
+
+/* Types and type definitions ------------------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_flash_area_structs UBI Virtual Flash Area Data Structures
+ * \{
+ */
+
+/**
+ * \brief Virtual flash area informations.
+ */
+struct ubi_flash_area_info {
+	size_t size; /*!< Size of flash area in bytes. */
+	size_t sector_size; /*!< Size of each sector (one LEB) in bytes. */
+	size_t sector_count; /*!< Total number of sectors. */
+	uint32_t align; /*!< Write offset and length alignment in bytes. */
+	uint8_t erased_val; /*!< Value of erased byte. */
+};
+
+/** \} name ubi_flash_area_structs */
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Extern variables and constant declarations -------------------------------------------------- */
+/* Module interface function declarations ------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_flash_area UBI Virtual Flash Area
+ * \brief Functions to access a static UBI volume with flash area semantics.
+ *
+ * Offsets are mapped linearly onto LEBs and every LEB is one sector. A sector erase maps the
+ * LEB to a fresh PEB, so erased state survives reboot and the old PEB is reclaimed by the
+ * erase path of UBI. Unmapped LEBs read as erased. Writes program erased space in place, so
+ * image trailers may be written in small aligned pieces like on raw flash.
+ * \{
+ */
+
+/**
+ * \brief Open a static UBI volume as a virtual flash area.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Static volume ID.
+ * \param[out] ufa		Pointer to UBI virtual flash area instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_flash_area_open(struct ubi_device *ubi, int vol_id, struct ubi_flash_area **ufa);
+
+/**
+ * \brief Read data from a virtual flash area.
+ *
+ * \param[in] ufa 		Pointer to UBI virtual flash area instance.
+ * \param off 			Offset relative to start of flash area.
+ * \param[out] dst 		Output buffer.
+ * \param len 			Number of bytes to read.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_flash_area_read(struct ubi_flash_area *ufa, off_t off, void *dst, size_t len);
+
+/**
+ * \brief Program erased space of a virtual flash area.
+ *
+ * \param[in] ufa 		Pointer to UBI virtual flash area instance.
+ * \param off 			Offset relative to start of flash area, aligned to write alignment.
+ * \param[in] src 		Input buffer.
+ * \param len 			Number of bytes to write, aligned to write alignment.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_flash_area_write(struct ubi_flash_area *ufa, off_t off, const void *src, size_t len);
+
+/**
+ * \brief Erase sectors of a virtual flash area.
+ *
+ * \param[in] ufa 		Pointer to UBI virtual flash area instance.
+ * \param off 			Offset relative to start of flash area, aligned to sector size.
+ * \param len 			Number of bytes to erase, aligned to sector size.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_flash_area_erase(struct ubi_flash_area *ufa, off_t off, size_t len);
+
+/**
+ * \brief Get information about a virtual flash area.
+ *
+ * \param[in] ufa 		Pointer to UBI virtual flash area instance.
+ * \param[out] info 		Pointer to virtual flash area informations.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_flash_area_get_info(struct ubi_flash_area *ufa, struct ubi_flash_area_info *info);
+
+/**
+ * \brief Get sector layout of a virtual flash area.
+ *
+ * \param[in] ufa 		Pointer to UBI virtual flash area instance.
+ * \param[in,out] count 	Capacity of \p sectors on input, number of sectors on output.
+ * \param[out] sectors 		Output array of sectors.
+ *
+ * \return 0 on success, -ENOMEM if \p sectors is too small, or negative error code.
+ */
+int ubi_flash_area_get_sectors(struct ubi_flash_area *ufa, uint32_t *count,
+			       struct flash_sector *sectors);
+
+/**
+ * \brief Close a virtual flash area and release its resources.
+ *
+ * \param[in] ufa 		Pointer to UBI virtual flash area instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_flash_area_close(struct ubi_flash_area *ufa);
+
+/** \} name ubi_flash_area */
+
+#endif /* UBI_FLASH_AREA_H */
@@ -0,0 +1,180 @@
+/**
+ * \file    ubi_kv.h
+ *
+ * \brief   Unsorted Block Images (UBI) key-value store interface.
+ *
+ * \author  Kamil Kielbasa
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ */
+
+/* Include guard ------------------------------------------------------------------------------- */
+#ifndef UBI_KV_H
+#define UBI_KV_H
+
+/* Include files ------------------------------------------------------------------------------- */
+#include "ubi.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines ------------------------------------------------------------------------------------- */
+/* Forward declarations ------------------------------------------------------------------------ */
+
+/**
+ * \brief Forward declaration of the UBI key-value store structure.
+ *
+ * This opaque structure represents a mounted key-value store on a single UBI volume.
+ */
+struct ubi_kv;
+
+/* Types and type definitions ------------------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_kv_structs UBI Key-Value Store Data Structures
+ * \{
+ */
+
+/**
+ * \brief Key-value store informations.
+ */
+struct ubi_kv_info {
+	size_t records; /*!< Number of live records. */
+	size_t live_bytes; /*!< Flash space occupied by live records. */
+	size_t free_lebs; /*!< Number of unmapped LEBs. */
+
+	size_t appends; /*!< Number of records appended since mount. */
+	size_t compactions; /*!< Number of LEBs compacted and unmapped since mount. */
+};
+
+/**
+ * \brief Callback invoked for each live record by \ref ubi_kv_foreach.
+ *
+ * \param[in] key 		Record key.
+ * \param val_len 		Length of record value in bytes.
+ * \param[in] arg 		User argument.
+ *
+ * \return 0 to continue iteration, non zero value to stop it.
+ */
+typedef int (*ubi_kv_foreach_cb)(const char *key, size_t val_len, void *arg);
+
+/** \} name ubi_kv_structs */
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Extern variables and constant declarations -------------------------------------------------- */
+/* Module interface function declarations ------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_kv UBI Key-Value Store
+ * \brief Log-structured key-value store on top of a dynamic UBI volume.
+ *
+ * Records are appended with \ref ubi_leb_write_offset into the newest LEB. An in-RAM hash
+ * index with one entry per live key is rebuilt on mount. When only one unmapped LEB is left,
+ * the oldest LEB is compacted: its live records are copied into the newest LEB and the oldest
+ * LEB is unmapped.
+ * \{
+ */
+
+/**
+ * \brief Mount a key-value store and rebuild its index.
+ *
+ * Empty volume is a valid, empty store. Volume has to be created with durable unmap, since
+ * compaction drops deletion records once the LEBs they hide are unmapped. Index keeps LEB numbers
+ * and offsets in 16 bits, so volumes of 65536 LEBs and more, or LEBs of more than 65535 write
+ * blocks, are rejected with -EINVAL.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Dynamic volume ID backing the store.
+ * \param[out] kv		Pointer to UBI key-value store instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_kv_mount(struct ubi_device *ubi, int vol_id, struct ubi_kv **kv);
+
+/**
+ * \brief Write a record.
+ *
+ * \param[in] kv 		Pointer to UBI key-value store instance.
+ * \param[in] key 		Null terminated key.
+ * \param[in] val 		Value buffer.
+ * \param len 			Length of \p val in bytes.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_kv_write(struct ubi_kv *kv, const char *key, const void *val, size_t len);
+
+/**
+ * \brief Read a record.
+ *
+ * \param[in] kv 		Pointer to UBI key-value store instance.
+ * \param[in] key 		Null terminated key.
+ * \param[out] buf 		Output buffer, value is truncated to \p size bytes.
+ * \param size 			Size of \p buf in bytes.
+ * \param[out] len 		Length of stored value in bytes.
+ *
+ * \return 0 on success, -ENOENT if key is not present, or negative error code.
+ */
+int ubi_kv_read(struct ubi_kv *kv, const char *key, void *buf, size_t size, size_t *len);
+
+/**
+ * \brief Delete a record.
+ *
+ * \param[in] kv 		Pointer to UBI key-value store instance.
+ * \param[in] key 		Null terminated key.
+ *
+ * \return 0 on success, -ENOENT if key is not present, or negative error code.
+ */
+int ubi_kv_delete(struct ubi_kv *kv, const char *key);
+
+/**
+ * \brief Iterate over live records.
+ *
+ * Store must not be modified from \p cb.
+ *
+ * \param[in] kv 		Pointer to UBI key-value store instance.
+ * \param cb 			Callback invoked for each record.
+ * \param[in] arg 		User argument passed to \p cb.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_kv_foreach(struct ubi_kv *kv, ubi_kv_foreach_cb cb, void *arg);
+
+/**
+ * \brief Get information about a key-value store.
+ *
+ * \param[in] kv 		Pointer to UBI key-value store instance.
+ * \param[out] info 		Pointer to key-value store informations.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_kv_get_info(struct ubi_kv *kv, struct ubi_kv_info *info);
+
+/**
+ * \brief Unmount a key-value store and release its resources.
+ *
+ * \param[in] kv 		Pointer to UBI key-value store instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_kv_unmount(struct ubi_kv *kv);
+
+#if defined(CONFIG_UBI_KV_SETTINGS)
+/**
+ * \brief Use a key-value store as Zephyr settings source and destination.
+ *
+ * Settings store is registered on the first call, subsequent calls rebind it to \p kv.
+ * Passing NULL detaches the store. Intended to be called from \c settings_backend_init
+ * when \c CONFIG_SETTINGS_CUSTOM is used.
+ *
+ * \param[in] kv 		Pointer to UBI key-value store instance, or NULL.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_kv_settings_register(struct ubi_kv *kv);
+#endif /* CONFIG_UBI_KV_SETTINGS */
+
+/** \} name ubi_kv */
+
+#endif /* UBI_KV_H */
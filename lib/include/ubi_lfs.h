@@ -0,0 +1,84 @@
+/**
+ * \file    ubi_lfs.h
+ *
+ * \brief   Unsorted Block Images (UBI) LittleFS block device adapter interface.
+ *
+ * \author  Kamil Kielbasa
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ */
+
+/* Include guard ------------------------------------------------------------------------------- */
+#ifndef UBI_LFS_H
+#define UBI_LFS_H
+
+/* Include files ------------------------------------------------------------------------------- */
+#include "ubi.h"
+
+#include <lfs.h>
+
+/* Defines ------------------------------------------------------------------------------------- */
+/* Forward declarations ------------------------------------------------------------------------ */
+
+/**
+ * \brief Forward declaration of the UBI LittleFS adapter structure.
+ *
+ * This opaque structure holds a LittleFS configuration backed by a single UBI volume.
+ */
+struct ubi_lfs;
+
+/* Types and type definitions ------------------------------------------------------------------ */
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Extern variables and constant declarations -------------------------------------------------- */
+/* Module interface function declarations ------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_lfs UBI LittleFS Adapter
+ * \brief Functions to run LittleFS on top of a UBI volume.
+ *
+ * Each LittleFS block is stored in one LEB. Block size is the LEB size rounded down to
+ * \c CONFIG_UBI_LFS_CACHE_SIZE. Block erase unmaps the LEB, which is mapped again lazily on the
+ * first program through \ref ubi_leb_write_offset. LittleFS block level wear-leveling is
+ * disabled because UBI already spreads erases across the whole device.
+ * \{
+ */
+
+/**
+ * \brief Create a LittleFS configuration on top of a UBI volume.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Volume ID backing the file system.
+ * \param[out] ctx		Pointer to UBI LittleFS adapter instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_lfs_create(struct ubi_device *ubi, int vol_id, struct ubi_lfs **ctx);
+
+/**
+ * \brief Get LittleFS configuration of an adapter.
+ *
+ * Returned configuration is valid until \ref ubi_lfs_destroy and can be passed directly to
+ * \c lfs_format and \c lfs_mount.
+ *
+ * \param[in] ctx 		Pointer to UBI LittleFS adapter instance.
+ *
+ * \return Pointer to LittleFS configuration, or NULL on invalid argument.
+ */
+const struct lfs_config *ubi_lfs_get_config(struct ubi_lfs *ctx);
+
+/**
+ * \brief Release a LittleFS adapter.
+ *
+ * File system must be unmounted before the adapter is released.
+ *
+ * \param[in] ctx 		Pointer to UBI LittleFS adapter instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_lfs_destroy(struct ubi_lfs *ctx);
+
+/** \} name ubi_lfs */
+
+#endif /* UBI_LFS_H */
@@ -0,0 +1,167 @@
+/**
+ * \file    ubi_ring.h
+ *
+ * \brief   Unsorted Block Images (UBI) circular log interface.
+ *
+ * \author  Kamil Kielbasa
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ */
+
+/* Include guard ------------------------------------------------------------------------------- */
+#ifndef UBI_RING_H
+#define UBI_RING_H
+
+/* Include files ------------------------------------------------------------------------------- */
+#include "ubi.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines ------------------------------------------------------------------------------------- */
+/* Forward declarations ------------------------------------------------------------------------ */
+
+/**
+ * \brief Forward declaration of the UBI circular log structure.
+ *
+ * This opaque structure represents an opened circular log on a single UBI volume.
+ */
+struct ubi_ring;
+
+/* Types and type definitions ------------------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_ring_structs UBI Circular Log Data Structures
+ * \{
+ */
+
+/**
+ * \brief Position of a record in circular log.
+ *
+ * LEB is identified by its sequence number, so a cursor stays valid while the LEB is reused.
+ */
+struct ubi_ring_cursor {
+	uint64_t sqnum; /*!< Sequence number of LEB holding the record. */
+	size_t offset; /*!< Offset of the record within LEB. */
+};
+
+/**
+ * \brief Circular log informations.
+ */
+struct ubi_ring_info {
+	size_t leb_count; /*!< Number of LEBs in volume. */
+	size_t used_lebs; /*!< Number of LEBs holding log records. */
+
+	size_t appends; /*!< Number of records appended since open. */
+	size_t reclaims; /*!< Number of oldest LEBs reclaimed since open. */
+};
+
+/** \} name ubi_ring_structs */
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Extern variables and constant declarations -------------------------------------------------- */
+/* Module interface function declarations ------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_ring UBI Circular Log
+ * \brief Append-only circular log on top of a dynamic UBI volume.
+ *
+ * LEBs are filled in cyclic order with framed records written through
+ * \ref ubi_leb_write_offset. Order of LEBs is recovered on open from sequence numbers of
+ * their VID headers. When the log is full the oldest LEB is unmapped and reused, so every
+ * LEB of log costs exactly one erase. Each LEB starts with a trim record which, together with
+ * records appended by \ref ubi_ring_trim, persists the oldest valid LEB.
+ * \{
+ */
+
+/**
+ * \brief Open a circular log and recover its head and tail.
+ *
+ * \param[in] ubi 		Pointer to UBI device.
+ * \param vol_id 		Dynamic volume ID backing the log.
+ * \param[out] ring		Pointer to UBI circular log instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_ring_open(struct ubi_device *ubi, int vol_id, struct ubi_ring **ring);
+
+/**
+ * \brief Append a record, reclaiming the oldest LEB if log is full.
+ *
+ * \param[in] ring 		Pointer to UBI circular log instance.
+ * \param[in] buf 		Record data.
+ * \param len 			Length of \p buf in bytes.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_ring_append(struct ubi_ring *ring, const void *buf, size_t len);
+
+/**
+ * \brief Read a record at cursor and advance cursor to the next record.
+ *
+ * \param[in] ring 		Pointer to UBI circular log instance.
+ * \param[in,out] cursor 	Position of the record.
+ * \param[out] buf 		Output buffer, record is truncated to \p size bytes.
+ * \param size 			Size of \p buf in bytes.
+ * \param[out] len 		Length of record in bytes.
+ *
+ * \return 0 on success, -ENODATA if cursor reached head of log, -ENOENT if cursor points to
+ * reclaimed LEB, or negative error code.
+ */
+int ubi_ring_read_from(struct ubi_ring *ring, struct ubi_ring_cursor *cursor, void *buf,
+		       size_t size, size_t *len);
+
+/**
+ * \brief Release all LEBs older than the LEB pointed by cursor.
+ *
+ * \param[in] ring 		Pointer to UBI circular log instance.
+ * \param[in] cursor 		Position of the oldest record to keep.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_ring_trim(struct ubi_ring *ring, const struct ubi_ring_cursor *cursor);
+
+/**
+ * \brief Get cursor of the oldest record.
+ *
+ * \param[in] ring 		Pointer to UBI circular log instance.
+ * \param[out] cursor 		Position of the oldest record.
+ *
+ * \return 0 on success, -ENODATA if log is empty, or negative error code.
+ */
+int ubi_ring_get_tail(struct ubi_ring *ring, struct ubi_ring_cursor *cursor);
+
+/**
+ * \brief Get cursor of the next appended record.
+ *
+ * \param[in] ring 		Pointer to UBI circular log instance.
+ * \param[out] cursor 		Position after the newest record.
+ *
+ * \return 0 on success, -ENODATA if log is empty, or negative error code.
+ */
+int ubi_ring_get_head(struct ubi_ring *ring, struct ubi_ring_cursor *cursor);
+
+/**
+ * \brief Get information about a circular log.
+ *
+ * \param[in] ring 		Pointer to UBI circular log instance.
+ * \param[out] info 		Pointer to circular log informations.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_ring_get_info(struct ubi_ring *ring, struct ubi_ring_info *info);
+
+/**
+ * \brief Close a circular log and release its resources.
+ *
+ * \param[in] ring 		Pointer to UBI circular log instance.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_ring_close(struct ubi_ring *ring);
+
+/** \} name ubi_ring */
+
+#endif /* UBI_RING_H */
@@ -13,12 +13,15 @@
 
 /* Internal headers: */
 #include "ubi.h"
+#include "ubi_crypto.h"
+#include "ubi_lz.h"
 #include "ubi_utils.h"
 
 /* Zephyr headers: */
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/__assert.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/crc.h>
 #include <zephyr/sys/rb.h>
 #include <zephyr/sys/slist.h>
@@ -36,10 +39,104 @@
 
 #define RBT_PTR(p) ((struct rbnode *)((uintptr_t)(p) & ~1))
 
+#define UBI_SEALED_UNMAPPED (UINT32_MAX)
+
+#define UBI_RBT_MAX_DEPTH (64)
+#define UBI_LOOKUP_RETRIES (4)
+#define UBI_PIN_LOCKED (-1)
+#define UBI_IO_CLASS_OF_VOLUME (UBI_IO_CLASS_COUNT)
+
 LOG_MODULE_REGISTER(ubi, CONFIG_UBI_LOG_LEVEL);
 
 /* Module types and type definitions ----------------------------------------------------------- */
 
+/**
+ * \brief Immutable LEB to PEB mapping of a sealed volume.
+ *
+ * Shared by the volume and every open handle, freed with the last reference. Reads through it
+ * take no lock, since neither mapping nor mapped PEBs change while a reference is held.
+ */
+struct ubi_sealed_volume {
+	atomic_t refs; /**< Number of references, volume holds one. */
+	struct ubi_flash flash; /**< Underlying MTD (Memory Technology Device), layout copied. */
+	bool is_compressed; /**< LEBs may hold compressed data. */
+	bool has_patterns; /**< LEBs may hold a fill pattern only. */
+	size_t leb_count; /**< Number of LEBs in the mapping. */
+	uint32_t pnums[]; /**< PEB of each LEB, UBI_SEALED_UNMAPPED if not mapped. */
+};
+
+/**
+ * \brief Location of LEB data streamed to or from flash, encrypted on the way if cipher is set.
+ */
+struct ubi_leb_io {
+	const struct ubi_flash *flash; /**< Underlying MTD (Memory Technology Device). */
+	size_t pnum; /**< PEB holding the LEB. */
+	struct ubi_crypto *crypto; /**< Cipher of the volume, NULL if data is not encrypted. */
+	struct ubi_crypto_tweak tweak; /**< Position of the LEB in the key stream. */
+};
+
+BUILD_ASSERT(UBI_CRYPTO_BLOCK_SIZE == WRITE_BLOCK_SIZE_ALIGNMENT);
+
+/**
+ * \brief Format of LEB data of a volume, captured together with the mapping.
+ */
+struct ubi_leb_codec {
+	bool is_compressed; /**< LEBs may hold compressed data. */
+	bool has_patterns; /**< LEBs may hold a fill pattern only. */
+	bool is_encrypted; /**< LEB data is encrypted. */
+	struct ubi_crypto *crypto; /**< Cipher of the volume key, NULL if key is not set. */
+};
+
+/**
+ * \brief Request waiting for the device.
+ */
+struct ubi_io_waiter {
+	sys_snode_t node; /**< Waiting requests list linkage. */
+	k_tid_t thread; /**< Waiting thread. */
+	int64_t deadline; /**< Dispatch deadline in system ticks. */
+	enum ubi_io_class io_class; /**< Class of the request. */
+	int prio; /**< Priority of the waiting thread. */
+	bool is_granted; /**< Device was handed over to the request. */
+};
+
+/**
+ * \brief Device lock dispatching waiting requests by class deadline.
+ *
+ * Device is owned by one thread at a time and may be taken recursively. On release it is handed
+ * over to the waiting request with earliest deadline, so newcomers never overtake it. Owner runs
+ * at the highest priority of the waiting requests, as a mutex with priority inheritance would.
+ */
+struct ubi_io_sched {
+	struct k_mutex lock; /**< Protects scheduler state, held only briefly. */
+	struct k_condvar dispatch; /**< Signalled when device is handed over. */
+	k_tid_t owner; /**< Thread owning the device, NULL if free. */
+	uint32_t depth; /**< Recursion depth of the owner. */
+	enum ubi_io_class owner_class; /**< Class the owner was granted the device for. */
+	int owner_prio; /**< Priority of the owner before it was raised by waiting requests. */
+	sys_slist_t waiters; /**< Requests waiting for the device. */
+	struct ubi_io_class_stats stats[UBI_IO_CLASS_COUNT]; /**< Statistics of each class. */
+};
+
+/**
+ * \brief Token bucket limiting a rate.
+ */
+struct ubi_quota_bucket {
+	int64_t tokens; /**< Available tokens in thousandths, negative while in debt. */
+	uint32_t rate; /**< Tokens added per second, zero if not limited. */
+	uint32_t burst; /**< Capacity of the bucket in tokens. */
+};
+
+/**
+ * \brief Write quota state of a volume.
+ */
+struct ubi_vol_quota {
+	struct ubi_quota_bucket pebs; /**< Bucket of consumed PEBs. */
+	struct ubi_quota_bucket bytes; /**< Bucket of written data bytes. */
+	int64_t refill_ms; /**< Uptime of the last refill in milliseconds. */
+	size_t reserved_pebs; /**< Free PEBs kept for the volume. */
+	bool is_blocking; /**< Over quota writes wait for refill. */
+};
+
 /**
  * \brief UBI volume representation.
  *
@@ -51,13 +148,26 @@ struct ubi_volume {
 	size_t vol_id; /**< Unique identifier of the volume. */
 	struct ubi_volume_config cfg; /**< Volume configuration parameters. */
 
+	bool is_snapshot; /**< Volume is a read-only snapshot of another volume. */
+	bool is_writing; /**< LEB write of the volume programs flash unlocked. */
+	bool is_sealed; /**< Volume contents are committed and never change. */
+	bool has_patterns; /**< Some LEB was written as a fill pattern since attach. */
+	uint8_t io_class; /**< Class of LEB requests, one of enum ubi_io_class. */
+	size_t src_vol_id; /**< Identifier of the snapshot source volume. */
+	uint64_t sqnum_bound; /**< Snapshot holds LEBs with lower sequence number, other volume
+				 holds LEBs with equal or higher one. */
+	struct ubi_sealed_volume *sealed; /**< Immutable mapping of a sealed volume. */
+	struct ubi_vol_quota *quota; /**< Write quota, NULL if not limited. */
+	struct ubi_crypto *crypto; /**< Cipher of the volume key, NULL if not set. */
+
+	atomic_t eba_seq; /**< EBA table and LEB count change counter, odd while changing. */
 	size_t eba_tbl_size; /**< Size of the eraseblock association (EBA) table. */
 	struct rbtree eba_tbl; /**< Red-black tree mapping:
                                      - Key: Logical Erase Block (LEB) index
                                      - Value: Physical Erase Block (PEB) index */
 };
 
-BUILD_ASSERT(sizeof(struct ubi_volume) == 48);
+BUILD_ASSERT(sizeof(struct ubi_volume) == 88);
 
 /**
  * \brief UBI device representation.
@@ -66,9 +176,17 @@ BUILD_ASSERT(sizeof(struct ubi_volume) == 48);
  * structures and global sequencing information.
  */
 struct ubi_device {
-	struct k_mutex mutex;
+	struct ubi_io_sched sched; /**< Device lock with class based dispatch. */
+	struct k_condvar write_done; /**< Signalled when an unlocked LEB write or PEB erase ends. */
+	uint32_t nr_of_writes; /**< Number of LEB writes programming flash unlocked. */
+	uint32_t nr_of_erases; /**< Number of PEB batch erases running unlocked. */
+
+	atomic_t vols_seq; /**< Volumes tree change counter, odd while changing. */
+	atomic_t rd_epoch; /**< Grace period counter of lock-free readers. */
+	atomic_t rd_count[2]; /**< Number of lock-free readers by grace period parity. */
+	struct k_condvar rd_done; /**< Signalled when last reader of a past grace period leaves. */
 
-	struct ubi_mtd mtd; /**< Underlying MTD (Memory Technology Device). */
+	struct ubi_flash flash; /**< Underlying MTD (Memory Technology Device) and its layout. */
 
 	size_t free_pebs_size; /**< Number of free PEBs available. */
 	struct rbtree free_pebs; /**< Red-black tree of free PEBs:
@@ -90,9 +208,16 @@ struct ubi_device {
 	struct rbtree vols; /**< Red-black tree of volumes:
 			       - Key: Volume identifier
 			       - Value: Volume pointer */
+
+	uint32_t erase_peb_us; /**< Measured time of one PEB erase and EC header program or 0. */
+	size_t quota_rsvd_pebs; /**< Free PEBs reserved by volume quotas. */
+
+	struct ubi_rbt_item *journal; /**< PEB of unmap journal keyed by erase counter, or NULL. */
+	size_t journal_offset; /**< Offset of next unmap record within journal LEB data. */
+	uint64_t sqnum_ceiling; /**< Sequence numbers below it are reserved by the journal. */
 };
 
-BUILD_ASSERT(sizeof(struct ubi_device) == 112);
+BUILD_ASSERT(sizeof(struct ubi_device) == 384);
 
 /**
  * \brief Red-black tree item used in UBI.
@@ -128,8 +253,47 @@ struct ubi_list_item {
 
 BUILD_ASSERT(sizeof(struct ubi_list_item) == 12);
 
+/**
+ * \brief Dirty PEB selected for a batch erase.
+ */
+struct ubi_erase_slot {
+	struct ubi_rbt_item *item; /**< Dirty PEB item, key holds erase counter. */
+	struct ubi_ec_hdr ec_hdr; /**< EC header saved before erase. */
+	size_t offset; /**< Offset of the PEB within its partition. */
+	uint32_t cost_us; /**< Measured time of the PEB erase and EC header program. */
+	uint8_t partition_id; /**< Partition holding the PEB. */
+	bool is_bad; /**< PEB failed to erase or program. */
+};
+
+/**
+ * \brief UBI volume table transaction.
+ *
+ * Holds a staged copy of the volume table. Operations edit the copy only, commit writes it as one
+ * new revision and applies the result to the in-memory volumes.
+ */
+struct ubi_vol_txn {
+	struct ubi_device *ubi; /**< Device locked by the transaction. */
+
+	size_t leb_usable_count; /**< Number of LEBs available to volumes. */
+	size_t vols_seqnr; /**< Staged volume sequence counter. */
+	size_t nr_of_ops; /**< Number of staged operations. */
+
+	size_t vol_count; /**< Number of staged volume headers. */
+	struct ubi_vol_hdr vol_hdrs[CONFIG_UBI_MAX_NR_OF_VOLUMES]; /**< Staged volume headers. */
+};
+
 /* Module interface variables and constants ---------------------------------------------------- */
 /* Static variables and constants -------------------------------------------------------------- */
+
+/** Latency target of each class, added to arrival time to get dispatch deadline. */
+static const uint32_t io_class_target_ms[UBI_IO_CLASS_COUNT] = {
+	[UBI_IO_CLASS_URGENT] = 0,
+	[UBI_IO_CLASS_NORMAL] = 10,
+	[UBI_IO_CLASS_ERASE] = 100,
+	[UBI_IO_CLASS_WEAR_LEVELING] = 500,
+	[UBI_IO_CLASS_SCRUB] = 1000,
+};
+
 /* Static function declarations ---------------------------------------------------------------- */
 
 /**
@@ -181,978 +345,4941 @@ static void move_to_bad_blocks(struct ubi_device *ubi, size_t pnum, size_t nr_of
  * \param lnum  	Logical eraseblock number within the volume.
  * \param[in] buf   	Pointer to the data buffer to be written.
  * \param len   	Length of the buffer in bytes.
+ * \param io_class 	Class of the request, or UBI_IO_CLASS_OF_VOLUME.
+ * \param is_admitted	Write was already admitted against volume quota by the caller.
  *
  * \return 0 on success, negative error code on failure.
  */
-static int leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf, size_t len);
-
-/* Static function definitions ----------------------------------------------------------------- */
-
-static bool ubi_rbt_cmp(struct rbnode *a, struct rbnode *b)
-{
-	__ASSERT_NO_MSG(a);
-	__ASSERT_NO_MSG(b);
-
-	struct ubi_rbt_item *data_a = CONTAINER_OF(a, struct ubi_rbt_item, node);
-	struct ubi_rbt_item *data_b = CONTAINER_OF(b, struct ubi_rbt_item, node);
+static int leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf, size_t len,
+		     enum ubi_io_class io_class, bool is_admitted);
 
-	if (data_a->key > data_b->key)
-		return false;
+/**
+ * \brief Read data from a logical eraseblock (LEB).
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param vol_id 	ID of the source volume.
+ * \param lnum  	Logical eraseblock number within the volume.
+ * \param offset 	Offset in bytes within the LEB.
+ * \param[out] buf   	Pointer to the output buffer.
+ * \param size   	Size of the buffer in bytes.
+ * \param io_class 	Class of the request, or UBI_IO_CLASS_OF_VOLUME.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_read(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset, void *buf,
+		    size_t size, enum ubi_io_class io_class);
 
-	return true;
-}
+/**
+ * \brief Read LEB data of a PEB, decrypt and decompress it as its volume and VID header say.
+ *
+ * \param[in] flash 	Pointer to memory technology device.
+ * \param pnum  	Physical eraseblock number.
+ * \param[in] codec 	Format of LEB data of the volume.
+ * \param offset 	Offset in bytes within decompressed data.
+ * \param[out] buf   	Pointer to the output buffer.
+ * \param size   	Size of the buffer in bytes.
+ *
+ * \return 0 on success, -EPERM if volume key is not set, negative error code on failure.
+ */
+static int leb_data_unpack(const struct ubi_flash *flash, size_t pnum,
+			   const struct ubi_leb_codec *codec, size_t offset, void *buf,
+			   size_t size);
 
-static struct ubi_rbt_item *ubi_rbt_search(struct rbtree *tree, uint32_t key)
-{
-	__ASSERT_NO_MSG(tree);
+/**
+ * \brief Check whether data consists of one repeated byte, a word at a time.
+ *
+ * \param[in] buf   	Pointer to the data.
+ * \param len   	Size of the data in bytes, non-zero.
+ * \param[out] fill 	Repeated byte value.
+ *
+ * \return true if all bytes are equal, false otherwise.
+ */
+static bool leb_data_is_uniform(const uint8_t *buf, size_t len, uint8_t *fill);
 
-	struct rbnode *node = tree->root;
+/**
+ * \brief Fill the part of a read range past LEB data size as a raw write leaves it.
+ *
+ * Zero padding up to write block size and erased bytes past it, so LEBs stored packed read the
+ * same as raw ones beyond their data.
+ *
+ * \param data_size 	Size of LEB data in bytes.
+ * \param offset 	Offset in bytes within LEB data.
+ * \param[out] buf   	Pointer to the output buffer.
+ * \param size   	Size of the buffer in bytes.
+ */
+static void leb_tail_read(size_t data_size, size_t offset, uint8_t *buf, size_t size);
 
-	while (node) {
-		struct ubi_rbt_item *item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+/**
+ * \brief Synthesize a range of pattern LEB data from its VID header.
+ *
+ * Bytes read as if the data had been programmed: fill up to data size, zero padding up to write
+ * block size and erased bytes past it.
+ *
+ * \param[in] vid_hdr 	Pointer to VID header of the LEB.
+ * \param offset 	Offset in bytes within LEB data.
+ * \param[out] buf   	Pointer to the output buffer.
+ * \param size   	Size of the buffer in bytes.
+ */
+static void leb_pattern_read(const struct ubi_vid_hdr *vid_hdr, size_t offset, uint8_t *buf,
+			     size_t size);
 
-		if (key < item->key) {
-			node = RBT_PTR(node->children[0]); // Go left
-		} else if (key > item->key) {
-			node = RBT_PTR(node->children[1]); // Go right
-		} else {
-			return item; // Match!
-		}
-	}
+/**
+ * \brief Prepare streaming of LEB data of a PEB, VID header is read only for a cipher.
+ *
+ * \param[in] flash 	Pointer to memory technology device.
+ * \param pnum  	Physical eraseblock number.
+ * \param[in] crypto 	Cipher of the volume, NULL if data is not encrypted.
+ * \param[out] io   	Pointer to the LEB data stream.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_io_open(const struct ubi_flash *flash, size_t pnum, struct ubi_crypto *crypto,
+		       struct ubi_leb_io *io);
 
-	return NULL;
-}
+/**
+ * \brief Program LEB data, encrypted in chunks if cipher is set. Used as compression sink too.
+ *
+ * \param[in] ctx   	Pointer to struct ubi_leb_io.
+ * \param offset 	Offset of the chunk within LEB data, a multiple of write block size.
+ * \param[in] buf   	Data to program.
+ * \param len   	Size of the data in bytes.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_io_write(void *ctx, size_t offset, const uint8_t *buf, size_t len);
 
-static void move_to_bad_blocks(struct ubi_device *ubi, size_t pnum, size_t nr_of_erases,
-			       struct ubi_list_item *bad_item)
-{
-	__ASSERT_NO_MSG(ubi);
-	__ASSERT_NO_MSG(bad_item);
+/**
+ * \brief Read LEB data, decrypted in place if cipher is set. Used as decompression source too.
+ *
+ * \param[in] ctx   	Pointer to struct ubi_leb_io.
+ * \param offset 	Offset within LEB data.
+ * \param[out] buf   	Output buffer.
+ * \param len   	Number of bytes to read.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_io_read(void *ctx, size_t offset, uint8_t *buf, size_t len);
 
-	bad_item->peb_index = pnum;
-	bad_item->nr_of_erases = nr_of_erases;
-	sys_slist_append(&ubi->bad_pebs, &bad_item->node);
-	ubi->bad_pebs_size += 1;
-}
+/**
+ * \brief Search a volume and wait until it has no LEB write in flight.
+ *
+ * Device lock must be held exactly once, it is released while waiting.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param vol_id 	ID of the volume.
+ *
+ * \return Pointer to the volume, or NULL if it does not exist.
+ */
+static struct ubi_volume *volume_wait_idle(struct ubi_device *ubi, int vol_id);
 
-static int leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf, size_t len)
-{
-	__ASSERT_NO_MSG(ubi);
-	__ASSERT_NO_MSG(vol_id >= 0);
-	__ASSERT_NO_MSG((buf && len > 0) || (!buf && len == 0));
+/**
+ * \brief Wait until no LEB write of the device is in flight.
+ *
+ * Used by volume table changes, which must not free or snapshot a volume being written.
+ * Device lock must be held exactly once, it is released while waiting.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ */
+static void device_wait_idle(struct ubi_device *ubi);
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+/**
+ * \brief Search a red-black tree which may be modified concurrently.
+ *
+ * Walk is bounded, so a torn tree cannot loop it forever. Result is valid only if the sequence
+ * counter guarding the tree is unchanged afterwards.
+ *
+ * \param[in] tree 	Pointer to the red-black tree to search.
+ * \param key  		32-bit key to search for.
+ *
+ * \return Pointer to the matching ubi_rbt_item, or NULL if not found.
+ */
+static struct ubi_rbt_item *ubi_rbt_search_optimistic(const struct rbtree *tree, uint32_t key);
 
-	int ret = -EIO;
+/**
+ * \brief Mark start of a change guarded by a sequence counter.
+ *
+ * Device lock must be held. Lock-free readers fall back to the lock until the change ends.
+ *
+ * \param[in] seq 	Pointer to the sequence counter.
+ */
+static void seq_write_begin(atomic_t *seq);
 
-	if (0 == ubi->vols_size) {
-		LOG_ERR("No volumes present on device");
-		ret = -ENOENT;
-		goto exit;
-	}
+/**
+ * \brief Mark end of a change guarded by a sequence counter.
+ *
+ * \param[in] seq 	Pointer to the sequence counter.
+ */
+static void seq_write_end(atomic_t *seq);
 
-	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+/**
+ * \brief Wait until lock-free readers which may still see unlinked items are gone.
+ *
+ * Called with device lock held between unlinking an item and freeing or erasing it. Readers
+ * never take the lock inside a read section, so waiting with the lock held cannot deadlock.
+ * Returns at once if no reader is inside, otherwise sleeps until the last one leaves.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ */
+static void reader_sync(struct ubi_device *ubi);
 
-	if (!entry) {
-		LOG_ERR("Device volume not found");
-		ret = -ENOENT;
-		goto exit;
-	}
+/**
+ * \brief Enter a lock-free read section.
+ *
+ * Reader counts into the parity of the current grace period. If a writer ended that period
+ * before the count, the writer did not wait for it, so the reader counts again into the new one.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ *
+ * \return Grace period parity the reader counted into, to be passed to reader_exit().
+ */
+static atomic_val_t reader_enter(struct ubi_device *ubi);
 
-	struct ubi_volume *vol = entry->value.vol;
+/**
+ * \brief Leave a lock-free read section.
+ *
+ * Last reader of a grace period already ended by reader_sync() wakes the waiting writer.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param epoch 	Grace period parity the reader counted into.
+ */
+static void reader_exit(struct ubi_device *ubi, atomic_val_t epoch);
 
-	if (lnum > vol->cfg.leb_count) {
-		LOG_ERR("Volume LEB limit exceeded");
-		ret = -EACCES;
-		goto exit;
-	}
+/**
+ * \brief Look up the PEB mapped to a LEB.
+ *
+ * Runs either inside a read section or with device lock held. Without the lock tree walks are
+ * validated by sequence counters and retried a few times.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param vol_id 	ID of the volume.
+ * \param lnum  	Logical eraseblock number.
+ * \param[out] is_mapped	true if LEB is mapped, false otherwise.
+ * \param[out] pnum  	Physical eraseblock number of a mapped LEB.
+ * \param[out] codec 	Format of LEB data of the volume, may be NULL.
+ *
+ * \return 0 on success, -EAGAIN if a lock-free lookup could not complete, or negative error code.
+ */
+static int eba_lookup(struct ubi_device *ubi, int vol_id, size_t lnum, bool *is_mapped,
+		      size_t *pnum, struct ubi_leb_codec *codec);
 
-	if (0 == ubi->free_pebs_size) {
-		LOG_ERR("Lack of free PEBs");
-		ret = -ENOSPC;
-		goto exit;
-	}
+/**
+ * \brief Look up the PEB mapped to a LEB and pin it against erase.
+ *
+ * Lookup runs lock-free inside a read section, which delays erase of the PEB until
+ * eba_unpin(). If a writer keeps changing the mapping, it falls back to the device lock. Pin is
+ * held on return regardless of result.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param vol_id 	ID of the volume.
+ * \param lnum  	Logical eraseblock number.
+ * \param[out] is_mapped	true if LEB is mapped, false otherwise.
+ * \param[out] pnum  	Physical eraseblock number of a mapped LEB.
+ * \param[out] codec 	Format of LEB data of the volume, may be NULL.
+ * \param[out] pin  	Pin to pass to eba_unpin().
+ * \param io_class 	Class of the request, or UBI_IO_CLASS_OF_VOLUME.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int eba_pin(struct ubi_device *ubi, int vol_id, size_t lnum, bool *is_mapped,
+		   size_t *pnum, struct ubi_leb_codec *codec, atomic_val_t *pin,
+		   enum ubi_io_class io_class);
 
-	if (len > (ubi->mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE)) {
-		LOG_ERR("Too big buffer to write in LEB");
-		ret = -ENOSPC;
-		goto exit;
-	}
+/**
+ * \brief Release a pin taken by eba_pin().
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param pin  		Pin returned by eba_pin().
+ */
+static void eba_unpin(struct ubi_device *ubi, atomic_val_t pin);
 
-	entry = ubi_rbt_search(&vol->eba_tbl, lnum);
+/**
+ * \brief Build immutable mapping of a sealed volume from its EBA table.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ * \param[out] sealed 	Pointer to the mapping, holding one reference.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int sealed_map_build(const struct ubi_device *ubi, struct ubi_volume *vol,
+			    struct ubi_sealed_volume **sealed);
 
-	if (entry) {
-		struct ubi_ec_hdr ec_hdr = { 0 };
-		ret = ubi_ec_hdr_read(&ubi->mtd, entry->value.pnum, &ec_hdr);
+/**
+ * \brief Drop one reference of a sealed volume mapping, free it with the last one.
+ *
+ * \param[in] sealed 	Pointer to the mapping, may be NULL.
+ */
+static void sealed_map_put(struct ubi_sealed_volume *sealed);
 
-		if (0 != ret) {
-			LOG_ERR("EC header read failure");
-			goto exit;
-		}
+/**
+ * \brief Check if a volume may be removed.
+ *
+ * \param[in] vol   	Pointer to the volume.
+ *
+ * \return true if no handle of a sealed volume is open, false otherwise.
+ */
+static bool sealed_map_is_idle(const struct ubi_volume *vol);
 
-		rb_remove(&vol->eba_tbl, &entry->node);
-		vol->eba_tbl_size -= 1;
+/**
+ * \brief Check if a PEB is shared with another volume.
+ *
+ * A snapshot and its source volume share PEBs of LEBs not rewritten since the snapshot was taken.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume which maps the PEB.
+ * \param lnum  	Logical eraseblock number.
+ * \param pnum  	Physical eraseblock number.
+ *
+ * \return true if another volume maps \p lnum to \p pnum, false otherwise.
+ */
+static bool peb_is_shared(struct ubi_device *ubi, const struct ubi_volume *vol, size_t lnum,
+			  size_t pnum);
 
-		entry->key = ec_hdr.ec;
-		rb_insert(&ubi->dirty_pebs, &entry->node);
-		ubi->dirty_pebs_size += 1;
-	}
+/**
+ * \brief Take a free PEB for a LEB write.
+ *
+ * The least worn free PEB is taken. On a striped device the least worn free PEB of the LEB stripe
+ * is preferred, so consecutive LEBs sit on different partitions.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param lnum  	Logical eraseblock number.
+ *
+ * \return Pointer to the free PEB item, removed from free PEBs.
+ */
+static struct ubi_rbt_item *free_peb_take(struct ubi_device *ubi, size_t lnum);
 
-	struct rbnode *min_rbnode = rb_get_min(&ubi->free_pebs);
-	struct ubi_rbt_item *min_node = CONTAINER_OF(min_rbnode, struct ubi_rbt_item, node);
+/**
+ * \brief Check if a LEB write has to wait for PEB erases running unlocked to get a free PEB.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the written volume.
+ *
+ * \return true if no free PEB is left for the volume and no dirty PEB is left to erase, but
+ *         erased PEBs are still to come back, false otherwise.
+ */
+static bool free_peb_is_pending(const struct ubi_device *ubi, const struct ubi_volume *vol);
 
-	rb_remove(&ubi->free_pebs, &min_node->node);
+/**
+ * \brief Remove a LEB from volume EBA table and drop its PEB reference.
+ *
+ * The PEB is moved to dirty PEBs once no other volume maps it.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ * \param[in] item  	Pointer to the EBA table item.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int peb_release(struct ubi_device *ubi, struct ubi_volume *vol, struct ubi_rbt_item *item);
+
+/**
+ * \brief Remove mapped LEBs of a range from volume EBA table and drop their PEB references.
+ *
+ * Unlike peb_release() no EC header is read. Released PEBs enter dirty PEBs keyed by erase
+ * counter 0, so they are erased first and erasure reads their real erase counters. Readers of
+ * PEBs still mapped by snapshots are waited for once for the whole range.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ * \param first  	First logical eraseblock number of the range.
+ * \param count  	Number of LEBs in the range.
+ */
+static void leb_unmap_range(struct ubi_device *ubi, struct ubi_volume *vol, size_t first,
+			    size_t count);
+
+/**
+ * \brief Take a free PEB for the unmap journal and program its VID header.
+ *
+ * Dirty PEBs are erased on demand when no free PEB is left.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ *
+ * \return 0 on success, -ENOSPC if no PEB is left, or negative error code.
+ */
+static int journal_open(struct ubi_device *ubi);
+
+/**
+ * \brief Replace a full unmap journal by a new one.
+ *
+ * New journal records again LEBs whose older PEBs may still be on flash and is completed before
+ * the full one is handed to dirty PEBs, so power cut at any point leaves one complete journal
+ * holding every needed record. Dirty PEBs are erased only when records do not fit half of the
+ * journal.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int journal_renew(struct ubi_device *ubi);
+
+/**
+ * \brief Record again unmapped LEBs of durable volumes which may still have a PEB on flash.
+ *
+ * LEB needs a record if one of dirty PEBs belongs to it or a snapshot still maps it. Consecutive
+ * LEBs of a volume share one record.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param write   	Program records into the journal if true, only count them otherwise.
+ * \param[out] count	Number of records.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int journal_rerecord(struct ubi_device *ubi, bool write, size_t *count);
+
+/**
+ * \brief Check if an unmap journal PEB holds the completion record of its opening.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param pnum  	Physical eraseblock number of the journal.
+ * \param[out] complete	True if journal is complete.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int journal_is_complete(struct ubi_device *ubi, size_t pnum, bool *complete);
+
+/**
+ * \brief Check if journal record of a volume has to wait for PEB erases running unlocked.
+ *
+ * Full journal is renewed only once no dirty PEB is being erased. Caller waits for write_done
+ * and looks its volume up again.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ *
+ * \return true if caller has to wait, false otherwise.
+ */
+static bool journal_is_busy(const struct ubi_device *ubi, const struct ubi_volume *vol);
+
+/**
+ * \brief Program one unmap record at the end of the unmap journal.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param vol_id  	Volume ID.
+ * \param first  	First logical eraseblock number of the range.
+ * \param count  	Number of LEBs in the range.
+ * \param sqnum  	Sequence number of the record.
+ *
+ * \return 0 on success, -ENOSPC if journal is full, or negative error code.
+ */
+static int journal_write(struct ubi_device *ubi, size_t vol_id, size_t first, size_t count,
+			 uint64_t sqnum);
+
+/**
+ * \brief Program one record into the unmap journal, opening or renewing it as needed.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param vol_id  	Volume ID.
+ * \param first  	First logical eraseblock number of the range.
+ * \param count  	Number of LEBs in the range.
+ * \param sqnum  	Sequence number of the record.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int journal_record(struct ubi_device *ubi, size_t vol_id, size_t first, size_t count,
+			  uint64_t sqnum);
+
+/**
+ * \brief Record unmap of a LEB range before it is unmapped.
+ *
+ * Only volumes with durable unmap are recorded. Journal is opened on first use and renewed when
+ * full.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ * \param first  	First logical eraseblock number of the range.
+ * \param count  	Number of LEBs in the range.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int journal_append(struct ubi_device *ubi, const struct ubi_volume *vol, size_t first,
+			  size_t count);
+
+/**
+ * \brief Reserve next block of sequence numbers in the unmap journal for an encrypted write.
+ *
+ * Attach resumes sequence numbers above the reserved ones, so counter blocks of encrypted data
+ * stay unique even once PEBs holding the highest sequence numbers are erased. Nothing is done
+ * for other volumes or while reserved sequence numbers are left.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ *
+ * \return 0 on success, -EAGAIN if caller has to wait for write_done and look its volume up
+ *         again, or negative error code.
+ */
+static int journal_reserve(struct ubi_device *ubi, const struct ubi_volume *vol);
+
+/**
+ * \brief Unmap LEBs whose PEBs are older than unmap records of the journal, during attach.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int journal_replay(struct ubi_device *ubi);
+
+/**
+ * \brief Map a LEB to a new PEB holding a copy of the shared PEB.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ * \param lnum  	Logical eraseblock number.
+ * \param old_pnum	Physical eraseblock number shared with snapshot.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_copy_on_write(struct ubi_device *ubi, struct ubi_volume *vol, size_t lnum,
+			     size_t old_pnum);
+
+/**
+ * \brief Attach a scanned PEB to snapshots of its volume.
+ *
+ * Snapshot keeps the PEB with the greatest sequence number below its snapshot sequence number.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the source volume of the PEB.
+ * \param[in] vid_hdr	Pointer to VID header of the PEB.
+ * \param pnum  	Physical eraseblock number.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int snapshot_attach_peb(struct ubi_device *ubi, const struct ubi_volume *vol,
+			       const struct ubi_vid_hdr *vid_hdr, size_t pnum);
+
+/**
+ * \brief Count LEBs which may still be allocated by volumes.
+ *
+ * \param[in] info   	Pointer to device informations.
+ *
+ * \return Number of LEBs available for allocation, reserved LEBs excluded.
+ */
+static size_t leb_avail_count(const struct ubi_device_info *info);
+
+/**
+ * \brief Erase a flash range in chunks of CONFIG_UBI_ERASE_CHUNK_SIZE bytes.
+ *
+ * Other threads get the CPU between chunks, so flash reads are not queued behind a whole
+ * range erase. Range is erased at once if chunk size is zero or does not divide it.
+ *
+ * \param[in] fa   	Pointer to the flash area.
+ * \param offset  	Offset of the range in bytes.
+ * \param size  	Size of the range in bytes.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int peb_range_erase(const struct flash_area *fa, size_t offset, size_t size);
+
+/**
+ * \brief Take the device lock as a request of a given class.
+ *
+ * Owner may take it again without waiting. Others wait until it is handed over to them.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param io_class 	Class of the request.
+ */
+static void device_lock(struct ubi_device *ubi, enum ubi_io_class io_class);
+
+/**
+ * \brief Release the device lock taken by device_lock().
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ */
+static void device_unlock(struct ubi_device *ubi);
+
+/**
+ * \brief Release the device lock, wait for a condition variable and take the lock again.
+ *
+ * Device lock must be held exactly once. Signalling side must use device_broadcast().
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] cond   	Pointer to the condition variable.
+ */
+static void device_wait(struct ubi_device *ubi, struct k_condvar *cond);
+
+/**
+ * \brief Wake all threads waiting in device_wait() for a condition variable.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] cond   	Pointer to the condition variable.
+ */
+static void device_broadcast(struct ubi_device *ubi, struct k_condvar *cond);
+
+/**
+ * \brief Hand a free device over to the waiting request with earliest deadline.
+ *
+ * Scheduler lock must be held.
+ *
+ * \param[in] sched   	Pointer to the device scheduler.
+ */
+static void io_dispatch(struct ubi_io_sched *sched);
+
+/**
+ * \brief Raise priority of the device owner to the highest priority of the waiting requests.
+ *
+ * Scheduler lock must be held.
+ *
+ * \param[in] sched   	Pointer to the device scheduler.
+ */
+static void io_owner_boost(struct ubi_io_sched *sched);
+
+/**
+ * \brief Restore priority the device owner had before it was raised by waiting requests.
+ *
+ * Scheduler lock must be held and the calling thread must own the device.
+ *
+ * \param[in] sched   	Pointer to the device scheduler.
+ */
+static void io_owner_restore(struct ubi_io_sched *sched);
+
+/**
+ * \brief Resolve class of a LEB request.
+ *
+ * Class of the volume is read without the device lock, normal class is used if a writer changes
+ * the volume tree meanwhile.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param vol_id 	ID of the volume.
+ * \param io_class 	Class given by caller, or UBI_IO_CLASS_OF_VOLUME.
+ *
+ * \return Class of the request.
+ */
+static enum ubi_io_class io_class_resolve(struct ubi_device *ubi, int vol_id,
+					  enum ubi_io_class io_class);
+
+/**
+ * \brief Release the device, sleep and take the device back with the same class.
+ *
+ * Device lock must be held exactly once.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param timeout 	Time to sleep.
+ */
+static void device_sleep(struct ubi_device *ubi, k_timeout_t timeout);
+
+/**
+ * \brief Add tokens accumulated since the last refill to both buckets of a quota.
+ *
+ * \param[in] quota 	Pointer to the volume quota.
+ */
+static void quota_refill(struct ubi_vol_quota *quota);
+
+/**
+ * \brief Compute time until a bucket holds enough tokens for a request.
+ *
+ * Costs above the burst wait for a full bucket only, so they are never refused forever.
+ *
+ * \param[in] bucket 	Pointer to the token bucket.
+ * \param cost 		Number of tokens the request takes.
+ *
+ * \return Delay in milliseconds, 0 if request may proceed now.
+ */
+static int64_t quota_bucket_delay_ms(const struct ubi_quota_bucket *bucket, size_t cost);
+
+/**
+ * \brief Admit a write of a volume against its quota and take the tokens.
+ *
+ * Device lock must be held. Writes under a device lock already held by the caller, e.g. in a
+ * volume table transaction, cannot sleep for refill and fail with -EAGAIN when over quota.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ * \param pebs  	Number of PEBs the write consumes.
+ * \param bytes 	Number of data bytes the write programs.
+ * \param[out] delay_ms	Time until refill if the caller should sleep and retry, 0 otherwise.
+ *
+ * \return 0 on success, -EAGAIN if over quota.
+ */
+static int quota_admit(struct ubi_device *ubi, struct ubi_volume *vol, size_t pebs, size_t bytes,
+		       int64_t *delay_ms);
+
+/**
+ * \brief Give back tokens taken by quota_admit() for a write which did not happen.
+ *
+ * \param[in] vol   	Pointer to the volume.
+ * \param pebs  	Number of PEBs admitted.
+ * \param bytes 	Number of data bytes admitted.
+ */
+static void quota_refund(struct ubi_volume *vol, size_t pebs, size_t bytes);
+
+/**
+ * \brief Free write quota of a volume and return its reserved PEBs.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ * \param[in] vol   	Pointer to the volume.
+ */
+static void quota_release(struct ubi_device *ubi, struct ubi_volume *vol);
+
+/**
+ * \brief Search staged volume header by volume identifier.
+ *
+ * \param[in] txn   	Pointer to the volume table transaction.
+ * \param vol_id  	Volume identifier.
+ *
+ * \return Pointer to staged volume header, or NULL if not found.
+ */
+static struct ubi_vol_hdr *txn_vol_search(struct ubi_vol_txn *txn, size_t vol_id);
+
+/**
+ * \brief Search staged volume header by volume name.
+ *
+ * \param[in] txn   	Pointer to the volume table transaction.
+ * \param[in] name  	Volume name.
+ *
+ * \return Pointer to staged volume header, or NULL if not found.
+ */
+static struct ubi_vol_hdr *txn_vol_search_name(struct ubi_vol_txn *txn,
+					       const unsigned char *name);
+
+/**
+ * \brief Count LEBs not allocated by staged volume headers.
+ *
+ * \param[in] txn   	Pointer to the volume table transaction.
+ *
+ * \return Number of LEBs available for allocation.
+ */
+static size_t txn_avail_lebs(const struct ubi_vol_txn *txn);
+
+/**
+ * \brief Grow volume with autoresize flag over all unallocated LEBs and clear the flag.
+ *
+ * \param[in] ubi   	Pointer to the UBI device structure.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int volume_autoresize(struct ubi_device *ubi);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static bool ubi_rbt_cmp(struct rbnode *a, struct rbnode *b)
+{
+	__ASSERT_NO_MSG(a);
+	__ASSERT_NO_MSG(b);
+
+	struct ubi_rbt_item *data_a = CONTAINER_OF(a, struct ubi_rbt_item, node);
+	struct ubi_rbt_item *data_b = CONTAINER_OF(b, struct ubi_rbt_item, node);
+
+	if (data_a->key > data_b->key)
+		return false;
+
+	return true;
+}
+
+static struct ubi_rbt_item *ubi_rbt_search(struct rbtree *tree, uint32_t key)
+{
+	__ASSERT_NO_MSG(tree);
+
+	struct rbnode *node = tree->root;
+
+	while (node) {
+		struct ubi_rbt_item *item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+
+		if (key < item->key) {
+			node = RBT_PTR(node->children[0]); // Go left
+		} else if (key > item->key) {
+			node = RBT_PTR(node->children[1]); // Go right
+		} else {
+			return item; // Match!
+		}
+	}
+
+	return NULL;
+}
+
+static void move_to_bad_blocks(struct ubi_device *ubi, size_t pnum, size_t nr_of_erases,
+			       struct ubi_list_item *bad_item)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(bad_item);
+
+	bad_item->peb_index = pnum;
+	bad_item->nr_of_erases = nr_of_erases;
+	sys_slist_append(&ubi->bad_pebs, &bad_item->node);
+	ubi->bad_pebs_size += 1;
+}
+
+static int leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf, size_t len,
+		     enum ubi_io_class io_class, bool is_admitted)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol_id >= 0);
+	__ASSERT_NO_MSG((buf && len > 0) || (!buf && len == 0));
+
+	io_class = io_class_resolve(ubi, vol_id, io_class);
+	device_lock(ubi, io_class);
+
+	int ret = -EIO;
+
+	if (0 == ubi->vols_size) {
+		LOG_ERR("No volumes present on device");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	struct ubi_volume *vol = NULL;
+	int64_t delay_ms = 0;
+
+search:
+	vol = volume_wait_idle(ubi, vol_id);
+
+	if (!vol) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	if (vol->is_snapshot) {
+		LOG_ERR("Snapshot volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
+
+	if (vol->is_sealed) {
+		LOG_ERR("Sealed volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
+
+	if (lnum > vol->cfg.leb_count) {
+		LOG_ERR("Volume LEB limit exceeded");
+		ret = -EACCES;
+		goto exit;
+	}
+
+	if (len > (ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE)) {
+		LOG_ERR("Too big buffer to write in LEB");
+		ret = -ENOSPC;
+		goto exit;
+	}
+
+	if (vol->cfg.encrypted && !vol->crypto && len > 0) {
+		LOG_ERR("Volume key not set");
+		ret = -EPERM;
+		goto exit;
+	}
+
+	/* Counter blocks of encrypted data take sequence numbers reserved across reboots */
+	ret = journal_reserve(ubi, vol);
+
+	/* Nested callers hold the lock twice and cannot wait, they get -EAGAIN instead */
+	if (-EAGAIN == ret && 1 == ubi->sched.depth) {
+		device_wait(ubi, &ubi->write_done);
+		goto search;
+	}
+
+	if (0 != ret)
+		goto exit;
+
+	/* PEBs erased unlocked by other threads come back free, wait rather than fail the write */
+	if (1 == ubi->sched.depth && free_peb_is_pending(ubi, vol)) {
+		device_wait(ubi, &ubi->write_done);
+		goto search;
+	}
+
+	/* Free PEBs reserved by quotas of other volumes are not taken */
+	const size_t rsvd_pebs = ubi->quota_rsvd_pebs - (vol->quota ? vol->quota->reserved_pebs : 0);
+
+	/* Reclaim dirty PEBs on demand rather than fail the write */
+	while (ubi->free_pebs_size <= rsvd_pebs && ubi->dirty_pebs_size > 0) {
+		ret = ubi_device_erase_peb(ubi);
+
+		if (0 != ret) {
+			LOG_ERR("Dirty PEB erase failure");
+			goto exit;
+		}
+	}
+
+	if (ubi->free_pebs_size <= rsvd_pebs) {
+		LOG_ERR("Lack of free PEBs");
+		ret = -ENOSPC;
+		goto exit;
+	}
+
+	/* Writes failing for lack of free PEBs are not charged, so admit once a PEB is there */
+	ret = is_admitted ? 0 : quota_admit(ubi, vol, 1, len, &delay_ms);
+
+	if (0 != delay_ms) {
+		/* Volume may change while device is released, so check it again */
+		device_sleep(ubi, K_MSEC(delay_ms));
+		goto search;
+	}
+
+	if (0 != ret) {
+		LOG_ERR("Volume write quota exceeded");
+		goto exit;
+	}
+
+	/* 1. Pin a free PEB and the volume, so neither is reused until the write commits */
+	struct ubi_rbt_item *min_node = free_peb_take(ubi, lnum);
+
+	vol->is_writing = true;
+	ubi->nr_of_writes += 1;
+
+	const bool is_compressed = vol->cfg.compressed && len > 0;
+
+	struct ubi_vid_hdr vid_hdr = { 0 };
+	vid_hdr.magic = UBI_VID_HDR_MAGIC;
+	vid_hdr.version = UBI_VID_HDR_VERSION;
+	vid_hdr.lnum = lnum;
+	vid_hdr.vol_id = vol->vol_id;
+	vid_hdr.sqnum = ubi->global_seqnr++;
+	vid_hdr.data_size = len;
+
+	/* 2. Compress and program flash unlocked, old PEB stays mapped for readers meanwhile */
+	device_unlock(ubi);
+
+	/* Volume is idle while its key changes, so the cipher stays valid until commit */
+	struct ubi_leb_io io = {
+		.flash = &ubi->flash,
+		.pnum = min_node->value.pnum,
+		.crypto = vol->cfg.encrypted ? vol->crypto : NULL,
+		.tweak = { .sqnum = vid_hdr.sqnum, .lnum = vid_hdr.lnum },
+	};
+	size_t comp_len = 0;
+	size_t erased_len = 0;
+	uint8_t fill = 0;
+
+	/* Uniform data is kept in VID header alone, encrypted volumes do not reveal it that way */
+	if (buf && len > 0 && !vol->cfg.encrypted && leb_data_is_uniform(buf, len, &fill)) {
+		/* Erased data area reads as 0xFF already and stays writable in place */
+		if (0xFF == fill) {
+			erased_len = ROUND_DOWN(len, WRITE_BLOCK_SIZE_ALIGNMENT);
+		} else {
+			vid_hdr.flags = UBI_VID_FLAG_PATTERN;
+			vid_hdr.fill = fill;
+		}
+	} else if (is_compressed) {
+		/* Size goes to VID header ahead of data, so compress twice rather than buffer it */
+		const size_t comp_max = MIN(ROUND_UP(len, WRITE_BLOCK_SIZE_ALIGNMENT),
+					    (size_t)UINT16_MAX * WRITE_BLOCK_SIZE_ALIGNMENT);
+
+		/* Keep data raw unless compression saves at least one write block */
+		if (0 == ubi_lz_compress(buf, len, comp_max - WRITE_BLOCK_SIZE_ALIGNMENT, NULL, NULL,
+					 &comp_len)) {
+			vid_hdr.flags = UBI_VID_FLAG_COMPRESSED;
+			vid_hdr.comp_blocks = comp_len / WRITE_BLOCK_SIZE_ALIGNMENT;
+		}
+	}
+
+	vid_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&vid_hdr, sizeof(vid_hdr) - sizeof(vid_hdr.hdr_crc));
+
+	ret = ubi_vid_hdr_write(&ubi->flash, min_node->value.pnum, &vid_hdr);
+
+	if (0 != ret)
+		LOG_ERR("VID header write failure");
+
+	if (0 == ret && (vid_hdr.flags & UBI_VID_FLAG_COMPRESSED)) {
+		ret = ubi_lz_compress(buf, len, comp_len, leb_io_write, &io, &comp_len);
+
+		if (0 != ret)
+			LOG_ERR("LEB data compression failure");
+	} else if (0 == ret && buf && len > erased_len &&
+		   0 == (vid_hdr.flags & UBI_VID_FLAG_PATTERN)) {
+		ret = leb_io_write(&io, erased_len, (const uint8_t *)buf + erased_len,
+				   len - erased_len);
+
+		if (0 != ret)
+			LOG_ERR("LEB data write failure");
+	}
+
+	device_lock(ubi, io_class);
+
+	/* 3. Commit new mapping, or hand partially programmed PEB over to erase */
+	if (0 != ret) {
+		rb_insert(&ubi->dirty_pebs, &min_node->node);
+		ubi->dirty_pebs_size += 1;
+		goto unpin;
+	}
+
+	seq_write_begin(&vol->eba_seq);
+
+	struct ubi_rbt_item *entry = ubi_rbt_search(&vol->eba_tbl, lnum);
+
+	if (entry)
+		ret = peb_release(ubi, vol, entry);
+
+	if (0 == ret) {
+		struct ubi_rbt_item *alloc_node = min_node;
+		alloc_node->key = lnum;
+		rb_insert(&vol->eba_tbl, &alloc_node->node);
+		vol->eba_tbl_size += 1;
+
+		if (vid_hdr.flags & UBI_VID_FLAG_PATTERN)
+			vol->has_patterns = true;
+	} else {
+		rb_insert(&ubi->dirty_pebs, &min_node->node);
+		ubi->dirty_pebs_size += 1;
+	}
+
+	seq_write_end(&vol->eba_seq);
+
+unpin:
+	vol->is_writing = false;
+	ubi->nr_of_writes -= 1;
+	device_broadcast(ubi, &ubi->write_done);
+
+exit:
+	device_unlock(ubi);
+	return ret;
+}
+
+static int leb_read(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset, void *buf,
+		    size_t size, enum ubi_io_class io_class)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol_id >= 0);
+	__ASSERT_NO_MSG(buf && size > 0);
+
+	int ret = -EIO;
+
+	bool is_mapped = false;
+	struct ubi_leb_codec codec = { 0 };
+	size_t pnum = 0;
+	atomic_val_t pin = UBI_PIN_LOCKED;
+	ret = eba_pin(ubi, vol_id, lnum, &is_mapped, &pnum, &codec, &pin, io_class);
+
+	if (0 != ret)
+		goto exit;
+
+	if (!is_mapped) {
+		LOG_ERR("LEB not found");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	ret = leb_data_unpack(&ubi->flash, pnum, &codec, offset, buf, size);
+
+	if (0 != ret) {
+		LOG_ERR("LEB data read failure");
+		goto exit;
+	}
+
+exit:
+	eba_unpin(ubi, pin);
+	return ret;
+}
+
+static int leb_data_unpack(const struct ubi_flash *flash, size_t pnum,
+			   const struct ubi_leb_codec *codec, size_t offset, void *buf,
+			   size_t size)
+{
+	__ASSERT_NO_MSG(flash);
+	__ASSERT_NO_MSG(codec);
+	__ASSERT_NO_MSG(buf);
+
+	/* Only LEBs of volumes with packed or encrypted data need VID header for the data format */
+	if (!codec->is_compressed && !codec->has_patterns && !codec->is_encrypted)
+		return ubi_leb_data_read(flash, pnum, offset, buf, size);
+
+	if (codec->is_encrypted && !codec->crypto) {
+		LOG_ERR("Volume key not set");
+		return -EPERM;
+	}
+
+	struct ubi_vid_hdr vid_hdr = { 0 };
+	int ret = ubi_vid_hdr_read(flash, pnum, &vid_hdr, true);
+
+	if (0 != ret) {
+		LOG_ERR("VID header read failure");
+		return ret;
+	}
+
+	if (vid_hdr.flags & UBI_VID_FLAG_PATTERN) {
+		leb_pattern_read(&vid_hdr, offset, buf, size);
+		return 0;
+	}
+
+	struct ubi_leb_io io = {
+		.flash = flash,
+		.pnum = pnum,
+		.crypto = codec->is_encrypted ? codec->crypto : NULL,
+		.tweak = { .sqnum = vid_hdr.sqnum, .lnum = vid_hdr.lnum },
+	};
+
+	if (0 == (vid_hdr.flags & UBI_VID_FLAG_COMPRESSED))
+		return leb_io_read(&io, offset, buf, size);
+
+	/* Only data itself is decompressed, bytes past it read as in a raw LEB */
+	const size_t data_len =
+		(offset < vid_hdr.data_size) ? MIN(size, vid_hdr.data_size - offset) : 0;
+
+	if (data_len > 0) {
+		ret = ubi_lz_decompress(leb_io_read, &io,
+					vid_hdr.comp_blocks * WRITE_BLOCK_SIZE_ALIGNMENT,
+					vid_hdr.data_size, offset, buf, data_len);
+
+		if (0 != ret) {
+			LOG_ERR("LEB data decompression failure");
+			return ret;
+		}
+	}
+
+	leb_tail_read(vid_hdr.data_size, offset, buf, size);
+	return 0;
+}
+
+static bool leb_data_is_uniform(const uint8_t *buf, size_t len, uint8_t *fill)
+{
+	__ASSERT_NO_MSG(buf && len > 0);
+	__ASSERT_NO_MSG(fill);
+
+	const uint8_t byte = buf[0];
+	const uint32_t word = byte * 0x01010101U;
+	size_t pos = 0;
+
+	/* Whole words, then the tail, first mismatch ends the scan. Words are copied out, so any
+	 * buffer alignment is fine and compilers still emit single loads where the core allows.
+	 */
+	for (; pos + sizeof(uint32_t) <= len; pos += sizeof(uint32_t)) {
+		uint32_t data = 0;
+		memcpy(&data, &buf[pos], sizeof(data));
+
+		if (data != word)
+			return false;
+	}
+
+	for (; pos < len; ++pos) {
+		if (buf[pos] != byte)
+			return false;
+	}
+
+	*fill = byte;
+	return true;
+}
+
+static void leb_tail_read(size_t data_size, size_t offset, uint8_t *buf, size_t size)
+{
+	__ASSERT_NO_MSG(buf);
+
+	const size_t pad_end = ROUND_UP(data_size, WRITE_BLOCK_SIZE_ALIGNMENT);
+	const size_t end = offset + size;
+
+	if (end <= data_size)
+		return;
+
+	const size_t from = MAX(offset, data_size);
+	uint8_t *tail = &buf[from - offset];
+
+	memset(tail, 0xFF, end - from);
+
+	if (from < pad_end)
+		memset(tail, 0, MIN(end, pad_end) - from);
+}
+
+static void leb_pattern_read(const struct ubi_vid_hdr *vid_hdr, size_t offset, uint8_t *buf,
+			     size_t size)
+{
+	__ASSERT_NO_MSG(vid_hdr);
+	__ASSERT_NO_MSG(buf);
+
+	const size_t data_end = vid_hdr->data_size;
+
+	if (offset < data_end)
+		memset(buf, (uint8_t)vid_hdr->fill, MIN(offset + size, data_end) - offset);
+
+	leb_tail_read(data_end, offset, buf, size);
+}
+
+static int leb_io_open(const struct ubi_flash *flash, size_t pnum, struct ubi_crypto *crypto,
+		       struct ubi_leb_io *io)
+{
+	__ASSERT_NO_MSG(flash);
+	__ASSERT_NO_MSG(io);
+
+	memset(io, 0, sizeof(*io));
+	io->flash = flash;
+	io->pnum = pnum;
+	io->crypto = crypto;
+
+	if (!crypto)
+		return 0;
+
+	struct ubi_vid_hdr vid_hdr = { 0 };
+	int ret = ubi_vid_hdr_read(flash, pnum, &vid_hdr, true);
+
+	if (0 != ret) {
+		LOG_ERR("VID header read failure");
+		return ret;
+	}
+
+	io->tweak.sqnum = vid_hdr.sqnum;
+	io->tweak.lnum = vid_hdr.lnum;
+	return 0;
+}
+
+static int leb_io_write(void *ctx, size_t offset, const uint8_t *buf, size_t len)
+{
+	__ASSERT_NO_MSG(ctx);
+
+	const struct ubi_leb_io *io = ctx;
+
+	if (!io->crypto)
+		return ubi_leb_data_write(io->flash, io->pnum, offset, buf, len);
+
+	int ret = 0;
+	uint8_t chunk[UBI_CRYPTO_CHUNK_SIZE] = { 0 };
+
+	/* Encrypt program unit sized chunks on the way, rather than a copy of the whole LEB */
+	for (size_t pos = 0; pos < len && 0 == ret; pos += sizeof(chunk)) {
+		const size_t chunk_len = MIN(sizeof(chunk), len - pos);
+		const size_t prog_len = ROUND_UP(chunk_len, UBI_CRYPTO_BLOCK_SIZE);
+
+		/* Tail is padded like a raw write pads it, so it decrypts to the same bytes */
+		memset(chunk, 0, sizeof(chunk));
+		memcpy(chunk, &buf[pos], chunk_len);
+
+		ret = ubi_crypto_encrypt(io->crypto, &io->tweak, offset + pos, chunk, prog_len);
+
+		if (0 == ret)
+			ret = ubi_leb_data_write(io->flash, io->pnum, offset + pos, chunk,
+						 prog_len);
+	}
+
+	memset(chunk, 0, sizeof(chunk));
+	return ret;
+}
+
+static int leb_io_read(void *ctx, size_t offset, uint8_t *buf, size_t len)
+{
+	__ASSERT_NO_MSG(ctx);
+
+	const struct ubi_leb_io *io = ctx;
+	int ret = ubi_leb_data_read(io->flash, io->pnum, offset, buf, len);
+
+	if (0 != ret || !io->crypto)
+		return ret;
+
+	const size_t end = offset + len;
+	size_t head = offset;
+	uint8_t blk[UBI_CRYPTO_BLOCK_SIZE] = { 0 };
+
+	/* Partial cipher blocks at both ends go through a block buffer, the rest in place */
+	if (0 != offset % UBI_CRYPTO_BLOCK_SIZE) {
+		const size_t blk_off = ROUND_DOWN(offset, UBI_CRYPTO_BLOCK_SIZE);
+
+		ret = ubi_leb_data_read(io->flash, io->pnum, blk_off, blk, sizeof(blk));
+
+		if (0 == ret)
+			ret = ubi_crypto_decrypt(io->crypto, &io->tweak, blk_off, blk, sizeof(blk));
+
+		if (0 != ret)
+			return ret;
+
+		memcpy(buf, &blk[offset - blk_off], MIN(end, blk_off + sizeof(blk)) - offset);
+		head = blk_off + sizeof(blk);
+	}
+
+	const size_t tail = MAX(head, ROUND_DOWN(end, UBI_CRYPTO_BLOCK_SIZE));
+
+	if (tail > head) {
+		ret = ubi_crypto_decrypt(io->crypto, &io->tweak, head, &buf[head - offset],
+					 tail - head);
+
+		if (0 != ret)
+			return ret;
+	}
+
+	if (end > tail) {
+		ret = ubi_leb_data_read(io->flash, io->pnum, tail, blk, sizeof(blk));
+
+		if (0 == ret)
+			ret = ubi_crypto_decrypt(io->crypto, &io->tweak, tail, blk, sizeof(blk));
+
+		if (0 != ret)
+			return ret;
+
+		memcpy(&buf[tail - offset], blk, end - tail);
+	}
+
+	return 0;
+}
+
+static struct ubi_volume *volume_wait_idle(struct ubi_device *ubi, int vol_id)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	while (true) {
+		struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+
+		if (!entry)
+			return NULL;
+
+		if (!entry->value.vol->is_writing)
+			return entry->value.vol;
+
+		device_wait(ubi, &ubi->write_done);
+	}
+}
+
+static void device_wait_idle(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	while (ubi->nr_of_writes > 0)
+		device_wait(ubi, &ubi->write_done);
+}
+
+static struct ubi_rbt_item *ubi_rbt_search_optimistic(const struct rbtree *tree, uint32_t key)
+{
+	__ASSERT_NO_MSG(tree);
+
+	struct rbnode *node = tree->root;
+
+	for (size_t depth = 0; node && depth < UBI_RBT_MAX_DEPTH; ++depth) {
+		struct ubi_rbt_item *item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+		const uint32_t item_key = item->key;
+
+		if (key < item_key)
+			node = RBT_PTR(node->children[0]);
+		else if (key > item_key)
+			node = RBT_PTR(node->children[1]);
+		else
+			return item;
+	}
+
+	return NULL;
+}
+
+static void seq_write_begin(atomic_t *seq)
+{
+	__ASSERT_NO_MSG(seq);
+	__ASSERT_NO_MSG(0 == (atomic_get(seq) & 1));
+
+	atomic_inc(seq);
+}
+
+static void seq_write_end(atomic_t *seq)
+{
+	__ASSERT_NO_MSG(seq);
+	__ASSERT_NO_MSG(1 == (atomic_get(seq) & 1));
+
+	atomic_inc(seq);
+}
+
+static void reader_sync(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	/* New readers count into the other parity, so readers of the old one only drain */
+	const atomic_val_t epoch = atomic_inc(&ubi->rd_epoch);
+	atomic_t *count = &ubi->rd_count[epoch & 1];
+
+	if (0 == atomic_get(count))
+		return;
+
+	/* Last reader signals under scheduler lock, so the count checked under it cannot miss it */
+	k_mutex_lock(&ubi->sched.lock, K_FOREVER);
+
+	while (0 != atomic_get(count))
+		k_condvar_wait(&ubi->rd_done, &ubi->sched.lock, K_FOREVER);
+
+	k_mutex_unlock(&ubi->sched.lock);
+}
+
+static atomic_val_t reader_enter(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	while (true) {
+		const atomic_val_t epoch = atomic_get(&ubi->rd_epoch) & 1;
+		atomic_inc(&ubi->rd_count[epoch]);
+
+		/* Period still current after the count, so the next reader_sync() waits for it */
+		if (epoch == (atomic_get(&ubi->rd_epoch) & 1))
+			return epoch;
+
+		reader_exit(ubi, epoch);
+	}
+}
+
+static void reader_exit(struct ubi_device *ubi, atomic_val_t epoch)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	/* Readers of the current grace period leave silently, nobody waits for them yet */
+	if (1 == atomic_dec(&ubi->rd_count[epoch]) && epoch != (atomic_get(&ubi->rd_epoch) & 1))
+		device_broadcast(ubi, &ubi->rd_done);
+}
+
+static int eba_lookup(struct ubi_device *ubi, int vol_id, size_t lnum, bool *is_mapped,
+		      size_t *pnum, struct ubi_leb_codec *codec)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(is_mapped);
+	__ASSERT_NO_MSG(pnum);
+
+	for (size_t retry = 0; retry < UBI_LOOKUP_RETRIES; ++retry) {
+		const atomic_val_t vols_seq = atomic_get(&ubi->vols_seq);
+
+		if (vols_seq & 1)
+			return -EAGAIN;
+
+		struct ubi_rbt_item *entry = ubi_rbt_search_optimistic(&ubi->vols, vol_id);
+
+		if (!entry) {
+			if (vols_seq != atomic_get(&ubi->vols_seq))
+				continue;
+
+			LOG_ERR("Device volume not found");
+			return -ENOENT;
+		}
+
+		/* Volume is freed only after a grace period, so it may be read even if stale */
+		struct ubi_volume *vol = entry->value.vol;
+		const atomic_val_t eba_seq = atomic_get(&vol->eba_seq);
+
+		if (eba_seq & 1)
+			return -EAGAIN;
+
+		const size_t leb_count = vol->cfg.leb_count;
+		const struct ubi_leb_codec found_codec = {
+			.is_compressed = vol->cfg.compressed,
+			.has_patterns = vol->has_patterns,
+			.is_encrypted = vol->cfg.encrypted,
+			.crypto = vol->crypto,
+		};
+		entry = (lnum > leb_count) ? NULL : ubi_rbt_search_optimistic(&vol->eba_tbl, lnum);
+		const size_t found = entry ? entry->value.pnum : 0;
+
+		if (vols_seq != atomic_get(&ubi->vols_seq) || eba_seq != atomic_get(&vol->eba_seq))
+			continue;
+
+		if (lnum > leb_count) {
+			LOG_ERR("Volume LEB limit exceeded");
+			return -EACCES;
+		}
+
+		*is_mapped = (NULL != entry);
+		*pnum = found;
+
+		if (codec)
+			*codec = found_codec;
+
+		return 0;
+	}
+
+	return -EAGAIN;
+}
+
+static int eba_pin(struct ubi_device *ubi, int vol_id, size_t lnum, bool *is_mapped,
+		   size_t *pnum, struct ubi_leb_codec *codec, atomic_val_t *pin,
+		   enum ubi_io_class io_class)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(pin);
+
+	*pin = reader_enter(ubi);
+
+	int ret = eba_lookup(ubi, vol_id, lnum, is_mapped, pnum, codec);
+
+	if (-EAGAIN != ret)
+		return ret;
+
+	/* Writer holds the lock while waiting for readers, so leave read section before locking */
+	reader_exit(ubi, *pin);
+
+	device_lock(ubi, io_class_resolve(ubi, vol_id, io_class));
+	*pin = UBI_PIN_LOCKED;
+
+	ret = eba_lookup(ubi, vol_id, lnum, is_mapped, pnum, codec);
+	__ASSERT_NO_MSG(-EAGAIN != ret);
+
+	return ret;
+}
+
+static void eba_unpin(struct ubi_device *ubi, atomic_val_t pin)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	if (UBI_PIN_LOCKED == pin)
+		device_unlock(ubi);
+	else
+		reader_exit(ubi, pin);
+}
+
+static int sealed_map_build(const struct ubi_device *ubi, struct ubi_volume *vol,
+			    struct ubi_sealed_volume **sealed)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+	__ASSERT_NO_MSG(sealed);
+
+	const size_t nr_of_parts = 1 + ubi->flash.mtd.concat_count;
+
+	struct ubi_sealed_volume *map =
+		k_malloc(sizeof(*map) + vol->cfg.leb_count * sizeof(map->pnums[0]));
+	size_t *part_ends = k_malloc(nr_of_parts * sizeof(*part_ends));
+
+	if (!map || !part_ends) {
+		LOG_ERR("Heap allocation failure");
+		k_free(map);
+		k_free(part_ends);
+		return -ENOMEM;
+	}
+
+	atomic_set(&map->refs, 1);
+	/* Handles may outlive the device, so their reads locate PEBs by a copy of its layout */
+	memcpy(part_ends, ubi->flash.part_ends, nr_of_parts * sizeof(*part_ends));
+	map->flash.mtd = ubi->flash.mtd;
+	map->flash.part_ends = part_ends;
+	map->is_compressed = vol->cfg.compressed;
+	map->has_patterns = vol->has_patterns;
+	map->leb_count = vol->cfg.leb_count;
+
+	for (size_t lnum = 0; lnum < map->leb_count; ++lnum)
+		map->pnums[lnum] = UBI_SEALED_UNMAPPED;
+
+	struct ubi_rbt_item *item = NULL;
+	RB_FOR_EACH_CONTAINER(&vol->eba_tbl, item, node)
+	{
+		if (item->key < map->leb_count)
+			map->pnums[item->key] = item->value.pnum;
+	}
+
+	*sealed = map;
+	return 0;
+}
+
+static void sealed_map_put(struct ubi_sealed_volume *sealed)
+{
+	if (sealed && 1 == atomic_dec(&sealed->refs)) {
+		k_free(sealed->flash.part_ends);
+		k_free(sealed);
+	}
+}
+
+static bool sealed_map_is_idle(const struct ubi_volume *vol)
+{
+	__ASSERT_NO_MSG(vol);
+
+	return !vol->sealed || 1 == atomic_get(&vol->sealed->refs);
+}
+
+static bool peb_is_shared(struct ubi_device *ubi, const struct ubi_volume *vol, size_t lnum,
+			  size_t pnum)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+	const size_t family_id = vol->is_snapshot ? vol->src_vol_id : vol->vol_id;
+
+	struct ubi_rbt_item *entry = NULL;
+	RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+	{
+		struct ubi_volume *other = entry->value.vol;
+
+		if (other == vol)
+			continue;
+
+		if (family_id != (other->is_snapshot ? other->src_vol_id : other->vol_id))
+			continue;
+
+		struct ubi_rbt_item *item = ubi_rbt_search(&other->eba_tbl, lnum);
+
+		if (item && pnum == item->value.pnum)
+			return true;
+	}
+
+	return false;
+}
+
+static struct ubi_rbt_item *free_peb_take(struct ubi_device *ubi, size_t lnum)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(ubi->free_pebs_size > 0);
+
+	struct rbnode *min = rb_get_min(&ubi->free_pebs);
+	struct ubi_rbt_item *item = CONTAINER_OF(min, struct ubi_rbt_item, node);
+
+	if (ubi->flash.mtd.striped && ubi->flash.mtd.concat_count > 0) {
+		const size_t stripe = lnum % (1 + ubi->flash.mtd.concat_count);
+
+		/* Free PEBs are ordered by erase counter, so first match is the least worn one */
+		struct ubi_rbt_item *entry = NULL;
+		RB_FOR_EACH_CONTAINER(&ubi->free_pebs, entry, node)
+		{
+			if (stripe == ubi_mtd_peb_stripe(&ubi->flash, entry->value.pnum)) {
+				item = entry;
+				break;
+			}
+		}
+	}
+
+	rb_remove(&ubi->free_pebs, &item->node);
+	ubi->free_pebs_size -= 1;
+
+	return item;
+}
+
+static bool free_peb_is_pending(const struct ubi_device *ubi, const struct ubi_volume *vol)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+	/* Free PEBs reserved by quotas of other volumes are not taken */
+	const size_t rsvd_pebs = ubi->quota_rsvd_pebs - (vol->quota ? vol->quota->reserved_pebs : 0);
+
+	return ubi->free_pebs_size <= rsvd_pebs && 0 == ubi->dirty_pebs_size &&
+	       ubi->nr_of_erases > 0;
+}
+
+static int peb_release(struct ubi_device *ubi, struct ubi_volume *vol, struct ubi_rbt_item *item)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+	__ASSERT_NO_MSG(item);
+
+	if (peb_is_shared(ubi, vol, item->key, item->value.pnum)) {
+		rb_remove(&vol->eba_tbl, &item->node);
+		vol->eba_tbl_size -= 1;
+
+		reader_sync(ubi);
+		k_free(item);
+		return 0;
+	}
+
+	struct ubi_ec_hdr ec_hdr = { 0 };
+	int ret = ubi_ec_hdr_read(&ubi->flash, item->value.pnum, &ec_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("EC header read failure");
+		return ret;
+	}
+
+	rb_remove(&vol->eba_tbl, &item->node);
+	vol->eba_tbl_size -= 1;
+
+	item->key = ec_hdr.ec;
+	rb_insert(&ubi->dirty_pebs, &item->node);
+	ubi->dirty_pebs_size += 1;
+
+	return 0;
+}
+
+static void leb_unmap_range(struct ubi_device *ubi, struct ubi_volume *vol, size_t first,
+			    size_t count)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+	struct rbtree shared = { .lessthan_fn = ubi_rbt_cmp };
+
+	seq_write_begin(&vol->eba_seq);
+
+	for (size_t lnum = first; lnum < first + count && vol->eba_tbl_size > 0; ++lnum) {
+		struct ubi_rbt_item *item = ubi_rbt_search(&vol->eba_tbl, lnum);
+
+		if (!item)
+			continue;
+
+		const bool is_shared = peb_is_shared(ubi, vol, lnum, item->value.pnum);
+
+		rb_remove(&vol->eba_tbl, &item->node);
+		vol->eba_tbl_size -= 1;
+
+		if (is_shared) {
+			rb_insert(&shared, &item->node);
+			continue;
+		}
+
+		item->key = 0;
+		rb_insert(&ubi->dirty_pebs, &item->node);
+		ubi->dirty_pebs_size += 1;
+	}
+
+	seq_write_end(&vol->eba_seq);
+
+	if (!rb_get_min(&shared))
+		return;
+
+	/* Lock-free readers may still hold items of PEBs kept by snapshots */
+	reader_sync(ubi);
+
+	struct rbnode *node = NULL;
+	while ((node = rb_get_min(&shared))) {
+		rb_remove(&shared, node);
+		k_free(CONTAINER_OF(node, struct ubi_rbt_item, node));
+	}
+}
+
+static int journal_open(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(!ubi->journal);
+
+	int ret = 0;
+
+	while (ubi->free_pebs_size <= ubi->quota_rsvd_pebs && ubi->dirty_pebs_size > 0) {
+		ret = ubi_device_erase_peb(ubi);
+
+		if (0 != ret) {
+			LOG_ERR("Dirty PEB erase failure");
+			return ret;
+		}
+	}
+
+	if (ubi->free_pebs_size <= ubi->quota_rsvd_pebs) {
+		LOG_ERR("Lack of free PEBs");
+		return -ENOSPC;
+	}
+
+	struct rbnode *node = rb_get_min(&ubi->free_pebs);
+	struct ubi_rbt_item *item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+
+	rb_remove(&ubi->free_pebs, &item->node);
 	ubi->free_pebs_size -= 1;
 
-	struct ubi_vid_hdr vid_hdr = { 0 };
-	vid_hdr.magic = UBI_VID_HDR_MAGIC;
-	vid_hdr.version = UBI_VID_HDR_VERSION;
-	vid_hdr.lnum = lnum;
-	vid_hdr.vol_id = vol->vol_id;
-	vid_hdr.sqnum = ubi->global_seqnr++;
-	vid_hdr.data_size = len;
-	vid_hdr.hdr_crc =
-		crc32_ieee((const uint8_t *)&vid_hdr, sizeof(vid_hdr) - sizeof(vid_hdr.hdr_crc));
+	struct ubi_vid_hdr vid_hdr = { 0 };
+	vid_hdr.magic = UBI_VID_HDR_MAGIC;
+	vid_hdr.version = UBI_VID_HDR_VERSION;
+	vid_hdr.vol_id = UBI_UNMAP_JOURNAL_VOL_ID;
+	vid_hdr.sqnum = ubi->global_seqnr++;
+	vid_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&vid_hdr, sizeof(vid_hdr) - sizeof(vid_hdr.hdr_crc));
+
+	ret = ubi_vid_hdr_write(&ubi->flash, item->value.pnum, &vid_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("VID header write failure");
+		rb_insert(&ubi->dirty_pebs, &item->node);
+		ubi->dirty_pebs_size += 1;
+		return ret;
+	}
+
+	ubi->journal = item;
+	ubi->journal_offset = 0;
+
+	return 0;
+}
+
+static int journal_rerecord(struct ubi_device *ubi, bool write, size_t *count)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(count);
+
+	int ret = 0;
+
+	*count = 0;
+
+	struct ubi_rbt_item *entry = NULL;
+	RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+	{
+		struct ubi_volume *vol = entry->value.vol;
+
+		if (vol->is_snapshot || !vol->cfg.durable_unmap)
+			continue;
+
+		struct rbtree lebs = { .lessthan_fn = ubi_rbt_cmp };
+		struct ubi_rbt_item *item = NULL;
+		struct rbnode *node = NULL;
+		size_t first = 0;
+		size_t run = 0;
+
+		/* 1. Collect unmapped LEBs of dirty PEBs, mapped ones are hidden by newer PEBs */
+		RB_FOR_EACH_CONTAINER(&ubi->dirty_pebs, item, node)
+		{
+			struct ubi_vid_hdr vid_hdr = { 0 };
+
+			if (0 != ubi_vid_hdr_read(&ubi->flash, item->value.pnum, &vid_hdr, true) ||
+			    vid_hdr.vol_id != vol->vol_id || vid_hdr.sqnum < vol->sqnum_bound ||
+			    ubi_rbt_search(&vol->eba_tbl, vid_hdr.lnum) ||
+			    ubi_rbt_search(&lebs, vid_hdr.lnum))
+				continue;
+
+			struct ubi_rbt_item *leb = k_malloc(sizeof(*leb));
+
+			if (!leb) {
+				LOG_ERR("Heap allocation failure");
+				ret = -ENOMEM;
+				goto release;
+			}
+
+			leb->key = vid_hdr.lnum;
+			rb_insert(&lebs, &leb->node);
+		}
+
+		/* 2. Collect unmapped LEBs whose PEBs are kept by snapshots */
+		struct ubi_rbt_item *snap = NULL;
+		RB_FOR_EACH_CONTAINER(&ubi->vols, snap, node)
+		{
+			struct ubi_volume *snap_vol = snap->value.vol;
+
+			if (!snap_vol->is_snapshot || snap_vol->src_vol_id != vol->vol_id)
+				continue;
+
+			RB_FOR_EACH_CONTAINER(&snap_vol->eba_tbl, item, node)
+			{
+				if (ubi_rbt_search(&vol->eba_tbl, item->key) ||
+				    ubi_rbt_search(&lebs, item->key))
+					continue;
+
+				struct ubi_rbt_item *leb = k_malloc(sizeof(*leb));
+
+				if (!leb) {
+					LOG_ERR("Heap allocation failure");
+					ret = -ENOMEM;
+					goto release;
+				}
+
+				leb->key = item->key;
+				rb_insert(&lebs, &leb->node);
+			}
+		}
+
+		/* 3. Record runs of consecutive LEBs */
+		RB_FOR_EACH_CONTAINER(&lebs, item, node)
+		{
+			if (run > 0 && first + run == item->key) {
+				run += 1;
+				continue;
+			}
+
+			if (run > 0 && write)
+				ret = journal_write(ubi, vol->vol_id, first, run,
+						    ubi->global_seqnr);
+
+			if (0 != ret)
+				goto release;
+
+			*count += (run > 0) ? 1 : 0;
+			first = item->key;
+			run = 1;
+		}
+
+		if (run > 0 && write)
+			ret = journal_write(ubi, vol->vol_id, first, run, ubi->global_seqnr);
+
+		*count += (run > 0) ? 1 : 0;
+
+release:
+		while ((node = rb_get_min(&lebs))) {
+			rb_remove(&lebs, node);
+			k_free(CONTAINER_OF(node, struct ubi_rbt_item, node));
+		}
+
+		if (0 != ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int journal_is_complete(struct ubi_device *ubi, size_t pnum, bool *complete)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(complete);
+
+	const size_t leb_size =
+		ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+
+	struct ubi_unmap_rec empty_rec = { 0 };
+	memset(&empty_rec, 0xff, sizeof(empty_rec));
+
+	*complete = false;
+
+	for (size_t offset = 0; offset + UBI_UNMAP_REC_SIZE <= leb_size;
+	     offset += UBI_UNMAP_REC_SIZE) {
+		struct ubi_unmap_rec rec = { 0 };
+		int ret = ubi_leb_data_read(&ubi->flash, pnum, offset, (uint8_t *)&rec,
+					    sizeof(rec));
+
+		if (0 != ret) {
+			LOG_ERR("Unmap record read failure");
+			return ret;
+		}
+
+		if (0 == memcmp(&rec, &empty_rec, sizeof(rec)))
+			break;
+
+		if (UBI_UNMAP_REC_MAGIC == rec.magic && UBI_UNMAP_JOURNAL_VOL_ID == rec.vol_id &&
+		    rec.rec_crc == crc32_ieee((const uint8_t *)&rec,
+					      sizeof(rec) - sizeof(rec.rec_crc))) {
+			*complete = true;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int journal_renew(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(ubi->journal);
+
+	/* Erases running unlocked were waited for by journal_is_busy() */
+	__ASSERT_NO_MSG(0 == ubi->nr_of_erases);
+
+	const size_t leb_size =
+		ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+	const size_t max_count = leb_size / UBI_UNMAP_REC_SIZE / 2 - 1;
+
+	int ret = 0;
+	size_t count = 0;
+
+	/* 1. Erase dirty PEBs only while records do not fit half of the new journal */
+	while (true) {
+		ret = journal_rerecord(ubi, false, &count);
+
+		if (0 != ret)
+			return ret;
+
+		if (count <= max_count || 0 == ubi->dirty_pebs_size)
+			break;
+
+		ret = ubi_device_erase_pebs(ubi, MIN(count - max_count, ubi->dirty_pebs_size),
+					    NULL);
+
+		if (0 != ret) {
+			LOG_ERR("Dirty PEBs erase failure");
+			return ret;
+		}
+	}
+
+	/* 2. Open new journal, full one stays authoritative until the new one is complete */
+	struct ubi_rbt_item *old = ubi->journal;
+	ubi->journal = NULL;
+
+	ret = journal_open(ubi);
+
+	if (0 != ret) {
+		ubi->journal = old;
+		return ret;
+	}
+
+	/* 3. Record LEBs again and complete the new journal */
+	ret = journal_rerecord(ubi, true, &count);
+
+	if (0 == ret)
+		ret = journal_write(ubi, UBI_UNMAP_JOURNAL_VOL_ID, 0, 0,
+				    MAX(ubi->global_seqnr, ubi->sqnum_ceiling));
+
+	struct ubi_rbt_item *item = (0 == ret) ? old : ubi->journal;
+	ubi->journal = (0 == ret) ? ubi->journal : old;
+
+	/* 4. Incomplete journal is dropped on attach, so either one is erased as any dirty PEB */
+	rb_insert(&ubi->dirty_pebs, &item->node);
+	ubi->dirty_pebs_size += 1;
+
+	return ret;
+}
+
+static bool journal_is_busy(const struct ubi_device *ubi, const struct ubi_volume *vol)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+	const size_t leb_size =
+		ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+
+	return (vol->cfg.durable_unmap || vol->cfg.encrypted) && ubi->journal &&
+	       ubi->nr_of_erases > 0 &&
+	       ubi->journal_offset + UBI_UNMAP_REC_SIZE > leb_size;
+}
+
+static int journal_write(struct ubi_device *ubi, size_t vol_id, size_t first, size_t count,
+			 uint64_t sqnum)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(ubi->journal);
+
+	const size_t leb_size =
+		ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+
+	if (ubi->journal_offset + UBI_UNMAP_REC_SIZE > leb_size)
+		return -ENOSPC;
+
+	struct ubi_unmap_rec rec = { 0 };
+	rec.magic = UBI_UNMAP_REC_MAGIC;
+	rec.vol_id = vol_id;
+	rec.lnum = first;
+	rec.count = count;
+	rec.sqnum = sqnum;
+	rec.rec_crc = crc32_ieee((const uint8_t *)&rec, sizeof(rec) - sizeof(rec.rec_crc));
+
+	const size_t offset = ubi->journal_offset;
+
+	/* Slot of a failed program is not reused, replay skips it by CRC */
+	ubi->journal_offset += UBI_UNMAP_REC_SIZE;
+
+	const int ret = ubi_leb_data_write(&ubi->flash, ubi->journal->value.pnum, offset,
+					   (const uint8_t *)&rec, sizeof(rec));
+
+	if (0 != ret)
+		LOG_ERR("Unmap record write failure");
+
+	return ret;
+}
+
+static int journal_record(struct ubi_device *ubi, size_t vol_id, size_t first, size_t count,
+			  uint64_t sqnum)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	int ret = 0;
+
+	if (!ubi->journal) {
+		ret = journal_open(ubi);
+
+		if (0 != ret) {
+			LOG_ERR("Unmap journal open failure");
+			return ret;
+		}
+
+		/* First journal has nothing to record again, incomplete one is dropped on attach */
+		ret = journal_write(ubi, UBI_UNMAP_JOURNAL_VOL_ID, 0, 0,
+				    MAX(ubi->global_seqnr, ubi->sqnum_ceiling));
+
+		if (0 != ret) {
+			rb_insert(&ubi->dirty_pebs, &ubi->journal->node);
+			ubi->dirty_pebs_size += 1;
+			ubi->journal = NULL;
+			return ret;
+		}
+	}
+
+	ret = journal_write(ubi, vol_id, first, count, sqnum);
+
+	if (-ENOSPC == ret) {
+		ret = journal_renew(ubi);
+
+		if (0 != ret) {
+			LOG_ERR("Unmap journal renew failure");
+			return ret;
+		}
+
+		ret = journal_write(ubi, vol_id, first, count, sqnum);
+	}
+
+	return ret;
+}
+
+static int journal_append(struct ubi_device *ubi, const struct ubi_volume *vol, size_t first,
+			  size_t count)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+	if (!vol->cfg.durable_unmap)
+		return 0;
+
+	/* Later LEB writes take this sequence number or higher, so they are never hidden */
+	return journal_record(ubi, vol->vol_id, first, count, ubi->global_seqnr);
+}
+
+static int journal_reserve(struct ubi_device *ubi, const struct ubi_volume *vol)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+#if defined(CONFIG_UBI_CRYPTO_ENABLE)
+	if (!vol->cfg.encrypted || ubi->global_seqnr < ubi->sqnum_ceiling)
+		return 0;
+
+	if (journal_is_busy(ubi, vol))
+		return -EAGAIN;
+
+	const uint64_t old_ceiling = ubi->sqnum_ceiling;
+
+	/* Renewal and opening of the journal record the ceiling in its completion record too */
+	ubi->sqnum_ceiling = ubi->global_seqnr + CONFIG_UBI_CRYPTO_SQNUM_RESERVE;
+
+	const int ret = journal_record(ubi, UBI_UNMAP_JOURNAL_VOL_ID, 0, 0, ubi->sqnum_ceiling);
+
+	if (0 != ret) {
+		LOG_ERR("Sequence number reservation failure");
+		ubi->sqnum_ceiling = old_ceiling;
+	}
+
+	return ret;
+#else
+	return 0;
+#endif /* CONFIG_UBI_CRYPTO_ENABLE */
+}
+
+static int journal_replay(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	if (!ubi->journal)
+		return 0;
+
+	const size_t pnum = ubi->journal->value.pnum;
+	const size_t leb_size =
+		ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+
+	struct ubi_unmap_rec empty_rec = { 0 };
+	memset(&empty_rec, 0xff, sizeof(empty_rec));
+
+	for (size_t offset = 0; offset + UBI_UNMAP_REC_SIZE <= leb_size;
+	     offset += UBI_UNMAP_REC_SIZE) {
+		struct ubi_unmap_rec rec = { 0 };
+		int ret = ubi_leb_data_read(&ubi->flash, pnum, offset, (uint8_t *)&rec,
+					    sizeof(rec));
+
+		if (0 != ret) {
+			LOG_ERR("Unmap record read failure");
+			return ret;
+		}
+
+		if (0 == memcmp(&rec, &empty_rec, sizeof(rec)))
+			break;
+
+		ubi->journal_offset = offset + UBI_UNMAP_REC_SIZE;
+
+		/* Record torn by power cut, its unmap never returned */
+		if (UBI_UNMAP_REC_MAGIC != rec.magic ||
+		    rec.rec_crc != crc32_ieee((const uint8_t *)&rec,
+					      sizeof(rec) - sizeof(rec.rec_crc)))
+			continue;
+
+		if (rec.sqnum > ubi->global_seqnr)
+			ubi->global_seqnr = rec.sqnum;
+
+		const struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, rec.vol_id);
+
+		if (!entry || entry->value.vol->is_snapshot)
+			continue;
+
+		struct ubi_volume *vol = entry->value.vol;
+
+		/* Volume was wiped or its ID reused later, its bound hides the same PEBs */
+		if (rec.sqnum <= vol->sqnum_bound)
+			continue;
+
+		const size_t last = MIN((size_t)rec.lnum + rec.count, vol->cfg.leb_count);
+
+		for (size_t lnum = rec.lnum; lnum < last; ++lnum) {
+			struct ubi_rbt_item *item = ubi_rbt_search(&vol->eba_tbl, lnum);
+
+			if (!item)
+				continue;
+
+			struct ubi_vid_hdr vid_hdr = { 0 };
+			ret = ubi_vid_hdr_read(&ubi->flash, item->value.pnum, &vid_hdr, true);
+
+			if (0 != ret || vid_hdr.sqnum >= rec.sqnum)
+				continue;
+
+			ret = peb_release(ubi, vol, item);
+
+			if (0 != ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int leb_copy_on_write(struct ubi_device *ubi, struct ubi_volume *vol, size_t lnum,
+			     size_t old_pnum)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+	/* Old PEB stays mapped by snapshot, so it is not erased while being copied, and the
+	 * caller admitted the copy against volume quota
+	 */
+	int ret = leb_write(ubi, vol->vol_id, lnum, NULL, 0, UBI_IO_CLASS_OF_VOLUME, true);
+
+	if (0 != ret) {
+		LOG_ERR("LEB map failure");
+		return ret;
+	}
+
+	struct ubi_rbt_item *entry = ubi_rbt_search(&vol->eba_tbl, lnum);
+	__ASSERT_NO_MSG(entry);
+
+	/* Copy has a new sequence number, so encrypted data is decrypted and encrypted again */
+	struct ubi_crypto *crypto = vol->cfg.encrypted ? vol->crypto : NULL;
+	struct ubi_leb_io src = { 0 };
+	struct ubi_leb_io dst = { 0 };
+
+	ret = leb_io_open(&ubi->flash, old_pnum, crypto, &src);
+
+	if (0 == ret)
+		ret = leb_io_open(&ubi->flash, entry->value.pnum, crypto, &dst);
+
+	if (0 != ret)
+		return ret;
+
+	const size_t leb_size =
+		ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+	uint8_t buf[16 * WRITE_BLOCK_SIZE_ALIGNMENT] = { 0 };
+
+	for (size_t offset = 0; offset < leb_size; offset += sizeof(buf)) {
+		const size_t len = MIN(sizeof(buf), leb_size - offset);
+
+		ret = leb_io_read(&src, offset, buf, len);
+
+		if (0 != ret) {
+			LOG_ERR("LEB data read failure");
+			return ret;
+		}
+
+		/* Copy only programmed write blocks, erased ones may be programmed later */
+		for (size_t blk = 0; blk < len;) {
+			size_t end = blk;
+
+			while (end < len) {
+				bool is_erased = true;
+
+				for (size_t i = 0; i < WRITE_BLOCK_SIZE_ALIGNMENT && is_erased; ++i)
+					is_erased = (0xFF == buf[end + i]);
+
+				if (is_erased)
+					break;
+
+				end += WRITE_BLOCK_SIZE_ALIGNMENT;
+			}
+
+			if (end > blk) {
+				ret = leb_io_write(&dst, offset + blk, &buf[blk], end - blk);
+
+				if (0 != ret) {
+					LOG_ERR("LEB data write failure");
+					return ret;
+				}
+			}
+
+			blk = end + WRITE_BLOCK_SIZE_ALIGNMENT;
+		}
+	}
+
+	return 0;
+}
+
+static int snapshot_attach_peb(struct ubi_device *ubi, const struct ubi_volume *vol,
+			       const struct ubi_vid_hdr *vid_hdr, size_t pnum)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+	__ASSERT_NO_MSG(vid_hdr);
+
+	struct ubi_rbt_item *entry = NULL;
+	RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+	{
+		struct ubi_volume *snap = entry->value.vol;
+
+		if (!snap->is_snapshot || snap->src_vol_id != vol->vol_id)
+			continue;
+
+		if (vid_hdr->lnum >= snap->cfg.leb_count || vid_hdr->sqnum >= snap->sqnum_bound)
+			continue;
+
+		/* Snapshots never outlive a wipe, so source bound holds for them too */
+		if (vid_hdr->sqnum < vol->sqnum_bound)
+			continue;
+
+		struct ubi_rbt_item *tmp = ubi_rbt_search(&snap->eba_tbl, vid_hdr->lnum);
+
+		if (tmp) {
+			struct ubi_vid_hdr exist_vid_hdr = { 0 };
+			int ret = ubi_vid_hdr_read(&ubi->flash, tmp->value.pnum, &exist_vid_hdr,
+						   true);
+
+			if (0 == ret && exist_vid_hdr.sqnum > vid_hdr->sqnum)
+				continue;
+
+			ret = peb_release(ubi, snap, tmp);
+
+			if (0 != ret)
+				return ret;
+		}
+
+		struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+		if (!item) {
+			LOG_ERR("Heap allocation failure");
+			return -ENOMEM;
+		}
+
+		item->key = vid_hdr->lnum;
+		item->value.pnum = pnum;
+		rb_insert(&snap->eba_tbl, &item->node);
+		snap->eba_tbl_size += 1;
+
+		if (vid_hdr->flags & UBI_VID_FLAG_PATTERN)
+			snap->has_patterns = true;
+	}
+
+	return 0;
+}
+
+static size_t leb_avail_count(const struct ubi_device_info *info)
+{
+	__ASSERT_NO_MSG(info);
+
+	const size_t usable = info->leb_total_count - info->reserved_leb_count;
+
+	return (usable > info->allocated_leb_count) ? (usable - info->allocated_leb_count) : 0;
+}
+
+static int peb_range_erase(const struct flash_area *fa, size_t offset, size_t size)
+{
+	__ASSERT_NO_MSG(fa);
+
+	const size_t chunk = CONFIG_UBI_ERASE_CHUNK_SIZE;
+
+	if (0 == chunk || chunk >= size || 0 != size % chunk)
+		return flash_area_erase(fa, offset, size);
+
+	for (size_t done = 0; done < size; done += chunk) {
+		const int ret = flash_area_erase(fa, offset + done, chunk);
+
+		if (0 != ret)
+			return ret;
+
+		k_yield();
+	}
+
+	return 0;
+}
+
+static void device_lock(struct ubi_device *ubi, enum ubi_io_class io_class)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(io_class < UBI_IO_CLASS_COUNT);
+
+	struct ubi_io_sched *sched = &ubi->sched;
+	struct ubi_io_class_stats *stats = &sched->stats[io_class];
+	const k_tid_t self = k_current_get();
+
+	k_mutex_lock(&sched->lock, K_FOREVER);
+
+	if (self == sched->owner) {
+		sched->depth += 1;
+		k_mutex_unlock(&sched->lock);
+		return;
+	}
+
+	const int64_t arrival = k_uptime_ticks();
+
+	if (!sched->owner && sys_slist_is_empty(&sched->waiters)) {
+		sched->owner = self;
+		sched->depth = 1;
+		sched->owner_class = io_class;
+		sched->owner_prio = k_thread_priority_get(self);
+	} else {
+		struct ubi_io_waiter waiter = {
+			.thread = self,
+			.deadline = arrival + k_ms_to_ticks_ceil64(io_class_target_ms[io_class]),
+			.io_class = io_class,
+			.prio = k_thread_priority_get(self),
+			.is_granted = false,
+		};
+
+		sys_slist_append(&sched->waiters, &waiter.node);
+		stats->queue_depth += 1;
+		stats->max_queue_depth = MAX(stats->max_queue_depth, stats->queue_depth);
+
+		/* Owner must not be preempted by threads of lower priority than the waiter */
+		io_owner_boost(sched);
+
+		while (!waiter.is_granted)
+			k_condvar_wait(&sched->dispatch, &sched->lock, K_FOREVER);
+
+		stats->queue_depth -= 1;
+	}
+
+	const uint64_t wait_us = k_ticks_to_us_floor64(k_uptime_ticks() - arrival);
+
+	stats->nr_of_dispatches += 1;
+	stats->total_wait_us += wait_us;
+	stats->max_wait_us = MAX(stats->max_wait_us, (uint32_t)MIN(wait_us, UINT32_MAX));
+
+	k_mutex_unlock(&sched->lock);
+}
+
+static void device_unlock(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	struct ubi_io_sched *sched = &ubi->sched;
+
+	k_mutex_lock(&sched->lock, K_FOREVER);
+
+	__ASSERT_NO_MSG(k_current_get() == sched->owner);
+	__ASSERT_NO_MSG(sched->depth > 0);
+
+	sched->depth -= 1;
+
+	if (0 == sched->depth) {
+		io_owner_restore(sched);
+		sched->owner = NULL;
+		io_dispatch(sched);
+	}
+
+	k_mutex_unlock(&sched->lock);
+}
+
+static void device_wait(struct ubi_device *ubi, struct k_condvar *cond)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(cond);
+
+	struct ubi_io_sched *sched = &ubi->sched;
+
+	k_mutex_lock(&sched->lock, K_FOREVER);
+
+	__ASSERT_NO_MSG(k_current_get() == sched->owner);
+	__ASSERT_NO_MSG(1 == sched->depth);
+
+	const enum ubi_io_class io_class = sched->owner_class;
+
+	/* Release and start waiting under scheduler lock, so a broadcast cannot be missed */
+	io_owner_restore(sched);
+	sched->owner = NULL;
+	sched->depth = 0;
+	io_dispatch(sched);
+
+	k_condvar_wait(cond, &sched->lock, K_FOREVER);
+	k_mutex_unlock(&sched->lock);
+
+	device_lock(ubi, io_class);
+}
+
+static void device_broadcast(struct ubi_device *ubi, struct k_condvar *cond)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(cond);
+
+	k_mutex_lock(&ubi->sched.lock, K_FOREVER);
+	k_condvar_broadcast(cond);
+	k_mutex_unlock(&ubi->sched.lock);
+}
+
+static void io_dispatch(struct ubi_io_sched *sched)
+{
+	__ASSERT_NO_MSG(sched);
+	__ASSERT_NO_MSG(!sched->owner);
+
+	struct ubi_io_waiter *next = NULL;
+	struct ubi_io_waiter *waiter = NULL;
+
+	/* Earliest deadline wins, waiters are in arrival order so ties are served first come */
+	SYS_SLIST_FOR_EACH_CONTAINER(&sched->waiters, waiter, node)
+	{
+		if (!next || waiter->deadline < next->deadline)
+			next = waiter;
+	}
+
+	if (!next)
+		return;
+
+	sys_slist_find_and_remove(&sched->waiters, &next->node);
+
+	sched->owner = next->thread;
+	sched->depth = 1;
+	sched->owner_class = next->io_class;
+	sched->owner_prio = next->prio;
+
+	/* Requests left waiting raise priority of the new owner as well */
+	io_owner_boost(sched);
+
+	next->is_granted = true;
+	k_condvar_broadcast(&sched->dispatch);
+}
+
+static void io_owner_boost(struct ubi_io_sched *sched)
+{
+	__ASSERT_NO_MSG(sched);
+	__ASSERT_NO_MSG(sched->owner);
+
+	struct ubi_io_waiter *waiter = NULL;
+	int prio = sched->owner_prio;
+
+	/* Numerically lower priority is the higher one */
+	SYS_SLIST_FOR_EACH_CONTAINER(&sched->waiters, waiter, node)
+	{
+		prio = MIN(prio, waiter->prio);
+	}
+
+	if (prio < k_thread_priority_get(sched->owner))
+		k_thread_priority_set(sched->owner, prio);
+}
+
+static void io_owner_restore(struct ubi_io_sched *sched)
+{
+	__ASSERT_NO_MSG(sched);
+	__ASSERT_NO_MSG(k_current_get() == sched->owner);
+
+	if (sched->owner_prio != k_thread_priority_get(sched->owner))
+		k_thread_priority_set(sched->owner, sched->owner_prio);
+}
+
+static enum ubi_io_class io_class_resolve(struct ubi_device *ubi, int vol_id,
+					  enum ubi_io_class io_class)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	if (UBI_IO_CLASS_OF_VOLUME != io_class)
+		return io_class;
+
+	const atomic_val_t epoch = reader_enter(ubi);
+
+	const atomic_val_t vols_seq = atomic_get(&ubi->vols_seq);
+	struct ubi_rbt_item *entry = ubi_rbt_search_optimistic(&ubi->vols, vol_id);
+	const uint8_t vol_class = entry ? entry->value.vol->io_class : UBI_IO_CLASS_NORMAL;
+
+	reader_exit(ubi, epoch);
+
+	if ((vols_seq & 1) || vols_seq != atomic_get(&ubi->vols_seq))
+		return UBI_IO_CLASS_NORMAL;
+
+	return (enum ubi_io_class)vol_class;
+}
+
+static void device_sleep(struct ubi_device *ubi, k_timeout_t timeout)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(1 == ubi->sched.depth);
+
+	const enum ubi_io_class io_class = ubi->sched.owner_class;
+
+	device_unlock(ubi);
+	k_sleep(timeout);
+	device_lock(ubi, io_class);
+}
+
+static void quota_refill(struct ubi_vol_quota *quota)
+{
+	__ASSERT_NO_MSG(quota);
+
+	const int64_t now = k_uptime_get();
+	const int64_t elapsed_ms = now - quota->refill_ms;
+	struct ubi_quota_bucket *buckets[] = { &quota->pebs, &quota->bytes };
+
+	quota->refill_ms = now;
+
+	/* Rate is in tokens per second, so one millisecond adds rate thousandths */
+	for (size_t i = 0; i < ARRAY_SIZE(buckets); ++i) {
+		struct ubi_quota_bucket *bucket = buckets[i];
+
+		if (0 == bucket->rate)
+			continue;
+
+		bucket->tokens = MIN(bucket->tokens + elapsed_ms * bucket->rate,
+				     (int64_t)bucket->burst * 1000);
+	}
+}
+
+static int64_t quota_bucket_delay_ms(const struct ubi_quota_bucket *bucket, size_t cost)
+{
+	__ASSERT_NO_MSG(bucket);
+
+	if (0 == bucket->rate)
+		return 0;
+
+	const int64_t needed = (int64_t)MIN(cost, bucket->burst) * 1000;
+
+	if (bucket->tokens >= needed)
+		return 0;
+
+	return DIV_ROUND_UP(needed - bucket->tokens, bucket->rate);
+}
+
+static int quota_admit(struct ubi_device *ubi, struct ubi_volume *vol, size_t pebs, size_t bytes,
+		       int64_t *delay_ms)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+	__ASSERT_NO_MSG(delay_ms);
+
+	struct ubi_vol_quota *quota = vol->quota;
+
+	*delay_ms = 0;
+
+	if (!quota)
+		return 0;
+
+	quota_refill(quota);
+
+	const int64_t wait_ms = MAX(quota_bucket_delay_ms(&quota->pebs, pebs),
+				    quota_bucket_delay_ms(&quota->bytes, bytes));
+
+	if (0 != wait_ms) {
+		if (quota->is_blocking && 1 == ubi->sched.depth)
+			*delay_ms = wait_ms;
+
+		return -EAGAIN;
+	}
+
+	if (0 != quota->pebs.rate)
+		quota->pebs.tokens -= (int64_t)pebs * 1000;
+
+	if (0 != quota->bytes.rate)
+		quota->bytes.tokens -= (int64_t)bytes * 1000;
+
+	return 0;
+}
+
+static void quota_refund(struct ubi_volume *vol, size_t pebs, size_t bytes)
+{
+	__ASSERT_NO_MSG(vol);
+
+	struct ubi_vol_quota *quota = vol->quota;
+
+	if (!quota)
+		return;
+
+	if (0 != quota->pebs.rate)
+		quota->pebs.tokens += (int64_t)pebs * 1000;
+
+	if (0 != quota->bytes.rate)
+		quota->bytes.tokens += (int64_t)bytes * 1000;
+}
+
+static void quota_release(struct ubi_device *ubi, struct ubi_volume *vol)
+{
+	__ASSERT_NO_MSG(ubi);
+	__ASSERT_NO_MSG(vol);
+
+	if (!vol->quota)
+		return;
+
+	ubi->quota_rsvd_pebs -= vol->quota->reserved_pebs;
+	k_free(vol->quota);
+	vol->quota = NULL;
+}
+
+static struct ubi_vol_hdr *txn_vol_search(struct ubi_vol_txn *txn, size_t vol_id)
+{
+	__ASSERT_NO_MSG(txn);
+
+	for (size_t idx = 0; idx < txn->vol_count; ++idx) {
+		if (vol_id == txn->vol_hdrs[idx].vol_id)
+			return &txn->vol_hdrs[idx];
+	}
+
+	return NULL;
+}
+
+static struct ubi_vol_hdr *txn_vol_search_name(struct ubi_vol_txn *txn,
+					       const unsigned char *name)
+{
+	__ASSERT_NO_MSG(txn);
+	__ASSERT_NO_MSG(name);
+
+	const size_t name_len = strnlen(name, UBI_VOLUME_NAME_MAX_LEN);
+
+	for (size_t idx = 0; idx < txn->vol_count; ++idx) {
+		const struct ubi_vol_hdr *hdr = &txn->vol_hdrs[idx];
+		const size_t len = strnlen(hdr->name, UBI_VOLUME_NAME_MAX_LEN);
+
+		if (name_len == len && 0 == memcmp(name, hdr->name, name_len))
+			return &txn->vol_hdrs[idx];
+	}
+
+	return NULL;
+}
+
+static size_t txn_avail_lebs(const struct ubi_vol_txn *txn)
+{
+	__ASSERT_NO_MSG(txn);
+
+	size_t lebs = 0;
+
+	for (size_t idx = 0; idx < txn->vol_count; ++idx)
+		lebs += txn->vol_hdrs[idx].lebs_count;
+
+	return (txn->leb_usable_count > lebs) ? (txn->leb_usable_count - lebs) : 0;
+}
+
+static int volume_autoresize(struct ubi_device *ubi)
+{
+	__ASSERT_NO_MSG(ubi);
+
+	bool requested = false;
+
+	struct ubi_rbt_item *entry = NULL;
+	RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+	{
+		requested |= entry->value.vol->cfg.autoresize;
+	}
+
+	if (!requested)
+		return 0;
+
+	struct ubi_vol_txn *txn = NULL;
+	int ret = ubi_vol_txn_begin(ubi, &txn);
+
+	if (0 != ret)
+		return ret;
+
+	for (size_t vol_idx = 0; vol_idx < txn->vol_count; ++vol_idx) {
+		struct ubi_vol_hdr *hdr = &txn->vol_hdrs[vol_idx];
+
+		if (0 == (hdr->flags & UBI_VOL_FLAG_AUTORESIZE))
+			continue;
+
+		/* Bad PEBs are excluded, so the grown volume can always be fully mapped */
+		hdr->lebs_count += txn_avail_lebs(txn);
+
+		hdr->flags &= ~UBI_VOL_FLAG_AUTORESIZE;
+		txn->nr_of_ops += 1;
+	}
+
+	return ubi_vol_txn_commit(txn);
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_device_init(const struct ubi_mtd *mtd, struct ubi_device **ubi)
+{
+	int ret = -1;
+
+	if (!mtd || !ubi)
+		return -EINVAL;
+
+	struct ubi_device *ubi_dev = k_malloc(sizeof(*ubi_dev));
+
+	if (!ubi_dev) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(ubi_dev, 0, sizeof(*ubi_dev));
+	k_mutex_init(&ubi_dev->sched.lock);
+	k_condvar_init(&ubi_dev->sched.dispatch);
+	sys_slist_init(&ubi_dev->sched.waiters);
+	k_condvar_init(&ubi_dev->write_done);
+	k_condvar_init(&ubi_dev->rd_done);
+	ubi_dev->flash.mtd = *mtd;
+	ubi_dev->free_pebs.lessthan_fn = ubi_rbt_cmp;
+	ubi_dev->dirty_pebs.lessthan_fn = ubi_rbt_cmp;
+	sys_slist_init(&ubi_dev->bad_pebs);
+	ubi_dev->vols.lessthan_fn = ubi_rbt_cmp;
+
+	/* PEBs are located by cached partition ends, not by opening every partition */
+	ret = ubi_mtd_layout_cache(&ubi_dev->flash);
+
+	if (0 != ret) {
+		LOG_ERR("Flash area is not ready");
+		goto exit;
+	}
+
+	size_t nr_of_pebs = 0;
+	ret = ubi_mtd_get_peb_count(&ubi_dev->flash, &nr_of_pebs);
+
+	if (0 != ret) {
+		LOG_ERR("Flash area is not ready");
+		goto exit;
+	}
+
+	ret = ubi_dev_hdr_recover(&ubi_dev->flash);
+
+	if (0 != ret) {
+		LOG_ERR("Device header recover failure");
+		goto exit;
+	}
+
+	bool is_mounted = false;
+	ret = ubi_dev_is_mounted(&ubi_dev->flash, &is_mounted);
+
+	if (0 != ret) {
+		LOG_ERR("Device check mount failure");
+		goto exit;
+	}
+
+	/* 1. UBI device is not mounted. */
+	if (false == is_mounted) {
+		ret = ubi_dev_mount(&ubi_dev->flash);
+
+		if (0 != ret) {
+			LOG_ERR("Device mount failure");
+			goto exit;
+		}
+
+		struct ubi_ec_hdr ec_hdr = { 0 };
+		ec_hdr.magic = UBI_EC_HDR_MAGIC;
+		ec_hdr.version = UBI_EC_HDR_VERSION;
+		ec_hdr.ec = 0;
+		ec_hdr.hdr_crc = crc32_ieee((const uint8_t *)&ec_hdr,
+					    sizeof(ec_hdr) - sizeof(ec_hdr.hdr_crc));
+
+		for (size_t peb_idx = UBI_DEV_HDR_NR_OF_RES_PEBS; peb_idx < nr_of_pebs; ++peb_idx) {
+			uint8_t partition_id = 0;
+			size_t offset = 0;
+			ret = ubi_mtd_peb_locate(&ubi_dev->flash, peb_idx, &partition_id, &offset);
+
+			if (0 != ret) {
+				LOG_ERR("PEB locate failure");
+				goto exit;
+			}
+
+			const struct flash_area *fa = NULL;
+			ret = flash_area_open(partition_id, &fa);
+
+			if (0 != ret) {
+				LOG_ERR("Flash area open failure");
+				goto exit;
+			}
+
+			ret = flash_area_erase(fa, offset, ubi_dev->flash.mtd.erase_block_size);
+
+			if (0 != ret) {
+				LOG_ERR("Flash erase failure");
+				flash_area_close(fa);
+				goto exit;
+			}
+
+			flash_area_close(fa);
+
+			ret = ubi_ec_hdr_write(&ubi_dev->flash, peb_idx, &ec_hdr);
+
+			if (0 != ret) {
+				LOG_ERR("EC header write failure");
+				goto exit;
+			}
+		}
+	}
+
+	struct ubi_dev_hdr dev_hdr = { 0 };
+	ret = ubi_dev_hdr_read(&ubi_dev->flash, &dev_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("Device header read failure");
+		goto exit;
+	}
+
+	/* PEB numbers of a different MTD list would point to other flash */
+	if (dev_hdr.size / ubi_dev->flash.mtd.erase_block_size != nr_of_pebs ||
+	    (0 != (dev_hdr.flags & UBI_DEV_FLAG_STRIPED)) != ubi_dev->flash.mtd.striped) {
+		LOG_ERR("MTD layout differs from formatted one");
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	/* 2. Collect EBA tables for volumes. */
+	for (size_t vol_idx = 0; vol_idx < dev_hdr.vol_count; ++vol_idx) {
+		struct ubi_vol_hdr vol_hdr = { 0 };
+		ret = ubi_vol_hdr_read(&ubi_dev->flash, vol_idx, &vol_hdr);
+
+		if (0 != ret) {
+			LOG_ERR("Volume header read failure");
+			goto exit;
+		}
+
+		struct ubi_volume *vol = k_malloc(sizeof(*vol));
+
+		if (!vol) {
+			LOG_ERR("Heap allocation failure");
+			ret = -ENOMEM;
+			goto exit;
+		}
+
+		memset(vol, 0, sizeof(*vol));
+		vol->vol_idx = vol_idx;
+		vol->vol_id = vol_hdr.vol_id;
+		vol->io_class = UBI_IO_CLASS_NORMAL;
+		memcpy(vol->cfg.name, vol_hdr.name, strlen(vol_hdr.name));
+		vol->cfg.type = vol_hdr.vol_type;
+		vol->cfg.leb_count = vol_hdr.lebs_count;
+		vol->cfg.autoresize = (0 != (vol_hdr.flags & UBI_VOL_FLAG_AUTORESIZE));
+		vol->cfg.compressed = (0 != (vol_hdr.flags & UBI_VOL_FLAG_COMPRESSED));
+		vol->cfg.encrypted = (0 != (vol_hdr.flags & UBI_VOL_FLAG_ENCRYPTED));
+		vol->cfg.durable_unmap = (0 != (vol_hdr.flags & UBI_VOL_FLAG_DURABLE_UNMAP));
+		vol->is_snapshot = (0 != (vol_hdr.flags & UBI_VOL_FLAG_SNAPSHOT));
+		vol->is_sealed = (0 != (vol_hdr.flags & UBI_VOL_FLAG_SEALED));
+		vol->src_vol_id = vol_hdr.src_vol_id;
+		vol->sqnum_bound = vol_hdr.sqnum_bound;
+		vol->eba_tbl_size = 0;
+		vol->eba_tbl.lessthan_fn = ubi_rbt_cmp;
+
+		/* Later writes must never fall below sequence number bound of any volume */
+		if (vol->sqnum_bound > ubi_dev->global_seqnr)
+			ubi_dev->global_seqnr = vol->sqnum_bound;
+
+		struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+		if (!item) {
+			LOG_ERR("Heap allocation failure");
+			ret = -ENOMEM;
+			k_free(vol);
+			goto exit;
+		}
+
+		memset(item, 0, sizeof(*item));
+		item->key = vol->vol_id;
+		item->value.vol = vol;
+
+		rb_insert(&ubi_dev->vols, &item->node);
+		ubi_dev->vols_size += 1;
+
+		if (vol->vol_id > ubi_dev->vols_seqnr)
+			ubi_dev->vols_seqnr = vol->vol_id;
+	}
+
+	if (dev_hdr.vol_count > 0)
+		ubi_dev->vols_seqnr += 1;
+
+	size_t ec_sum = 0;
+	size_t ec_count = 0;
+
+	/* 3. Scan all PEB's with correct EC header and collect average of erases */
+	for (size_t pnum = UBI_DEV_HDR_NR_OF_RES_PEBS; pnum < nr_of_pebs; ++pnum) {
+		struct ubi_ec_hdr ec_hdr = { 0 };
+		ret = ubi_ec_hdr_read(&ubi_dev->flash, pnum, &ec_hdr);
+
+		if (0 == ret) {
+			ec_sum += ec_hdr.ec;
+			ec_count += 1;
+		}
+	}
+
+	const size_t ec_avg = ec_sum / ec_count;
+	uint64_t journal_sqnum = 0;
+
+	/* 4. Scan all PEB's and update volume EBA table:
+   	 *    1. If EC header is incorrect, then append to bad PEBs.
+   	 *    2. If EC header is correct and VID header is empty, then insert to free PEBs.
+   	 *    3. If EC header is correct and VID header is incorrect, then append to bad PEBs.
+   	 *    4. If EC header is correct and VID header is correct then:
+   	 *       1. Collect greater sequence number from VID.
+   	 *       2. Keep the newest complete unmap journal PEB, insert older and incomplete ones to
+   	 *          dirty PEBs. Search in volume EBA table LEB with this key exist.
+   	 *	 3. Volume does not exist, or PEB is below volume sequence number bound, then insert
+   	 *	    to dirty PEBs.
+   	 *	 4. Offer LEB to snapshots of volume, each keeps the greatest sequence number
+   	 *	    below its snapshot sequence number.
+         *       5. LEB does not exist, but exceed volume LEB limit, insert to dirty PEBs.
+   	 *       6. LEB does not exist, then insert to volume EBA table.
+   	 *       7. LEB does exist but EC or VID headers of EBA table LEB are incorrect, then append to bad PEBs.
+   	 *       8. LEB does exist and EC and VID headers are correct then:
+   	 *          1. If newer LEB has lower sequence number, then append to dirty PEBs.
+   	 *          2. If newer LEB has greater sequence number, then remove old LEB
+   	 *	       from volume EBA table and append to dirty PEBs. The newer LEB append to
+   	 *	       volume EBA table.
+   	 *       PEBs still mapped by a snapshot are never appended to dirty PEBs.
+   	 */
+	for (size_t pnum = UBI_DEV_HDR_NR_OF_RES_PEBS; pnum < nr_of_pebs; ++pnum) {
+		/* 4.1 */
+		struct ubi_ec_hdr ec_hdr = { 0 };
+		ret = ubi_ec_hdr_read(&ubi_dev->flash, pnum, &ec_hdr);
+
+		if (0 != ret) {
+			struct ubi_list_item *item = k_malloc(sizeof(*item));
+
+			if (!item) {
+				LOG_ERR("Heap allocation failure");
+				ret = -ENOMEM;
+				goto exit;
+			}
+
+			move_to_bad_blocks(ubi_dev, pnum, ec_avg, item);
+			continue;
+		}
+
+		/* 4.2 */
+		struct ubi_vid_hdr vid_hdr = { 0 };
+		ret = ubi_vid_hdr_read(&ubi_dev->flash, pnum, &vid_hdr, false);
+
+		if (0 != ret) {
+			LOG_ERR("VID header read failure");
+			goto exit;
+		}
+
+		struct ubi_vid_hdr empty_vid_hdr = { 0 };
+		memset(&empty_vid_hdr, 0xff, sizeof(empty_vid_hdr));
+
+		if (0 == memcmp(&vid_hdr, &empty_vid_hdr, sizeof(vid_hdr))) {
+			struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+			if (!item) {
+				LOG_ERR("Heap allocation failure");
+				ret = -ENOMEM;
+				goto exit;
+			}
+
+			item->key = ec_hdr.ec;
+			item->value.pnum = pnum;
+			rb_insert(&ubi_dev->free_pebs, &item->node);
+			ubi_dev->free_pebs_size += 1;
+
+			continue;
+		}
+
+		/* 4.3 */
+		memset(&vid_hdr, 0, sizeof(vid_hdr));
+		ret = ubi_vid_hdr_read(&ubi_dev->flash, pnum, &vid_hdr, true);
+
+		if (0 != ret) {
+			struct ubi_list_item *item = k_malloc(sizeof(*item));
+
+			if (!item) {
+				LOG_ERR("Heap allocation failure");
+				ret = -ENOMEM;
+				goto exit;
+			}
+
+			move_to_bad_blocks(ubi_dev, pnum, ec_hdr.ec, item);
+			continue;
+		}
+
+		/* 4.4 */
+
+		/* 4.4.1 Next write gets a sequence number above every one on flash */
+		if (vid_hdr.sqnum >= ubi_dev->global_seqnr)
+			ubi_dev->global_seqnr = vid_hdr.sqnum + 1;
+
+		/* 4.4.2 */
+		if (UBI_UNMAP_JOURNAL_VOL_ID == vid_hdr.vol_id) {
+			struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+			if (!item) {
+				LOG_ERR("Heap allocation failure");
+				ret = -ENOMEM;
+				goto exit;
+			}
+
+			item->key = ec_hdr.ec;
+			item->value.pnum = pnum;
+
+			bool complete = false;
+			ret = journal_is_complete(ubi_dev, pnum, &complete);
+
+			if (0 != ret) {
+				k_free(item);
+				goto exit;
+			}
+
+			/* Older journal outlives its renewal only until it is erased */
+			if (complete && (!ubi_dev->journal || vid_hdr.sqnum > journal_sqnum)) {
+				struct ubi_rbt_item *old = ubi_dev->journal;
+
+				ubi_dev->journal = item;
+				journal_sqnum = vid_hdr.sqnum;
+				item = old;
+			}
+
+			if (item) {
+				rb_insert(&ubi_dev->dirty_pebs, &item->node);
+				ubi_dev->dirty_pebs_size += 1;
+			}
+
+			continue;
+		}
+
+		struct ubi_rbt_item *tmp = ubi_rbt_search(&ubi_dev->vols, vid_hdr.vol_id);
+
+		/* 4.4.3 */
+		if (!tmp) {
+			struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+			if (!item) {
+				LOG_ERR("Heap allocation failure");
+				ret = -ENOMEM;
+				goto exit;
+			}
+
+			item->key = ec_hdr.ec;
+			item->value.pnum = pnum;
+			rb_insert(&ubi_dev->dirty_pebs, &item->node);
+			ubi_dev->dirty_pebs_size += 1;
+
+			continue;
+		}
+
+		struct ubi_volume *vol = tmp->value.vol;
+
+		/* PEB written before volume was wiped, or by a removed volume of the same ID */
+		if (vol->is_snapshot || vid_hdr.sqnum < vol->sqnum_bound) {
+			struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+			if (!item) {
+				LOG_ERR("Heap allocation failure");
+				ret = -ENOMEM;
+				goto exit;
+			}
+
+			item->key = ec_hdr.ec;
+			item->value.pnum = pnum;
+			rb_insert(&ubi_dev->dirty_pebs, &item->node);
+			ubi_dev->dirty_pebs_size += 1;
+
+			continue;
+		}
+
+		if (vid_hdr.flags & UBI_VID_FLAG_PATTERN)
+			vol->has_patterns = true;
+
+		/* 4.4.4 */
+		ret = snapshot_attach_peb(ubi_dev, vol, &vid_hdr, pnum);
+
+		if (0 != ret)
+			goto exit;
+
+		struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+		if (!item) {
+			LOG_ERR("Heap allocation failure");
+			ret = -ENOMEM;
+			goto exit;
+		}
+
+		tmp = ubi_rbt_search(&vol->eba_tbl, vid_hdr.lnum);
+
+		if (!tmp) {
+			/* 4.4.5 */
+			if (vid_hdr.lnum >= vol->cfg.leb_count) {
+				if (peb_is_shared(ubi_dev, vol, vid_hdr.lnum, pnum)) {
+					k_free(item);
+					continue;
+				}
+
+				item->key = ec_hdr.ec;
+				item->value.pnum = pnum;
+				rb_insert(&ubi_dev->dirty_pebs, &item->node);
+				ubi_dev->dirty_pebs_size += 1;
+				continue;
+			}
+
+			/* 4.4.6 */
+			item->key = vid_hdr.lnum;
+			item->value.pnum = pnum;
+			rb_insert(&vol->eba_tbl, &item->node);
+			vol->eba_tbl_size += 1;
+
+			continue;
+		} else {
+			/* 4.4.7 */
+			struct ubi_ec_hdr exist_ec_hdr = { 0 };
+			ret = ubi_ec_hdr_read(&ubi_dev->flash, tmp->value.pnum, &exist_ec_hdr);
+
+			if (0 != ret) {
+				struct ubi_list_item *bad_item = k_malloc(sizeof(*bad_item));
+
+				if (!bad_item) {
+					LOG_ERR("Heap allocation failure");
+					k_free(item);
+					ret = -ENOMEM;
+					goto exit;
+				}
+
+				move_to_bad_blocks(ubi_dev, tmp->value.pnum, ec_avg, bad_item);
+				continue;
+			}
+
+			struct ubi_vid_hdr exist_vid_hdr = { 0 };
+			ret = ubi_vid_hdr_read(&ubi_dev->flash, tmp->value.pnum, &exist_vid_hdr,
+					       true);
+
+			if (0 != ret) {
+				struct ubi_list_item *bad_item = k_malloc(sizeof(*bad_item));
+
+				if (!bad_item) {
+					LOG_ERR("Heap allocation failure");
+					k_free(item);
+					ret = -ENOMEM;
+					goto exit;
+				}
+
+				move_to_bad_blocks(ubi_dev, tmp->value.pnum, ec_hdr.ec, bad_item);
+				continue;
+			}
+
+			/* 4.4.8.1 */
+			if (vid_hdr.sqnum < exist_vid_hdr.sqnum) {
+				if (peb_is_shared(ubi_dev, vol, vid_hdr.lnum, pnum)) {
+					k_free(item);
+					continue;
+				}
+
+				item->key = ec_hdr.ec;
+				item->value.pnum = pnum;
+				rb_insert(&ubi_dev->dirty_pebs, &item->node);
+				ubi_dev->dirty_pebs_size += 1;
+
+				continue;
+			} else {
+				/* 4.4.8.2 */
+				ret = peb_release(ubi_dev, vol, tmp);
+
+				if (0 != ret) {
+					k_free(item);
+					goto exit;
+				}
+
+				/* EBA item is keyed by LEB number and holds the newer PEB */
+				item->key = vid_hdr.lnum;
+				item->value.pnum = pnum;
+				rb_insert(&vol->eba_tbl, &item->node);
+				vol->eba_tbl_size += 1;
+
+				continue;
+			}
+		}
+	}
+
+	/* 5. Unmap LEBs recorded in unmap journal */
+	ret = journal_replay(ubi_dev);
+
+	if (0 != ret) {
+		LOG_ERR("Unmap journal replay failure");
+		goto exit;
+	}
+
+	/* 6. Grow autoresize volume over all unallocated LEBs */
+	ret = volume_autoresize(ubi_dev);
+
+	if (0 != ret) {
+		LOG_ERR("Volume autoresize failure");
+		goto exit;
+	}
+
+	/* 7. Build immutable mappings of sealed volumes */
+	struct ubi_rbt_item *vol_entry = NULL;
+	RB_FOR_EACH_CONTAINER(&ubi_dev->vols, vol_entry, node)
+	{
+		struct ubi_volume *vol = vol_entry->value.vol;
+
+		if (!vol->is_sealed)
+			continue;
+
+		ret = sealed_map_build(ubi_dev, vol, &vol->sealed);
+
+		if (0 != ret) {
+			LOG_ERR("Sealed volume map failure");
+			goto exit;
+		}
+	}
+
+	*ubi = ubi_dev;
+	return 0;
+
+exit:
+	ubi_device_deinit(ubi_dev);
+	*ubi = NULL;
+	return ret;
+}
+
+int ubi_device_get_info(struct ubi_device *ubi, struct ubi_device_info *info)
+{
+	if (!ubi || !info)
+		return -EINVAL;
+
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+
+	size_t nr_of_pebs = 0;
+	int ret = ubi_mtd_get_peb_count(&ubi->flash, &nr_of_pebs);
+
+	if (0 != ret) {
+		LOG_ERR("Flash area open failure");
+		goto exit;
+	}
+
+	memset(info, 0, sizeof(*info));
+	info->leb_total_count = nr_of_pebs - UBI_DEV_HDR_NR_OF_RES_PEBS;
+	info->leb_size = ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+
+	info->free_leb_count = ubi->free_pebs_size;
+	info->dirty_leb_count = ubi->dirty_pebs_size;
+	info->bad_leb_count = ubi->bad_pebs_size;
+
+	/* Reserve level rounded up like Linux UBI, bad PEBs are taken from the reserve first */
+	const size_t rsvd_level =
+		DIV_ROUND_UP(info->leb_total_count * CONFIG_UBI_RESERVED_PEBS_PER1024, 1024);
+	info->reserved_leb_count = MIN(info->leb_total_count, MAX(rsvd_level, ubi->bad_pebs_size));
+
+	/* Unmap journal PEB is never allocated to volumes */
+	if (ubi->journal && info->reserved_leb_count < info->leb_total_count)
+		info->reserved_leb_count += 1;
+
+	if (ubi->vols_size > 0) {
+		struct ubi_rbt_item *entry = NULL;
+		RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+		{
+			const struct ubi_volume *vol = entry->value.vol;
+			info->allocated_leb_count += vol->cfg.leb_count;
+		}
+		info->volumes_count = ubi->vols_size;
+	} else {
+		info->allocated_leb_count = 0;
+		info->volumes_count = 0;
+	}
+
+exit:
+	device_unlock(ubi);
+	return ret;
+}
+
+int ubi_device_erase_peb(struct ubi_device *ubi)
+{
+	return ubi_device_erase_pebs(ubi, 1, NULL);
+}
+
+int ubi_device_erase_pebs(struct ubi_device *ubi, size_t max_count, size_t *erased)
+{
+	if (!ubi || 0 == max_count)
+		return -EINVAL;
+
+	const uint32_t batch_start = k_cycle_get_32();
+
+	device_lock(ubi, UBI_IO_CLASS_ERASE);
+
+	int ret = 0;
+	size_t nr_of_slots = 0;
+	size_t nr_of_erased = 0;
+	struct ubi_erase_slot *slots = NULL;
+
+	const size_t count = MIN(max_count, ubi->dirty_pebs_size);
+
+	if (0 == count)
+		goto exit;
+
+	slots = k_malloc(count * sizeof(*slots));
+
+	if (!slots) {
+		LOG_ERR("Heap allocation failure");
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	/* 1. Take dirty PEBs with lowest erase counters and save their EC headers */
+	for (size_t idx = 0; idx < count; ++idx) {
+		struct rbnode *node = rb_get_min(&ubi->dirty_pebs);
+		struct ubi_rbt_item *entry = CONTAINER_OF(node, struct ubi_rbt_item, node);
+
+		rb_remove(&ubi->dirty_pebs, &entry->node);
+		ubi->dirty_pebs_size -= 1;
+
+		struct ubi_erase_slot *slot = &slots[nr_of_slots++];
+		memset(slot, 0, sizeof(*slot));
+		slot->item = entry;
+
+		if (0 != ubi_ec_hdr_read(&ubi->flash, entry->value.pnum, &slot->ec_hdr)) {
+			LOG_ERR("EC header read failure");
+			slot->is_bad = true;
+		}
+
+		if (0 != ubi_mtd_peb_locate(&ubi->flash, entry->value.pnum, &slot->partition_id,
+					    &slot->offset)) {
+			LOG_ERR("PEB locate failure");
+			slot->is_bad = true;
+		}
+	}
+
+	/* 2. Sort by partition and offset, so adjacent PEBs form one erase range */
+	for (size_t idx = 1; idx < nr_of_slots; ++idx) {
+		const struct ubi_erase_slot tmp = slots[idx];
+		size_t pos = idx;
+
+		while (pos > 0 && (slots[pos - 1].partition_id > tmp.partition_id ||
+				   (slots[pos - 1].partition_id == tmp.partition_id &&
+				    slots[pos - 1].offset > tmp.offset))) {
+			slots[pos] = slots[pos - 1];
+			pos -= 1;
+		}
+
+		slots[pos] = tmp;
+	}
+
+	/*
+	 * Taken PEBs are neither mapped nor in any pool, so flash work runs unlocked and reads of
+	 * other PEBs are not blocked by it. A caller already holding the lock keeps it. Lock-free
+	 * readers which looked a taken PEB up before it was unmapped finish their read first.
+	 */
+	reader_sync(ubi);
+	ubi->nr_of_erases += 1;
+	device_unlock(ubi);
+
+	/* 3. Erase each range of adjacent PEBs at once, retry one by one on failure */
+	for (size_t first = 0, last = 0; first < nr_of_slots; first = last) {
+		last = first + 1;
+
+		if (slots[first].is_bad)
+			continue;
+
+		while (last < nr_of_slots && !slots[last].is_bad &&
+		       slots[last].partition_id == slots[first].partition_id &&
+		       slots[last].offset ==
+			       slots[last - 1].offset + ubi->flash.mtd.erase_block_size)
+			last += 1;
+
+		const struct flash_area *fa = NULL;
+
+		/* Partitions were checked at attach, failure is handled like a failed erase */
+		if (0 != flash_area_open(slots[first].partition_id, &fa)) {
+			LOG_ERR("Flash area open failure");
+
+			for (size_t idx = first; idx < last; ++idx)
+				slots[idx].is_bad = true;
+
+			continue;
+		}
+
+		const size_t offset = slots[first].offset;
+		const size_t size = (last - first) * ubi->flash.mtd.erase_block_size;
+		const uint32_t start = k_cycle_get_32();
+
+		if (0 != peb_range_erase(fa, offset, size)) {
+			for (size_t idx = first; idx < last; ++idx) {
+				const size_t peb_size = ubi->flash.mtd.erase_block_size;
+
+				if (0 != peb_range_erase(fa, slots[idx].offset, peb_size)) {
+					LOG_ERR("Flash erase failure");
+					slots[idx].is_bad = true;
+				}
+			}
+		}
+
+		flash_area_close(fa);
+
+		/* One erase call covers the range, its time is split evenly between its PEBs */
+		const uint32_t range_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+		for (size_t idx = first; idx < last; ++idx)
+			slots[idx].cost_us = range_us / (last - first);
+	}
+
+	/* 4. Program EC headers back to back */
+	for (size_t idx = 0; idx < nr_of_slots; ++idx) {
+		struct ubi_erase_slot *slot = &slots[idx];
+
+		if (slot->is_bad)
+			continue;
+
+		slot->ec_hdr.ec += 1;
+		slot->ec_hdr.hdr_crc =
+			crc32_ieee((const uint8_t *)&slot->ec_hdr,
+				   sizeof(slot->ec_hdr) - sizeof(slot->ec_hdr.hdr_crc));
+
+		const size_t pnum = slot->item->value.pnum;
+		const uint32_t start = k_cycle_get_32();
+
+		if (0 != ubi_ec_hdr_write(&ubi->flash, pnum, &slot->ec_hdr)) {
+			LOG_ERR("EC header write failure");
+			slot->is_bad = true;
+		}
+
+		slot->cost_us += k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	}
+
+	device_lock(ubi, UBI_IO_CLASS_ERASE);
+
+	ubi->nr_of_erases -= 1;
+	device_broadcast(ubi, &ubi->write_done);
+
+	/* 5. Return erased PEBs to free PEBs, failed ones to bad PEBs */
+	for (size_t idx = 0; idx < nr_of_slots; ++idx) {
+		struct ubi_rbt_item *entry = slots[idx].item;
+
+		if (slots[idx].is_bad) {
+			struct ubi_list_item *bad_item = k_malloc(sizeof(*bad_item));
+
+			if (!bad_item) {
+				LOG_ERR("Heap allocation failure");
+				rb_insert(&ubi->dirty_pebs, &entry->node);
+				ubi->dirty_pebs_size += 1;
+				continue;
+			}
+
+			move_to_bad_blocks(ubi, entry->value.pnum, entry->key, bad_item);
+			k_free(entry);
+			continue;
+		}
+
+		entry->key = slots[idx].ec_hdr.ec;
+		rb_insert(&ubi->free_pebs, &entry->node);
+		ubi->free_pebs_size += 1;
+		nr_of_erased += 1;
+	}
+
+	/*
+	 * Cost of one PEB is the slowest PEB of the batch, or the batch average if bookkeeping
+	 * dominates. It is never zero to keep budget estimates finite.
+	 */
+	uint32_t sample =
+		MAX(1, k_cyc_to_us_floor32(k_cycle_get_32() - batch_start) / nr_of_slots);
+
+	for (size_t idx = 0; idx < nr_of_slots; ++idx) {
+		if (!slots[idx].is_bad)
+			sample = MAX(sample, slots[idx].cost_us);
+	}
+
+	/* Slower PEB raises the estimate at once, faster ones lower it gradually */
+	ubi->erase_peb_us = (0 == ubi->erase_peb_us) ?
+				    sample :
+				    MAX(sample, (3 * ubi->erase_peb_us + sample) / 4);
+
+	if (ubi->bad_pebs_size > 0) {
+		/** TODO: Torture bad blocks. */
+	}
+
+exit:
+	if (slots)
+		k_free(slots);
+
+	if (erased)
+		*erased = nr_of_erased;
+
+	device_unlock(ubi);
+	return ret;
+}
+
+int ubi_device_maintain(struct ubi_device *ubi, k_timeout_t budget, size_t *remaining)
+{
+	if (!ubi)
+		return -EINVAL;
+
+	int ret = 0;
+	const bool is_unbounded = K_TIMEOUT_EQ(budget, K_FOREVER);
+	/* Deadline on uptime ticks takes absolute timeouts and budgets past a cycle counter wrap */
+	const k_timepoint_t deadline = sys_timepoint_calc(budget);
+
+	/* Lock is not held across batches, so readers are served between them */
+	while (true) {
+		device_lock(ubi, UBI_IO_CLASS_ERASE);
+		size_t count = ubi->dirty_pebs_size;
+		/* Cost is unknown before the first erase, so the datasheet worst case is used */
+		const uint32_t erase_peb_us = (0 == ubi->erase_peb_us) ?
+						      CONFIG_UBI_ERASE_PEB_WORST_US :
+						      ubi->erase_peb_us;
+		device_unlock(ubi);
+
+		if (0 == count)
+			break;
+
+		if (!is_unbounded) {
+			if (sys_timepoint_expired(deadline))
+				break;
+
+			const k_timeout_t left = sys_timepoint_timeout(deadline);
+			const uint64_t left_us = k_ticks_to_us_floor64(left.ticks);
+
+			/*
+			 * Batch fills half of the remaining budget and the rest is measured
+			 * again, so a cost underestimated by half still returns in time.
+			 */
+			const size_t fit = left_us / erase_peb_us;
+			count = MIN(count, DIV_ROUND_UP(fit, 2));
+		}
+
+		if (0 == count)
+			break;
+
+		size_t erased = 0;
+		ret = ubi_device_erase_pebs(ubi, count, &erased);
+
+		if (0 != ret) {
+			LOG_ERR("PEBs erase failure");
+			break;
+		}
+
+		if (0 == erased)
+			break;
+	}
+
+	if (remaining) {
+		device_lock(ubi, UBI_IO_CLASS_ERASE);
+		*remaining = ubi->dirty_pebs_size;
+		device_unlock(ubi);
+	}
+
+	return ret;
+}
+
+int ubi_device_deinit(struct ubi_device *ubi)
+{
+	if (!ubi)
+		return -EINVAL;
+
+	struct rbnode *node = NULL;
+	struct ubi_rbt_item *rbt_item = NULL;
+	struct ubi_rbt_item *vol_item = NULL;
+
+	struct ubi_list_item *list_item = NULL;
+	struct ubi_list_item *list_next = NULL;
+
+	while ((node = rb_get_min(&ubi->free_pebs))) {
+		rbt_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+		rb_remove(&ubi->free_pebs, &rbt_item->node);
+		k_free(rbt_item);
+		ubi->free_pebs_size -= 1;
+	}
+
+	while ((node = rb_get_min(&ubi->dirty_pebs))) {
+		rbt_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+		rb_remove(&ubi->dirty_pebs, &rbt_item->node);
+		k_free(rbt_item);
+		ubi->dirty_pebs_size -= 1;
+	}
+
+	k_free(ubi->journal);
+
+	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&ubi->bad_pebs, list_item, list_next, node)
+	{
+		sys_slist_remove(&ubi->bad_pebs, NULL, &list_item->node);
+		k_free(list_item);
+		ubi->bad_pebs_size -= 1;
+	}
+
+	while ((node = rb_get_min(&ubi->vols))) {
+		rbt_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+		rb_remove(&ubi->vols, &rbt_item->node);
+
+		struct ubi_volume *vol = rbt_item->value.vol;
+		while ((node = rb_get_min(&vol->eba_tbl))) {
+			vol_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
+			rb_remove(&vol->eba_tbl, &vol_item->node);
+			k_free(vol_item);
+			vol->eba_tbl_size -= 1;
+		}
+
+		sealed_map_put(vol->sealed);
+		quota_release(ubi, vol);
+		ubi_crypto_close(vol->crypto);
+		k_free(rbt_item->value.vol);
+		k_free(rbt_item);
+		ubi->vols_size -= 1;
+	}
+
+	k_free(ubi->flash.part_ends);
+	k_free(ubi);
+	return 0;
+}
+
+int ubi_device_get_io_stats(struct ubi_device *ubi, enum ubi_io_class io_class,
+			    struct ubi_io_class_stats *stats)
+{
+	if (!ubi || io_class >= UBI_IO_CLASS_COUNT || !stats)
+		return -EINVAL;
+
+	/* Scheduler lock only, statistics are read without queueing for the device */
+	k_mutex_lock(&ubi->sched.lock, K_FOREVER);
+	*stats = ubi->sched.stats[io_class];
+	k_mutex_unlock(&ubi->sched.lock);
+
+	return 0;
+}
+
+#if defined(CONFIG_UBI_TEST_API_ENABLE)
+
+int ubi_device_get_peb_ec(struct ubi_device *ubi, size_t **peb_ec, size_t *len)
+{
+	int ret = -EIO;
+
+	if (!ubi || !peb_ec || !len)
+		return -EINVAL;
+
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+
+	size_t nr_of_pebs = 0;
+
+	ret = ubi_mtd_get_peb_count(&ubi->flash, &nr_of_pebs);
+
+	if (0 != ret) {
+		LOG_ERR("Flash area open failure");
+		goto exit;
+	}
+
+	nr_of_pebs -= UBI_DEV_HDR_NR_OF_RES_PEBS;
+
+	size_t *_peb_ec = k_malloc(nr_of_pebs * sizeof(*_peb_ec));
+
+	if (!_peb_ec) {
+		LOG_ERR("Heap allocation failure");
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	for (size_t pnum = 0; pnum < nr_of_pebs; ++pnum) {
+		struct ubi_ec_hdr ec_hdr = { 0 };
+		ret = ubi_ec_hdr_read(&ubi->flash, pnum + UBI_DEV_HDR_NR_OF_RES_PEBS, &ec_hdr);
+
+		if (0 != ret) {
+			LOG_ERR("EC header read failure");
+			k_free(_peb_ec);
+			goto exit;
+		}
+
+		_peb_ec[pnum] = ec_hdr.ec;
+	}
+
+	*len = nr_of_pebs;
+	*peb_ec = _peb_ec;
+
+exit:
+	device_unlock(ubi);
+	return 0;
+}
+
+#endif /* CONFIG_UBI_TEST_API_ENABLE */
+
+int ubi_volume_create(struct ubi_device *ubi, const struct ubi_volume_config *vol_cfg, int *vol_id)
+{
+	int ret = -EIO;
+
+	if (!ubi || !vol_cfg || !vol_id)
+		return -EINVAL;
+
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+
+	/* 1. Check if volume exist */
+	const size_t name_len = strnlen(vol_cfg->name, UBI_VOLUME_NAME_MAX_LEN);
+
+	struct ubi_rbt_item *entry = NULL;
+	RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+	{
+		const struct ubi_volume *vol = entry->value.vol;
+		const size_t len = strnlen(vol->cfg.name, UBI_VOLUME_NAME_MAX_LEN);
+
+		if (name_len == len && 0 == memcmp(vol_cfg->name, vol->cfg.name, name_len)) {
+			*vol_id = vol->vol_id;
+			ret = 0;
+			goto exit;
+		}
+	}
+
+	if (vol_cfg->encrypted && !IS_ENABLED(CONFIG_UBI_CRYPTO_ENABLE)) {
+		LOG_ERR("Volume encryption is disabled");
+		ret = -ENOTSUP;
+		goto exit;
+	}
+
+	if (vol_cfg->autoresize) {
+		if (UBI_VOLUME_TYPE_DYNAMIC != vol_cfg->type) {
+			LOG_ERR("Only dynamic volume may be autoresized");
+			ret = -EINVAL;
+			goto exit;
+		}
+
+		RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+		{
+			if (entry->value.vol->cfg.autoresize) {
+				LOG_ERR("Autoresize is requested by another volume");
+				ret = -EEXIST;
+				goto exit;
+			}
+		}
+	}
+
+	/* 2. Create volume */
+	struct ubi_device_info info = { 0 };
+	ret = ubi_device_get_info(ubi, &info);
+
+	if (0 != ret) {
+		LOG_ERR("UBI device get info failure");
+		goto exit;
+	}
+
+	if (vol_cfg->leb_count > leb_avail_count(&info)) {
+		LOG_ERR("Failed to allocate PEBs for volume");
+		ret = -ENOSPC;
+		goto exit;
+	}
+
+	struct ubi_dev_hdr dev_hdr = { 0 };
+	ret = ubi_dev_hdr_read(&ubi->flash, &dev_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("Device header read failure");
+		goto exit;
+	}
+
+	struct ubi_dev_hdr new_dev_hdr = dev_hdr;
+	new_dev_hdr.revision += 1;
+	new_dev_hdr.vol_count += 1;
+	new_dev_hdr.hdr_crc = crc32_ieee((const uint8_t *)&new_dev_hdr,
+					 sizeof(new_dev_hdr) - sizeof(new_dev_hdr.hdr_crc));
+
+	struct ubi_vol_hdr new_vol_hdr = { 0 };
+	new_vol_hdr.magic = UBI_VOL_HDR_MAGIC;
+	new_vol_hdr.version = UBI_VOL_HDR_VERSION;
+	new_vol_hdr.vol_type = vol_cfg->type;
+	new_vol_hdr.flags = vol_cfg->autoresize ? UBI_VOL_FLAG_AUTORESIZE : 0;
+	new_vol_hdr.flags |= vol_cfg->compressed ? UBI_VOL_FLAG_COMPRESSED : 0;
+	new_vol_hdr.flags |= vol_cfg->encrypted ? UBI_VOL_FLAG_ENCRYPTED : 0;
+	new_vol_hdr.flags |= vol_cfg->durable_unmap ? UBI_VOL_FLAG_DURABLE_UNMAP : 0;
+	new_vol_hdr.vol_id = ubi->vols_seqnr++;
+	new_vol_hdr.lebs_count = vol_cfg->leb_count;
+	new_vol_hdr.sqnum_bound = ubi->global_seqnr;
+	strncpy(new_vol_hdr.name, vol_cfg->name, UBI_VOLUME_NAME_MAX_LEN);
+	new_vol_hdr.hdr_crc = crc32_ieee((const uint8_t *)&new_vol_hdr,
+					 sizeof(new_vol_hdr) - sizeof(new_vol_hdr.hdr_crc));
+
+	ret = ubi_vol_hdr_append(&ubi->flash, &new_dev_hdr, &new_vol_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("Volume header append failure");
+		goto exit;
+	}
+
+	struct ubi_volume *vol = k_malloc(sizeof(*vol));
+	if (!vol) {
+		LOG_ERR("Heap allocation failure");
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	memset(vol, 0, sizeof(*vol));
+	vol->vol_idx = new_dev_hdr.vol_count - 1;
+	vol->vol_id = new_vol_hdr.vol_id;
+	vol->io_class = UBI_IO_CLASS_NORMAL;
+	memcpy(vol->cfg.name, new_vol_hdr.name, strlen(new_vol_hdr.name));
+	vol->cfg.type = new_vol_hdr.vol_type;
+	vol->cfg.leb_count = new_vol_hdr.lebs_count;
+	vol->sqnum_bound = new_vol_hdr.sqnum_bound;
+	vol->cfg.autoresize = vol_cfg->autoresize;
+	vol->cfg.compressed = vol_cfg->compressed;
+	vol->cfg.encrypted = vol_cfg->encrypted;
+	vol->cfg.durable_unmap = vol_cfg->durable_unmap;
+	vol->eba_tbl_size = 0;
+	vol->eba_tbl.lessthan_fn = ubi_rbt_cmp;
+
+	struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+	if (!item) {
+		LOG_ERR("Heap allocation failure");
+		k_free(vol);
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	item->key = vol->vol_id;
+	item->value.vol = vol;
+
+	seq_write_begin(&ubi->vols_seq);
+	rb_insert(&ubi->vols, &item->node);
+	ubi->vols_size += 1;
+	seq_write_end(&ubi->vols_seq);
+
+	*vol_id = vol->vol_id;
+
+exit:
+	device_unlock(ubi);
+	return ret;
+}
+
+int ubi_volume_snapshot(struct ubi_device *ubi, int src_id, const char *name, int *dst_id)
+{
+	int ret = -EIO;
+
+	if (!ubi || src_id < 0 || !name || !dst_id)
+		return -EINVAL;
+
+	const size_t name_len = strnlen(name, UBI_VOLUME_NAME_MAX_LEN);
+
+	if (0 == name_len || UBI_VOLUME_NAME_MAX_LEN == name_len)
+		return -EINVAL;
+
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+	device_wait_idle(ubi);
+
+	struct ubi_volume *snap = NULL;
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, src_id);
+
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	struct ubi_volume *src = entry->value.vol;
+
+	if (src->is_snapshot) {
+		LOG_ERR("Snapshot of snapshot is not supported");
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	/* 1. Check if name is free */
+	RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+	{
+		const struct ubi_volume *vol = entry->value.vol;
+		const size_t len = strnlen(vol->cfg.name, UBI_VOLUME_NAME_MAX_LEN);
+
+		if (name_len == len && 0 == memcmp(name, vol->cfg.name, name_len)) {
+			LOG_ERR("Volume name already exists");
+			ret = -EEXIST;
+			goto exit;
+		}
+	}
 
-	ret = ubi_vid_hdr_write(&ubi->mtd, min_node->value.pnum, &vid_hdr);
+	/* 2. Reserve LEBs for copy on write of every source LEB */
+	struct ubi_device_info info = { 0 };
+	ret = ubi_device_get_info(ubi, &info);
 
 	if (0 != ret) {
-		LOG_ERR("VID header write failure");
+		LOG_ERR("UBI device get info failure");
 		goto exit;
 	}
 
-	if (buf && len > 0) {
-		ret = ubi_leb_data_write(&ubi->mtd, min_node->value.pnum, buf, len);
+	if (src->cfg.leb_count > leb_avail_count(&info)) {
+		LOG_ERR("Failed to allocate PEBs for volume");
+		ret = -ENOSPC;
+		goto exit;
+	}
 
-		if (0 != ret) {
-			LOG_ERR("LEB data write failure");
+	/* 3. Share EBA table of source volume */
+	snap = k_malloc(sizeof(*snap));
+
+	if (!snap) {
+		LOG_ERR("Heap allocation failure");
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	memset(snap, 0, sizeof(*snap));
+	memcpy(snap->cfg.name, name, name_len);
+	snap->cfg.type = src->cfg.type;
+	snap->cfg.leb_count = src->cfg.leb_count;
+	snap->cfg.compressed = src->cfg.compressed;
+	snap->has_patterns = src->has_patterns;
+	snap->cfg.encrypted = src->cfg.encrypted;
+	snap->io_class = src->io_class;
+	snap->is_snapshot = true;
+	snap->src_vol_id = src->vol_id;
+	snap->sqnum_bound = ubi->global_seqnr;
+	snap->eba_tbl.lessthan_fn = ubi_rbt_cmp;
+
+	struct ubi_rbt_item *item = NULL;
+	RB_FOR_EACH_CONTAINER(&src->eba_tbl, entry, node)
+	{
+		item = k_malloc(sizeof(*item));
+
+		if (!item) {
+			LOG_ERR("Heap allocation failure");
+			ret = -ENOMEM;
 			goto exit;
 		}
+
+		item->key = entry->key;
+		item->value.pnum = entry->value.pnum;
+		rb_insert(&snap->eba_tbl, &item->node);
+		snap->eba_tbl_size += 1;
+	}
+
+	item = k_malloc(sizeof(*item));
+
+	if (!item) {
+		LOG_ERR("Heap allocation failure");
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	/* 4. Single volume header append persists the snapshot */
+	struct ubi_dev_hdr dev_hdr = { 0 };
+	ret = ubi_dev_hdr_read(&ubi->flash, &dev_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("Device header read failure");
+		k_free(item);
+		goto exit;
+	}
+
+	dev_hdr.revision += 1;
+	dev_hdr.vol_count += 1;
+	dev_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
+
+	struct ubi_vol_hdr vol_hdr = { 0 };
+	vol_hdr.magic = UBI_VOL_HDR_MAGIC;
+	vol_hdr.version = UBI_VOL_HDR_VERSION;
+	vol_hdr.vol_type = snap->cfg.type;
+	vol_hdr.flags = UBI_VOL_FLAG_SNAPSHOT;
+	vol_hdr.flags |= snap->cfg.compressed ? UBI_VOL_FLAG_COMPRESSED : 0;
+	vol_hdr.flags |= snap->cfg.encrypted ? UBI_VOL_FLAG_ENCRYPTED : 0;
+	vol_hdr.vol_id = ubi->vols_seqnr;
+	vol_hdr.lebs_count = snap->cfg.leb_count;
+	vol_hdr.sqnum_bound = snap->sqnum_bound;
+	vol_hdr.src_vol_id = snap->src_vol_id;
+	memcpy(vol_hdr.name, name, name_len);
+	vol_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&vol_hdr, sizeof(vol_hdr) - sizeof(vol_hdr.hdr_crc));
+
+	ret = ubi_vol_hdr_append(&ubi->flash, &dev_hdr, &vol_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("Volume header append failure");
+		k_free(item);
+		goto exit;
 	}
 
-	struct ubi_rbt_item *alloc_node = min_node;
-	alloc_node->key = lnum;
-	rb_insert(&vol->eba_tbl, &alloc_node->node);
-	vol->eba_tbl_size += 1;
+	ubi->vols_seqnr += 1;
+	snap->vol_idx = dev_hdr.vol_count - 1;
+	snap->vol_id = vol_hdr.vol_id;
+
+	item->key = snap->vol_id;
+	item->value.vol = snap;
+
+	seq_write_begin(&ubi->vols_seq);
+	rb_insert(&ubi->vols, &item->node);
+	ubi->vols_size += 1;
+	seq_write_end(&ubi->vols_seq);
+
+	*dst_id = snap->vol_id;
+	snap = NULL;
 
 exit:
-	k_mutex_unlock(&ubi->mutex);
+	if (snap) {
+		for (struct rbnode *node = rb_get_min(&snap->eba_tbl); node;
+		     node = rb_get_min(&snap->eba_tbl)) {
+			rb_remove(&snap->eba_tbl, node);
+			k_free(CONTAINER_OF(node, struct ubi_rbt_item, node));
+		}
+
+		k_free(snap);
+	}
+
+	device_unlock(ubi);
 	return ret;
 }
 
-/* Module interface function definitions ------------------------------------------------------- */
-
-int ubi_device_init(const struct ubi_mtd *mtd, struct ubi_device **ubi)
+int ubi_volume_resize(struct ubi_device *ubi, int vol_id, const struct ubi_volume_config *vol_cfg)
 {
-	int ret = -1;
+	int ret = -EIO;
 
-	if (!mtd || !ubi)
+	if (!ubi || !vol_cfg)
 		return -EINVAL;
 
-	struct ubi_device *ubi_dev = k_malloc(sizeof(*ubi_dev));
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+	device_wait_idle(ubi);
 
-	if (!ubi_dev) {
-		LOG_ERR("Heap allocation failure");
-		return -ENOMEM;
+	if (0 == ubi->vols_size) {
+		LOG_ERR("No volumes present on device");
+		ret = -ENOENT;
+		goto exit;
 	}
 
-	memset(ubi_dev, 0, sizeof(*ubi_dev));
-	k_mutex_init(&ubi_dev->mutex);
-	ubi_dev->mtd = *mtd;
-	ubi_dev->free_pebs.lessthan_fn = ubi_rbt_cmp;
-	ubi_dev->dirty_pebs.lessthan_fn = ubi_rbt_cmp;
-	sys_slist_init(&ubi_dev->bad_pebs);
-	ubi_dev->vols.lessthan_fn = ubi_rbt_cmp;
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	struct ubi_volume *vol = entry->value.vol;
+
+	if (vol->is_snapshot) {
+		LOG_ERR("Snapshot volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
+
+	if (UBI_VOLUME_TYPE_DYNAMIC != vol->cfg.type) {
+		LOG_ERR("Static volume cannot be resized");
+		ret = -ECANCELED;
+		goto exit;
+	}
+
+	if (vol_cfg->leb_count == vol->cfg.leb_count) {
+		LOG_ERR("Cannot resize for the same count of LEBs");
+		ret = -ECANCELED;
+		goto exit;
+	}
 
-	const struct flash_area *fa = NULL;
-	ret = flash_area_open(ubi_dev->mtd.partition_id, &fa);
+	if (vol_cfg->leb_count > vol->cfg.leb_count) {
+		struct ubi_device_info info = { 0 };
+		ret = ubi_device_get_info(ubi, &info);
+
+		if (0 != ret) {
+			LOG_ERR("Device get info failure");
+			goto exit;
+		}
+
+		const size_t avail = leb_avail_count(&info);
+		const size_t diff = vol_cfg->leb_count - vol->cfg.leb_count;
+
+		if (diff > avail) {
+			LOG_ERR("Lack of available for allocation LEBs");
+			ret = -ENOSPC;
+			goto exit;
+		}
+	} else {
+		const size_t diff = vol->cfg.leb_count - vol_cfg->leb_count;
+
+		if (0 == diff) {
+			LOG_ERR("Cannot resize volume to zero LEBs");
+			ret = -ECANCELED;
+			goto exit;
+		}
+
+		leb_unmap_range(ubi, vol, vol_cfg->leb_count, diff);
+	}
+
+	struct ubi_dev_hdr dev_hdr = { 0 };
+	ret = ubi_dev_hdr_read(&ubi->flash, &dev_hdr);
 
 	if (0 != ret) {
-		LOG_ERR("Flash area open failure");
-		return ret;
+		LOG_ERR("Device header read failure");
+		goto exit;
 	}
 
-	if (!flash_area_device_is_ready(fa)) {
-		LOG_ERR("Flash area is not ready");
-		flash_area_close(fa);
-		return -ENODEV;
+	dev_hdr.revision += 1;
+	dev_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
+
+	struct ubi_vol_hdr vol_hdr = { 0 };
+	ret = ubi_vol_hdr_read(&ubi->flash, vol->vol_idx, &vol_hdr);
+
+	if (0 != ret) {
+		LOG_ERR("Volume header read failure");
+		goto exit;
 	}
 
-	const size_t nr_of_pebs = fa->fa_size / ubi_dev->mtd.erase_block_size;
-	flash_area_close(fa);
+	vol_hdr.lebs_count = vol_cfg->leb_count;
+	vol_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&vol_hdr, sizeof(vol_hdr) - sizeof(vol_hdr.hdr_crc));
 
-	bool is_mounted = false;
-	ret = ubi_dev_is_mounted(&ubi_dev->mtd, &is_mounted);
+	ret = ubi_vol_hdr_update(&ubi->flash, &dev_hdr, vol->vol_idx, &vol_hdr);
 
 	if (0 != ret) {
-		LOG_ERR("Device check mount failure");
-		return ret;
+		LOG_ERR("Volume header update failure");
+		goto exit;
 	}
 
-	/* 1. UBI device is not mounted. */
-	if (false == is_mounted) {
-		ret = ubi_dev_mount(&ubi_dev->mtd);
+	seq_write_begin(&vol->eba_seq);
+	vol->cfg.leb_count = vol_cfg->leb_count;
+	seq_write_end(&vol->eba_seq);
 
-		if (0 != ret) {
-			LOG_ERR("Device mount failure");
-			return ret;
-		}
+exit:
+	device_unlock(ubi);
+	return ret;
+}
 
-		struct ubi_ec_hdr ec_hdr = { 0 };
-		ec_hdr.magic = UBI_EC_HDR_MAGIC;
-		ec_hdr.version = UBI_EC_HDR_VERSION;
-		ec_hdr.ec = 0;
-		ec_hdr.hdr_crc = crc32_ieee((const uint8_t *)&ec_hdr,
-					    sizeof(ec_hdr) - sizeof(ec_hdr.hdr_crc));
+int ubi_volume_remove(struct ubi_device *ubi, int vol_id)
+{
+	int ret = -EIO;
 
-		for (size_t peb_idx = UBI_DEV_HDR_NR_OF_RES_PEBS; peb_idx < nr_of_pebs; ++peb_idx) {
-			const struct flash_area *fa = NULL;
-			ret = flash_area_open(ubi_dev->mtd.partition_id, &fa);
+	if (!ubi)
+		return -EINVAL;
 
-			if (0 != ret) {
-				LOG_ERR("Flash area open failure");
-				return ret;
-			}
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+	device_wait_idle(ubi);
+
+	if (0 == ubi->vols_size) {
+		LOG_ERR("No volumes present on device");
+		ret = -ENOENT;
+		goto exit;
+	}
 
-			const size_t offset = peb_idx * ubi_dev->mtd.erase_block_size;
-			ret = flash_area_erase(fa, offset, ubi_dev->mtd.erase_block_size);
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
 
-			if (0 != ret) {
-				LOG_ERR("Flash erase failure");
-				flash_area_close(fa);
-				goto exit;
-			}
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
 
-			flash_area_close(fa);
+	struct ubi_volume *vol = entry->value.vol;
+	struct ubi_rbt_item *item = NULL;
 
-			ret = ubi_ec_hdr_write(&ubi_dev->mtd, peb_idx, &ec_hdr);
+	RB_FOR_EACH_CONTAINER(&ubi->vols, item, node)
+	{
+		const struct ubi_volume *snap = item->value.vol;
 
-			if (0 != ret) {
-				LOG_ERR("EC header write failure");
-				goto exit;
-			}
+		if (snap->is_snapshot && snap->src_vol_id == vol->vol_id) {
+			LOG_ERR("Volume has snapshots");
+			ret = -EBUSY;
+			goto exit;
 		}
 	}
 
+	if (!sealed_map_is_idle(vol)) {
+		LOG_ERR("Sealed volume is open");
+		ret = -EBUSY;
+		goto exit;
+	}
+
 	struct ubi_dev_hdr dev_hdr = { 0 };
-	ret = ubi_dev_hdr_read(&ubi_dev->mtd, &dev_hdr);
+	ret = ubi_dev_hdr_read(&ubi->flash, &dev_hdr);
 
 	if (0 != ret) {
 		LOG_ERR("Device header read failure");
-		return ret;
+		goto exit;
 	}
 
-	/* 2. Collect EBA tables for volumes. */
+	dev_hdr.vol_count -= 1;
+	dev_hdr.revision += 1;
+	dev_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
+
+	ret = ubi_vol_hdr_remove(&ubi->flash, &dev_hdr, vol->vol_idx);
+
+	if (0 != ret) {
+		LOG_ERR("Volume header remove failure");
+		goto exit;
+	}
+
+	/* Removed volume header makes its PEBs dirty on attach, nothing is read from them */
+	seq_write_begin(&ubi->vols_seq);
+
+	leb_unmap_range(ubi, vol, 0, vol->cfg.leb_count);
+	__ASSERT_NO_MSG(0 == vol->eba_tbl_size);
+
+	rb_remove(&ubi->vols, &entry->node);
+	ubi->vols_size -= 1;
+
+	seq_write_end(&ubi->vols_seq);
+
+	reader_sync(ubi);
+	sealed_map_put(vol->sealed);
+	quota_release(ubi, vol);
+
+	/* Destroy the key, data left in dirty PEBs is unreadable without it */
+	ubi_crypto_close(vol->crypto);
+	k_free(entry->value.vol);
+	k_free(entry);
+
 	for (size_t vol_idx = 0; vol_idx < dev_hdr.vol_count; ++vol_idx) {
 		struct ubi_vol_hdr vol_hdr = { 0 };
-		ret = ubi_vol_hdr_read(&ubi_dev->mtd, vol_idx, &vol_hdr);
+		ret = ubi_vol_hdr_read(&ubi->flash, vol_idx, &vol_hdr);
 
 		if (0 != ret) {
-			LOG_ERR("Volume header read failure");
+			LOG_ERR("Volume header readd failure");
 			goto exit;
 		}
 
-		struct ubi_volume *vol = k_malloc(sizeof(*vol));
+		entry = ubi_rbt_search(&ubi->vols, vol_hdr.vol_id);
 
-		if (!vol) {
-			LOG_ERR("Heap allocation failure");
-			ret = -ENOMEM;
+		if (!entry) {
+			LOG_ERR("Inconsistency between cache and nvm");
+			ret = -EIO;
 			goto exit;
 		}
 
-		memset(vol, 0, sizeof(*vol));
+		vol = entry->value.vol;
 		vol->vol_idx = vol_idx;
-		vol->vol_id = vol_hdr.vol_id;
-		memcpy(vol->cfg.name, vol_hdr.name, strlen(vol_hdr.name));
-		vol->cfg.type = vol_hdr.vol_type;
-		vol->cfg.leb_count = vol_hdr.lebs_count;
-		vol->eba_tbl_size = 0;
-		vol->eba_tbl.lessthan_fn = ubi_rbt_cmp;
+	}
 
-		struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+exit:
+	device_unlock(ubi);
+	return ret;
+}
 
-		if (!item) {
-			LOG_ERR("Heap allocation failure");
-			ret = -ENOMEM;
-			k_free(vol);
-			goto exit;
-		}
+int ubi_volume_wipe(struct ubi_device *ubi, int vol_id)
+{
+	int ret = -EIO;
 
-		memset(item, 0, sizeof(*item));
-		item->key = vol->vol_id;
-		item->value.vol = vol;
+	if (!ubi || vol_id < 0)
+		return -EINVAL;
 
-		rb_insert(&ubi_dev->vols, &item->node);
-		ubi_dev->vols_size += 1;
+	device_lock(ubi, io_class_resolve(ubi, vol_id, UBI_IO_CLASS_OF_VOLUME));
 
-		if (vol->vol_id > ubi_dev->vols_seqnr)
-			ubi_dev->vols_seqnr = vol->vol_id;
+	/* LEB write in flight would commit a sequence number below the new bound */
+	struct ubi_volume *vol = volume_wait_idle(ubi, vol_id);
+
+	if (!vol) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
 	}
 
-	if (dev_hdr.vol_count > 0)
-		ubi_dev->vols_seqnr += 1;
+	if (vol->is_snapshot) {
+		LOG_ERR("Snapshot volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
 
-	size_t ec_sum = 0;
-	size_t ec_count = 0;
+	if (vol->is_sealed) {
+		LOG_ERR("Sealed volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
 
-	/* 3. Scan all PEB's with correct EC header and collect average of erases */
-	for (size_t pnum = UBI_DEV_HDR_NR_OF_RES_PEBS; pnum < nr_of_pebs; ++pnum) {
-		struct ubi_ec_hdr ec_hdr = { 0 };
-		ret = ubi_ec_hdr_read(&ubi_dev->mtd, pnum, &ec_hdr);
+	struct ubi_rbt_item *item = NULL;
 
-		if (0 == ret) {
-			ec_sum += ec_hdr.ec;
-			ec_count += 1;
+	RB_FOR_EACH_CONTAINER(&ubi->vols, item, node)
+	{
+		const struct ubi_volume *snap = item->value.vol;
+
+		if (snap->is_snapshot && snap->src_vol_id == vol->vol_id) {
+			LOG_ERR("Volume has snapshots");
+			ret = -EBUSY;
+			goto exit;
 		}
 	}
 
-	const size_t ec_avg = ec_sum / ec_count;
+	struct ubi_dev_hdr dev_hdr = { 0 };
+	ret = ubi_dev_hdr_read(&ubi->flash, &dev_hdr);
 
-	/* 4. Scan all PEB's and update volume EBA table:
-   	 *    1. If EC header is incorrect, then append to bad PEBs.
-   	 *    2. If EC header is correct and VID header is empty, then insert to free PEBs.
-   	 *    3. If EC header is correct and VID header is incorrect, then append to bad PEBs.
-   	 *    4. If EC header is correct and VID header is correct then:
-   	 *       1. Collect greater sequence number from VID.
-   	 *       2. Search in volume EBA table LEB with this key exist.
-   	 *	 3. Volume does not exist, then insert to dirty PEBs.
-         *       4. LEB does not exist, but exceed volume LEB limit, insert to dirty PEBs.
-   	 *       5. LEB does not exist, then insert to volume EBA table.
-   	 *       6. LEB does exist but EC or VID headers of EBA table LEB are incorrect, then append to bad PEBs.
-   	 *       7. LEB does exist and EC and VID headers are correct then:
-   	 *          1. If newer LEB has lower sequence number, then append to dirty PEBs.
-   	 *          2. If newer LEB has greater sequence number, then remove old LEB
-   	 *	       from volume EBA table and append to dirty PEBs. The newer LEB append to
-   	 *	       volume EBA table.
-   	 */
-	for (size_t pnum = UBI_DEV_HDR_NR_OF_RES_PEBS; pnum < nr_of_pebs; ++pnum) {
-		/* 4.1 */
-		struct ubi_ec_hdr ec_hdr = { 0 };
-		ret = ubi_ec_hdr_read(&ubi_dev->mtd, pnum, &ec_hdr);
+	if (0 != ret) {
+		LOG_ERR("Device header read failure");
+		goto exit;
+	}
 
-		if (0 != ret) {
-			struct ubi_list_item *item = k_malloc(sizeof(*item));
+	dev_hdr.revision += 1;
+	dev_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
 
-			if (!item) {
-				LOG_ERR("Heap allocation failure");
-				ret = -ENOMEM;
-				goto exit;
-			}
+	struct ubi_vol_hdr vol_hdr = { 0 };
+	ret = ubi_vol_hdr_read(&ubi->flash, vol->vol_idx, &vol_hdr);
 
-			move_to_bad_blocks(ubi_dev, pnum, ec_avg, item);
-			continue;
-		}
+	if (0 != ret) {
+		LOG_ERR("Volume header read failure");
+		goto exit;
+	}
 
-		/* 4.2 */
-		struct ubi_vid_hdr vid_hdr = { 0 };
-		ret = ubi_vid_hdr_read(&ubi_dev->mtd, pnum, &vid_hdr, false);
+	/* Every PEB of the volume has a lower sequence number, so all of them go stale at once */
+	vol_hdr.sqnum_bound = ubi->global_seqnr;
+	vol_hdr.hdr_crc =
+		crc32_ieee((const uint8_t *)&vol_hdr, sizeof(vol_hdr) - sizeof(vol_hdr.hdr_crc));
 
-		if (0 != ret) {
-			LOG_ERR("VID header read failure");
-			goto exit;
-		}
+	ret = ubi_vol_hdr_update(&ubi->flash, &dev_hdr, vol->vol_idx, &vol_hdr);
 
-		struct ubi_vid_hdr empty_vid_hdr = { 0 };
-		memset(&empty_vid_hdr, 0xff, sizeof(empty_vid_hdr));
+	if (0 != ret) {
+		LOG_ERR("Volume header update failure");
+		goto exit;
+	}
 
-		if (0 == memcmp(&vid_hdr, &empty_vid_hdr, sizeof(vid_hdr))) {
-			struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+	vol->sqnum_bound = vol_hdr.sqnum_bound;
+	leb_unmap_range(ubi, vol, 0, vol->cfg.leb_count);
 
-			if (!item) {
-				LOG_ERR("Heap allocation failure");
-				ret = -ENOMEM;
-				goto exit;
-			}
+exit:
+	device_unlock(ubi);
+	return ret;
+}
 
-			item->key = ec_hdr.ec;
-			item->value.pnum = pnum;
-			rb_insert(&ubi_dev->free_pebs, &item->node);
-			ubi_dev->free_pebs_size += 1;
+int ubi_volume_rename(struct ubi_device *ubi, int vol_id, const char *name)
+{
+	if (!ubi || vol_id < 0 || !name)
+		return -EINVAL;
 
-			continue;
-		}
+	struct ubi_vol_txn *txn = NULL;
+	int ret = ubi_vol_txn_begin(ubi, &txn);
 
-		/* 4.3 */
-		memset(&vid_hdr, 0, sizeof(vid_hdr));
-		ret = ubi_vid_hdr_read(&ubi_dev->mtd, pnum, &vid_hdr, true);
+	if (0 != ret) {
+		LOG_ERR("Volume transaction begin failure");
+		return ret;
+	}
 
-		if (0 != ret) {
-			struct ubi_list_item *item = k_malloc(sizeof(*item));
+	ret = ubi_vol_txn_rename(txn, vol_id, name);
 
-			if (!item) {
-				LOG_ERR("Heap allocation failure");
-				ret = -ENOMEM;
-				goto exit;
-			}
+	if (0 != ret) {
+		ubi_vol_txn_abort(txn);
+		return ret;
+	}
 
-			move_to_bad_blocks(ubi_dev, pnum, ec_hdr.ec, item);
-			continue;
-		}
+	return ubi_vol_txn_commit(txn);
+}
 
-		/* 4.4 */
+int ubi_volume_swap_names(struct ubi_device *ubi, int vol_id_1, int vol_id_2)
+{
+	if (!ubi || vol_id_1 < 0 || vol_id_2 < 0 || vol_id_1 == vol_id_2)
+		return -EINVAL;
 
-		/* 4.4.1 */
-		if (vid_hdr.sqnum > ubi_dev->global_seqnr)
-			ubi_dev->global_seqnr = vid_hdr.sqnum;
+	struct ubi_vol_txn *txn = NULL;
+	int ret = ubi_vol_txn_begin(ubi, &txn);
 
-		/* 4.4.2 */
-		struct ubi_rbt_item *tmp = ubi_rbt_search(&ubi_dev->vols, vid_hdr.vol_id);
+	if (0 != ret) {
+		LOG_ERR("Volume transaction begin failure");
+		return ret;
+	}
 
-		/* 4.4.3 */
-		if (!tmp) {
-			struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+	struct ubi_vol_hdr *hdr_1 = txn_vol_search(txn, vol_id_1);
+	struct ubi_vol_hdr *hdr_2 = txn_vol_search(txn, vol_id_2);
 
-			if (!item) {
-				LOG_ERR("Heap allocation failure");
-				ret = -ENOMEM;
-				goto exit;
-			}
+	if (!hdr_1 || !hdr_2) {
+		LOG_ERR("Device volume not found");
+		ubi_vol_txn_abort(txn);
+		return -ENOENT;
+	}
 
-			item->key = ec_hdr.ec;
-			item->value.pnum = pnum;
-			rb_insert(&ubi_dev->dirty_pebs, &item->node);
-			ubi_dev->dirty_pebs_size += 1;
+	/* Names stay unique, so swap is staged directly instead of two renames */
+	uint8_t name[UBI_VOLUME_NAME_MAX_LEN] = { 0 };
+	memcpy(name, hdr_1->name, sizeof(name));
+	memcpy(hdr_1->name, hdr_2->name, sizeof(name));
+	memcpy(hdr_2->name, name, sizeof(name));
+	txn->nr_of_ops += 1;
 
-			continue;
-		}
+	return ubi_vol_txn_commit(txn);
+}
 
-		struct ubi_volume *vol = tmp->value.vol;
+int ubi_volume_seal(struct ubi_device *ubi, int vol_id)
+{
+	int ret = -EIO;
 
-		struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+	if (!ubi || vol_id < 0)
+		return -EINVAL;
 
-		if (!item) {
-			LOG_ERR("Heap allocation failure");
-			ret = -ENOMEM;
-			goto exit;
-		}
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+	device_wait_idle(ubi);
 
-		tmp = ubi_rbt_search(&vol->eba_tbl, vid_hdr.lnum);
+	struct ubi_vol_txn *txn = NULL;
+	struct ubi_sealed_volume *sealed = NULL;
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
 
-		if (!tmp) {
-			/* 4.4.4 */
-			if (vid_hdr.lnum >= vol->cfg.leb_count) {
-				item->key = ec_hdr.ec;
-				item->value.pnum = pnum;
-				rb_insert(&ubi_dev->dirty_pebs, &item->node);
-				ubi_dev->dirty_pebs_size += 1;
-				continue;
-			}
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
 
-			/* 4.4.5 */
-			item->key = vid_hdr.lnum;
-			item->value.pnum = pnum;
-			rb_insert(&vol->eba_tbl, &item->node);
-			vol->eba_tbl_size += 1;
+	struct ubi_volume *vol = entry->value.vol;
+
+	if (vol->is_sealed) {
+		ret = 0;
+		goto exit;
+	}
+
+	if (vol->is_snapshot || UBI_VOLUME_TYPE_STATIC != vol->cfg.type) {
+		LOG_ERR("Only static volume can be sealed");
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	if (vol->cfg.encrypted) {
+		LOG_ERR("Encrypted volume cannot be sealed");
+		ret = -ENOTSUP;
+		goto exit;
+	}
+
+	/* Mapping is built first, so a committed seal cannot fail afterwards */
+	ret = sealed_map_build(ubi, vol, &sealed);
+
+	if (0 != ret)
+		goto exit;
 
-			continue;
-		} else {
-			/* 4.4.6 */
-			struct ubi_ec_hdr exist_ec_hdr = { 0 };
-			ret = ubi_ec_hdr_read(&ubi_dev->mtd, tmp->value.pnum, &exist_ec_hdr);
+	ret = ubi_vol_txn_begin(ubi, &txn);
 
-			if (0 != ret) {
-				struct ubi_list_item *bad_item = k_malloc(sizeof(*bad_item));
+	if (0 != ret) {
+		LOG_ERR("Volume transaction begin failure");
+		goto exit;
+	}
 
-				if (!bad_item) {
-					LOG_ERR("Heap allocation failure");
-					k_free(item);
-					ret = -ENOMEM;
-					goto exit;
-				}
+	struct ubi_vol_hdr *hdr = txn_vol_search(txn, vol_id);
+	__ASSERT_NO_MSG(hdr);
 
-				move_to_bad_blocks(ubi_dev, tmp->value.pnum, ec_avg, bad_item);
-				continue;
-			}
+	hdr->flags |= UBI_VOL_FLAG_SEALED;
+	txn->nr_of_ops += 1;
 
-			struct ubi_vid_hdr exist_vid_hdr = { 0 };
-			ret = ubi_vid_hdr_read(&ubi_dev->mtd, tmp->value.pnum, &exist_vid_hdr,
-					       true);
+	ret = ubi_vol_txn_commit(txn);
 
-			if (0 != ret) {
-				struct ubi_list_item *bad_item = k_malloc(sizeof(*bad_item));
+	if (0 != ret) {
+		LOG_ERR("Volume transaction commit failure");
+		goto exit;
+	}
 
-				if (!bad_item) {
-					LOG_ERR("Heap allocation failure");
-					k_free(item);
-					ret = -ENOMEM;
-					goto exit;
-				}
+	vol->is_sealed = true;
+	vol->sealed = sealed;
+	sealed = NULL;
 
-				move_to_bad_blocks(ubi_dev, tmp->value.pnum, ec_hdr.ec, bad_item);
-				continue;
-			}
+exit:
+	sealed_map_put(sealed);
+	device_unlock(ubi);
+	return ret;
+}
 
-			/* 4.4.7.1 */
-			if (vid_hdr.sqnum < exist_vid_hdr.sqnum) {
-				item->key = ec_hdr.ec;
-				item->value.pnum = pnum;
-				rb_insert(&ubi_dev->dirty_pebs, &item->node);
-				ubi_dev->dirty_pebs_size += 1;
+int ubi_volume_get_info(struct ubi_device *ubi, int vol_id, struct ubi_volume_config *vol_cfg,
+			size_t *alloc_lebs)
+{
+	if (!ubi || vol_id < 0 || !vol_cfg || !alloc_lebs)
+		return -EINVAL;
 
-				continue;
-			} else {
-				/* 4.4.7.2 */
-				rb_remove(&vol->eba_tbl, &tmp->node);
-				vol->eba_tbl_size -= 1;
+	int ret = -EIO;
 
-				tmp->key = exist_ec_hdr.ec;
-				rb_insert(&ubi_dev->dirty_pebs, &tmp->node);
-				ubi_dev->dirty_pebs_size += 1;
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
 
-				item->key = vid_hdr.lnum;
-				item->key = pnum;
-				rb_insert(&vol->eba_tbl, &item->node);
-				vol->eba_tbl_size += 1;
+	if (0 == ubi->vols_size) {
+		LOG_ERR("No volumes present on device");
+		ret = -ENOENT;
+		goto exit;
+	}
 
-				continue;
-			}
-		}
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
 	}
 
-	*ubi = ubi_dev;
-	return 0;
+	struct ubi_volume *vol = entry->value.vol;
+	*vol_cfg = vol->cfg;
+	*alloc_lebs = vol->eba_tbl_size;
+	ret = 0;
 
 exit:
-	ubi_device_deinit(ubi_dev);
-	*ubi = NULL;
+	device_unlock(ubi);
 	return ret;
 }
 
-int ubi_device_get_info(struct ubi_device *ubi, struct ubi_device_info *info)
+int ubi_volume_get_compression(struct ubi_device *ubi, int vol_id, size_t *data_size,
+			       size_t *stored_size)
 {
-	if (!ubi || !info)
+	if (!ubi || vol_id < 0 || !data_size || !stored_size)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	int ret = -EIO;
 
-	const struct flash_area *fa = NULL;
-	int ret = flash_area_open(ubi->mtd.partition_id, &fa);
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
 
-	if (0 != ret) {
-		LOG_ERR("Flash area open failure");
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
 		goto exit;
 	}
 
-	memset(info, 0, sizeof(*info));
-	info->leb_total_count =
-		(fa->fa_size / ubi->mtd.erase_block_size) - UBI_DEV_HDR_NR_OF_RES_PEBS;
-	info->leb_size = ubi->mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
-
-	info->free_leb_count = ubi->free_pebs_size;
-	info->dirty_leb_count = ubi->dirty_pebs_size;
-	info->bad_leb_count = ubi->bad_pebs_size;
+	*data_size = 0;
+	*stored_size = 0;
+	ret = 0;
 
-	flash_area_close(fa);
+	struct ubi_rbt_item *item = NULL;
+	RB_FOR_EACH_CONTAINER(&entry->value.vol->eba_tbl, item, node)
+	{
+		struct ubi_vid_hdr vid_hdr = { 0 };
+		ret = ubi_vid_hdr_read(&ubi->flash, item->value.pnum, &vid_hdr, true);
 
-	if (ubi->vols_size > 0) {
-		struct ubi_rbt_item *entry = NULL;
-		RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
-		{
-			const struct ubi_volume *vol = entry->value.vol;
-			info->allocated_leb_count += vol->cfg.leb_count;
+		if (0 != ret) {
+			LOG_ERR("VID header read failure");
+			goto exit;
 		}
-		info->volumes_count = ubi->vols_size;
-	} else {
-		info->allocated_leb_count = 0;
-		info->volumes_count = 0;
+
+		*data_size += vid_hdr.data_size;
+
+		if (vid_hdr.flags & UBI_VID_FLAG_COMPRESSED)
+			*stored_size += vid_hdr.comp_blocks * WRITE_BLOCK_SIZE_ALIGNMENT;
+		else if (0 == (vid_hdr.flags & UBI_VID_FLAG_PATTERN))
+			*stored_size += vid_hdr.data_size;
 	}
 
 exit:
-	k_mutex_unlock(&ubi->mutex);
+	device_unlock(ubi);
 	return ret;
 }
 
-int ubi_device_erase_peb(struct ubi_device *ubi)
+int ubi_volume_set_io_class(struct ubi_device *ubi, int vol_id, enum ubi_io_class io_class)
 {
-	if (!ubi)
+	if (!ubi || vol_id < 0 || io_class >= UBI_IO_CLASS_COUNT)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
-
 	int ret = -EIO;
 
-	struct ubi_list_item *bad_item = k_malloc(sizeof(*bad_item));
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
 
-	if (!bad_item) {
-		LOG_ERR("Heap allocation failure");
-		return -ENOMEM;
-	}
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
 
-	if (ubi->dirty_pebs_size > 0) {
-		struct rbnode *node = rb_get_min(&ubi->dirty_pebs);
-		struct ubi_rbt_item *entry = CONTAINER_OF(node, struct ubi_rbt_item, node);
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
 
-		struct ubi_ec_hdr ec_hdr = { 0 };
-		ret = ubi_ec_hdr_read(&ubi->mtd, entry->value.pnum, &ec_hdr);
+	entry->value.vol->io_class = io_class;
+	ret = 0;
 
-		if (0 != ret) {
-			LOG_ERR("EC header read failure");
+exit:
+	device_unlock(ubi);
+	return ret;
+}
 
-			move_to_bad_blocks(ubi, entry->value.pnum, entry->key, bad_item);
-			k_free(entry);
+int ubi_volume_set_quota(struct ubi_device *ubi, int vol_id, const struct ubi_volume_quota *quota)
+{
+	if (!ubi || vol_id < 0)
+		return -EINVAL;
 
-			goto bad_blocks;
-		}
+	int ret = -EIO;
 
-		const struct flash_area *fa = NULL;
-		ret = flash_area_open(ubi->mtd.partition_id, &fa);
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
 
-		if (0 != ret) {
-			LOG_ERR("Flash area open failure");
-			goto bad_blocks;
-		}
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
 
-		const size_t offset = entry->value.pnum * ubi->mtd.erase_block_size;
-		ret = flash_area_erase(fa, offset, ubi->mtd.erase_block_size);
-		flash_area_close(fa);
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
 
-		if (0 != ret) {
-			LOG_ERR("Flash erase failure");
+	struct ubi_volume *vol = entry->value.vol;
 
-			move_to_bad_blocks(ubi, entry->value.pnum, entry->key, bad_item);
-			k_free(entry);
+	if (!quota) {
+		quota_release(ubi, vol);
+		ret = 0;
+		goto exit;
+	}
 
-			goto bad_blocks;
-		}
+	if (vol->is_snapshot || vol->is_sealed) {
+		LOG_ERR("Volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
 
-		ec_hdr.ec += 1;
-		ec_hdr.hdr_crc = crc32_ieee((const uint8_t *)&ec_hdr,
-					    sizeof(ec_hdr) - sizeof(ec_hdr.hdr_crc));
-		ret = ubi_ec_hdr_write(&ubi->mtd, entry->value.pnum, &ec_hdr);
+	const size_t old_rsvd_pebs = vol->quota ? vol->quota->reserved_pebs : 0;
+	const size_t rsvd_pebs = ubi->quota_rsvd_pebs - old_rsvd_pebs + quota->reserved_pebs;
 
-		if (0 != ret) {
-			LOG_ERR("EC header write failure");
+	if (rsvd_pebs > ubi->free_pebs_size + ubi->dirty_pebs_size) {
+		LOG_ERR("Lack of PEBs to reserve");
+		ret = -ENOSPC;
+		goto exit;
+	}
 
-			move_to_bad_blocks(ubi, entry->value.pnum, entry->key, bad_item);
-			k_free(entry);
+	if (!vol->quota) {
+		vol->quota = k_malloc(sizeof(*vol->quota));
 
-			goto bad_blocks;
+		if (!vol->quota) {
+			LOG_ERR("Heap allocation failure");
+			ret = -ENOMEM;
+			goto exit;
 		}
+	}
 
-		rb_remove(&ubi->dirty_pebs, &entry->node);
-		ubi->dirty_pebs_size -= 1;
+	/* Buckets start full, so a new quota never stalls pending work */
+	struct ubi_vol_quota *vol_quota = vol->quota;
+	memset(vol_quota, 0, sizeof(*vol_quota));
 
-		entry->key = ec_hdr.ec;
-		rb_insert(&ubi->free_pebs, &entry->node);
-		ubi->free_pebs_size += 1;
-	}
+	vol_quota->pebs.rate = quota->pebs_per_sec;
+	vol_quota->pebs.burst = quota->peb_burst ? quota->peb_burst : quota->pebs_per_sec;
+	vol_quota->pebs.tokens = (int64_t)vol_quota->pebs.burst * 1000;
 
-	k_free(bad_item);
+	vol_quota->bytes.rate = quota->bytes_per_sec;
+	vol_quota->bytes.burst = quota->byte_burst ? quota->byte_burst : quota->bytes_per_sec;
+	vol_quota->bytes.tokens = (int64_t)vol_quota->bytes.burst * 1000;
 
-bad_blocks:
-	if (ubi->bad_pebs_size > 0) {
-		/** TODO: Torture bad blocks. */
-	}
+	vol_quota->refill_ms = k_uptime_get();
+	vol_quota->reserved_pebs = quota->reserved_pebs;
+	vol_quota->is_blocking = quota->is_blocking;
 
-	k_mutex_unlock(&ubi->mutex);
-	return 0;
+	ubi->quota_rsvd_pebs = rsvd_pebs;
+	ret = 0;
+
+exit:
+	device_unlock(ubi);
+	return ret;
 }
 
-int ubi_device_deinit(struct ubi_device *ubi)
+int ubi_volume_set_key(struct ubi_device *ubi, int vol_id, const uint8_t *key, size_t key_len)
 {
-	if (!ubi)
+	if (!ubi || vol_id < 0 || (key && 16 != key_len && 32 != key_len))
 		return -EINVAL;
 
-	struct rbnode *node = NULL;
-	struct ubi_rbt_item *rbt_item = NULL;
-	struct ubi_rbt_item *vol_item = NULL;
+	int ret = -EIO;
+	struct ubi_crypto *crypto = NULL;
 
-	struct ubi_list_item *list_item = NULL;
-	struct ubi_list_item *list_next = NULL;
+	/* Session is keyed before locking, driver may take a while to expand the key */
+	if (key) {
+		ret = ubi_crypto_open(key, key_len, &crypto);
 
-	while ((node = rb_get_min(&ubi->free_pebs))) {
-		rbt_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
-		rb_remove(&ubi->free_pebs, &rbt_item->node);
-		k_free(rbt_item);
-		ubi->free_pebs_size -= 1;
+		if (0 != ret) {
+			LOG_ERR("Cipher session open failure");
+			return ret;
+		}
 	}
 
-	while ((node = rb_get_min(&ubi->dirty_pebs))) {
-		rbt_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
-		rb_remove(&ubi->dirty_pebs, &rbt_item->node);
-		k_free(rbt_item);
-		ubi->dirty_pebs_size -= 1;
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+
+	/* Unlocked LEB write of the volume keeps using the old cipher until it commits */
+	struct ubi_volume *vol = volume_wait_idle(ubi, vol_id);
+
+	if (!vol) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
 	}
 
-	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&ubi->bad_pebs, list_item, list_next, node)
-	{
-		sys_slist_remove(&ubi->bad_pebs, NULL, &list_item->node);
-		k_free(list_item);
-		ubi->bad_pebs_size -= 1;
+	if (!vol->cfg.encrypted) {
+		LOG_ERR("Volume is not encrypted");
+		ret = -ENOTSUP;
+		goto exit;
 	}
 
-	while ((node = rb_get_min(&ubi->vols))) {
-		rbt_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
-		rb_remove(&ubi->vols, &rbt_item->node);
+	struct ubi_crypto *old = vol->crypto;
 
-		struct ubi_volume *vol = rbt_item->value.vol;
-		while ((node = rb_get_min(&vol->eba_tbl))) {
-			vol_item = CONTAINER_OF(node, struct ubi_rbt_item, node);
-			rb_remove(&vol->eba_tbl, &vol_item->node);
-			k_free(vol_item);
-			vol->eba_tbl_size -= 1;
-		}
+	seq_write_begin(&vol->eba_seq);
+	vol->crypto = crypto;
+	seq_write_end(&vol->eba_seq);
 
-		k_free(rbt_item->value.vol);
-		k_free(rbt_item);
-		ubi->vols_size -= 1;
-	}
+	/* Lock-free readers may still hold the old cipher, it is destroyed once they leave */
+	reader_sync(ubi);
+	crypto = old;
+	ret = 0;
 
-	k_free(ubi);
-	return 0;
+exit:
+	device_unlock(ubi);
+	ubi_crypto_close(crypto);
+	return ret;
 }
 
-#if defined(CONFIG_UBI_TEST_API_ENABLE)
-
-int ubi_device_get_peb_ec(struct ubi_device *ubi, size_t **peb_ec, size_t *len)
+int ubi_vol_txn_begin(struct ubi_device *ubi, struct ubi_vol_txn **txn)
 {
 	int ret = -EIO;
 
-	if (!ubi || !peb_ec || !len)
+	if (!ubi || !txn)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	struct ubi_vol_txn *vol_txn = k_malloc(sizeof(*vol_txn));
 
-	const struct flash_area *fa = NULL;
+	if (!vol_txn) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(vol_txn, 0, sizeof(*vol_txn));
+	vol_txn->ubi = ubi;
+
+	/* Device stays locked for calling thread until commit or abort */
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+	device_wait_idle(ubi);
+
+	/* Unmaps in transaction renew a full journal, which cannot wait for unlocked erases */
+	while (ubi->nr_of_erases > 0)
+		device_wait(ubi, &ubi->write_done);
+
+	struct ubi_device_info info = { 0 };
+	ret = ubi_device_get_info(ubi, &info);
+
+	if (0 != ret) {
+		LOG_ERR("Device get info failure");
+		goto exit;
+	}
 
-	ret = flash_area_open(ubi->mtd.partition_id, &fa);
+	struct ubi_dev_hdr dev_hdr = { 0 };
+	ret = ubi_dev_hdr_read(&ubi->flash, &dev_hdr);
 
 	if (0 != ret) {
-		LOG_ERR("Flash area open failure");
+		LOG_ERR("Device header read failure");
 		goto exit;
 	}
 
-	const size_t nr_of_pebs =
-		(fa->fa_size / ubi->mtd.erase_block_size) - UBI_DEV_HDR_NR_OF_RES_PEBS;
-
-	flash_area_close(fa);
-
-	size_t *_peb_ec = k_malloc(nr_of_pebs * sizeof(*_peb_ec));
-
-	if (!_peb_ec) {
-		LOG_ERR("Heap allocation failure");
-		ret = -ENOMEM;
+	if (dev_hdr.vol_count > CONFIG_UBI_MAX_NR_OF_VOLUMES) {
+		LOG_ERR("Inconsistency between cache and nvm");
+		ret = -EIO;
 		goto exit;
 	}
 
-	for (size_t pnum = 0; pnum < nr_of_pebs; ++pnum) {
-		struct ubi_ec_hdr ec_hdr = { 0 };
-		ret = ubi_ec_hdr_read(&ubi->mtd, pnum + UBI_DEV_HDR_NR_OF_RES_PEBS, &ec_hdr);
+	for (size_t vol_idx = 0; vol_idx < dev_hdr.vol_count; ++vol_idx) {
+		ret = ubi_vol_hdr_read(&ubi->flash, vol_idx, &vol_txn->vol_hdrs[vol_idx]);
 
 		if (0 != ret) {
-			LOG_ERR("EC header read failure");
-			k_free(_peb_ec);
+			LOG_ERR("Volume header read failure");
 			goto exit;
 		}
-
-		_peb_ec[pnum] = ec_hdr.ec;
 	}
 
-	*len = nr_of_pebs;
-	*peb_ec = _peb_ec;
+	vol_txn->leb_usable_count = info.leb_total_count - info.reserved_leb_count;
+	vol_txn->vols_seqnr = ubi->vols_seqnr;
+	vol_txn->vol_count = dev_hdr.vol_count;
 
-exit:
-	k_mutex_unlock(&ubi->mutex);
+	*txn = vol_txn;
 	return 0;
-}
 
-#endif /* CONFIG_UBI_TEST_API_ENABLE */
+exit:
+	device_unlock(ubi);
+	k_free(vol_txn);
+	return ret;
+}
 
-int ubi_volume_create(struct ubi_device *ubi, const struct ubi_volume_config *vol_cfg, int *vol_id)
+int ubi_vol_txn_create(struct ubi_vol_txn *txn, const struct ubi_volume_config *vol_cfg,
+		       int *vol_id)
 {
-	int ret = -EIO;
-
-	if (!ubi || !vol_cfg || !vol_id)
+	if (!txn || !vol_cfg || !vol_id || 0 == strnlen(vol_cfg->name, UBI_VOLUME_NAME_MAX_LEN))
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	const struct ubi_vol_hdr *exist = txn_vol_search_name(txn, vol_cfg->name);
 
-	/* 1. Check if volume exist */
-	const size_t name_len = strnlen(vol_cfg->name, UBI_VOLUME_NAME_MAX_LEN);
+	if (exist) {
+		*vol_id = exist->vol_id;
+		return 0;
+	}
 
-	struct ubi_rbt_item *entry = NULL;
-	RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
-	{
-		const struct ubi_volume *vol = entry->value.vol;
-		const size_t len = strnlen(vol->cfg.name, UBI_VOLUME_NAME_MAX_LEN);
+	if (vol_cfg->encrypted && !IS_ENABLED(CONFIG_UBI_CRYPTO_ENABLE)) {
+		LOG_ERR("Volume encryption is disabled");
+		return -ENOTSUP;
+	}
 
-		if (name_len == len && 0 == memcmp(vol_cfg->name, vol->cfg.name, name_len)) {
-			*vol_id = vol->vol_id;
-			ret = 0;
-			goto exit;
+	if (vol_cfg->autoresize) {
+		if (UBI_VOLUME_TYPE_DYNAMIC != vol_cfg->type) {
+			LOG_ERR("Only dynamic volume may be autoresized");
+			return -EINVAL;
 		}
-	}
 
-	/* 2. Create volume */
-	struct ubi_device_info info = { 0 };
-	ret = ubi_device_get_info(ubi, &info);
+		for (size_t idx = 0; idx < txn->vol_count; ++idx) {
+			if (txn->vol_hdrs[idx].flags & UBI_VOL_FLAG_AUTORESIZE) {
+				LOG_ERR("Autoresize is requested by another volume");
+				return -EEXIST;
+			}
+		}
+	}
 
-	if (0 != ret) {
-		LOG_ERR("UBI device get info failure");
-		goto exit;
+	if (txn->vol_count >= CONFIG_UBI_MAX_NR_OF_VOLUMES) {
+		LOG_ERR("Lack of free volume slots");
+		return -ENOSPC;
 	}
 
-	const size_t total_free_pebs = info.leb_total_count - info.allocated_leb_count;
-	if (vol_cfg->leb_count > total_free_pebs) {
+	if (vol_cfg->leb_count > txn_avail_lebs(txn)) {
 		LOG_ERR("Failed to allocate PEBs for volume");
-		ret = -ENOSPC;
-		goto exit;
+		return -ENOSPC;
 	}
 
-	struct ubi_dev_hdr dev_hdr = { 0 };
-	ret = ubi_dev_hdr_read(&ubi->mtd, &dev_hdr);
+	struct ubi_vol_hdr *hdr = &txn->vol_hdrs[txn->vol_count];
 
-	if (0 != ret) {
-		LOG_ERR("Device header read failure");
-		goto exit;
-	}
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = UBI_VOL_HDR_MAGIC;
+	hdr->version = UBI_VOL_HDR_VERSION;
+	hdr->vol_type = vol_cfg->type;
+	hdr->flags = vol_cfg->autoresize ? UBI_VOL_FLAG_AUTORESIZE : 0;
+	hdr->flags |= vol_cfg->compressed ? UBI_VOL_FLAG_COMPRESSED : 0;
+	hdr->flags |= vol_cfg->encrypted ? UBI_VOL_FLAG_ENCRYPTED : 0;
+	hdr->flags |= vol_cfg->durable_unmap ? UBI_VOL_FLAG_DURABLE_UNMAP : 0;
+	hdr->vol_id = txn->vols_seqnr++;
+	hdr->lebs_count = vol_cfg->leb_count;
+	hdr->sqnum_bound = txn->ubi->global_seqnr;
+	strncpy(hdr->name, vol_cfg->name, UBI_VOLUME_NAME_MAX_LEN);
 
-	struct ubi_dev_hdr new_dev_hdr = dev_hdr;
-	new_dev_hdr.revision += 1;
-	new_dev_hdr.vol_count += 1;
-	new_dev_hdr.hdr_crc = crc32_ieee((const uint8_t *)&new_dev_hdr,
-					 sizeof(new_dev_hdr) - sizeof(new_dev_hdr.hdr_crc));
+	txn->vol_count += 1;
+	txn->nr_of_ops += 1;
 
-	struct ubi_vol_hdr new_vol_hdr = { 0 };
-	new_vol_hdr.magic = UBI_VOL_HDR_MAGIC;
-	new_vol_hdr.version = UBI_VOL_HDR_VERSION;
-	new_vol_hdr.vol_type = vol_cfg->type;
-	new_vol_hdr.vol_id = ubi->vols_seqnr++;
-	new_vol_hdr.lebs_count = vol_cfg->leb_count;
-	strncpy(new_vol_hdr.name, vol_cfg->name, UBI_VOLUME_NAME_MAX_LEN);
-	new_vol_hdr.hdr_crc = crc32_ieee((const uint8_t *)&new_vol_hdr,
-					 sizeof(new_vol_hdr) - sizeof(new_vol_hdr.hdr_crc));
+	*vol_id = hdr->vol_id;
+
+	return 0;
+}
+
+int ubi_vol_txn_resize(struct ubi_vol_txn *txn, int vol_id, const struct ubi_volume_config *vol_cfg)
+{
+	if (!txn || vol_id < 0 || !vol_cfg)
+		return -EINVAL;
 
-	ret = ubi_vol_hdr_append(&ubi->mtd, &new_dev_hdr, &new_vol_hdr);
+	struct ubi_vol_hdr *hdr = txn_vol_search(txn, vol_id);
 
-	if (0 != ret) {
-		LOG_ERR("Volume header append failure");
-		goto exit;
+	if (!hdr) {
+		LOG_ERR("Device volume not found");
+		return -ENOENT;
 	}
 
-	struct ubi_volume *vol = k_malloc(sizeof(*vol));
-	if (!vol) {
-		LOG_ERR("Heap allocation failure");
-		ret = -ENOMEM;
-		goto exit;
+	if (hdr->flags & UBI_VOL_FLAG_SNAPSHOT) {
+		LOG_ERR("Snapshot volume is read-only");
+		return -EROFS;
 	}
 
-	memset(vol, 0, sizeof(*vol));
-	vol->vol_idx = new_dev_hdr.vol_count - 1;
-	vol->vol_id = new_vol_hdr.vol_id;
-	memcpy(vol->cfg.name, new_vol_hdr.name, strlen(new_vol_hdr.name));
-	vol->cfg.type = new_vol_hdr.vol_type;
-	vol->cfg.leb_count = new_vol_hdr.lebs_count;
-	vol->eba_tbl_size = 0;
-	vol->eba_tbl.lessthan_fn = ubi_rbt_cmp;
+	if (UBI_VOLUME_TYPE_DYNAMIC != hdr->vol_type) {
+		LOG_ERR("Static volume cannot be resized");
+		return -ECANCELED;
+	}
 
-	struct ubi_rbt_item *item = k_malloc(sizeof(*item));
-	if (!item) {
-		LOG_ERR("Heap allocation failure");
-		k_free(vol);
-		ret = -ENOMEM;
-		goto exit;
+	if (0 == vol_cfg->leb_count || vol_cfg->leb_count == hdr->lebs_count) {
+		LOG_ERR("Cannot resize to zero or the same count of LEBs");
+		return -ECANCELED;
 	}
 
-	item->key = vol->vol_id;
-	item->value.vol = vol;
-	rb_insert(&ubi->vols, &item->node);
-	ubi->vols_size += 1;
+	if (vol_cfg->leb_count > hdr->lebs_count) {
+		if (vol_cfg->leb_count - hdr->lebs_count > txn_avail_lebs(txn)) {
+			LOG_ERR("Lack of available for allocation LEBs");
+			return -ENOSPC;
+		}
+	}
 
-	*vol_id = vol->vol_id;
+	hdr->lebs_count = vol_cfg->leb_count;
+	txn->nr_of_ops += 1;
 
-exit:
-	k_mutex_unlock(&ubi->mutex);
-	return ret;
+	return 0;
 }
 
-int ubi_volume_resize(struct ubi_device *ubi, int vol_id, const struct ubi_volume_config *vol_cfg)
+int ubi_vol_txn_remove(struct ubi_vol_txn *txn, int vol_id)
 {
-	int ret = -EIO;
-
-	if (!ubi || !vol_cfg)
+	if (!txn || vol_id < 0)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	const struct ubi_vol_hdr *hdr = txn_vol_search(txn, vol_id);
 
-	if (0 == ubi->vols_size) {
-		LOG_ERR("No volumes present on device");
-		ret = -ENOENT;
-		goto exit;
+	if (!hdr) {
+		LOG_ERR("Device volume not found");
+		return -ENOENT;
 	}
 
-	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+	for (size_t idx = 0; idx < txn->vol_count; ++idx) {
+		const struct ubi_vol_hdr *snap = &txn->vol_hdrs[idx];
 
-	if (!entry) {
-		LOG_ERR("Device volume not found");
-		ret = -ENOENT;
-		goto exit;
+		if ((snap->flags & UBI_VOL_FLAG_SNAPSHOT) && snap->src_vol_id == hdr->vol_id) {
+			LOG_ERR("Volume has snapshots");
+			return -EBUSY;
+		}
 	}
 
-	struct ubi_volume *vol = entry->value.vol;
+	const struct ubi_rbt_item *entry = ubi_rbt_search(&txn->ubi->vols, vol_id);
 
-	if (UBI_VOLUME_TYPE_DYNAMIC != vol->cfg.type) {
-		LOG_ERR("Static volume cannot be resized");
-		ret = -ECANCELED;
-		goto exit;
+	if (entry && !sealed_map_is_idle(entry->value.vol)) {
+		LOG_ERR("Sealed volume is open");
+		return -EBUSY;
 	}
 
-	if (vol_cfg->leb_count == vol->cfg.leb_count) {
-		LOG_ERR("Cannot resize for the same count of LEBs");
-		ret = -ECANCELED;
-		goto exit;
+	const size_t idx = hdr - txn->vol_hdrs;
+
+	memmove(&txn->vol_hdrs[idx], &txn->vol_hdrs[idx + 1],
+		(txn->vol_count - idx - 1) * sizeof(txn->vol_hdrs[0]));
+
+	txn->vol_count -= 1;
+	txn->nr_of_ops += 1;
+
+	return 0;
+}
+
+int ubi_vol_txn_rename(struct ubi_vol_txn *txn, int vol_id, const char *name)
+{
+	if (!txn || vol_id < 0 || !name || 0 == strnlen(name, UBI_VOLUME_NAME_MAX_LEN))
+		return -EINVAL;
+
+	struct ubi_vol_hdr *hdr = txn_vol_search(txn, vol_id);
+
+	if (!hdr) {
+		LOG_ERR("Device volume not found");
+		return -ENOENT;
 	}
 
-	if (vol_cfg->leb_count > vol->cfg.leb_count) {
-		struct ubi_device_info info = { 0 };
-		ret = ubi_device_get_info(ubi, &info);
+	const struct ubi_vol_hdr *exist = txn_vol_search_name(txn, name);
 
-		if (0 != ret) {
-			LOG_ERR("Device get info failure");
-			goto exit;
-		}
+	if (exist == hdr)
+		return 0;
 
-		const size_t avail = info.leb_total_count - info.allocated_leb_count;
-		const size_t diff = vol_cfg->leb_count - vol->cfg.leb_count;
+	if (exist) {
+		LOG_ERR("Volume name is taken");
+		return -EEXIST;
+	}
 
-		if (diff > avail) {
-			LOG_ERR("Lack of available for allocation LEBs");
-			ret = -ENOSPC;
-			goto exit;
-		}
-	} else {
-		const size_t diff = vol->cfg.leb_count - vol_cfg->leb_count;
+	memset(hdr->name, 0, sizeof(hdr->name));
+	strncpy(hdr->name, name, UBI_VOLUME_NAME_MAX_LEN);
+	txn->nr_of_ops += 1;
 
-		if (0 == diff) {
-			LOG_ERR("Cannot resize volume to zero LEBs");
-			ret = -ECANCELED;
-			goto exit;
-		}
+	return 0;
+}
 
-		for (size_t lnum = (vol->cfg.leb_count - diff); lnum < vol->cfg.leb_count; ++lnum) {
-			struct ubi_rbt_item *item = ubi_rbt_search(&vol->eba_tbl, lnum);
+int ubi_vol_txn_commit(struct ubi_vol_txn *txn)
+{
+	int ret = 0;
 
-			if (item) {
-				rb_remove(&vol->eba_tbl, &item->node);
-				vol->eba_tbl_size -= 1;
+	if (!txn)
+		return -EINVAL;
 
-				struct ubi_ec_hdr ec_hdr = { 0 };
-				ret = ubi_ec_hdr_read(&ubi->mtd, item->value.pnum, &ec_hdr);
+	struct ubi_device *ubi = txn->ubi;
+	struct ubi_rbt_item *new_items[CONFIG_UBI_MAX_NR_OF_VOLUMES] = { 0 };
 
-				if (0 != ret) {
-					LOG_ERR("EC header read failure");
-					goto exit;
-				}
+	if (0 == txn->nr_of_ops)
+		goto exit;
 
-				item->key = ec_hdr.ec;
-				rb_insert(&ubi->dirty_pebs, &item->node);
-				ubi->dirty_pebs_size += 1;
-			}
+	/* 1. Allocate created volumes before table write, so commit cannot fail half-way */
+	for (size_t vol_idx = 0; vol_idx < txn->vol_count; ++vol_idx) {
+		const struct ubi_vol_hdr *hdr = &txn->vol_hdrs[vol_idx];
+
+		if (ubi_rbt_search(&ubi->vols, hdr->vol_id))
+			continue;
+
+		struct ubi_volume *vol = k_malloc(sizeof(*vol));
+		struct ubi_rbt_item *item = k_malloc(sizeof(*item));
+
+		if (!vol || !item) {
+			LOG_ERR("Heap allocation failure");
+			k_free(vol);
+			k_free(item);
+			ret = -ENOMEM;
+			goto exit;
 		}
+
+		memset(vol, 0, sizeof(*vol));
+		vol->vol_id = hdr->vol_id;
+		vol->cfg.type = hdr->vol_type;
+		vol->io_class = UBI_IO_CLASS_NORMAL;
+		vol->eba_tbl.lessthan_fn = ubi_rbt_cmp;
+
+		item->key = vol->vol_id;
+		item->value.vol = vol;
+		new_items[vol_idx] = item;
 	}
 
+	/* 2. Write staged volume table as single revision */
 	struct ubi_dev_hdr dev_hdr = { 0 };
-	ret = ubi_dev_hdr_read(&ubi->mtd, &dev_hdr);
+	ret = ubi_dev_hdr_read(&ubi->flash, &dev_hdr);
 
 	if (0 != ret) {
 		LOG_ERR("Device header read failure");
@@ -1160,43 +5287,156 @@ int ubi_volume_resize(struct ubi_device *ubi, int vol_id, const struct ubi_volum
 	}
 
 	dev_hdr.revision += 1;
+	dev_hdr.vol_count = txn->vol_count;
 	dev_hdr.hdr_crc =
 		crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
 
-	struct ubi_vol_hdr vol_hdr = { 0 };
-	ret = ubi_vol_hdr_read(&ubi->mtd, vol->vol_idx, &vol_hdr);
+	for (size_t vol_idx = 0; vol_idx < txn->vol_count; ++vol_idx) {
+		struct ubi_vol_hdr *hdr = &txn->vol_hdrs[vol_idx];
+
+		hdr->hdr_crc =
+			crc32_ieee((const uint8_t *)hdr, sizeof(*hdr) - sizeof(hdr->hdr_crc));
+	}
+
+	ret = ubi_vol_table_write(&ubi->flash, &dev_hdr, txn->vol_hdrs);
 
 	if (0 != ret) {
-		LOG_ERR("Volume header read failure");
+		LOG_ERR("Volume table write failure");
 		goto exit;
 	}
 
-	vol_hdr.lebs_count = vol_cfg->leb_count;
-	vol_hdr.hdr_crc =
-		crc32_ieee((const uint8_t *)&vol_hdr, sizeof(vol_hdr) - sizeof(vol_hdr.hdr_crc));
+	/* 3. Release volumes removed from table, nothing is read from their PEBs, so no step
+	 * after table write can fail and leave RAM behind flash
+	 */
+	for (;;) {
+		struct ubi_rbt_item *entry = NULL;
+		struct ubi_rbt_item *removed = NULL;
+
+		RB_FOR_EACH_CONTAINER(&ubi->vols, entry, node)
+		{
+			if (!txn_vol_search(txn, entry->key)) {
+				removed = entry;
+				break;
+			}
+		}
 
-	ret = ubi_vol_hdr_update(&ubi->mtd, &dev_hdr, vol->vol_idx, &vol_hdr);
+		if (!removed)
+			break;
 
-	if (0 != ret) {
-		LOG_ERR("Volume header update failure");
-		goto exit;
+		struct ubi_volume *vol = removed->value.vol;
+
+		seq_write_begin(&ubi->vols_seq);
+
+		leb_unmap_range(ubi, vol, 0, vol->cfg.leb_count);
+		__ASSERT_NO_MSG(0 == vol->eba_tbl_size);
+
+		rb_remove(&ubi->vols, &removed->node);
+		ubi->vols_size -= 1;
+
+		seq_write_end(&ubi->vols_seq);
+
+		reader_sync(ubi);
+		sealed_map_put(vol->sealed);
+		quota_release(ubi, vol);
+		ubi_crypto_close(vol->crypto);
+		k_free(vol);
+		k_free(removed);
 	}
 
-	vol->cfg.leb_count = vol_cfg->leb_count;
+	/* 4. Apply staged headers to remaining and created volumes */
+	for (size_t vol_idx = 0; vol_idx < txn->vol_count; ++vol_idx) {
+		const struct ubi_vol_hdr *hdr = &txn->vol_hdrs[vol_idx];
+		struct ubi_rbt_item *entry = new_items[vol_idx];
+
+		if (entry) {
+			new_items[vol_idx] = NULL;
+
+			seq_write_begin(&ubi->vols_seq);
+			rb_insert(&ubi->vols, &entry->node);
+			ubi->vols_size += 1;
+			seq_write_end(&ubi->vols_seq);
+		} else {
+			entry = ubi_rbt_search(&ubi->vols, hdr->vol_id);
+		}
+
+		struct ubi_volume *vol = entry->value.vol;
+
+		/* Dropped LEBs are not read, as in resize, so nothing fails after table write */
+		if (hdr->lebs_count < vol->cfg.leb_count)
+			leb_unmap_range(ubi, vol, hdr->lebs_count,
+					vol->cfg.leb_count - hdr->lebs_count);
+
+		seq_write_begin(&vol->eba_seq);
+
+		vol->vol_idx = vol_idx;
+		vol->cfg.leb_count = hdr->lebs_count;
+		vol->sqnum_bound = hdr->sqnum_bound;
+		vol->cfg.autoresize = (0 != (hdr->flags & UBI_VOL_FLAG_AUTORESIZE));
+		vol->cfg.compressed = (0 != (hdr->flags & UBI_VOL_FLAG_COMPRESSED));
+		vol->cfg.encrypted = (0 != (hdr->flags & UBI_VOL_FLAG_ENCRYPTED));
+		vol->cfg.durable_unmap = (0 != (hdr->flags & UBI_VOL_FLAG_DURABLE_UNMAP));
+		memcpy(vol->cfg.name, hdr->name, sizeof(vol->cfg.name));
+
+		seq_write_end(&vol->eba_seq);
+	}
+
+	ubi->vols_seqnr = txn->vols_seqnr;
+
+exit:
+	for (size_t vol_idx = 0; vol_idx < ARRAY_SIZE(new_items); ++vol_idx) {
+		if (new_items[vol_idx]) {
+			k_free(new_items[vol_idx]->value.vol);
+			k_free(new_items[vol_idx]);
+		}
+	}
+
+	device_unlock(ubi);
+	k_free(txn);
+	return ret;
+}
+
+int ubi_vol_txn_abort(struct ubi_vol_txn *txn)
+{
+	if (!txn)
+		return -EINVAL;
+
+	device_unlock(txn->ubi);
+	k_free(txn);
+
+	return 0;
+}
+
+int ubi_leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf, size_t len)
+{
+	if (!ubi || vol_id < 0 || !buf || 0 == len)
+		return -EINVAL;
+
+	return leb_write(ubi, vol_id, lnum, buf, len, UBI_IO_CLASS_OF_VOLUME, false);
+}
+
+int ubi_leb_write_class(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf,
+			size_t len, enum ubi_io_class io_class)
+{
+	if (!ubi || vol_id < 0 || !buf || 0 == len || io_class >= UBI_IO_CLASS_COUNT)
+		return -EINVAL;
 
-exit:
-	k_mutex_unlock(&ubi->mutex);
-	return ret;
+	return leb_write(ubi, vol_id, lnum, buf, len, io_class, false);
 }
 
-int ubi_volume_remove(struct ubi_device *ubi, int vol_id)
+int ubi_leb_write_offset(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset,
+			 const void *buf, size_t len)
 {
 	int ret = -EIO;
 
-	if (!ubi)
+	if (!ubi || vol_id < 0 || !buf || 0 == len)
+		return -EINVAL;
+
+	if (0 != offset % WRITE_BLOCK_SIZE_ALIGNMENT || 0 != len % WRITE_BLOCK_SIZE_ALIGNMENT)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	const enum ubi_io_class io_class = io_class_resolve(ubi, vol_id, UBI_IO_CLASS_OF_VOLUME);
+
+	device_lock(ubi, io_class);
 
 	if (0 == ubi->vols_size) {
 		LOG_ERR("No volumes present on device");
@@ -1204,153 +5444,221 @@ int ubi_volume_remove(struct ubi_device *ubi, int vol_id)
 		goto exit;
 	}
 
-	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+	struct ubi_volume *vol = NULL;
+	int64_t delay_ms = 0;
 
-	if (!entry) {
+search:
+	/* Wait here, nested LEB write below must not wait with the lock held twice */
+	vol = volume_wait_idle(ubi, vol_id);
+
+	if (!vol) {
 		LOG_ERR("Device volume not found");
 		ret = -ENOENT;
 		goto exit;
 	}
 
-	struct ubi_dev_hdr dev_hdr = { 0 };
-	ret = ubi_dev_hdr_read(&ubi->mtd, &dev_hdr);
+	if (vol->is_snapshot) {
+		LOG_ERR("Snapshot volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
 
-	if (0 != ret) {
-		LOG_ERR("Device header read failure");
+	if (vol->is_sealed) {
+		LOG_ERR("Sealed volume is read-only");
+		ret = -EROFS;
 		goto exit;
 	}
 
-	dev_hdr.vol_count -= 1;
-	dev_hdr.revision += 1;
-	dev_hdr.hdr_crc =
-		crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
+	if (lnum >= vol->cfg.leb_count) {
+		LOG_ERR("Volume LEB limit exceeded");
+		ret = -EACCES;
+		goto exit;
+	}
 
-	struct ubi_volume *vol = entry->value.vol;
-	ret = ubi_vol_hdr_remove(&ubi->mtd, &dev_hdr, vol->vol_idx);
+	if ((offset + len) >
+	    (ubi->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE)) {
+		LOG_ERR("Too big buffer to write in LEB");
+		ret = -ENOSPC;
+		goto exit;
+	}
 
-	if (0 != ret) {
-		LOG_ERR("Volume header remove failure");
+	if (vol->cfg.encrypted && !vol->crypto) {
+		LOG_ERR("Volume key not set");
+		ret = -EPERM;
 		goto exit;
 	}
 
-	struct ubi_rbt_item *item = NULL;
-	RB_FOR_EACH_CONTAINER(&vol->eba_tbl, item, node)
-	{
-		rb_remove(&vol->eba_tbl, &item->node);
-		vol->eba_tbl_size -= 1;
+	struct ubi_rbt_item *entry = ubi_rbt_search(&vol->eba_tbl, lnum);
 
-		struct ubi_ec_hdr ec_hdr = { 0 };
-		ret = ubi_ec_hdr_read(&ubi->mtd, item->value.pnum, &ec_hdr);
+	if (entry && (vol->cfg.compressed || vol->has_patterns)) {
+		struct ubi_vid_hdr vid_hdr = { 0 };
+		ret = ubi_vid_hdr_read(&ubi->flash, entry->value.pnum, &vid_hdr, true);
 
 		if (0 != ret) {
-			LOG_ERR("EC header read failure");
+			LOG_ERR("VID header read failure");
 			goto exit;
 		}
 
-		item->key = ec_hdr.ec;
-		rb_insert(&ubi->dirty_pebs, &item->node);
-		ubi->dirty_pebs_size += 1;
+		if (vid_hdr.flags & (UBI_VID_FLAG_COMPRESSED | UBI_VID_FLAG_PATTERN)) {
+			LOG_ERR("LEB holds compressed or pattern data");
+			ret = -ENOTSUP;
+			goto exit;
+		}
 	}
 
-	rb_remove(&ubi->vols, &entry->node);
-	ubi->vols_size -= 1;
+	const bool needs_peb = !entry || peb_is_shared(ubi, vol, lnum, entry->value.pnum);
 
-	k_free(entry->value.vol);
-	k_free(entry);
+	/* Nested LEB write below cannot wait, so sequence numbers and free PEB are awaited here,
+	 * unless the caller holds the lock as well
+	 */
+	ret = needs_peb ? journal_reserve(ubi, vol) : 0;
 
-	for (size_t vol_idx = 0; vol_idx < dev_hdr.vol_count; ++vol_idx) {
-		struct ubi_vol_hdr vol_hdr = { 0 };
-		ret = ubi_vol_hdr_read(&ubi->mtd, vol_idx, &vol_hdr);
+	if (1 == ubi->sched.depth &&
+	    (-EAGAIN == ret || (needs_peb && free_peb_is_pending(ubi, vol)))) {
+		device_wait(ubi, &ubi->write_done);
+		goto search;
+	}
+
+	if (0 != ret)
+		goto exit;
+
+	/* Admit the PEB of a map or copy too, refunded if the map or copy below fails */
+	ret = quota_admit(ubi, vol, needs_peb ? 1 : 0, len, &delay_ms);
+
+	if (0 != delay_ms) {
+		device_sleep(ubi, K_MSEC(delay_ms));
+		goto search;
+	}
+
+	if (0 != ret) {
+		LOG_ERR("Volume write quota exceeded");
+		goto exit;
+	}
+
+	if (!entry) {
+		ret = leb_write(ubi, vol_id, lnum, NULL, 0, UBI_IO_CLASS_OF_VOLUME, true);
 
 		if (0 != ret) {
-			LOG_ERR("Volume header readd failure");
+			LOG_ERR("LEB map failure");
+			quota_refund(vol, 1, len);
 			goto exit;
 		}
 
-		entry = ubi_rbt_search(&ubi->vols, vol_hdr.vol_id);
+		entry = ubi_rbt_search(&vol->eba_tbl, lnum);
+		__ASSERT_NO_MSG(entry);
+	} else if (peb_is_shared(ubi, vol, lnum, entry->value.pnum)) {
+		/* Copy is mapped before it holds data, keep lock-free readers off until it does */
+		seq_write_begin(&ubi->vols_seq);
+		ret = leb_copy_on_write(ubi, vol, lnum, entry->value.pnum);
+		seq_write_end(&ubi->vols_seq);
 
-		if (!entry) {
-			LOG_ERR("Inconsistency between cache and nvm");
-			ret = -EIO;
+		if (0 != ret) {
+			LOG_ERR("LEB copy on write failure");
+			quota_refund(vol, 1, len);
 			goto exit;
 		}
 
-		vol = entry->value.vol;
-		vol->vol_idx = vol_idx;
+		entry = ubi_rbt_search(&vol->eba_tbl, lnum);
+		__ASSERT_NO_MSG(entry);
 	}
 
-exit:
-	k_mutex_unlock(&ubi->mutex);
-	return ret;
-}
-
-int ubi_volume_get_info(struct ubi_device *ubi, int vol_id, struct ubi_volume_config *vol_cfg,
-			size_t *alloc_lebs)
-{
-	if (!ubi || vol_id < 0 || !vol_cfg || !alloc_lebs)
-		return -EINVAL;
+	const size_t pnum = entry->value.pnum;
 
-	int ret = -EIO;
+	/* 1. Pin the volume, so its LEB stays mapped to the PEB until programming ends */
+	vol->is_writing = true;
+	ubi->nr_of_writes += 1;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	/* 2. Program flash unlocked, readers of other LEBs proceed meanwhile */
+	device_unlock(ubi);
 
-	if (0 == ubi->vols_size) {
-		LOG_ERR("No volumes present on device");
-		ret = -ENOENT;
-		goto exit;
-	}
+	/* Key stream continues at the offset, under sequence number of the mapped PEB */
+	struct ubi_leb_io io = { 0 };
+	ret = leb_io_open(&ubi->flash, pnum, vol->cfg.encrypted ? vol->crypto : NULL, &io);
 
-	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+	if (0 == ret) {
+		ret = leb_io_write(&io, offset, buf, len);
 
-	if (!entry) {
-		LOG_ERR("Device volume not found");
-		ret = -ENOENT;
-		goto exit;
+		if (0 != ret)
+			LOG_ERR("LEB data write failure");
 	}
 
-	struct ubi_volume *vol = entry->value.vol;
-	*vol_cfg = vol->cfg;
-	*alloc_lebs = vol->eba_tbl_size;
-	ret = 0;
+	device_lock(ubi, io_class);
+
+	/* 3. Unpin the volume, mapping is unchanged as data went into the erased LEB area */
+	vol->is_writing = false;
+	ubi->nr_of_writes -= 1;
+	device_broadcast(ubi, &ubi->write_done);
 
 exit:
-	k_mutex_unlock(&ubi->mutex);
+	device_unlock(ubi);
 	return ret;
 }
 
-int ubi_leb_write(struct ubi_device *ubi, int vol_id, size_t lnum, const void *buf, size_t len)
+int ubi_leb_read(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset, void *buf,
+		 size_t size)
 {
-	if (!ubi || vol_id < 0 || !buf || 0 == len)
+	if (!ubi || vol_id < 0 || !buf || 0 == size)
 		return -EINVAL;
 
-	return leb_write(ubi, vol_id, lnum, buf, len);
+	return leb_read(ubi, vol_id, lnum, offset, buf, size, UBI_IO_CLASS_OF_VOLUME);
 }
 
-int ubi_leb_read(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset, void *buf,
-		 size_t size)
+int ubi_leb_read_class(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset, void *buf,
+		       size_t size, enum ubi_io_class io_class)
+{
+	if (!ubi || vol_id < 0 || !buf || 0 == size || io_class >= UBI_IO_CLASS_COUNT)
+		return -EINVAL;
+
+	return leb_read(ubi, vol_id, lnum, offset, buf, size, io_class);
+}
+
+int ubi_leb_map(struct ubi_device *ubi, int vol_id, size_t lnum)
+{
+	if (!ubi || vol_id < 0)
+		return -EINVAL;
+
+	return leb_write(ubi, vol_id, lnum, NULL, 0, UBI_IO_CLASS_OF_VOLUME, false);
+}
+
+int ubi_leb_unmap(struct ubi_device *ubi, int vol_id, size_t lnum)
 {
 	int ret = -EIO;
 
-	if (!ubi || vol_id < 0 || !buf || 0 == size)
+	if (!ubi || vol_id < 0)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	device_lock(ubi, io_class_resolve(ubi, vol_id, UBI_IO_CLASS_OF_VOLUME));
+
+	struct ubi_rbt_item *entry = NULL;
+	struct ubi_volume *vol = NULL;
 
+search:
 	if (0 == ubi->vols_size) {
 		LOG_ERR("No volumes present on device");
 		ret = -ENOENT;
 		goto exit;
 	}
 
-	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+	/* Unmap record must not be older than an in-flight write to the same volume */
+	vol = volume_wait_idle(ubi, vol_id);
 
-	if (!entry) {
+	if (!vol) {
 		LOG_ERR("Device volume not found");
 		ret = -ENOENT;
 		goto exit;
 	}
 
-	struct ubi_volume *vol = entry->value.vol;
+	if (vol->is_snapshot) {
+		LOG_ERR("Snapshot volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
+
+	if (vol->is_sealed) {
+		LOG_ERR("Sealed volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
 
 	if (lnum > vol->cfg.leb_count) {
 		LOG_ERR("Volume LEB limit exceeded");
@@ -1361,87 +5669,107 @@ int ubi_leb_read(struct ubi_device *ubi, int vol_id, size_t lnum, size_t offset,
 	entry = ubi_rbt_search(&vol->eba_tbl, lnum);
 
 	if (!entry) {
-		LOG_ERR("LEB not found");
-		ret = -ENOENT;
+		LOG_ERR("Cannot unmap an unmapped LEB");
+		ret = -EACCES;
 		goto exit;
 	}
 
-	ret = ubi_leb_data_read(&ubi->mtd, entry->value.pnum, offset, buf, size);
+	if (journal_is_busy(ubi, vol)) {
+		/* Lock held by caller, e.g. a volume table transaction, cannot be given up here */
+		if (1 != ubi->sched.depth) {
+			ret = -EAGAIN;
+			goto exit;
+		}
+
+		/* Full journal is renewed only after unlocked erases finish, volume may change */
+		device_wait(ubi, &ubi->write_done);
+		goto search;
+	}
+
+	ret = journal_append(ubi, vol, lnum, 1);
 
 	if (0 != ret) {
-		LOG_ERR("LEB data read failure");
+		LOG_ERR("Unmap journal append failure");
 		goto exit;
 	}
 
+	seq_write_begin(&vol->eba_seq);
+	ret = peb_release(ubi, vol, entry);
+	seq_write_end(&vol->eba_seq);
+
 exit:
-	k_mutex_unlock(&ubi->mutex);
+	device_unlock(ubi);
 	return ret;
 }
 
-int ubi_leb_map(struct ubi_device *ubi, int vol_id, size_t lnum)
-{
-	if (!ubi || vol_id < 0)
-		return -EINVAL;
-
-	return leb_write(ubi, vol_id, lnum, NULL, 0);
-}
-
-int ubi_leb_unmap(struct ubi_device *ubi, int vol_id, size_t lnum)
+int ubi_leb_unmap_range(struct ubi_device *ubi, int vol_id, size_t first, size_t count)
 {
 	int ret = -EIO;
 
-	if (!ubi || vol_id < 0)
+	if (!ubi || vol_id < 0 || 0 == count)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	device_lock(ubi, io_class_resolve(ubi, vol_id, UBI_IO_CLASS_OF_VOLUME));
 
+	struct ubi_volume *vol = NULL;
+
+search:
 	if (0 == ubi->vols_size) {
 		LOG_ERR("No volumes present on device");
 		ret = -ENOENT;
 		goto exit;
 	}
 
-	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+	/* Unmap record must not be older than an in-flight write to the same volume */
+	vol = volume_wait_idle(ubi, vol_id);
 
-	if (!entry) {
+	if (!vol) {
 		LOG_ERR("Device volume not found");
 		ret = -ENOENT;
 		goto exit;
 	}
 
-	struct ubi_volume *vol = entry->value.vol;
+	if (vol->is_snapshot) {
+		LOG_ERR("Snapshot volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
 
-	if (lnum > vol->cfg.leb_count) {
+	if (vol->is_sealed) {
+		LOG_ERR("Sealed volume is read-only");
+		ret = -EROFS;
+		goto exit;
+	}
+
+	if (first >= vol->cfg.leb_count || count > vol->cfg.leb_count - first) {
 		LOG_ERR("Volume LEB limit exceeded");
 		ret = -EACCES;
 		goto exit;
 	}
 
-	entry = ubi_rbt_search(&vol->eba_tbl, lnum);
+	if (journal_is_busy(ubi, vol)) {
+		/* Lock held by caller, e.g. a volume table transaction, cannot be given up here */
+		if (1 != ubi->sched.depth) {
+			ret = -EAGAIN;
+			goto exit;
+		}
 
-	if (!entry) {
-		LOG_ERR("Cannot unmap an unmapped LEB");
-		ret = -EACCES;
-		goto exit;
+		/* Full journal is renewed only after unlocked erases finish, volume may change */
+		device_wait(ubi, &ubi->write_done);
+		goto search;
 	}
 
-	struct ubi_ec_hdr ec_hdr = { 0 };
-	ret = ubi_ec_hdr_read(&ubi->mtd, entry->value.pnum, &ec_hdr);
+	ret = journal_append(ubi, vol, first, count);
 
 	if (0 != ret) {
-		LOG_ERR("EC header read failure");
+		LOG_ERR("Unmap journal append failure");
 		goto exit;
 	}
 
-	rb_remove(&vol->eba_tbl, &entry->node);
-	vol->eba_tbl_size -= 1;
-
-	entry->key = ec_hdr.ec;
-	rb_insert(&ubi->dirty_pebs, &entry->node);
-	ubi->dirty_pebs_size += 1;
+	leb_unmap_range(ubi, vol, first, count);
 
 exit:
-	k_mutex_unlock(&ubi->mutex);
+	device_unlock(ubi);
 	return ret;
 }
 
@@ -1450,50 +5778,59 @@ int ubi_leb_is_mapped(struct ubi_device *ubi, int vol_id, size_t lnum, bool *is_
 	if (!ubi || vol_id < 0 || !is_mapped)
 		return -EINVAL;
 
+	size_t pnum = 0;
+	atomic_val_t pin = UBI_PIN_LOCKED;
+	const int ret =
+		eba_pin(ubi, vol_id, lnum, is_mapped, &pnum, NULL, &pin, UBI_IO_CLASS_OF_VOLUME);
+
+	eba_unpin(ubi, pin);
+	return ret;
+}
+
+int ubi_leb_get_size(struct ubi_device *ubi, int vol_id, size_t lnum, size_t *size)
+{
 	int ret = -EIO;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	if (!ubi || vol_id < 0 || !size)
+		return -EINVAL;
 
-	if (0 == ubi->vols_size) {
-		LOG_ERR("No volumes present on device");
-		ret = -ENOENT;
-		goto exit;
-	}
+	bool is_mapped = false;
+	size_t pnum = 0;
+	atomic_val_t pin = UBI_PIN_LOCKED;
+	ret = eba_pin(ubi, vol_id, lnum, &is_mapped, &pnum, NULL, &pin, UBI_IO_CLASS_OF_VOLUME);
 
-	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+	if (0 != ret)
+		goto exit;
 
-	if (!entry) {
-		LOG_ERR("Device volume not found");
+	if (!is_mapped) {
+		LOG_ERR("LEB %zu in volume %d is not mapped", lnum, vol_id);
 		ret = -ENOENT;
 		goto exit;
 	}
 
-	struct ubi_volume *vol = entry->value.vol;
+	struct ubi_vid_hdr vid_hdr = { 0 };
+	ret = ubi_vid_hdr_read(&ubi->flash, pnum, &vid_hdr, true);
 
-	if (lnum > vol->cfg.leb_count) {
-		LOG_ERR("Volume LEB limit exceeded");
-		ret = -EACCES;
+	if (0 != ret) {
+		LOG_ERR("VID header read failure");
 		goto exit;
 	}
 
-	entry = ubi_rbt_search(&vol->eba_tbl, lnum);
-
-	*is_mapped = (NULL == entry) ? false : true;
-	ret = 0;
+	*size = vid_hdr.data_size;
 
 exit:
-	k_mutex_unlock(&ubi->mutex);
+	eba_unpin(ubi, pin);
 	return ret;
 }
 
-int ubi_leb_get_size(struct ubi_device *ubi, int vol_id, size_t lnum, size_t *size)
+int ubi_leb_get_sqnum(struct ubi_device *ubi, int vol_id, size_t lnum, uint64_t *sqnum)
 {
 	int ret = -EIO;
 
-	if (!ubi || vol_id < 0 || !size)
+	if (!ubi || vol_id < 0 || !sqnum)
 		return -EINVAL;
 
-	k_mutex_lock(&ubi->mutex, K_FOREVER);
+	device_lock(ubi, io_class_resolve(ubi, vol_id, UBI_IO_CLASS_OF_VOLUME));
 
 	if (0 == ubi->vols_size) {
 		LOG_ERR("No volumes present on device");
@@ -1511,7 +5848,7 @@ int ubi_leb_get_size(struct ubi_device *ubi, int vol_id, size_t lnum, size_t *si
 
 	struct ubi_volume *vol = entry->value.vol;
 
-	if (lnum > vol->cfg.leb_count) {
+	if (lnum >= vol->cfg.leb_count) {
 		LOG_ERR("Volume LEB limit exceeded");
 		ret = -EACCES;
 		goto exit;
@@ -1526,16 +5863,92 @@ int ubi_leb_get_size(struct ubi_device *ubi, int vol_id, size_t lnum, size_t *si
 	}
 
 	struct ubi_vid_hdr vid_hdr = { 0 };
-	ret = ubi_vid_hdr_read(&ubi->mtd, entry->value.pnum, &vid_hdr, true);
+	ret = ubi_vid_hdr_read(&ubi->flash, entry->value.pnum, &vid_hdr, true);
 
 	if (0 != ret) {
 		LOG_ERR("VID header read failure");
 		goto exit;
 	}
 
-	*size = vid_hdr.data_size;
+	*sqnum = vid_hdr.sqnum;
+
+exit:
+	device_unlock(ubi);
+	return ret;
+}
+
+int ubi_sealed_open(struct ubi_device *ubi, int vol_id, struct ubi_sealed_volume **sealed)
+{
+	int ret = -EIO;
+
+	if (!ubi || vol_id < 0 || !sealed)
+		return -EINVAL;
+
+	device_lock(ubi, UBI_IO_CLASS_NORMAL);
+
+	struct ubi_rbt_item *entry = ubi_rbt_search(&ubi->vols, vol_id);
+
+	if (!entry) {
+		LOG_ERR("Device volume not found");
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	struct ubi_volume *vol = entry->value.vol;
+
+	if (!vol->is_sealed) {
+		LOG_ERR("Volume is not sealed");
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	atomic_inc(&vol->sealed->refs);
+	*sealed = vol->sealed;
+	ret = 0;
 
 exit:
-	k_mutex_unlock(&ubi->mutex);
+	device_unlock(ubi);
 	return ret;
 }
+
+int ubi_sealed_read(struct ubi_sealed_volume *sealed, size_t lnum, size_t offset, void *buf,
+		    size_t size)
+{
+	if (!sealed || !buf || 0 == size)
+		return -EINVAL;
+
+	const size_t leb_size =
+		sealed->flash.mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE;
+
+	if (offset > leb_size || size > leb_size - offset)
+		return -EINVAL;
+
+	if (lnum >= sealed->leb_count) {
+		LOG_ERR("Volume LEB limit exceeded");
+		return -EACCES;
+	}
+
+	const uint32_t pnum = sealed->pnums[lnum];
+
+	if (UBI_SEALED_UNMAPPED == pnum) {
+		LOG_ERR("LEB not found");
+		return -ENOENT;
+	}
+
+	const struct ubi_leb_codec codec = {
+		.is_compressed = sealed->is_compressed,
+		.has_patterns = sealed->has_patterns,
+	};
+
+	return leb_data_unpack(&sealed->flash, pnum, &codec, offset, buf, size);
+}
+
+int ubi_sealed_close(struct ubi_sealed_volume *sealed)
+{
+	if (!sealed)
+		return -EINVAL;
+
+	sealed_map_put(sealed);
+
+	return 0;
+}
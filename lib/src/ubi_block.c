@@ -0,0 +1,480 @@
+/**
+ * \file    ubi_block.c
+ * \author  Kamil Kielbasa
+ * \brief   Unsorted Block Images (UBI) block device implementation.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi.h"
+#include "ubi_block.h"
+
+/* Zephyr headers: */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/drivers/disk.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define SECTOR_SIZE (CONFIG_UBI_BLOCK_SECTOR_SIZE)
+
+LOG_MODULE_REGISTER(ubi_block, CONFIG_UBI_LOG_LEVEL);
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief UBI block device representation.
+ *
+ * This structure binds a registered Zephyr disk with a UBI volume and keeps
+ * a single LEB sized read-modify-write cache.
+ */
+struct ubi_block {
+	struct disk_info disk; /**< Registered Zephyr disk. */
+	struct k_mutex mutex; /**< Serializes disk operations. */
+
+	struct ubi_device *ubi; /**< Underlying UBI device. */
+	int vol_id; /**< Backing volume identifier. */
+	bool read_only; /**< Backing volume is static. */
+
+	char name[UBI_VOLUME_NAME_MAX_LEN]; /**< Disk name. */
+
+	size_t sectors_per_leb; /**< Number of sectors stored in one LEB. */
+	size_t sector_count; /**< Total number of sectors. */
+
+	size_t cache_lnum; /**< LEB number held in the cache. */
+	bool cache_valid; /**< Cache holds \p cache_lnum contents. */
+	bool cache_dirty; /**< Cache differs from flash contents. */
+	uint8_t *cache; /**< LEB sized cache buffer. */
+
+	struct ubi_block_info info; /**< Geometry and access statistics. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief Write back the LEB cache if it is dirty.
+ *
+ * \param[in] block 	Pointer to UBI block device instance.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int cache_flush(struct ubi_block *block);
+
+/**
+ * \brief Load a LEB into the cache, flushing previous contents if needed.
+ *
+ * \param[in] block 	Pointer to UBI block device instance.
+ * \param lnum 		Logical eraseblock number.
+ * \param fill_only	Skip reading the LEB because it will be overwritten entirely.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int cache_load(struct ubi_block *block, size_t lnum, bool fill_only);
+
+/**
+ * \brief Read a run of sectors located in one LEB.
+ *
+ * \param[in] block 	Pointer to UBI block device instance.
+ * \param lnum 		Logical eraseblock number.
+ * \param offset 	Offset in bytes within the LEB.
+ * \param[out] buf 	Output buffer.
+ * \param len 		Number of bytes to read.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_run_read(struct ubi_block *block, size_t lnum, size_t offset, uint8_t *buf,
+			size_t len);
+
+static int disk_ubi_init(struct disk_info *disk);
+static int disk_ubi_status(struct disk_info *disk);
+static int disk_ubi_read(struct disk_info *disk, uint8_t *buf, uint32_t start_sector,
+			 uint32_t num_sector);
+static int disk_ubi_write(struct disk_info *disk, const uint8_t *buf, uint32_t start_sector,
+			  uint32_t num_sector);
+static int disk_ubi_ioctl(struct disk_info *disk, uint8_t cmd, void *buff);
+
+static const struct disk_operations ubi_block_ops = {
+	.init = disk_ubi_init,
+	.status = disk_ubi_status,
+	.read = disk_ubi_read,
+	.write = disk_ubi_write,
+	.ioctl = disk_ubi_ioctl,
+};
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static int cache_flush(struct ubi_block *block)
+{
+	__ASSERT_NO_MSG(block);
+
+	if (!block->cache_valid || !block->cache_dirty)
+		return 0;
+
+	int ret = ubi_leb_write(block->ubi, block->vol_id, block->cache_lnum, block->cache,
+				block->sectors_per_leb * SECTOR_SIZE);
+
+	if (0 != ret) {
+		LOG_ERR("LEB write failure");
+		return ret;
+	}
+
+	block->cache_dirty = false;
+	block->info.leb_writes += 1;
+
+	return 0;
+}
+
+static int cache_load(struct ubi_block *block, size_t lnum, bool fill_only)
+{
+	__ASSERT_NO_MSG(block);
+
+	if (block->cache_valid && lnum == block->cache_lnum)
+		return 0;
+
+	int ret = cache_flush(block);
+
+	if (0 != ret)
+		return ret;
+
+	block->cache_valid = false;
+
+	if (fill_only) {
+		memset(block->cache, 0xff, block->sectors_per_leb * SECTOR_SIZE);
+	} else {
+		ret = leb_run_read(block, lnum, 0, block->cache,
+				   block->sectors_per_leb * SECTOR_SIZE);
+
+		if (0 != ret)
+			return ret;
+	}
+
+	block->cache_lnum = lnum;
+	block->cache_valid = true;
+	block->cache_dirty = false;
+
+	return 0;
+}
+
+static int leb_run_read(struct ubi_block *block, size_t lnum, size_t offset, uint8_t *buf,
+			size_t len)
+{
+	__ASSERT_NO_MSG(block);
+	__ASSERT_NO_MSG(buf);
+
+	bool is_mapped = false;
+	int ret = ubi_leb_is_mapped(block->ubi, block->vol_id, lnum, &is_mapped);
+
+	if (0 != ret) {
+		LOG_ERR("LEB map check failure");
+		return ret;
+	}
+
+	/* Unmapped LEBs read as erased flash */
+	if (!is_mapped) {
+		memset(buf, 0xff, len);
+		return 0;
+	}
+
+	ret = ubi_leb_read(block->ubi, block->vol_id, lnum, offset, buf, len);
+
+	if (0 != ret) {
+		LOG_ERR("LEB read failure");
+		return ret;
+	}
+
+	block->info.leb_reads += 1;
+
+	return 0;
+}
+
+static int disk_ubi_init(struct disk_info *disk)
+{
+	ARG_UNUSED(disk);
+
+	return 0;
+}
+
+static int disk_ubi_status(struct disk_info *disk)
+{
+	struct ubi_block *block = CONTAINER_OF(disk, struct ubi_block, disk);
+
+	if (block->read_only)
+		return DISK_STATUS_WR_PROTECT;
+
+	return DISK_STATUS_OK;
+}
+
+static int disk_ubi_read(struct disk_info *disk, uint8_t *buf, uint32_t start_sector,
+			 uint32_t num_sector)
+{
+	struct ubi_block *block = CONTAINER_OF(disk, struct ubi_block, disk);
+
+	if (!buf)
+		return -EINVAL;
+
+	if ((size_t)start_sector + num_sector > block->sector_count)
+		return -EINVAL;
+
+	k_mutex_lock(&block->mutex, K_FOREVER);
+
+	int ret = 0;
+	size_t sector = start_sector;
+	size_t left = num_sector;
+
+	while (left > 0) {
+		const size_t lnum = sector / block->sectors_per_leb;
+		const size_t idx = sector % block->sectors_per_leb;
+		const size_t count = MIN(left, block->sectors_per_leb - idx);
+
+		if (block->cache_valid && lnum == block->cache_lnum) {
+			memcpy(buf, &block->cache[idx * SECTOR_SIZE], count * SECTOR_SIZE);
+			block->info.cache_hits += count;
+		} else {
+			ret = leb_run_read(block, lnum, idx * SECTOR_SIZE, buf,
+					   count * SECTOR_SIZE);
+
+			if (0 != ret)
+				goto exit;
+		}
+
+		buf += count * SECTOR_SIZE;
+		sector += count;
+		left -= count;
+	}
+
+exit:
+	k_mutex_unlock(&block->mutex);
+	return ret;
+}
+
+static int disk_ubi_write(struct disk_info *disk, const uint8_t *buf, uint32_t start_sector,
+			  uint32_t num_sector)
+{
+	struct ubi_block *block = CONTAINER_OF(disk, struct ubi_block, disk);
+
+	if (!buf)
+		return -EINVAL;
+
+	if (block->read_only)
+		return -EROFS;
+
+	if ((size_t)start_sector + num_sector > block->sector_count)
+		return -EINVAL;
+
+	k_mutex_lock(&block->mutex, K_FOREVER);
+
+	int ret = 0;
+	size_t sector = start_sector;
+	size_t left = num_sector;
+
+	while (left > 0) {
+		const size_t lnum = sector / block->sectors_per_leb;
+		const size_t idx = sector % block->sectors_per_leb;
+		const size_t count = MIN(left, block->sectors_per_leb - idx);
+
+		if (block->cache_valid && lnum == block->cache_lnum)
+			block->info.cache_hits += count;
+
+		ret = cache_load(block, lnum, count == block->sectors_per_leb);
+
+		if (0 != ret) {
+			LOG_ERR("LEB cache load failure");
+			goto exit;
+		}
+
+		memcpy(&block->cache[idx * SECTOR_SIZE], buf, count * SECTOR_SIZE);
+		block->cache_dirty = true;
+
+		buf += count * SECTOR_SIZE;
+		sector += count;
+		left -= count;
+	}
+
+exit:
+	k_mutex_unlock(&block->mutex);
+	return ret;
+}
+
+static int disk_ubi_ioctl(struct disk_info *disk, uint8_t cmd, void *buff)
+{
+	struct ubi_block *block = CONTAINER_OF(disk, struct ubi_block, disk);
+
+	int ret = 0;
+
+	switch (cmd) {
+	case DISK_IOCTL_GET_SECTOR_COUNT:
+		*(uint32_t *)buff = block->sector_count;
+		break;
+
+	case DISK_IOCTL_GET_SECTOR_SIZE:
+		*(uint32_t *)buff = SECTOR_SIZE;
+		break;
+
+	case DISK_IOCTL_GET_ERASE_BLOCK_SZ:
+		*(uint32_t *)buff = block->sectors_per_leb;
+		break;
+
+	case DISK_IOCTL_CTRL_SYNC:
+	case DISK_IOCTL_CTRL_DEINIT:
+		ret = ubi_block_sync(block);
+		break;
+
+	case DISK_IOCTL_CTRL_INIT:
+		break;
+
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	return ret;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_block_create(struct ubi_device *ubi, int vol_id, const char *disk_name,
+		     struct ubi_block **block)
+{
+	int ret = -EIO;
+
+	if (!ubi || vol_id < 0 || !disk_name || !block)
+		return -EINVAL;
+
+	const size_t name_len = strnlen(disk_name, UBI_VOLUME_NAME_MAX_LEN);
+
+	if (0 == name_len || UBI_VOLUME_NAME_MAX_LEN == name_len)
+		return -EINVAL;
+
+	struct ubi_device_info dev_info = { 0 };
+	ret = ubi_device_get_info(ubi, &dev_info);
+
+	if (0 != ret) {
+		LOG_ERR("Device get info failure");
+		return ret;
+	}
+
+	struct ubi_volume_config vol_cfg = { 0 };
+	size_t alloc_lebs = 0;
+	ret = ubi_volume_get_info(ubi, vol_id, &vol_cfg, &alloc_lebs);
+
+	if (0 != ret) {
+		LOG_ERR("Volume get info failure");
+		return ret;
+	}
+
+	const size_t sectors_per_leb = dev_info.leb_size / SECTOR_SIZE;
+
+	if (0 == sectors_per_leb) {
+		LOG_ERR("Sector size exceeds LEB size");
+		return -EINVAL;
+	}
+
+	struct ubi_block *blk = k_malloc(sizeof(*blk));
+
+	if (!blk) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(blk, 0, sizeof(*blk));
+	k_mutex_init(&blk->mutex);
+	blk->ubi = ubi;
+	blk->vol_id = vol_id;
+	blk->read_only = (UBI_VOLUME_TYPE_STATIC == vol_cfg.type);
+	memcpy(blk->name, disk_name, name_len);
+	blk->sectors_per_leb = sectors_per_leb;
+	blk->sector_count = vol_cfg.leb_count * sectors_per_leb;
+
+	blk->info.sector_size = SECTOR_SIZE;
+	blk->info.sector_count = blk->sector_count;
+	blk->info.sectors_per_leb = sectors_per_leb;
+
+	blk->cache = k_malloc(sectors_per_leb * SECTOR_SIZE);
+
+	if (!blk->cache) {
+		LOG_ERR("Heap allocation failure");
+		k_free(blk);
+		return -ENOMEM;
+	}
+
+	blk->disk.name = blk->name;
+	blk->disk.ops = &ubi_block_ops;
+
+	ret = disk_access_register(&blk->disk);
+
+	if (0 != ret) {
+		LOG_ERR("Disk register failure");
+		k_free(blk->cache);
+		k_free(blk);
+		return ret;
+	}
+
+	*block = blk;
+	return 0;
+}
+
+int ubi_block_sync(struct ubi_block *block)
+{
+	if (!block)
+		return -EINVAL;
+
+	k_mutex_lock(&block->mutex, K_FOREVER);
+	const int ret = cache_flush(block);
+	k_mutex_unlock(&block->mutex);
+
+	return ret;
+}
+
+int ubi_block_get_info(struct ubi_block *block, struct ubi_block_info *info)
+{
+	if (!block || !info)
+		return -EINVAL;
+
+	k_mutex_lock(&block->mutex, K_FOREVER);
+	*info = block->info;
+	k_mutex_unlock(&block->mutex);
+
+	return 0;
+}
+
+int ubi_block_destroy(struct ubi_block *block)
+{
+	if (!block)
+		return -EINVAL;
+
+	int ret = ubi_block_sync(block);
+
+	if (0 != ret) {
+		LOG_ERR("Block device sync failure");
+		return ret;
+	}
+
+	ret = disk_access_unregister(&block->disk);
+
+	if (0 != ret) {
+		LOG_ERR("Disk unregister failure");
+		return ret;
+	}
+
+	k_free(block->cache);
+	k_free(block);
+
+	return 0;
+}
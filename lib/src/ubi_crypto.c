@@ -0,0 +1,234 @@
+/**
+ * \file    ubi_crypto.c
+ * \author  Kamil Kielbasa
+ * \brief   Unsorted Block Images (UBI) LEB data encryption.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi_crypto.h"
+
+/* Zephyr headers: */
+#include <zephyr/crypto/crypto.h>
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/util.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define UBI_CRYPTO_KEY_MAX_LEN (32)
+#define UBI_CRYPTO_CAPS (CAP_RAW_KEY | CAP_SEPARATE_IO_BUFS | CAP_SYNC_OPS)
+
+LOG_MODULE_REGISTER(ubi_crypto, CONFIG_UBI_LOG_LEVEL);
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief Cipher session keyed by a volume key.
+ */
+struct ubi_crypto {
+	const struct device *dev; /**< Crypto driver. */
+	struct cipher_ctx ctx; /**< Single block encryption session. */
+	struct k_mutex lock; /**< Serializes operations of the session. */
+	uint8_t key[UBI_CRYPTO_KEY_MAX_LEN]; /**< Key, driver may refer to it during session. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief XOR data with the key stream of its LEB.
+ *
+ * \param[in] crypto 		Pointer to the session.
+ * \param[in] tweak 		Position of the LEB in the key stream.
+ * \param offset 		Offset of the data within LEB, a multiple of cipher block size.
+ * \param[in,out] buf 		Data, a multiple of cipher block size.
+ * \param len 			Size of the data in bytes.
+ * \param skip_erased 		Leave erased cipher blocks unchanged.
+ *
+ * \return 0 on success, or negative error code of crypto driver.
+ */
+static int crypto_xor_stream(struct ubi_crypto *crypto, const struct ubi_crypto_tweak *tweak,
+			     size_t offset, uint8_t *buf, size_t len, bool skip_erased);
+
+/**
+ * \brief Overwrite memory so the compiler cannot drop the stores.
+ *
+ * \param[out] buf 		Memory to wipe.
+ * \param len 			Size of the memory in bytes.
+ */
+static void crypto_wipe(void *buf, size_t len);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static int crypto_xor_stream(struct ubi_crypto *crypto, const struct ubi_crypto_tweak *tweak,
+			     size_t offset, uint8_t *buf, size_t len, bool skip_erased)
+{
+	__ASSERT_NO_MSG(crypto);
+	__ASSERT_NO_MSG(tweak);
+	__ASSERT_NO_MSG(buf);
+	__ASSERT_NO_MSG(0 == offset % UBI_CRYPTO_BLOCK_SIZE);
+	__ASSERT_NO_MSG(0 == len % UBI_CRYPTO_BLOCK_SIZE);
+
+	int ret = 0;
+
+	uint8_t ctr[UBI_CRYPTO_BLOCK_SIZE] = { 0 };
+	uint8_t stream[UBI_CRYPTO_BLOCK_SIZE] = { 0 };
+
+	/* Counter block: sequence number, LEB number and block index, all little endian */
+	for (size_t i = 0; i < 8; ++i)
+		ctr[i] = (uint8_t)(tweak->sqnum >> (8 * i));
+
+	for (size_t i = 0; i < 4; ++i)
+		ctr[8 + i] = (uint8_t)(tweak->lnum >> (8 * i));
+
+	k_mutex_lock(&crypto->lock, K_FOREVER);
+
+	for (size_t pos = 0; pos < len; pos += UBI_CRYPTO_BLOCK_SIZE) {
+		uint8_t *blk = &buf[pos];
+
+		if (skip_erased) {
+			bool is_erased = true;
+
+			for (size_t i = 0; i < UBI_CRYPTO_BLOCK_SIZE && is_erased; ++i)
+				is_erased = (0xFF == blk[i]);
+
+			if (is_erased)
+				continue;
+		}
+
+		const uint32_t index = (offset + pos) / UBI_CRYPTO_BLOCK_SIZE;
+
+		for (size_t i = 0; i < 4; ++i)
+			ctr[12 + i] = (uint8_t)(index >> (8 * i));
+
+		struct cipher_pkt pkt = {
+			.in_buf = ctr,
+			.in_len = sizeof(ctr),
+			.out_buf = stream,
+			.out_buf_max = sizeof(stream),
+		};
+
+		ret = cipher_block_op(&crypto->ctx, &pkt);
+
+		if (0 != ret) {
+			LOG_ERR("Cipher block operation failure");
+			break;
+		}
+
+		for (size_t i = 0; i < UBI_CRYPTO_BLOCK_SIZE; ++i)
+			blk[i] ^= stream[i];
+	}
+
+	k_mutex_unlock(&crypto->lock);
+
+	crypto_wipe(stream, sizeof(stream));
+	return ret;
+}
+
+static void crypto_wipe(void *buf, size_t len)
+{
+	volatile uint8_t *p = buf;
+
+	for (size_t i = 0; i < len; ++i)
+		p[i] = 0;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_crypto_open(const uint8_t *key, size_t key_len, struct ubi_crypto **crypto)
+{
+	int ret = -EIO;
+
+	if (!key || !crypto || (16 != key_len && 32 != key_len))
+		return -EINVAL;
+
+	const struct device *dev = device_get_binding(CONFIG_UBI_CRYPTO_DRV_NAME);
+
+	if (!dev || !device_is_ready(dev)) {
+		LOG_ERR("Crypto driver not ready");
+		return -ENODEV;
+	}
+
+	if (UBI_CRYPTO_CAPS != (cipher_query_hwcaps(dev) & UBI_CRYPTO_CAPS)) {
+		LOG_ERR("Crypto driver lacks capabilities");
+		return -ENOTSUP;
+	}
+
+	struct ubi_crypto *session = k_malloc(sizeof(*session));
+
+	if (!session) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(session, 0, sizeof(*session));
+	memcpy(session->key, key, key_len);
+	k_mutex_init(&session->lock);
+
+	session->dev = dev;
+	session->ctx.keylen = key_len;
+	session->ctx.key.bit_stream = session->key;
+	session->ctx.flags = UBI_CRYPTO_CAPS;
+
+	/* Counter mode needs encryption only, ECB gives full control over counter blocks */
+	ret = cipher_begin_session(dev, &session->ctx, CRYPTO_CIPHER_ALGO_AES,
+				   CRYPTO_CIPHER_MODE_ECB, CRYPTO_CIPHER_OP_ENCRYPT);
+
+	if (0 != ret) {
+		LOG_ERR("Cipher session begin failure");
+		crypto_wipe(session, sizeof(*session));
+		k_free(session);
+		return ret;
+	}
+
+	*crypto = session;
+	return 0;
+}
+
+void ubi_crypto_close(struct ubi_crypto *crypto)
+{
+	if (!crypto)
+		return;
+
+	cipher_free_session(crypto->dev, &crypto->ctx);
+
+	crypto_wipe(crypto, sizeof(*crypto));
+	k_free(crypto);
+}
+
+int ubi_crypto_encrypt(struct ubi_crypto *crypto, const struct ubi_crypto_tweak *tweak,
+		       size_t offset, uint8_t *buf, size_t len)
+{
+	if (!crypto || !tweak || !buf || 0 != offset % UBI_CRYPTO_BLOCK_SIZE ||
+	    0 != len % UBI_CRYPTO_BLOCK_SIZE)
+		return -EINVAL;
+
+	return crypto_xor_stream(crypto, tweak, offset, buf, len, false);
+}
+
+int ubi_crypto_decrypt(struct ubi_crypto *crypto, const struct ubi_crypto_tweak *tweak,
+		       size_t offset, uint8_t *buf, size_t len)
+{
+	if (!crypto || !tweak || !buf || 0 != offset % UBI_CRYPTO_BLOCK_SIZE ||
+	    0 != len % UBI_CRYPTO_BLOCK_SIZE)
+		return -EINVAL;
+
+	return crypto_xor_stream(crypto, tweak, offset, buf, len, true);
+}
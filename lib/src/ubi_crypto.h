@@ -0,0 +1,146 @@
+/**
+ * \file    ubi_crypto.h
+ *
+ * \brief   Unsorted Block Images (UBI) LEB data encryption.
+ *
+ * \author  Kamil Kielbasa
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ */
+
+/* Include guard ------------------------------------------------------------------------------- */
+#ifndef UBI_CRYPTO_H
+#define UBI_CRYPTO_H
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Standard library headers */
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines ------------------------------------------------------------------------------------- */
+
+/**
+ * \def UBI_CRYPTO_BLOCK_SIZE
+ * \brief Size of cipher block, equal to write block size.
+ */
+#define UBI_CRYPTO_BLOCK_SIZE (16)
+
+/**
+ * \def UBI_CRYPTO_CHUNK_SIZE
+ * \brief Size of chunks LEB data is encrypted and programmed in, a multiple of cipher block size.
+ */
+#define UBI_CRYPTO_CHUNK_SIZE (64)
+
+/* Types and type definitions ------------------------------------------------------------------ */
+
+/**
+ * \brief Cipher session keyed by a volume key.
+ */
+struct ubi_crypto;
+
+/**
+ * \brief Position of LEB data in the key stream of a volume.
+ */
+struct ubi_crypto_tweak {
+	uint64_t sqnum; /**< Sequence number of the VID header. */
+	uint32_t lnum; /**< Logical eraseblock number. */
+};
+
+/* Module interface function declarations ------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_crypto LEB Data Encryption
+ * \brief Functions to encrypt and decrypt LEB data in place.
+ *
+ * Data is encrypted by AES in counter mode. Counter block holds sequence number, LEB number and
+ * index of the cipher block within LEB data, so any block decrypts on its own and no counter is
+ * used twice under one key. Volume identifier enters through the per volume key. Key stream is
+ * produced by single block operations of the crypto driver set by CONFIG_UBI_CRYPTO_DRV_NAME.
+ * \{
+ */
+
+#if defined(CONFIG_UBI_CRYPTO_ENABLE)
+
+/**
+ * \brief Begin a cipher session with a volume key.
+ *
+ * \param[in] key 		AES key.
+ * \param key_len 		Size of the key in bytes, 16 or 32.
+ * \param[out] crypto 		Pointer to the new session.
+ *
+ * \return 0 on success, -ENODEV if crypto driver is missing, -ENOTSUP if driver lacks the
+ * required capabilities, or negative error code.
+ */
+int ubi_crypto_open(const uint8_t *key, size_t key_len, struct ubi_crypto **crypto);
+
+/**
+ * \brief End a cipher session and destroy its copy of the key.
+ *
+ * \param[in] crypto 		Pointer to the session, may be NULL.
+ */
+void ubi_crypto_close(struct ubi_crypto *crypto);
+
+/**
+ * \brief Encrypt LEB data in place.
+ *
+ * \param[in] crypto 		Pointer to the session.
+ * \param[in] tweak 		Position of the LEB in the key stream.
+ * \param offset 		Offset of the data within LEB, a multiple of cipher block size.
+ * \param[in,out] buf 		Data, a multiple of cipher block size.
+ * \param len 			Size of the data in bytes.
+ *
+ * \return 0 on success, or negative error code of crypto driver.
+ */
+int ubi_crypto_encrypt(struct ubi_crypto *crypto, const struct ubi_crypto_tweak *tweak,
+		       size_t offset, uint8_t *buf, size_t len);
+
+/**
+ * \brief Decrypt LEB data in place.
+ *
+ * Erased cipher blocks are left erased, so unwritten parts of a LEB still read as erased.
+ *
+ * \param[in] crypto 		Pointer to the session.
+ * \param[in] tweak 		Position of the LEB in the key stream.
+ * \param offset 		Offset of the data within LEB, a multiple of cipher block size.
+ * \param[in,out] buf 		Data, a multiple of cipher block size.
+ * \param len 			Size of the data in bytes.
+ *
+ * \return 0 on success, or negative error code of crypto driver.
+ */
+int ubi_crypto_decrypt(struct ubi_crypto *crypto, const struct ubi_crypto_tweak *tweak,
+		       size_t offset, uint8_t *buf, size_t len);
+
+#else
+
+static inline int ubi_crypto_open(const uint8_t *key, size_t key_len, struct ubi_crypto **crypto)
+{
+	return -ENOTSUP;
+}
+
+static inline void ubi_crypto_close(struct ubi_crypto *crypto)
+{
+}
+
+static inline int ubi_crypto_encrypt(struct ubi_crypto *crypto,
+				     const struct ubi_crypto_tweak *tweak, size_t offset,
+				     uint8_t *buf, size_t len)
+{
+	return -ENOTSUP;
+}
+
+static inline int ubi_crypto_decrypt(struct ubi_crypto *crypto,
+				     const struct ubi_crypto_tweak *tweak, size_t offset,
+				     uint8_t *buf, size_t len)
+{
+	return -ENOTSUP;
+}
+
+#endif /* CONFIG_UBI_CRYPTO_ENABLE */
+
+/** \} name ubi_crypto */
+
+#endif /* UBI_CRYPTO_H */
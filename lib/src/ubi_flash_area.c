@@ -0,0 +1,291 @@
+/**
+ * \file    ubi_flash_area.c
+ * \author  Kamil Kielbasa
+ * \brief   Unsorted Block Images (UBI) virtual flash area implementation.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi.h"
+#include "ubi_flash_area.h"
+#include "ubi_utils.h"
+
+/* Zephyr headers: */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/util.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define FLASH_AREA_ALIGN (WRITE_BLOCK_SIZE_ALIGNMENT)
+#define FLASH_AREA_ERASED_VAL (0xFF)
+
+LOG_MODULE_REGISTER(ubi_flash_area, CONFIG_UBI_LOG_LEVEL);
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief UBI virtual flash area representation.
+ */
+struct ubi_flash_area {
+	struct k_mutex mutex; /**< Serializes flash area operations. */
+
+	struct ubi_device *ubi; /**< Underlying UBI device. */
+	int vol_id; /**< Backing volume identifier. */
+
+	size_t leb_size; /**< Size of each LEB (sector) in bytes. */
+	size_t leb_count; /**< Number of LEBs in volume. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief Check that a range lies within a virtual flash area.
+ *
+ * \param[in] ufa 	Pointer to UBI virtual flash area instance.
+ * \param off 		Offset relative to start of flash area.
+ * \param len 		Length of range in bytes.
+ *
+ * \return true if range is valid, false otherwise.
+ */
+static bool range_is_valid(const struct ubi_flash_area *ufa, off_t off, size_t len);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static bool range_is_valid(const struct ubi_flash_area *ufa, off_t off, size_t len)
+{
+	__ASSERT_NO_MSG(ufa);
+
+	const size_t size = ufa->leb_size * ufa->leb_count;
+
+	return off >= 0 && (size_t)off <= size && len <= size - (size_t)off;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_flash_area_open(struct ubi_device *ubi, int vol_id, struct ubi_flash_area **ufa)
+{
+	int ret = -EIO;
+
+	if (!ubi || vol_id < 0 || !ufa)
+		return -EINVAL;
+
+	struct ubi_device_info dev_info = { 0 };
+	ret = ubi_device_get_info(ubi, &dev_info);
+
+	if (0 != ret) {
+		LOG_ERR("Device get info failure");
+		return ret;
+	}
+
+	struct ubi_volume_config vol_cfg = { 0 };
+	size_t alloc_lebs = 0;
+	ret = ubi_volume_get_info(ubi, vol_id, &vol_cfg, &alloc_lebs);
+
+	if (0 != ret) {
+		LOG_ERR("Volume get info failure");
+		return ret;
+	}
+
+	if (UBI_VOLUME_TYPE_STATIC != vol_cfg.type || 0 == vol_cfg.leb_count) {
+		LOG_ERR("Volume is not suitable for flash area");
+		return -EINVAL;
+	}
+
+	struct ubi_flash_area *area = k_malloc(sizeof(*area));
+
+	if (!area) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(area, 0, sizeof(*area));
+	k_mutex_init(&area->mutex);
+	area->ubi = ubi;
+	area->vol_id = vol_id;
+	area->leb_size = dev_info.leb_size;
+	area->leb_count = vol_cfg.leb_count;
+
+	*ufa = area;
+	return 0;
+}
+
+int ubi_flash_area_read(struct ubi_flash_area *ufa, off_t off, void *dst, size_t len)
+{
+	if (!ufa || (!dst && len > 0))
+		return -EINVAL;
+
+	if (!range_is_valid(ufa, off, len))
+		return -EINVAL;
+
+	k_mutex_lock(&ufa->mutex, K_FOREVER);
+
+	uint8_t *out = dst;
+	size_t pos = off;
+	int ret = 0;
+
+	while (len > 0) {
+		const size_t lnum = pos / ufa->leb_size;
+		const size_t leb_off = pos % ufa->leb_size;
+		const size_t chunk = MIN(len, ufa->leb_size - leb_off);
+
+		bool is_mapped = false;
+		ret = ubi_leb_is_mapped(ufa->ubi, ufa->vol_id, lnum, &is_mapped);
+
+		if (0 != ret) {
+			LOG_ERR("LEB map check failure");
+			goto exit;
+		}
+
+		if (is_mapped) {
+			ret = ubi_leb_read(ufa->ubi, ufa->vol_id, lnum, leb_off, out, chunk);
+
+			if (0 != ret) {
+				LOG_ERR("LEB read failure");
+				goto exit;
+			}
+		} else {
+			memset(out, FLASH_AREA_ERASED_VAL, chunk);
+		}
+
+		out += chunk;
+		pos += chunk;
+		len -= chunk;
+	}
+
+exit:
+	k_mutex_unlock(&ufa->mutex);
+	return ret;
+}
+
+int ubi_flash_area_write(struct ubi_flash_area *ufa, off_t off, const void *src, size_t len)
+{
+	if (!ufa || (!src && len > 0))
+		return -EINVAL;
+
+	if (!range_is_valid(ufa, off, len))
+		return -EINVAL;
+
+	if (0 != off % FLASH_AREA_ALIGN || 0 != len % FLASH_AREA_ALIGN)
+		return -EINVAL;
+
+	k_mutex_lock(&ufa->mutex, K_FOREVER);
+
+	const uint8_t *in = src;
+	size_t pos = off;
+	int ret = 0;
+
+	while (len > 0) {
+		const size_t lnum = pos / ufa->leb_size;
+		const size_t leb_off = pos % ufa->leb_size;
+		const size_t chunk = MIN(len, ufa->leb_size - leb_off);
+
+		/* Never written LEB is mapped on demand by offset write */
+		ret = ubi_leb_write_offset(ufa->ubi, ufa->vol_id, lnum, leb_off, in, chunk);
+
+		if (0 != ret) {
+			LOG_ERR("LEB write failure");
+			goto exit;
+		}
+
+		in += chunk;
+		pos += chunk;
+		len -= chunk;
+	}
+
+exit:
+	k_mutex_unlock(&ufa->mutex);
+	return ret;
+}
+
+int ubi_flash_area_erase(struct ubi_flash_area *ufa, off_t off, size_t len)
+{
+	if (!ufa)
+		return -EINVAL;
+
+	if (!range_is_valid(ufa, off, len))
+		return -EINVAL;
+
+	if (0 != off % ufa->leb_size || 0 != len % ufa->leb_size)
+		return -EINVAL;
+
+	k_mutex_lock(&ufa->mutex, K_FOREVER);
+
+	int ret = 0;
+
+	for (size_t lnum = off / ufa->leb_size; len > 0; ++lnum, len -= ufa->leb_size) {
+		/* Map to an empty PEB, unmap alone would resurrect old data after reboot */
+		ret = ubi_leb_map(ufa->ubi, ufa->vol_id, lnum);
+
+		if (0 != ret) {
+			LOG_ERR("LEB map failure");
+			goto exit;
+		}
+	}
+
+exit:
+	k_mutex_unlock(&ufa->mutex);
+	return ret;
+}
+
+int ubi_flash_area_get_info(struct ubi_flash_area *ufa, struct ubi_flash_area_info *info)
+{
+	if (!ufa || !info)
+		return -EINVAL;
+
+	memset(info, 0, sizeof(*info));
+	info->size = ufa->leb_size * ufa->leb_count;
+	info->sector_size = ufa->leb_size;
+	info->sector_count = ufa->leb_count;
+	info->align = FLASH_AREA_ALIGN;
+	info->erased_val = FLASH_AREA_ERASED_VAL;
+
+	return 0;
+}
+
+int ubi_flash_area_get_sectors(struct ubi_flash_area *ufa, uint32_t *count,
+			       struct flash_sector *sectors)
+{
+	if (!ufa || !count || !sectors)
+		return -EINVAL;
+
+	if (*count < ufa->leb_count)
+		return -ENOMEM;
+
+	for (size_t lnum = 0; lnum < ufa->leb_count; ++lnum) {
+		sectors[lnum].fs_off = lnum * ufa->leb_size;
+		sectors[lnum].fs_size = ufa->leb_size;
+	}
+
+	*count = ufa->leb_count;
+
+	return 0;
+}
+
+int ubi_flash_area_close(struct ubi_flash_area *ufa)
+{
+	if (!ufa)
+		return -EINVAL;
+
+	k_free(ufa);
+
+	return 0;
+}
@@ -0,0 +1,1076 @@
+/**
+ * \file    ubi_kv.c
+ * \author  Kamil Kielbasa
+ * \brief   Unsorted Block Images (UBI) key-value store implementation.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi.h"
+#include "ubi_kv.h"
+#include "ubi_utils.h"
+
+/* Zephyr headers: */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define KV_KEY_MAX_LEN (CONFIG_UBI_KV_MAX_KEY_LEN)
+#define KV_VAL_MAX_LEN (CONFIG_UBI_KV_MAX_VALUE_LEN)
+#define KV_MAX_RECORDS (CONFIG_UBI_KV_MAX_RECORDS)
+
+#define KV_ALIGN (WRITE_BLOCK_SIZE_ALIGNMENT)
+
+/* Key-value LEB header constants */
+#define KV_LEB_HDR_MAGIC (0x4B564C42)
+#define KV_LEB_HDR_SIZE (16)
+
+/* Key-value record header constants */
+#define KV_REC_HDR_MAGIC (0x4B565243)
+#define KV_REC_HDR_SIZE (16)
+#define KV_REC_FLAG_DELETED BIT(0)
+#define KV_REC_MAX_SIZE ROUND_UP(KV_REC_HDR_SIZE + KV_KEY_MAX_LEN + KV_VAL_MAX_LEN, KV_ALIGN)
+
+#define KV_ERASED_WORD (0xFFFFFFFF)
+#define KV_SLOT_EMPTY (UINT16_MAX)
+
+BUILD_ASSERT(KV_KEY_MAX_LEN > 0 && KV_KEY_MAX_LEN <= UINT8_MAX);
+BUILD_ASSERT(KV_VAL_MAX_LEN <= UINT16_MAX);
+
+LOG_MODULE_REGISTER(ubi_kv, CONFIG_UBI_LOG_LEVEL);
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief Key-value LEB header, stored at the beginning of each mapped LEB.
+ */
+struct kv_leb_hdr {
+	uint32_t magic; /*!< Magic number */
+	uint32_t seq; /*!< LEB sequence number, newer LEBs have higher numbers */
+	uint32_t padding; /*!< Reserved */
+	uint32_t hdr_crc; /*!< CRC32 of header */
+};
+BUILD_ASSERT(sizeof(struct kv_leb_hdr) == KV_LEB_HDR_SIZE);
+BUILD_ASSERT(sizeof(struct kv_leb_hdr) % KV_ALIGN == 0);
+
+/**
+ * \brief Key-value record header, followed by key and value.
+ */
+struct kv_rec_hdr {
+	uint32_t magic; /*!< Magic number */
+	uint8_t key_len; /*!< Key length in bytes */
+	uint8_t flags; /*!< Record flags */
+	uint16_t val_len; /*!< Value length in bytes */
+	uint32_t padding; /*!< Reserved */
+	uint32_t crc; /*!< CRC32 of header, key and value */
+};
+BUILD_ASSERT(sizeof(struct kv_rec_hdr) == KV_REC_HDR_SIZE);
+BUILD_ASSERT(sizeof(struct kv_rec_hdr) % KV_ALIGN == 0);
+
+/**
+ * \brief Hash index slot pointing to the newest record of a key.
+ */
+struct kv_slot {
+	uint32_t hash; /**< Key hash. */
+	uint16_t lnum; /**< LEB holding the record, \ref KV_SLOT_EMPTY if unused. */
+	uint16_t offset; /**< Record offset within LEB in \ref KV_ALIGN units. */
+	uint16_t size; /**< Record size in \ref KV_ALIGN units. */
+	uint16_t padding; /**< Reserved. */
+};
+
+/**
+ * \brief UBI key-value store representation.
+ */
+struct ubi_kv {
+	struct k_mutex mutex; /**< Serializes store operations. */
+
+	struct ubi_device *ubi; /**< Underlying UBI device. */
+	int vol_id; /**< Backing volume identifier. */
+
+	size_t leb_size; /**< Size of each LEB in bytes. */
+	size_t leb_count; /**< Number of LEBs in volume. */
+	size_t capacity; /**< Maximum number of live bytes. */
+
+	uint32_t *leb_seq; /**< Sequence number per LEB, 0 if unmapped. */
+	uint32_t *leb_live; /**< Live record bytes per LEB. */
+	uint32_t seq_next; /**< Sequence number of next opened LEB. */
+
+	bool active_valid; /**< Active LEB is open. */
+	size_t active_lnum; /**< LEB receiving appended records. */
+	size_t active_wp; /**< Write pointer within active LEB. */
+	bool compacting; /**< Compaction is in progress. */
+
+	struct kv_slot *slots; /**< Hash index with linear probing. */
+	size_t slots_mask; /**< Number of slots minus one. */
+
+	uint8_t rec_buf[KV_REC_MAX_SIZE]; /**< Record staging buffer. */
+	uint8_t key_buf[ROUND_UP(KV_REC_HDR_SIZE + KV_KEY_MAX_LEN, KV_ALIGN)]; /**< Key buffer. */
+
+	struct ubi_kv_info info; /**< Store statistics. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief Compute FNV-1a hash of a key.
+ *
+ * \param[in] key 	Key buffer.
+ * \param key_len 	Key length in bytes.
+ *
+ * \return Key hash.
+ */
+static uint32_t kv_hash(const char *key, size_t key_len);
+
+/**
+ * \brief Find index slot of a key.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param[in] key 	Key buffer.
+ * \param key_len 	Key length in bytes.
+ * \param hash 		Key hash.
+ * \param[out] idx 	Index of slot holding the key, or of the first empty slot.
+ * \param[out] found 	True if key is present in index.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int slot_find(struct ubi_kv *kv, const char *key, size_t key_len, uint32_t hash,
+		     size_t *idx, bool *found);
+
+/**
+ * \brief Remove a slot and shift following slots of the probe sequence back.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param idx 		Index of slot to remove.
+ */
+static void slot_remove(struct ubi_kv *kv, size_t idx);
+
+/**
+ * \brief Update index with a record written at given location.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param[in] hdr 	Record header.
+ * \param[in] key 	Record key.
+ * \param lnum 		LEB holding the record.
+ * \param offset 	Record offset within LEB.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int index_update(struct ubi_kv *kv, const struct kv_rec_hdr *hdr, const char *key,
+			size_t lnum, size_t offset);
+
+/**
+ * \brief Load a record into the staging buffer and verify it.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param lnum 		Logical eraseblock number.
+ * \param offset 	Record offset within LEB.
+ * \param[out] size 	Record size in bytes.
+ *
+ * \return 0 on success, -ENODATA on erased space, -EBADMSG on corrupted record,
+ * or other negative error code on failure.
+ */
+static int rec_load(struct ubi_kv *kv, size_t lnum, size_t offset, size_t *size);
+
+/**
+ * \brief Build a record in the staging buffer.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param[in] key 	Record key.
+ * \param key_len 	Key length in bytes.
+ * \param[in] val 	Record value, NULL for deletion record.
+ * \param val_len 	Value length in bytes.
+ *
+ * \return Record size in bytes.
+ */
+static size_t rec_build(struct ubi_kv *kv, const char *key, size_t key_len, const void *val,
+			size_t val_len);
+
+/**
+ * \brief Append staging buffer to the active LEB.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param size 		Record size in bytes.
+ * \param[out] lnum 	LEB holding the record.
+ * \param[out] offset 	Record offset within LEB.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int rec_append(struct ubi_kv *kv, size_t size, size_t *lnum, size_t *offset);
+
+/**
+ * \brief Make sure that active LEB has room for a record, compacting if needed.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param size 		Record size in bytes.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int room_ensure(struct ubi_kv *kv, size_t size);
+
+/**
+ * \brief Open an unmapped LEB as the active LEB.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_open(struct ubi_kv *kv);
+
+/**
+ * \brief Copy live records of the oldest LEB into the active LEB and unmap it.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_compact(struct ubi_kv *kv);
+
+/**
+ * \brief Scan records of a LEB and update index with them.
+ *
+ * \param[in] kv 	Pointer to UBI key-value store instance.
+ * \param lnum 		Logical eraseblock number.
+ * \param[out] end 	Offset of first byte after the last valid record.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_scan(struct ubi_kv *kv, size_t lnum, size_t *end);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static uint32_t kv_hash(const char *key, size_t key_len)
+{
+	uint32_t hash = 2166136261U;
+
+	for (size_t i = 0; i < key_len; ++i) {
+		hash ^= (uint8_t)key[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static int slot_find(struct ubi_kv *kv, const char *key, size_t key_len, uint32_t hash,
+		     size_t *idx, bool *found)
+{
+	__ASSERT_NO_MSG(kv);
+	__ASSERT_NO_MSG(key);
+	__ASSERT_NO_MSG(idx);
+	__ASSERT_NO_MSG(found);
+
+	*found = false;
+
+	for (size_t i = hash & kv->slots_mask;; i = (i + 1) & kv->slots_mask) {
+		const struct kv_slot *slot = &kv->slots[i];
+
+		if (KV_SLOT_EMPTY == slot->lnum) {
+			*idx = i;
+			return 0;
+		}
+
+		if (slot->hash != hash)
+			continue;
+
+		/* Hash match, compare keys stored on flash, key of another length is a collision */
+		const size_t offset = slot->offset * KV_ALIGN;
+		int ret = ubi_leb_read(kv->ubi, kv->vol_id, slot->lnum, offset, kv->key_buf,
+				       KV_REC_HDR_SIZE);
+
+		if (0 != ret) {
+			LOG_ERR("Record header read failure");
+			return ret;
+		}
+
+		const struct kv_rec_hdr *hdr = (const struct kv_rec_hdr *)kv->key_buf;
+
+		if (hdr->key_len != key_len || KV_REC_HDR_SIZE + key_len > kv->leb_size - offset)
+			continue;
+
+		ret = ubi_leb_read(kv->ubi, kv->vol_id, slot->lnum, offset + KV_REC_HDR_SIZE,
+				   &kv->key_buf[KV_REC_HDR_SIZE], key_len);
+
+		if (0 != ret) {
+			LOG_ERR("Record key read failure");
+			return ret;
+		}
+
+		if (0 == memcmp(&kv->key_buf[KV_REC_HDR_SIZE], key, key_len)) {
+			*idx = i;
+			*found = true;
+			return 0;
+		}
+	}
+}
+
+static void slot_remove(struct ubi_kv *kv, size_t idx)
+{
+	__ASSERT_NO_MSG(kv);
+
+	size_t i = idx;
+	size_t j = idx;
+
+	for (;;) {
+		kv->slots[i].lnum = KV_SLOT_EMPTY;
+
+		for (;;) {
+			j = (j + 1) & kv->slots_mask;
+
+			if (KV_SLOT_EMPTY == kv->slots[j].lnum)
+				return;
+
+			/* Keep entries whose home slot lies cyclically in (i, j] */
+			const size_t home = kv->slots[j].hash & kv->slots_mask;
+
+			if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+				continue;
+
+			kv->slots[i] = kv->slots[j];
+			i = j;
+			break;
+		}
+	}
+}
+
+static int index_update(struct ubi_kv *kv, const struct kv_rec_hdr *hdr, const char *key,
+			size_t lnum, size_t offset)
+{
+	__ASSERT_NO_MSG(kv);
+	__ASSERT_NO_MSG(hdr);
+	__ASSERT_NO_MSG(key);
+
+	const uint32_t hash = kv_hash(key, hdr->key_len);
+	const size_t size = ROUND_UP(KV_REC_HDR_SIZE + hdr->key_len + hdr->val_len, KV_ALIGN);
+
+	size_t idx = 0;
+	bool found = false;
+	int ret = slot_find(kv, key, hdr->key_len, hash, &idx, &found);
+
+	if (0 != ret)
+		return ret;
+
+	struct kv_slot *slot = &kv->slots[idx];
+
+	if (found) {
+		kv->leb_live[slot->lnum] -= slot->size * KV_ALIGN;
+		kv->info.live_bytes -= slot->size * KV_ALIGN;
+	}
+
+	if (hdr->flags & KV_REC_FLAG_DELETED) {
+		if (found) {
+			slot_remove(kv, idx);
+			kv->info.records -= 1;
+		}
+
+		return 0;
+	}
+
+	if (!found) {
+		if (KV_MAX_RECORDS == kv->info.records) {
+			LOG_ERR("Index is full");
+			return -ENOSPC;
+		}
+
+		kv->info.records += 1;
+	}
+
+	slot->hash = hash;
+	slot->lnum = lnum;
+	slot->offset = offset / KV_ALIGN;
+	slot->size = size / KV_ALIGN;
+
+	kv->leb_live[lnum] += size;
+	kv->info.live_bytes += size;
+
+	return 0;
+}
+
+static int rec_load(struct ubi_kv *kv, size_t lnum, size_t offset, size_t *size)
+{
+	__ASSERT_NO_MSG(kv);
+	__ASSERT_NO_MSG(size);
+
+	if (offset + KV_REC_HDR_SIZE > kv->leb_size)
+		return -ENODATA;
+
+	int ret = ubi_leb_read(kv->ubi, kv->vol_id, lnum, offset, kv->rec_buf, KV_REC_HDR_SIZE);
+
+	if (0 != ret) {
+		LOG_ERR("Record header read failure");
+		return ret;
+	}
+
+	const struct kv_rec_hdr *hdr = (const struct kv_rec_hdr *)kv->rec_buf;
+
+	if (KV_ERASED_WORD == hdr->magic)
+		return -ENODATA;
+
+	if (KV_REC_HDR_MAGIC != hdr->magic || 0 == hdr->key_len || hdr->key_len > KV_KEY_MAX_LEN ||
+	    hdr->val_len > KV_VAL_MAX_LEN)
+		return -EBADMSG;
+
+	const size_t data_len = hdr->key_len + hdr->val_len;
+	*size = ROUND_UP(KV_REC_HDR_SIZE + data_len, KV_ALIGN);
+
+	if (offset + *size > kv->leb_size)
+		return -EBADMSG;
+
+	ret = ubi_leb_read(kv->ubi, kv->vol_id, lnum, offset + KV_REC_HDR_SIZE,
+			   &kv->rec_buf[KV_REC_HDR_SIZE], data_len);
+
+	if (0 != ret) {
+		LOG_ERR("Record data read failure");
+		return ret;
+	}
+
+	uint32_t crc = crc32_ieee(kv->rec_buf, KV_REC_HDR_SIZE - sizeof(hdr->crc));
+	crc = crc32_ieee_update(crc, &kv->rec_buf[KV_REC_HDR_SIZE], data_len);
+
+	if (crc != hdr->crc)
+		return -EBADMSG;
+
+	return 0;
+}
+
+static size_t rec_build(struct ubi_kv *kv, const char *key, size_t key_len, const void *val,
+			size_t val_len)
+{
+	__ASSERT_NO_MSG(kv);
+	__ASSERT_NO_MSG(key);
+
+	const size_t size = ROUND_UP(KV_REC_HDR_SIZE + key_len + val_len, KV_ALIGN);
+	struct kv_rec_hdr *hdr = (struct kv_rec_hdr *)kv->rec_buf;
+
+	memset(kv->rec_buf, 0, size);
+	hdr->magic = KV_REC_HDR_MAGIC;
+	hdr->key_len = key_len;
+	hdr->flags = val ? 0 : KV_REC_FLAG_DELETED;
+	hdr->val_len = val_len;
+
+	memcpy(&kv->rec_buf[KV_REC_HDR_SIZE], key, key_len);
+
+	if (val && val_len > 0)
+		memcpy(&kv->rec_buf[KV_REC_HDR_SIZE + key_len], val, val_len);
+
+	hdr->crc = crc32_ieee(kv->rec_buf, KV_REC_HDR_SIZE - sizeof(hdr->crc));
+	hdr->crc = crc32_ieee_update(hdr->crc, &kv->rec_buf[KV_REC_HDR_SIZE], key_len + val_len);
+
+	return size;
+}
+
+static int rec_append(struct ubi_kv *kv, size_t size, size_t *lnum, size_t *offset)
+{
+	__ASSERT_NO_MSG(kv);
+	__ASSERT_NO_MSG(lnum);
+	__ASSERT_NO_MSG(offset);
+
+	int ret = room_ensure(kv, size);
+
+	if (0 != ret)
+		return ret;
+
+	ret = ubi_leb_write_offset(kv->ubi, kv->vol_id, kv->active_lnum, kv->active_wp,
+				   kv->rec_buf, size);
+
+	if (0 != ret) {
+		LOG_ERR("Record write failure");
+
+		/* Never program partially written space again */
+		kv->active_wp = kv->leb_size;
+		return ret;
+	}
+
+	*lnum = kv->active_lnum;
+	*offset = kv->active_wp;
+
+	kv->active_wp += size;
+	kv->info.appends += 1;
+
+	return 0;
+}
+
+static int room_ensure(struct ubi_kv *kv, size_t size)
+{
+	__ASSERT_NO_MSG(kv);
+
+	for (size_t n = 0;; ++n) {
+		if (kv->active_valid && kv->active_wp + size <= kv->leb_size)
+			return 0;
+
+		/* Last unmapped LEB is reserved for compaction */
+		if (kv->compacting || kv->info.free_lebs > 1)
+			return leb_open(kv);
+
+		if (n == kv->leb_count) {
+			LOG_ERR("Compaction does not release space");
+			return -ENOSPC;
+		}
+
+		int ret = leb_compact(kv);
+
+		if (0 != ret)
+			return ret;
+	}
+}
+
+static int leb_open(struct ubi_kv *kv)
+{
+	__ASSERT_NO_MSG(kv);
+
+	if (0 == kv->info.free_lebs) {
+		LOG_ERR("Lack of free LEBs");
+		return -ENOSPC;
+	}
+
+	size_t lnum = 0;
+
+	while (0 != kv->leb_seq[lnum])
+		lnum += 1;
+
+	struct kv_leb_hdr hdr = { 0 };
+	hdr.magic = KV_LEB_HDR_MAGIC;
+	hdr.seq = kv->seq_next;
+	hdr.hdr_crc = crc32_ieee((const uint8_t *)&hdr, sizeof(hdr) - sizeof(hdr.hdr_crc));
+
+	int ret = ubi_leb_write_offset(kv->ubi, kv->vol_id, lnum, 0, &hdr, sizeof(hdr));
+
+	if (0 != ret) {
+		LOG_ERR("LEB header write failure");
+		return ret;
+	}
+
+	kv->leb_seq[lnum] = kv->seq_next++;
+	kv->leb_live[lnum] = 0;
+	kv->info.free_lebs -= 1;
+
+	kv->active_valid = true;
+	kv->active_lnum = lnum;
+	kv->active_wp = KV_LEB_HDR_SIZE;
+
+	return 0;
+}
+
+static int leb_compact(struct ubi_kv *kv)
+{
+	__ASSERT_NO_MSG(kv);
+
+	/* Oldest LEB is compacted, deletion records only hide records of LEBs already unmapped */
+	size_t victim = kv->leb_count;
+
+	for (size_t lnum = 0; lnum < kv->leb_count; ++lnum) {
+		if (0 == kv->leb_seq[lnum] || (kv->active_valid && lnum == kv->active_lnum))
+			continue;
+
+		if (victim == kv->leb_count || kv->leb_seq[lnum] < kv->leb_seq[victim])
+			victim = lnum;
+	}
+
+	if (victim == kv->leb_count) {
+		LOG_ERR("No LEB to compact");
+		return -ENOSPC;
+	}
+
+	int ret = 0;
+	size_t offset = KV_LEB_HDR_SIZE;
+
+	kv->compacting = true;
+
+	while (kv->leb_live[victim] > 0) {
+		size_t size = 0;
+		ret = rec_load(kv, victim, offset, &size);
+
+		if (-ENODATA == ret || -EBADMSG == ret) {
+			ret = 0;
+			break;
+		}
+
+		if (0 != ret)
+			goto exit;
+
+		const struct kv_rec_hdr *hdr = (const struct kv_rec_hdr *)kv->rec_buf;
+		const char *key = (const char *)&kv->rec_buf[KV_REC_HDR_SIZE];
+		const size_t key_len = hdr->key_len;
+
+		size_t idx = 0;
+		bool found = false;
+
+		if (0 == (hdr->flags & KV_REC_FLAG_DELETED)) {
+			ret = slot_find(kv, key, key_len, kv_hash(key, key_len), &idx, &found);
+
+			if (0 != ret)
+				goto exit;
+		}
+
+		if (found && victim == kv->slots[idx].lnum &&
+		    offset / KV_ALIGN == kv->slots[idx].offset) {
+			size_t lnum = 0;
+			size_t new_offset = 0;
+			ret = rec_append(kv, size, &lnum, &new_offset);
+
+			if (0 != ret)
+				goto exit;
+
+			kv->slots[idx].lnum = lnum;
+			kv->slots[idx].offset = new_offset / KV_ALIGN;
+			kv->leb_live[victim] -= size;
+			kv->leb_live[lnum] += size;
+		}
+
+		offset += size;
+	}
+
+	ret = ubi_leb_unmap(kv->ubi, kv->vol_id, victim);
+
+	if (0 != ret) {
+		LOG_ERR("LEB unmap failure");
+		goto exit;
+	}
+
+	kv->leb_seq[victim] = 0;
+	kv->leb_live[victim] = 0;
+	kv->info.free_lebs += 1;
+	kv->info.compactions += 1;
+
+exit:
+	kv->compacting = false;
+	return ret;
+}
+
+static int leb_scan(struct ubi_kv *kv, size_t lnum, size_t *end)
+{
+	__ASSERT_NO_MSG(kv);
+	__ASSERT_NO_MSG(end);
+
+	size_t offset = KV_LEB_HDR_SIZE;
+
+	for (;;) {
+		size_t size = 0;
+		int ret = rec_load(kv, lnum, offset, &size);
+
+		if (-ENODATA == ret)
+			break;
+
+		if (-EBADMSG == ret) {
+			/* Interrupted write, remaining space cannot be programmed again */
+			LOG_WRN("Corrupted record in LEB %zu at %zu", lnum, offset);
+			offset = kv->leb_size;
+			break;
+		}
+
+		if (0 != ret)
+			return ret;
+
+		const struct kv_rec_hdr *hdr = (const struct kv_rec_hdr *)kv->rec_buf;
+		ret = index_update(kv, hdr, (const char *)&kv->rec_buf[KV_REC_HDR_SIZE], lnum,
+				   offset);
+
+		if (0 != ret)
+			return ret;
+
+		offset += size;
+	}
+
+	*end = offset;
+	return 0;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_kv_mount(struct ubi_device *ubi, int vol_id, struct ubi_kv **kv)
+{
+	int ret = -EIO;
+
+	if (!ubi || vol_id < 0 || !kv)
+		return -EINVAL;
+
+	struct ubi_device_info dev_info = { 0 };
+	ret = ubi_device_get_info(ubi, &dev_info);
+
+	if (0 != ret) {
+		LOG_ERR("Device get info failure");
+		return ret;
+	}
+
+	struct ubi_volume_config vol_cfg = { 0 };
+	size_t alloc_lebs = 0;
+	ret = ubi_volume_get_info(ubi, vol_id, &vol_cfg, &alloc_lebs);
+
+	if (0 != ret) {
+		LOG_ERR("Volume get info failure");
+		return ret;
+	}
+
+	/* Compaction drops deletion records, unmap of their older records has to survive reboot */
+	if (UBI_VOLUME_TYPE_DYNAMIC != vol_cfg.type || !vol_cfg.durable_unmap ||
+	    vol_cfg.leb_count < 2 || dev_info.leb_size < KV_LEB_HDR_SIZE + 2 * KV_REC_MAX_SIZE) {
+		LOG_ERR("Volume is not suitable for key-value store");
+		return -EINVAL;
+	}
+
+	/* Index slots keep LEB number and offset in 16 bits, LEB number UINT16_MAX marks empty */
+	if (vol_cfg.leb_count > KV_SLOT_EMPTY || dev_info.leb_size / KV_ALIGN > UINT16_MAX) {
+		LOG_ERR("Volume is too large for key-value store index");
+		return -EINVAL;
+	}
+
+	struct ubi_kv *store = k_malloc(sizeof(*store));
+
+	if (!store) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(store, 0, sizeof(*store));
+	k_mutex_init(&store->mutex);
+	store->ubi = ubi;
+	store->vol_id = vol_id;
+	store->leb_size = dev_info.leb_size;
+	store->leb_count = vol_cfg.leb_count;
+	store->capacity = (vol_cfg.leb_count - 1) *
+			  (dev_info.leb_size - KV_LEB_HDR_SIZE - KV_REC_MAX_SIZE);
+	store->seq_next = 1;
+
+	size_t nr_of_slots = 1;
+
+	while (nr_of_slots < 2 * KV_MAX_RECORDS)
+		nr_of_slots <<= 1;
+
+	store->slots_mask = nr_of_slots - 1;
+
+	store->slots = k_malloc(nr_of_slots * sizeof(*store->slots));
+	store->leb_seq = k_malloc(vol_cfg.leb_count * sizeof(*store->leb_seq));
+	store->leb_live = k_malloc(vol_cfg.leb_count * sizeof(*store->leb_live));
+
+	if (!store->slots || !store->leb_seq || !store->leb_live) {
+		LOG_ERR("Heap allocation failure");
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	for (size_t i = 0; i < nr_of_slots; ++i)
+		store->slots[i].lnum = KV_SLOT_EMPTY;
+
+	memset(store->leb_seq, 0, vol_cfg.leb_count * sizeof(*store->leb_seq));
+	memset(store->leb_live, 0, vol_cfg.leb_count * sizeof(*store->leb_live));
+
+	/* 1. Read LEB headers, drop LEBs mapped without a valid header */
+	size_t nr_of_mapped = 0;
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		bool is_mapped = false;
+		ret = ubi_leb_is_mapped(ubi, vol_id, lnum, &is_mapped);
+
+		if (0 != ret) {
+			LOG_ERR("LEB map check failure");
+			goto exit;
+		}
+
+		if (!is_mapped) {
+			store->info.free_lebs += 1;
+			continue;
+		}
+
+		struct kv_leb_hdr hdr = { 0 };
+		ret = ubi_leb_read(ubi, vol_id, lnum, 0, &hdr, sizeof(hdr));
+
+		if (0 != ret) {
+			LOG_ERR("LEB header read failure");
+			goto exit;
+		}
+
+		const uint32_t crc =
+			crc32_ieee((const uint8_t *)&hdr, sizeof(hdr) - sizeof(hdr.hdr_crc));
+
+		if (KV_LEB_HDR_MAGIC != hdr.magic || crc != hdr.hdr_crc || 0 == hdr.seq) {
+			ret = ubi_leb_unmap(ubi, vol_id, lnum);
+
+			if (0 != ret) {
+				LOG_ERR("LEB unmap failure");
+				goto exit;
+			}
+
+			store->info.free_lebs += 1;
+			continue;
+		}
+
+		store->leb_seq[lnum] = hdr.seq;
+		store->seq_next = MAX(store->seq_next, hdr.seq + 1);
+		nr_of_mapped += 1;
+	}
+
+	/* 2. Replay LEBs from the oldest to the newest one */
+	uint32_t last_seq = 0;
+
+	for (size_t n = 0; n < nr_of_mapped; ++n) {
+		size_t lnum = vol_cfg.leb_count;
+
+		for (size_t i = 0; i < vol_cfg.leb_count; ++i) {
+			if (store->leb_seq[i] <= last_seq)
+				continue;
+
+			if (lnum == vol_cfg.leb_count || store->leb_seq[i] < store->leb_seq[lnum])
+				lnum = i;
+		}
+
+		size_t end = 0;
+		ret = leb_scan(store, lnum, &end);
+
+		if (0 != ret) {
+			LOG_ERR("LEB scan failure");
+			goto exit;
+		}
+
+		last_seq = store->leb_seq[lnum];
+		store->active_valid = true;
+		store->active_lnum = lnum;
+		store->active_wp = end;
+	}
+
+	*kv = store;
+	return 0;
+
+exit:
+	k_free(store->leb_live);
+	k_free(store->leb_seq);
+	k_free(store->slots);
+	k_free(store);
+	return ret;
+}
+
+int ubi_kv_write(struct ubi_kv *kv, const char *key, const void *val, size_t len)
+{
+	if (!kv || !key || (!val && len > 0) || len > KV_VAL_MAX_LEN)
+		return -EINVAL;
+
+	const size_t key_len = strnlen(key, KV_KEY_MAX_LEN + 1);
+
+	if (0 == key_len || key_len > KV_KEY_MAX_LEN)
+		return -EINVAL;
+
+	/* Zero length value must still differ from a deletion record */
+	static const uint8_t empty;
+	const void *data = val ? val : &empty;
+
+	k_mutex_lock(&kv->mutex, K_FOREVER);
+
+	int ret = -EIO;
+	const uint32_t hash = kv_hash(key, key_len);
+	const size_t size = ROUND_UP(KV_REC_HDR_SIZE + key_len + len, KV_ALIGN);
+
+	size_t idx = 0;
+	bool found = false;
+	ret = slot_find(kv, key, key_len, hash, &idx, &found);
+
+	if (0 != ret)
+		goto exit;
+
+	if (!found && KV_MAX_RECORDS == kv->info.records) {
+		LOG_ERR("Index is full");
+		ret = -ENOSPC;
+		goto exit;
+	}
+
+	const size_t old_size = found ? kv->slots[idx].size * KV_ALIGN : 0;
+
+	if (kv->info.live_bytes - old_size + size > kv->capacity) {
+		LOG_ERR("Store is full");
+		ret = -ENOSPC;
+		goto exit;
+	}
+
+	/* Compaction may reuse staging buffer, so record is built afterwards */
+	ret = room_ensure(kv, size);
+
+	if (0 != ret)
+		goto exit;
+
+	rec_build(kv, key, key_len, data, len);
+
+	size_t lnum = 0;
+	size_t offset = 0;
+	ret = rec_append(kv, size, &lnum, &offset);
+
+	if (0 != ret)
+		goto exit;
+
+	ret = index_update(kv, (const struct kv_rec_hdr *)kv->rec_buf, key, lnum, offset);
+
+exit:
+	k_mutex_unlock(&kv->mutex);
+	return ret;
+}
+
+int ubi_kv_read(struct ubi_kv *kv, const char *key, void *buf, size_t size, size_t *len)
+{
+	if (!kv || !key || (!buf && size > 0) || !len)
+		return -EINVAL;
+
+	const size_t key_len = strnlen(key, KV_KEY_MAX_LEN + 1);
+
+	if (0 == key_len || key_len > KV_KEY_MAX_LEN)
+		return -EINVAL;
+
+	k_mutex_lock(&kv->mutex, K_FOREVER);
+
+	size_t idx = 0;
+	bool found = false;
+	int ret = slot_find(kv, key, key_len, kv_hash(key, key_len), &idx, &found);
+
+	if (0 != ret)
+		goto exit;
+
+	if (!found) {
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	/* Key buffer holds header of matched record */
+	const struct kv_rec_hdr *hdr = (const struct kv_rec_hdr *)kv->key_buf;
+	const size_t rlen = MIN(size, hdr->val_len);
+
+	*len = hdr->val_len;
+
+	if (rlen > 0) {
+		ret = ubi_leb_read(kv->ubi, kv->vol_id, kv->slots[idx].lnum,
+				   kv->slots[idx].offset * KV_ALIGN + KV_REC_HDR_SIZE + key_len, buf,
+				   rlen);
+
+		if (0 != ret) {
+			LOG_ERR("Record value read failure");
+			goto exit;
+		}
+	}
+
+exit:
+	k_mutex_unlock(&kv->mutex);
+	return ret;
+}
+
+int ubi_kv_delete(struct ubi_kv *kv, const char *key)
+{
+	if (!kv || !key)
+		return -EINVAL;
+
+	const size_t key_len = strnlen(key, KV_KEY_MAX_LEN + 1);
+
+	if (0 == key_len || key_len > KV_KEY_MAX_LEN)
+		return -EINVAL;
+
+	k_mutex_lock(&kv->mutex, K_FOREVER);
+
+	size_t idx = 0;
+	bool found = false;
+	int ret = slot_find(kv, key, key_len, kv_hash(key, key_len), &idx, &found);
+
+	if (0 != ret)
+		goto exit;
+
+	if (!found) {
+		ret = -ENOENT;
+		goto exit;
+	}
+
+	const size_t size = ROUND_UP(KV_REC_HDR_SIZE + key_len, KV_ALIGN);
+	ret = room_ensure(kv, size);
+
+	if (0 != ret)
+		goto exit;
+
+	rec_build(kv, key, key_len, NULL, 0);
+
+	size_t lnum = 0;
+	size_t offset = 0;
+	ret = rec_append(kv, size, &lnum, &offset);
+
+	if (0 != ret)
+		goto exit;
+
+	ret = index_update(kv, (const struct kv_rec_hdr *)kv->rec_buf, key, lnum, offset);
+
+exit:
+	k_mutex_unlock(&kv->mutex);
+	return ret;
+}
+
+int ubi_kv_foreach(struct ubi_kv *kv, ubi_kv_foreach_cb cb, void *arg)
+{
+	if (!kv || !cb)
+		return -EINVAL;
+
+	k_mutex_lock(&kv->mutex, K_FOREVER);
+
+	int ret = 0;
+	char key[KV_KEY_MAX_LEN + 1] = { 0 };
+
+	for (size_t i = 0; i <= kv->slots_mask; ++i) {
+		const struct kv_slot *slot = &kv->slots[i];
+
+		if (KV_SLOT_EMPTY == slot->lnum)
+			continue;
+
+		const size_t len = MIN(sizeof(kv->key_buf), slot->size * KV_ALIGN);
+		ret = ubi_leb_read(kv->ubi, kv->vol_id, slot->lnum, slot->offset * KV_ALIGN,
+				   kv->key_buf, len);
+
+		if (0 != ret) {
+			LOG_ERR("Record key read failure");
+			goto exit;
+		}
+
+		const struct kv_rec_hdr *hdr = (const struct kv_rec_hdr *)kv->key_buf;
+		const size_t val_len = hdr->val_len;
+
+		memcpy(key, &kv->key_buf[KV_REC_HDR_SIZE], hdr->key_len);
+		key[hdr->key_len] = '\0';
+
+		if (0 != cb(key, val_len, arg))
+			break;
+	}
+
+exit:
+	k_mutex_unlock(&kv->mutex);
+	return ret;
+}
+
+int ubi_kv_get_info(struct ubi_kv *kv, struct ubi_kv_info *info)
+{
+	if (!kv || !info)
+		return -EINVAL;
+
+	k_mutex_lock(&kv->mutex, K_FOREVER);
+	*info = kv->info;
+	k_mutex_unlock(&kv->mutex);
+
+	return 0;
+}
+
+int ubi_kv_unmount(struct ubi_kv *kv)
+{
+	if (!kv)
+		return -EINVAL;
+
+	k_free(kv->leb_live);
+	k_free(kv->leb_seq);
+	k_free(kv->slots);
+	k_free(kv);
+
+	return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * \file    ubi_kv_settings.c
+ * \author  Kamil Kielbasa
+ * \brief   Zephyr settings backend on top of UBI key-value store.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi_kv.h"
+
+/* Zephyr headers: */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/__assert.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+LOG_MODULE_REGISTER(ubi_kv_settings, CONFIG_UBI_LOG_LEVEL);
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief Context of a single settings load.
+ */
+struct kv_settings_load_ctx {
+	const struct settings_load_arg *arg; /**< Settings load argument. */
+	int ret; /**< First error reported by a settings handler. */
+};
+
+/**
+ * \brief Context of a single value read requested by a settings handler.
+ */
+struct kv_settings_read_ctx {
+	const char *key; /**< Key of value to read. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+
+static struct ubi_kv *kv_settings_kv = NULL;
+static bool kv_settings_registered = false;
+
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief Read value of a record for a settings handler.
+ *
+ * \param[in] cb_arg 	Pointer to read context.
+ * \param[out] data 	Output buffer.
+ * \param len 		Size of \p data in bytes.
+ *
+ * \return Number of bytes read, or negative error code.
+ */
+static ssize_t kv_settings_read_cb(void *cb_arg, void *data, size_t len);
+
+/**
+ * \brief Pass a single record to matching settings handler.
+ *
+ * \param[in] key 	Record key.
+ * \param val_len 	Length of record value in bytes.
+ * \param[in] arg 	Pointer to load context.
+ *
+ * \return 0 to continue iteration.
+ */
+static int kv_settings_load_cb(const char *key, size_t val_len, void *arg);
+
+static int kv_settings_load(struct settings_store *cs, const struct settings_load_arg *arg);
+static int kv_settings_save(struct settings_store *cs, const char *name, const char *value,
+			    size_t val_len);
+
+static const struct settings_store_itf kv_settings_itf = {
+	.csi_load = kv_settings_load,
+	.csi_save = kv_settings_save,
+};
+
+static struct settings_store kv_settings_store = {
+	.cs_itf = &kv_settings_itf,
+};
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static ssize_t kv_settings_read_cb(void *cb_arg, void *data, size_t len)
+{
+	const struct kv_settings_read_ctx *ctx = cb_arg;
+	size_t val_len = 0;
+
+	int ret = ubi_kv_read(kv_settings_kv, ctx->key, data, len, &val_len);
+
+	if (0 != ret)
+		return ret;
+
+	return MIN(len, val_len);
+}
+
+static int kv_settings_load_cb(const char *key, size_t val_len, void *arg)
+{
+	struct kv_settings_load_ctx *ctx = arg;
+
+	if (ctx->arg && ctx->arg->subtree && !settings_name_steq(key, ctx->arg->subtree, NULL))
+		return 0;
+
+	struct kv_settings_read_ctx read_ctx = { .key = key };
+	int ret = settings_call_set_handler(key, val_len, kv_settings_read_cb, &read_ctx, ctx->arg);
+
+	if (0 != ret && 0 == ctx->ret)
+		ctx->ret = ret;
+
+	return 0;
+}
+
+static int kv_settings_load(struct settings_store *cs, const struct settings_load_arg *arg)
+{
+	ARG_UNUSED(cs);
+
+	if (!kv_settings_kv)
+		return -ENODEV;
+
+	struct kv_settings_load_ctx ctx = { .arg = arg };
+	int ret = ubi_kv_foreach(kv_settings_kv, kv_settings_load_cb, &ctx);
+
+	if (0 != ret) {
+		LOG_ERR("Key-value store iteration failure");
+		return ret;
+	}
+
+	return ctx.ret;
+}
+
+static int kv_settings_save(struct settings_store *cs, const char *name, const char *value,
+			    size_t val_len)
+{
+	ARG_UNUSED(cs);
+
+	if (!kv_settings_kv)
+		return -ENODEV;
+
+	if (!name)
+		return -EINVAL;
+
+	/* Settings deletes an entry by saving an empty value */
+	if (!value || 0 == val_len) {
+		int ret = ubi_kv_delete(kv_settings_kv, name);
+		return (-ENOENT == ret) ? 0 : ret;
+	}
+
+	return ubi_kv_write(kv_settings_kv, name, value, val_len);
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_kv_settings_register(struct ubi_kv *kv)
+{
+	kv_settings_kv = kv;
+
+	if (!kv_settings_registered) {
+		settings_src_register(&kv_settings_store);
+		settings_dst_register(&kv_settings_store);
+		kv_settings_registered = true;
+	}
+
+	return 0;
+}
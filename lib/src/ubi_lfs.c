@@ -0,0 +1,253 @@
+/**
+ * \file    ubi_lfs.c
+ * \author  Kamil Kielbasa
+ * \brief   Unsorted Block Images (UBI) LittleFS block device adapter implementation.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi.h"
+#include "ubi_lfs.h"
+#include "ubi_utils.h"
+
+/* Zephyr headers: */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/util.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define LFS_CACHE_SIZE (CONFIG_UBI_LFS_CACHE_SIZE)
+#define LFS_LOOKAHEAD_SIZE (CONFIG_UBI_LFS_LOOKAHEAD_SIZE)
+
+BUILD_ASSERT(LFS_CACHE_SIZE % WRITE_BLOCK_SIZE_ALIGNMENT == 0);
+BUILD_ASSERT(LFS_LOOKAHEAD_SIZE % 8 == 0);
+
+LOG_MODULE_REGISTER(ubi_lfs, CONFIG_UBI_LOG_LEVEL);
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief UBI LittleFS adapter representation.
+ *
+ * This structure binds a LittleFS configuration with a UBI volume and owns
+ * the LittleFS cache buffers.
+ */
+struct ubi_lfs {
+	struct lfs_config cfg; /**< LittleFS configuration. */
+
+	struct ubi_device *ubi; /**< Underlying UBI device. */
+	int vol_id; /**< Backing volume identifier. */
+
+	uint8_t read_buf[LFS_CACHE_SIZE]; /**< LittleFS read cache. */
+	uint8_t prog_buf[LFS_CACHE_SIZE]; /**< LittleFS program cache. */
+	uint8_t lookahead_buf[LFS_LOOKAHEAD_SIZE]; /**< LittleFS lookahead buffer. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief Convert UBI error code into LittleFS error code.
+ *
+ * \param err 		UBI negative error code.
+ *
+ * \return LittleFS error code.
+ */
+static int lfs_err(int err);
+
+static int lfs_ubi_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+			void *buffer, lfs_size_t size);
+static int lfs_ubi_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+			const void *buffer, lfs_size_t size);
+static int lfs_ubi_erase(const struct lfs_config *c, lfs_block_t block);
+static int lfs_ubi_sync(const struct lfs_config *c);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static int lfs_err(int err)
+{
+	switch (err) {
+	case 0:
+		return LFS_ERR_OK;
+	case -ENOSPC:
+		return LFS_ERR_NOSPC;
+	case -ENOMEM:
+		return LFS_ERR_NOMEM;
+	case -EINVAL:
+		return LFS_ERR_INVAL;
+	default:
+		return LFS_ERR_IO;
+	}
+}
+
+static int lfs_ubi_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+			void *buffer, lfs_size_t size)
+{
+	struct ubi_lfs *ctx = c->context;
+
+	bool is_mapped = false;
+	int ret = ubi_leb_is_mapped(ctx->ubi, ctx->vol_id, block, &is_mapped);
+
+	if (0 != ret) {
+		LOG_ERR("LEB map check failure");
+		return lfs_err(ret);
+	}
+
+	/* Unmapped LEBs read as erased flash */
+	if (!is_mapped) {
+		memset(buffer, 0xff, size);
+		return LFS_ERR_OK;
+	}
+
+	ret = ubi_leb_read(ctx->ubi, ctx->vol_id, block, off, buffer, size);
+
+	if (0 != ret)
+		LOG_ERR("LEB read failure");
+
+	return lfs_err(ret);
+}
+
+static int lfs_ubi_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+			const void *buffer, lfs_size_t size)
+{
+	struct ubi_lfs *ctx = c->context;
+
+	int ret = ubi_leb_write_offset(ctx->ubi, ctx->vol_id, block, off, buffer, size);
+
+	if (0 != ret)
+		LOG_ERR("LEB write failure");
+
+	return lfs_err(ret);
+}
+
+static int lfs_ubi_erase(const struct lfs_config *c, lfs_block_t block)
+{
+	struct ubi_lfs *ctx = c->context;
+
+	bool is_mapped = false;
+	int ret = ubi_leb_is_mapped(ctx->ubi, ctx->vol_id, block, &is_mapped);
+
+	if (0 != ret) {
+		LOG_ERR("LEB map check failure");
+		return lfs_err(ret);
+	}
+
+	/* Erased state is provided by the next lazy map */
+	if (!is_mapped)
+		return LFS_ERR_OK;
+
+	ret = ubi_leb_unmap(ctx->ubi, ctx->vol_id, block);
+
+	if (0 != ret)
+		LOG_ERR("LEB unmap failure");
+
+	return lfs_err(ret);
+}
+
+static int lfs_ubi_sync(const struct lfs_config *c)
+{
+	ARG_UNUSED(c);
+
+	/* Programs are written through to flash */
+	return LFS_ERR_OK;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_lfs_create(struct ubi_device *ubi, int vol_id, struct ubi_lfs **ctx)
+{
+	int ret = -EIO;
+
+	if (!ubi || vol_id < 0 || !ctx)
+		return -EINVAL;
+
+	struct ubi_device_info dev_info = { 0 };
+	ret = ubi_device_get_info(ubi, &dev_info);
+
+	if (0 != ret) {
+		LOG_ERR("Device get info failure");
+		return ret;
+	}
+
+	struct ubi_volume_config vol_cfg = { 0 };
+	size_t alloc_lebs = 0;
+	ret = ubi_volume_get_info(ubi, vol_id, &vol_cfg, &alloc_lebs);
+
+	if (0 != ret) {
+		LOG_ERR("Volume get info failure");
+		return ret;
+	}
+
+	const size_t block_size = ROUND_DOWN(dev_info.leb_size, LFS_CACHE_SIZE);
+
+	if (0 == block_size) {
+		LOG_ERR("Cache size exceeds LEB size");
+		return -EINVAL;
+	}
+
+	struct ubi_lfs *lfs = k_malloc(sizeof(*lfs));
+
+	if (!lfs) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(lfs, 0, sizeof(*lfs));
+	lfs->ubi = ubi;
+	lfs->vol_id = vol_id;
+
+	lfs->cfg.context = lfs;
+	lfs->cfg.read = lfs_ubi_read;
+	lfs->cfg.prog = lfs_ubi_prog;
+	lfs->cfg.erase = lfs_ubi_erase;
+	lfs->cfg.sync = lfs_ubi_sync;
+
+	lfs->cfg.read_size = WRITE_BLOCK_SIZE_ALIGNMENT;
+	lfs->cfg.prog_size = WRITE_BLOCK_SIZE_ALIGNMENT;
+	lfs->cfg.block_size = block_size;
+	lfs->cfg.block_count = vol_cfg.leb_count;
+	lfs->cfg.block_cycles = -1;
+	lfs->cfg.cache_size = LFS_CACHE_SIZE;
+	lfs->cfg.lookahead_size = LFS_LOOKAHEAD_SIZE;
+
+	lfs->cfg.read_buffer = lfs->read_buf;
+	lfs->cfg.prog_buffer = lfs->prog_buf;
+	lfs->cfg.lookahead_buffer = lfs->lookahead_buf;
+
+	*ctx = lfs;
+	return 0;
+}
+
+const struct lfs_config *ubi_lfs_get_config(struct ubi_lfs *ctx)
+{
+	if (!ctx)
+		return NULL;
+
+	return &ctx->cfg;
+}
+
+int ubi_lfs_destroy(struct ubi_lfs *ctx)
+{
+	if (!ctx)
+		return -EINVAL;
+
+	k_free(ctx);
+
+	return 0;
+}
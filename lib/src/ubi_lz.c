@@ -0,0 +1,446 @@
+/**
+ * \file    ubi_lz.c
+ * \author  Kamil Kielbasa
+ * \brief   Unsorted Block Images (UBI) LEB data compression.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi_lz.h"
+#include "ubi_utils.h"
+
+/* Zephyr headers: */
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/util.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define LZ_MIN_MATCH (4)
+#define LZ_RUN_MASK (15)
+#define LZ_HASH_BITS (8)
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+#define LZ_ERASED_VAL (0xFF)
+
+BUILD_ASSERT(0 == UBI_LZ_CHUNK_SIZE % WRITE_BLOCK_SIZE_ALIGNMENT);
+BUILD_ASSERT(0 == (UBI_LZ_WINDOW_SIZE & (UBI_LZ_WINDOW_SIZE - 1)));
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief Output side of compression.
+ */
+struct lz_encoder {
+	uint8_t chunk[UBI_LZ_CHUNK_SIZE]; /**< Compressed bytes not yet passed to the sink. */
+	size_t fill; /**< Number of bytes in the chunk. */
+	size_t total; /**< Number of compressed bytes produced. */
+	size_t max_len; /**< Largest acceptable number of compressed bytes. */
+	ubi_lz_write_t write; /**< Sink of compressed chunks, NULL to count only. */
+	void *ctx; /**< Context passed to the sink. */
+};
+
+/**
+ * \brief State of streaming decompression.
+ */
+struct lz_decoder {
+	uint8_t window[UBI_LZ_WINDOW_SIZE]; /**< Most recent decompressed bytes. */
+	uint8_t chunk[UBI_LZ_CHUNK_SIZE]; /**< Compressed bytes read ahead. */
+	size_t chunk_pos; /**< Position of next byte in the chunk. */
+	size_t chunk_fill; /**< Number of bytes in the chunk. */
+	size_t in_pos; /**< Offset of the next chunk within compressed data. */
+	size_t in_len; /**< Size of compressed data. */
+	ubi_lz_read_t read; /**< Source of compressed data. */
+	void *ctx; /**< Context passed to the source. */
+	size_t pos; /**< Number of bytes decompressed so far. */
+	size_t end; /**< Decompression stops at this position. */
+	size_t offset; /**< Position of the first byte copied out. */
+	uint8_t *dst; /**< Output buffer of the requested range. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief Hash four bytes of input.
+ *
+ * \param[in] src 	Pointer to the bytes.
+ *
+ * \return Index to the hash table.
+ */
+static uint32_t lz_hash(const uint8_t *src);
+
+/**
+ * \brief Append one byte of compressed data, pass full chunks to the sink.
+ *
+ * \param[in] enc 	Pointer to the encoder.
+ * \param byte 		Byte to append.
+ *
+ * \return 0 on success, -EFBIG if size limit is exceeded, or negative error code of the sink.
+ */
+static int encoder_put(struct lz_encoder *enc, uint8_t byte);
+
+/**
+ * \brief Append remainder of a run length above the token field.
+ *
+ * \param[in] enc 	Pointer to the encoder.
+ * \param len 		Remainder of the run length.
+ *
+ * \return 0 on success, or negative error code.
+ */
+static int encoder_put_length(struct lz_encoder *enc, size_t len);
+
+/**
+ * \brief Append one sequence of literals followed by an optional match.
+ *
+ * \param[in] enc 	Pointer to the encoder.
+ * \param[in] lit 	Pointer to the literals.
+ * \param lit_len 	Number of literals.
+ * \param dist 		Distance of the match.
+ * \param match_len 	Length of the match, 0 for the last sequence.
+ *
+ * \return 0 on success, or negative error code.
+ */
+static int encoder_sequence(struct lz_encoder *enc, const uint8_t *lit, size_t lit_len,
+			    size_t dist, size_t match_len);
+
+/**
+ * \brief Pad the last chunk to write block size and pass it to the sink.
+ *
+ * \param[in] enc 	Pointer to the encoder.
+ *
+ * \return 0 on success, or negative error code.
+ */
+static int encoder_flush(struct lz_encoder *enc);
+
+/**
+ * \brief Take next byte of compressed data, read ahead a chunk when needed.
+ *
+ * \param[in] dec 	Pointer to the decoder.
+ * \param[out] byte 	Next compressed byte.
+ *
+ * \return 0 on success, -EBADMSG at end of compressed data, or negative error code.
+ */
+static int decoder_get(struct lz_decoder *dec, uint8_t *byte);
+
+/**
+ * \brief Take remainder of a run length above the token field.
+ *
+ * \param[in] dec 	Pointer to the decoder.
+ * \param[in,out] len 	Run length to extend.
+ *
+ * \return 0 on success, or negative error code.
+ */
+static int decoder_get_length(struct lz_decoder *dec, size_t *len);
+
+/**
+ * \brief Produce one decompressed byte.
+ *
+ * \param[in] dec 	Pointer to the decoder.
+ * \param byte 		Decompressed byte.
+ */
+static void decoder_emit(struct lz_decoder *dec, uint8_t byte);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static uint32_t lz_hash(const uint8_t *src)
+{
+	__ASSERT_NO_MSG(src);
+
+	uint32_t val = 0;
+	memcpy(&val, src, sizeof(val));
+
+	return (val * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static int encoder_put(struct lz_encoder *enc, uint8_t byte)
+{
+	__ASSERT_NO_MSG(enc);
+
+	if (enc->total >= enc->max_len)
+		return -EFBIG;
+
+	enc->chunk[enc->fill++] = byte;
+	enc->total += 1;
+
+	if (enc->fill < UBI_LZ_CHUNK_SIZE)
+		return 0;
+
+	enc->fill = 0;
+
+	if (!enc->write)
+		return 0;
+
+	return enc->write(enc->ctx, enc->total - UBI_LZ_CHUNK_SIZE, enc->chunk, UBI_LZ_CHUNK_SIZE);
+}
+
+static int encoder_put_length(struct lz_encoder *enc, size_t len)
+{
+	__ASSERT_NO_MSG(enc);
+
+	int ret = 0;
+
+	for (; len >= UINT8_MAX && 0 == ret; len -= UINT8_MAX)
+		ret = encoder_put(enc, UINT8_MAX);
+
+	if (0 != ret)
+		return ret;
+
+	return encoder_put(enc, len);
+}
+
+static int encoder_sequence(struct lz_encoder *enc, const uint8_t *lit, size_t lit_len,
+			    size_t dist, size_t match_len)
+{
+	__ASSERT_NO_MSG(enc);
+	__ASSERT_NO_MSG(lit || 0 == lit_len);
+	__ASSERT_NO_MSG(0 == match_len || match_len >= LZ_MIN_MATCH);
+
+	const size_t match_run = (match_len > 0) ? match_len - LZ_MIN_MATCH : 0;
+	const uint8_t token = (MIN(lit_len, LZ_RUN_MASK) << 4) | MIN(match_run, LZ_RUN_MASK);
+
+	int ret = encoder_put(enc, token);
+
+	if (0 == ret && lit_len >= LZ_RUN_MASK)
+		ret = encoder_put_length(enc, lit_len - LZ_RUN_MASK);
+
+	for (size_t i = 0; i < lit_len && 0 == ret; ++i)
+		ret = encoder_put(enc, lit[i]);
+
+	if (0 != ret || 0 == match_len)
+		return ret;
+
+	ret = encoder_put(enc, dist & 0xFF);
+
+	if (0 == ret)
+		ret = encoder_put(enc, dist >> 8);
+
+	if (0 == ret && match_run >= LZ_RUN_MASK)
+		ret = encoder_put_length(enc, match_run - LZ_RUN_MASK);
+
+	return ret;
+}
+
+static int encoder_flush(struct lz_encoder *enc)
+{
+	__ASSERT_NO_MSG(enc);
+
+	const size_t padded = ROUND_UP(enc->fill, WRITE_BLOCK_SIZE_ALIGNMENT);
+
+	if (enc->total - enc->fill + padded > enc->max_len)
+		return -EFBIG;
+
+	memset(&enc->chunk[enc->fill], LZ_ERASED_VAL, padded - enc->fill);
+	enc->total += padded - enc->fill;
+	enc->fill = 0;
+
+	if (!enc->write || 0 == padded)
+		return 0;
+
+	return enc->write(enc->ctx, enc->total - padded, enc->chunk, padded);
+}
+
+static int decoder_get(struct lz_decoder *dec, uint8_t *byte)
+{
+	__ASSERT_NO_MSG(dec);
+	__ASSERT_NO_MSG(byte);
+
+	if (dec->chunk_pos == dec->chunk_fill) {
+		const size_t len = MIN(UBI_LZ_CHUNK_SIZE, dec->in_len - dec->in_pos);
+
+		if (0 == len)
+			return -EBADMSG;
+
+		const int ret = dec->read(dec->ctx, dec->in_pos, dec->chunk, len);
+
+		if (0 != ret)
+			return ret;
+
+		dec->in_pos += len;
+		dec->chunk_pos = 0;
+		dec->chunk_fill = len;
+	}
+
+	*byte = dec->chunk[dec->chunk_pos++];
+	return 0;
+}
+
+static int decoder_get_length(struct lz_decoder *dec, size_t *len)
+{
+	__ASSERT_NO_MSG(dec);
+	__ASSERT_NO_MSG(len);
+
+	uint8_t byte = 0;
+	int ret = 0;
+
+	do {
+		ret = decoder_get(dec, &byte);
+		*len += byte;
+	} while (0 == ret && UINT8_MAX == byte);
+
+	return ret;
+}
+
+static void decoder_emit(struct lz_decoder *dec, uint8_t byte)
+{
+	__ASSERT_NO_MSG(dec);
+
+	dec->window[dec->pos & (UBI_LZ_WINDOW_SIZE - 1)] = byte;
+
+	if (dec->pos >= dec->offset)
+		dec->dst[dec->pos - dec->offset] = byte;
+
+	dec->pos += 1;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_lz_compress(const uint8_t *src, size_t len, size_t max_len, ubi_lz_write_t write,
+		    void *ctx, size_t *out_len)
+{
+	if ((!src && len > 0) || !out_len)
+		return -EINVAL;
+
+	struct lz_encoder enc = { .max_len = max_len, .write = write, .ctx = ctx };
+	uint16_t head[LZ_HASH_SIZE] = { 0 };
+	size_t anchor = 0;
+	size_t pos = 0;
+	int ret = 0;
+
+	/* Table keeps low half of positions, stale entries fail distance or content check */
+	while (pos + LZ_MIN_MATCH <= len) {
+		const uint32_t hash = lz_hash(&src[pos]);
+		const size_t dist = (uint16_t)(pos - head[hash]);
+		head[hash] = pos;
+
+		if (0 == dist || dist > UBI_LZ_WINDOW_SIZE || dist > pos ||
+		    0 != memcmp(&src[pos - dist], &src[pos], LZ_MIN_MATCH)) {
+			pos += 1;
+			continue;
+		}
+
+		size_t match_len = LZ_MIN_MATCH;
+
+		while (pos + match_len < len && src[pos - dist + match_len] == src[pos + match_len])
+			match_len += 1;
+
+		ret = encoder_sequence(&enc, &src[anchor], pos - anchor, dist, match_len);
+
+		if (0 != ret)
+			return ret;
+
+		/* Index matched bytes too, repeated records then match as a whole */
+		for (size_t i = pos + 1; i < pos + match_len && i + LZ_MIN_MATCH <= len; ++i)
+			head[lz_hash(&src[i])] = i;
+
+		pos += match_len;
+		anchor = pos;
+	}
+
+	ret = encoder_sequence(&enc, &src[anchor], len - anchor, 0, 0);
+
+	if (0 != ret)
+		return ret;
+
+	ret = encoder_flush(&enc);
+
+	if (0 != ret)
+		return ret;
+
+	*out_len = enc.total;
+	return 0;
+}
+
+int ubi_lz_decompress(ubi_lz_read_t read, void *ctx, size_t in_len, size_t data_len,
+		      size_t offset, uint8_t *dst, size_t size)
+{
+	if (!read || (!dst && size > 0))
+		return -EINVAL;
+
+	struct lz_decoder dec = {
+		.in_len = in_len,
+		.read = read,
+		.ctx = ctx,
+		.end = MIN(data_len, offset + size),
+		.offset = offset,
+		.dst = dst,
+	};
+	int ret = 0;
+
+	while (dec.pos < dec.end) {
+		uint8_t token = 0;
+		ret = decoder_get(&dec, &token);
+
+		if (0 != ret)
+			return ret;
+
+		size_t lit_len = token >> 4;
+
+		if (LZ_RUN_MASK == lit_len) {
+			ret = decoder_get_length(&dec, &lit_len);
+
+			if (0 != ret)
+				return ret;
+		}
+
+		for (; lit_len > 0 && dec.pos < dec.end; --lit_len) {
+			uint8_t byte = 0;
+			ret = decoder_get(&dec, &byte);
+
+			if (0 != ret)
+				return ret;
+
+			decoder_emit(&dec, byte);
+		}
+
+		if (dec.pos == dec.end)
+			break;
+
+		uint8_t dist_lo = 0;
+		uint8_t dist_hi = 0;
+		ret = decoder_get(&dec, &dist_lo);
+
+		if (0 == ret)
+			ret = decoder_get(&dec, &dist_hi);
+
+		if (0 != ret)
+			return ret;
+
+		const size_t dist = dist_lo | (dist_hi << 8);
+
+		if (0 == dist || dist > UBI_LZ_WINDOW_SIZE || dist > dec.pos)
+			return -EBADMSG;
+
+		size_t match_len = token & LZ_RUN_MASK;
+
+		if (LZ_RUN_MASK == match_len) {
+			ret = decoder_get_length(&dec, &match_len);
+
+			if (0 != ret)
+				return ret;
+		}
+
+		/* Byte by byte copy, so overlapping matches repeat their pattern */
+		for (match_len += LZ_MIN_MATCH; match_len > 0 && dec.pos < dec.end; --match_len)
+			decoder_emit(&dec, dec.window[(dec.pos - dist) & (UBI_LZ_WINDOW_SIZE - 1)]);
+	}
+
+	/* Range past end of data reads as erased flash */
+	if (offset + size > dec.end)
+		memset(&dst[MAX(dec.end, offset) - offset], LZ_ERASED_VAL,
+		       offset + size - MAX(dec.end, offset));
+
+	return 0;
+}
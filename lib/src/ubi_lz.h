@@ -0,0 +1,113 @@
+/**
+ * \file    ubi_lz.h
+ *
+ * \brief   Unsorted Block Images (UBI) LEB data compression.
+ *
+ * \author  Kamil Kielbasa
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ */
+
+/* Include guard ------------------------------------------------------------------------------- */
+#ifndef UBI_LZ_H
+#define UBI_LZ_H
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Standard library headers */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Defines ------------------------------------------------------------------------------------- */
+
+/**
+ * \def UBI_LZ_WINDOW_SIZE
+ * \brief Longest match distance, decompression keeps only this much history.
+ */
+#define UBI_LZ_WINDOW_SIZE (256)
+
+/**
+ * \def UBI_LZ_CHUNK_SIZE
+ * \brief Size of chunks compressed data is streamed in, a multiple of write block size.
+ */
+#define UBI_LZ_CHUNK_SIZE (64)
+
+/* Types and type definitions ------------------------------------------------------------------ */
+
+/**
+ * \brief Sink of compressed data.
+ *
+ * \param[in] ctx 		Caller context.
+ * \param offset 		Offset of the chunk within compressed data.
+ * \param[in] buf 		Chunk of compressed data.
+ * \param len 			Size of the chunk in bytes.
+ *
+ * \return 0 on success, or negative error code.
+ */
+typedef int (*ubi_lz_write_t)(void *ctx, size_t offset, const uint8_t *buf, size_t len);
+
+/**
+ * \brief Source of compressed data.
+ *
+ * \param[in] ctx 		Caller context.
+ * \param offset 		Offset within compressed data.
+ * \param[out] buf 		Output buffer.
+ * \param len 			Number of bytes to read.
+ *
+ * \return 0 on success, or negative error code.
+ */
+typedef int (*ubi_lz_read_t)(void *ctx, size_t offset, uint8_t *buf, size_t len);
+
+/* Module interface function declarations ------------------------------------------------------ */
+
+/**
+ * \defgroup ubi_lz LEB Data Compression
+ * \brief Functions to compress LEB data and decompress any range of it.
+ *
+ * Data is encoded in LZ4 block format with match distance limited to \ref UBI_LZ_WINDOW_SIZE,
+ * so neither direction needs a buffer of LEB size. Compressed data is padded with erased bytes
+ * to write block size.
+ * \{
+ */
+
+/**
+ * \brief Compress data and stream it to a sink.
+ *
+ * \param[in] src 		Data to compress.
+ * \param len 			Size of the data in bytes.
+ * \param max_len 		Largest acceptable size of compressed data, padding included.
+ * \param write 		Sink of compressed chunks, NULL to compute size only.
+ * \param[in] ctx 		Context passed to the sink.
+ * \param[out] out_len 		Size of compressed data, padding included.
+ *
+ * \return 0 on success, -EFBIG if data does not compress below \p max_len, or negative error
+ * code of the sink.
+ */
+int ubi_lz_compress(const uint8_t *src, size_t len, size_t max_len, ubi_lz_write_t write,
+		    void *ctx, size_t *out_len);
+
+/**
+ * \brief Decompress a range of data streamed from a source.
+ *
+ * Output before \p offset is decoded into the history window only. Bytes past \p data_len
+ * read as erased.
+ *
+ * \param read 			Source of compressed data.
+ * \param[in] ctx 		Context passed to the source.
+ * \param in_len 		Size of compressed data in bytes.
+ * \param data_len 		Size of decompressed data in bytes.
+ * \param offset 		Offset of the range within decompressed data.
+ * \param[out] dst 		Output buffer.
+ * \param size 			Size of the range in bytes.
+ *
+ * \return 0 on success, -EBADMSG if compressed data is malformed, or negative error code of
+ * the source.
+ */
+int ubi_lz_decompress(ubi_lz_read_t read, void *ctx, size_t in_len, size_t data_len,
+		      size_t offset, uint8_t *dst, size_t size);
+
+/** \} name ubi_lz */
+
+#endif /* UBI_LZ_H */
@@ -0,0 +1,703 @@
+/**
+ * \file    ubi_ring.c
+ * \author  Kamil Kielbasa
+ * \brief   Unsorted Block Images (UBI) circular log implementation.
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* Internal headers: */
+#include "ubi.h"
+#include "ubi_ring.h"
+#include "ubi_utils.h"
+
+/* Zephyr headers: */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+/* Standard library headers: */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define RING_ALIGN (WRITE_BLOCK_SIZE_ALIGNMENT)
+
+/* Ring record header constants */
+#define RING_REC_HDR_MAGIC (0xA5)
+#define RING_REC_HDR_SIZE (8)
+#define RING_REC_MAX_LEN (CONFIG_UBI_RING_MAX_RECORD_LEN)
+#define RING_REC_MAX_SIZE ROUND_UP(RING_REC_HDR_SIZE + RING_REC_MAX_LEN, RING_ALIGN)
+
+#define RING_ERASED_BYTE (0xFF)
+#define RING_UNMAPPED (UINT64_MAX)
+
+BUILD_ASSERT(RING_REC_MAX_LEN > 0 && RING_REC_MAX_LEN <= UINT16_MAX);
+
+LOG_MODULE_REGISTER(ubi_ring, CONFIG_UBI_LOG_LEVEL);
+
+/* Module types and type definitions ----------------------------------------------------------- */
+
+/**
+ * \brief Types of circular log records.
+ */
+enum ring_rec_type {
+	RING_REC_TYPE_DATA = 1, /*!< User data record. */
+	RING_REC_TYPE_TRIM = 2, /*!< LEBs with lower sequence number are released. */
+};
+
+/**
+ * \brief Circular log record header, followed by record data.
+ */
+struct ring_rec_hdr {
+	uint8_t magic; /*!< Magic number */
+	uint8_t type; /*!< Record type */
+	uint16_t len; /*!< Data length in bytes */
+	uint32_t crc; /*!< CRC32 of header and data */
+};
+BUILD_ASSERT(sizeof(struct ring_rec_hdr) == RING_REC_HDR_SIZE);
+
+/**
+ * \brief UBI circular log representation.
+ */
+struct ubi_ring {
+	struct k_mutex mutex; /**< Serializes log operations. */
+
+	struct ubi_device *ubi; /**< Underlying UBI device. */
+	int vol_id; /**< Backing volume identifier. */
+
+	size_t leb_size; /**< Size of each LEB in bytes. */
+	size_t leb_count; /**< Number of LEBs in volume. */
+	uint64_t *leb_sqnum; /**< Sequence number per LEB, \ref RING_UNMAPPED if unused. */
+
+	bool empty; /**< No LEB is mapped. */
+	size_t head; /**< LEB receiving appended records. */
+	size_t head_wp; /**< Write pointer within head LEB. */
+	size_t tail; /**< Oldest LEB of log. */
+
+	uint8_t rec_buf[RING_REC_MAX_SIZE]; /**< Record staging buffer. */
+
+	struct ubi_ring_info info; /**< Log statistics. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+/* Static function declarations ---------------------------------------------------------------- */
+
+/**
+ * \brief Build a record in the staging buffer.
+ *
+ * \param[in] ring 	Pointer to UBI circular log instance.
+ * \param type 		Record type.
+ * \param[in] data 	Record data.
+ * \param len 		Data length in bytes.
+ *
+ * \return Record size in bytes.
+ */
+static size_t rec_build(struct ubi_ring *ring, enum ring_rec_type type, const void *data,
+			size_t len);
+
+/**
+ * \brief Load a record into the staging buffer and verify it.
+ *
+ * \param[in] ring 	Pointer to UBI circular log instance.
+ * \param lnum 		Logical eraseblock number.
+ * \param offset 	Record offset within LEB.
+ * \param end 		Offset of first byte which may not hold records.
+ * \param[out] size 	Record size in bytes.
+ *
+ * \return 0 on success, -ENODATA on erased space, -EBADMSG on corrupted record,
+ * or other negative error code on failure.
+ */
+static int rec_load(struct ubi_ring *ring, size_t lnum, size_t offset, size_t end,
+		    size_t *size);
+
+/**
+ * \brief Append a record to the head LEB, advancing head if needed.
+ *
+ * \param[in] ring 	Pointer to UBI circular log instance.
+ * \param type 		Record type.
+ * \param[in] data 	Record data.
+ * \param len 		Data length in bytes.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int rec_append(struct ubi_ring *ring, enum ring_rec_type type, const void *data,
+		      size_t len);
+
+/**
+ * \brief Open next LEB as head, reclaiming the oldest LEB if log is full.
+ *
+ * \param[in] ring 	Pointer to UBI circular log instance.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_advance(struct ubi_ring *ring);
+
+/**
+ * \brief Unmap a LEB of log.
+ *
+ * \param[in] ring 	Pointer to UBI circular log instance.
+ * \param lnum 		Logical eraseblock number.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int leb_release(struct ubi_ring *ring, size_t lnum);
+
+/**
+ * \brief Find LEB with given sequence number.
+ *
+ * \param[in] ring 	Pointer to UBI circular log instance.
+ * \param sqnum 	Sequence number.
+ * \param[out] lnum 	Logical eraseblock number.
+ *
+ * \return 0 on success, -ENOENT if LEB was reclaimed, -EINVAL if LEB was never written.
+ */
+static int leb_find(struct ubi_ring *ring, uint64_t sqnum, size_t *lnum);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static size_t rec_build(struct ubi_ring *ring, enum ring_rec_type type, const void *data,
+			size_t len)
+{
+	__ASSERT_NO_MSG(ring);
+	__ASSERT_NO_MSG(data);
+
+	const size_t size = ROUND_UP(RING_REC_HDR_SIZE + len, RING_ALIGN);
+	struct ring_rec_hdr *hdr = (struct ring_rec_hdr *)ring->rec_buf;
+
+	hdr->magic = RING_REC_HDR_MAGIC;
+	hdr->type = type;
+	hdr->len = len;
+
+	memcpy(&ring->rec_buf[RING_REC_HDR_SIZE], data, len);
+	memset(&ring->rec_buf[RING_REC_HDR_SIZE + len], 0, size - RING_REC_HDR_SIZE - len);
+
+	hdr->crc = crc32_ieee(ring->rec_buf, RING_REC_HDR_SIZE - sizeof(hdr->crc));
+	hdr->crc = crc32_ieee_update(hdr->crc, &ring->rec_buf[RING_REC_HDR_SIZE], len);
+
+	return size;
+}
+
+static int rec_load(struct ubi_ring *ring, size_t lnum, size_t offset, size_t end,
+		    size_t *size)
+{
+	__ASSERT_NO_MSG(ring);
+	__ASSERT_NO_MSG(size);
+
+	if (offset + RING_REC_HDR_SIZE > end)
+		return -ENODATA;
+
+	int ret = ubi_leb_read(ring->ubi, ring->vol_id, lnum, offset, ring->rec_buf,
+			       RING_REC_HDR_SIZE);
+
+	if (0 != ret) {
+		LOG_ERR("Record header read failure");
+		return ret;
+	}
+
+	const struct ring_rec_hdr *hdr = (const struct ring_rec_hdr *)ring->rec_buf;
+
+	if (RING_ERASED_BYTE == hdr->magic)
+		return -ENODATA;
+
+	if (RING_REC_HDR_MAGIC != hdr->magic || hdr->len > RING_REC_MAX_LEN)
+		return -EBADMSG;
+
+	*size = ROUND_UP(RING_REC_HDR_SIZE + hdr->len, RING_ALIGN);
+
+	if (offset + *size > end)
+		return -EBADMSG;
+
+	if (hdr->len > 0) {
+		ret = ubi_leb_read(ring->ubi, ring->vol_id, lnum, offset + RING_REC_HDR_SIZE,
+				   &ring->rec_buf[RING_REC_HDR_SIZE], hdr->len);
+
+		if (0 != ret) {
+			LOG_ERR("Record data read failure");
+			return ret;
+		}
+	}
+
+	uint32_t crc = crc32_ieee(ring->rec_buf, RING_REC_HDR_SIZE - sizeof(hdr->crc));
+	crc = crc32_ieee_update(crc, &ring->rec_buf[RING_REC_HDR_SIZE], hdr->len);
+
+	if (crc != hdr->crc)
+		return -EBADMSG;
+
+	return 0;
+}
+
+static int rec_append(struct ubi_ring *ring, enum ring_rec_type type, const void *data,
+		      size_t len)
+{
+	__ASSERT_NO_MSG(ring);
+
+	const size_t size = ROUND_UP(RING_REC_HDR_SIZE + len, RING_ALIGN);
+	int ret = 0;
+
+	if (ring->empty || ring->head_wp + size > ring->leb_size) {
+		ret = leb_advance(ring);
+
+		if (0 != ret)
+			return ret;
+	}
+
+	rec_build(ring, type, data, len);
+
+	ret = ubi_leb_write_offset(ring->ubi, ring->vol_id, ring->head, ring->head_wp,
+				   ring->rec_buf, size);
+
+	if (0 != ret) {
+		LOG_ERR("Record write failure");
+
+		/* Never program partially written space again */
+		ring->head_wp = ring->leb_size;
+		return ret;
+	}
+
+	ring->head_wp += size;
+
+	return 0;
+}
+
+static int leb_advance(struct ubi_ring *ring)
+{
+	__ASSERT_NO_MSG(ring);
+
+	const size_t next = (ring->head + 1) % ring->leb_count;
+	int ret = 0;
+
+	/* Log is full, next LEB is the oldest one */
+	if (RING_UNMAPPED != ring->leb_sqnum[next]) {
+		__ASSERT_NO_MSG(next == ring->tail);
+
+		ret = leb_release(ring, next);
+
+		if (0 != ret)
+			return ret;
+
+		ring->tail = (next + 1) % ring->leb_count;
+		ring->info.reclaims += 1;
+	}
+
+	/* Persist the oldest valid LEB, stale LEBs may be mapped again after reboot */
+	const uint64_t trim_sqnum = ring->empty ? 0 : ring->leb_sqnum[ring->tail];
+	const size_t size = rec_build(ring, RING_REC_TYPE_TRIM, &trim_sqnum, sizeof(trim_sqnum));
+
+	ret = ubi_leb_write_offset(ring->ubi, ring->vol_id, next, 0, ring->rec_buf, size);
+
+	if (0 != ret) {
+		LOG_ERR("Trim record write failure");
+		return ret;
+	}
+
+	ret = ubi_leb_get_sqnum(ring->ubi, ring->vol_id, next, &ring->leb_sqnum[next]);
+
+	if (0 != ret) {
+		LOG_ERR("LEB sequence number read failure");
+		return ret;
+	}
+
+	if (ring->empty) {
+		ring->empty = false;
+		ring->tail = next;
+	}
+
+	ring->head = next;
+	ring->head_wp = size;
+
+	return 0;
+}
+
+static int leb_release(struct ubi_ring *ring, size_t lnum)
+{
+	__ASSERT_NO_MSG(ring);
+
+	int ret = ubi_leb_unmap(ring->ubi, ring->vol_id, lnum);
+
+	if (0 != ret) {
+		LOG_ERR("LEB unmap failure");
+		return ret;
+	}
+
+	ring->leb_sqnum[lnum] = RING_UNMAPPED;
+
+	return 0;
+}
+
+static int leb_find(struct ubi_ring *ring, uint64_t sqnum, size_t *lnum)
+{
+	__ASSERT_NO_MSG(ring);
+	__ASSERT_NO_MSG(lnum);
+
+	if (sqnum < ring->leb_sqnum[ring->tail])
+		return -ENOENT;
+
+	if (sqnum > ring->leb_sqnum[ring->head])
+		return -EINVAL;
+
+	for (size_t i = ring->tail;; i = (i + 1) % ring->leb_count) {
+		if (sqnum == ring->leb_sqnum[i]) {
+			*lnum = i;
+			return 0;
+		}
+
+		if (i == ring->head)
+			break;
+	}
+
+	return -ENOENT;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+int ubi_ring_open(struct ubi_device *ubi, int vol_id, struct ubi_ring **ring)
+{
+	int ret = -EIO;
+
+	if (!ubi || vol_id < 0 || !ring)
+		return -EINVAL;
+
+	struct ubi_device_info dev_info = { 0 };
+	ret = ubi_device_get_info(ubi, &dev_info);
+
+	if (0 != ret) {
+		LOG_ERR("Device get info failure");
+		return ret;
+	}
+
+	struct ubi_volume_config vol_cfg = { 0 };
+	size_t alloc_lebs = 0;
+	ret = ubi_volume_get_info(ubi, vol_id, &vol_cfg, &alloc_lebs);
+
+	if (0 != ret) {
+		LOG_ERR("Volume get info failure");
+		return ret;
+	}
+
+	if (UBI_VOLUME_TYPE_DYNAMIC != vol_cfg.type || vol_cfg.leb_count < 2 ||
+	    dev_info.leb_size < 2 * RING_REC_MAX_SIZE) {
+		LOG_ERR("Volume is not suitable for circular log");
+		return -EINVAL;
+	}
+
+	struct ubi_ring *log = k_malloc(sizeof(*log));
+
+	if (!log) {
+		LOG_ERR("Heap allocation failure");
+		return -ENOMEM;
+	}
+
+	memset(log, 0, sizeof(*log));
+	k_mutex_init(&log->mutex);
+	log->ubi = ubi;
+	log->vol_id = vol_id;
+	log->leb_size = dev_info.leb_size;
+	log->leb_count = vol_cfg.leb_count;
+	log->info.leb_count = vol_cfg.leb_count;
+
+	log->leb_sqnum = k_malloc(vol_cfg.leb_count * sizeof(*log->leb_sqnum));
+
+	if (!log->leb_sqnum) {
+		LOG_ERR("Heap allocation failure");
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	/* 1. Collect sequence numbers, the newest LEB is head */
+	log->empty = true;
+	log->head = vol_cfg.leb_count - 1;
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		bool is_mapped = false;
+		log->leb_sqnum[lnum] = RING_UNMAPPED;
+
+		ret = ubi_leb_is_mapped(ubi, vol_id, lnum, &is_mapped);
+
+		if (0 != ret) {
+			LOG_ERR("LEB map check failure");
+			goto exit;
+		}
+
+		if (!is_mapped)
+			continue;
+
+		ret = ubi_leb_get_sqnum(ubi, vol_id, lnum, &log->leb_sqnum[lnum]);
+
+		if (0 != ret) {
+			LOG_ERR("LEB sequence number read failure");
+			goto exit;
+		}
+
+		if (log->empty || log->leb_sqnum[lnum] > log->leb_sqnum[log->head]) {
+			log->empty = false;
+			log->head = lnum;
+		}
+	}
+
+	if (log->empty) {
+		*ring = log;
+		return 0;
+	}
+
+	/* 2. Scan head LEB for write pointer and the newest trim point */
+	uint64_t trim_sqnum = 0;
+	size_t offset = 0;
+
+	for (;;) {
+		size_t size = 0;
+		ret = rec_load(log, log->head, offset, log->leb_size, &size);
+
+		if (-ENODATA == ret)
+			break;
+
+		if (-EBADMSG == ret) {
+			/* Interrupted write, remaining space cannot be programmed again */
+			LOG_WRN("Corrupted record in LEB %zu at %zu", log->head, offset);
+			offset = log->leb_size;
+			break;
+		}
+
+		if (0 != ret)
+			goto exit;
+
+		const struct ring_rec_hdr *hdr = (const struct ring_rec_hdr *)log->rec_buf;
+
+		if (RING_REC_TYPE_TRIM == hdr->type && sizeof(trim_sqnum) == hdr->len)
+			memcpy(&trim_sqnum, &log->rec_buf[RING_REC_HDR_SIZE], sizeof(trim_sqnum));
+
+		offset += size;
+	}
+
+	log->head_wp = offset;
+
+	/* 3. Walk back from head while sequence numbers decrease, the rest is stale */
+	log->tail = log->head;
+
+	for (;;) {
+		const size_t prev = (log->tail + log->leb_count - 1) % log->leb_count;
+
+		if (prev == log->head || RING_UNMAPPED == log->leb_sqnum[prev] ||
+		    log->leb_sqnum[prev] > log->leb_sqnum[log->tail] ||
+		    log->leb_sqnum[prev] < trim_sqnum)
+			break;
+
+		log->tail = prev;
+	}
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		if (RING_UNMAPPED == log->leb_sqnum[lnum])
+			continue;
+
+		const size_t dist = (lnum + log->leb_count - log->tail) % log->leb_count;
+		const size_t span = (log->head + log->leb_count - log->tail) % log->leb_count;
+
+		if (dist <= span)
+			continue;
+
+		ret = leb_release(log, lnum);
+
+		if (0 != ret)
+			goto exit;
+	}
+
+	*ring = log;
+	return 0;
+
+exit:
+	k_free(log->leb_sqnum);
+	k_free(log);
+	return ret;
+}
+
+int ubi_ring_append(struct ubi_ring *ring, const void *buf, size_t len)
+{
+	if (!ring || !buf || 0 == len || len > RING_REC_MAX_LEN)
+		return -EINVAL;
+
+	k_mutex_lock(&ring->mutex, K_FOREVER);
+
+	int ret = rec_append(ring, RING_REC_TYPE_DATA, buf, len);
+
+	if (0 == ret)
+		ring->info.appends += 1;
+
+	k_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+int ubi_ring_read_from(struct ubi_ring *ring, struct ubi_ring_cursor *cursor, void *buf,
+		       size_t size, size_t *len)
+{
+	if (!ring || !cursor || (!buf && size > 0) || !len)
+		return -EINVAL;
+
+	k_mutex_lock(&ring->mutex, K_FOREVER);
+
+	int ret = -ENODATA;
+
+	if (ring->empty)
+		goto exit;
+
+	for (;;) {
+		size_t lnum = 0;
+		ret = leb_find(ring, cursor->sqnum, &lnum);
+
+		if (0 != ret)
+			goto exit;
+
+		const size_t end = (lnum == ring->head) ? ring->head_wp : ring->leb_size;
+		size_t rec_size = 0;
+		ret = rec_load(ring, lnum, cursor->offset, end, &rec_size);
+
+		if (-ENODATA == ret || -EBADMSG == ret) {
+			if (lnum == ring->head) {
+				ret = -ENODATA;
+				goto exit;
+			}
+
+			/* Continue with the first record of next LEB */
+			const size_t next = (lnum + 1) % ring->leb_count;
+			cursor->sqnum = ring->leb_sqnum[next];
+			cursor->offset = 0;
+			continue;
+		}
+
+		if (0 != ret)
+			goto exit;
+
+		cursor->offset += rec_size;
+
+		const struct ring_rec_hdr *hdr = (const struct ring_rec_hdr *)ring->rec_buf;
+
+		if (RING_REC_TYPE_DATA != hdr->type)
+			continue;
+
+		*len = hdr->len;
+		memcpy(buf, &ring->rec_buf[RING_REC_HDR_SIZE], MIN(size, hdr->len));
+		break;
+	}
+
+exit:
+	k_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+int ubi_ring_trim(struct ubi_ring *ring, const struct ubi_ring_cursor *cursor)
+{
+	if (!ring || !cursor)
+		return -EINVAL;
+
+	k_mutex_lock(&ring->mutex, K_FOREVER);
+
+	int ret = 0;
+
+	if (ring->empty)
+		goto exit;
+
+	if (cursor->sqnum > ring->leb_sqnum[ring->head]) {
+		ret = -EINVAL;
+		goto exit;
+	}
+
+	bool released = false;
+
+	while (ring->tail != ring->head && ring->leb_sqnum[ring->tail] < cursor->sqnum) {
+		ret = leb_release(ring, ring->tail);
+
+		if (0 != ret)
+			goto exit;
+
+		ring->tail = (ring->tail + 1) % ring->leb_count;
+		released = true;
+	}
+
+	if (released) {
+		const uint64_t trim_sqnum = ring->leb_sqnum[ring->tail];
+		ret = rec_append(ring, RING_REC_TYPE_TRIM, &trim_sqnum, sizeof(trim_sqnum));
+	}
+
+exit:
+	k_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+int ubi_ring_get_tail(struct ubi_ring *ring, struct ubi_ring_cursor *cursor)
+{
+	if (!ring || !cursor)
+		return -EINVAL;
+
+	k_mutex_lock(&ring->mutex, K_FOREVER);
+
+	int ret = -ENODATA;
+
+	if (!ring->empty) {
+		cursor->sqnum = ring->leb_sqnum[ring->tail];
+		cursor->offset = 0;
+		ret = 0;
+	}
+
+	k_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+int ubi_ring_get_head(struct ubi_ring *ring, struct ubi_ring_cursor *cursor)
+{
+	if (!ring || !cursor)
+		return -EINVAL;
+
+	k_mutex_lock(&ring->mutex, K_FOREVER);
+
+	int ret = -ENODATA;
+
+	if (!ring->empty) {
+		cursor->sqnum = ring->leb_sqnum[ring->head];
+		cursor->offset = ring->head_wp;
+		ret = 0;
+	}
+
+	k_mutex_unlock(&ring->mutex);
+	return ret;
+}
+
+int ubi_ring_get_info(struct ubi_ring *ring, struct ubi_ring_info *info)
+{
+	if (!ring || !info)
+		return -EINVAL;
+
+	k_mutex_lock(&ring->mutex, K_FOREVER);
+
+	*info = ring->info;
+	info->used_lebs = 0;
+
+	for (size_t lnum = 0; lnum < ring->leb_count; ++lnum)
+		if (RING_UNMAPPED != ring->leb_sqnum[lnum])
+			info->used_lebs += 1;
+
+	k_mutex_unlock(&ring->mutex);
+
+	return 0;
+}
+
+int ubi_ring_close(struct ubi_ring *ring)
+{
+	if (!ring)
+		return -EINVAL;
+
+	k_free(ring->leb_sqnum);
+	k_free(ring);
+
+	return 0;
+}
@@ -39,35 +39,85 @@ enum dual_bank_state { BANKS_INVALID, BANKS_VALID, BANK1_VALID, BANK2_VALID };
 /**
  * \brief Read the device headers from a UBI device.
  *
- * \param[in] mtd		UBI MTD device structure.
+ * \param[in] flash		UBI MTD device structure.
  * \param[out] db_state   	Dual-bank state.
  * \param[out] dev_hdr_1  	First device header.
  * \param[out] dev_hdr_2  	Second device header.
  *
  * \return 0 on success, negative error code on failure.
  */
-static int get_dev_hdr(const struct ubi_mtd *mtd, enum dual_bank_state *db_state,
+static int get_dev_hdr(const struct ubi_flash *flash, enum dual_bank_state *db_state,
 		       struct ubi_dev_hdr *dev_hdr_1, struct ubi_dev_hdr *dev_hdr_2);
 
 /**
  * \brief Overwrite the device and volume headers on a UBI device.
  *
- * \param[in] mtd       	UBI MTD device structure.
+ * \param[in] flash     	UBI MTD device structure.
  * \param[out] db_state  	Dual-bank state.
  * \param[in] buf       	Buffer containing the new device and volumes data.
  * \param len       		Size of the \p buf in bytes.
  *
  * \return 0 on success, negative error code on failure.
  */
-static int overwrite_dev_and_vol_hdrs(const struct ubi_mtd *mtd, enum dual_bank_state *db_state,
+static int overwrite_dev_and_vol_hdrs(const struct ubi_flash *flash, enum dual_bank_state *db_state,
 				      const uint8_t *buf, size_t len);
 
+/**
+ * \brief Read the whole volume table stored in one bank.
+ *
+ * \param[in] flash     	UBI MTD device structure.
+ * \param pnum       		Physical eraseblock number of bank.
+ * \param[out] buf       	Buffer for device and volumes headers, large enough for
+ * 				\ref CONFIG_UBI_MAX_NR_OF_VOLUMES volumes.
+ * \param[out] len       	Size of the volume table in bytes.
+ *
+ * \return 0 if bank holds a complete table, -EBADMSG if any header is corrupted or negative
+ * error code on failure.
+ */
+static int read_bank(const struct ubi_flash *flash, size_t pnum, uint8_t *buf, size_t *len);
+
+/**
+ * \brief Erase one bank and write a volume table to it.
+ *
+ * \param[in] flash     	UBI MTD device structure.
+ * \param pnum       		Physical eraseblock number of bank.
+ * \param[in] buf       	Buffer containing the device and volumes data.
+ * \param len       		Size of the \p buf in bytes.
+ *
+ * \return 0 on success, negative error code on failure.
+ */
+static int write_bank(const struct ubi_flash *flash, size_t pnum, const uint8_t *buf, size_t len);
+
+/**
+ * \brief Get number of PEBs one partition adds to the PEB namespace.
+ *
+ * \param[in] flash     	UBI MTD device structure.
+ * \param idx       		Index of partition, 0 for the first one.
+ * \param[out] nr_of_pebs  	Number of PEBs, without reserved PEBs of device headers.
+ *
+ * \return 0 on success, -ENODEV if partition is not ready, or negative error code.
+ */
+static int part_get_peb_count(const struct ubi_flash *flash, size_t idx, size_t *nr_of_pebs);
+
+/**
+ * \brief Open the flash area holding a PEB, which is not reserved for device headers.
+ *
+ * \param[in] flash     	UBI MTD device structure.
+ * \param pnum       		Physical eraseblock number.
+ * \param[out] fa       	Flash area of the partition holding the PEB.
+ * \param[out] offset       	Offset of the PEB within the flash area.
+ *
+ * \return 0 on success, -EINVAL if PEB is reserved or out of range, or negative error code.
+ */
+static int peb_open(const struct ubi_flash *flash, size_t pnum, const struct flash_area **fa,
+		    size_t *offset);
+
 /* Static function definitions ----------------------------------------------------------------- */
 
-static int get_dev_hdr(const struct ubi_mtd *mtd, enum dual_bank_state *db_state,
+static int get_dev_hdr(const struct ubi_flash *flash, enum dual_bank_state *db_state,
 		       struct ubi_dev_hdr *dev_hdr_1, struct ubi_dev_hdr *dev_hdr_2)
 {
-	__ASSERT_NO_MSG(mtd);
+	__ASSERT_NO_MSG(flash);
 	__ASSERT_NO_MSG(db_state);
 	__ASSERT_NO_MSG(dev_hdr_1);
 	__ASSERT_NO_MSG(dev_hdr_2);
@@ -84,13 +134,13 @@ static int get_dev_hdr(const struct ubi_mtd *mtd, enum dual_bank_state *db_state
 	struct ubi_dev_hdr hdr_2 = { 0 };
 
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	ret = flash_area_open(flash->mtd.partition_id, &fa);
 
 	if (0 != ret)
 		return ret;
 
 	/* Read first device header */
-	offset = UBI_DEV_HDR_RES_PEB_0 * mtd->erase_block_size;
+	offset = UBI_DEV_HDR_RES_PEB_0 * flash->mtd.erase_block_size;
 	ret = flash_area_read(fa, offset, &hdr_1, sizeof(hdr_1));
 
 	valid_1 = (0 == ret);
@@ -103,7 +153,7 @@ static int get_dev_hdr(const struct ubi_mtd *mtd, enum dual_bank_state *db_state
 	}
 
 	/* Read second device header */
-	offset = UBI_DEV_HDR_RES_PEB_1 * mtd->erase_block_size;
+	offset = UBI_DEV_HDR_RES_PEB_1 * flash->mtd.erase_block_size;
 	ret = flash_area_read(fa, offset, &hdr_2, sizeof(hdr_2));
 
 	valid_2 = (0 == ret);
@@ -148,67 +198,316 @@ static int get_dev_hdr(const struct ubi_mtd *mtd, enum dual_bank_state *db_state
 	return 0;
 }
 
-static int overwrite_dev_and_vol_hdrs(const struct ubi_mtd *mtd, enum dual_bank_state *db_state,
+static int overwrite_dev_and_vol_hdrs(const struct ubi_flash *flash, enum dual_bank_state *db_state,
 				      const uint8_t *buf, size_t len)
 {
-	__ASSERT_NO_MSG(mtd);
+	__ASSERT_NO_MSG(flash);
 	__ASSERT_NO_MSG(db_state);
 	__ASSERT_NO_MSG(buf);
 	__ASSERT_NO_MSG(0 != len);
 
-	if (len > mtd->erase_block_size)
+	if (len > flash->mtd.erase_block_size)
 		return -EINVAL;
 
 	int ret = -EIO;
-	size_t offset = 0;
 
 	*db_state = BANKS_INVALID;
 
+	/* First bank is always written first, so it holds the newer revision after power cut */
+	ret = write_bank(flash, UBI_DEV_HDR_RES_PEB_0, buf, len);
+
+	if (0 != ret)
+		return ret;
+
+	*db_state = BANK1_VALID;
+
+	ret = write_bank(flash, UBI_DEV_HDR_RES_PEB_1, buf, len);
+
+	if (0 != ret)
+		return ret;
+
+	*db_state = BANKS_VALID;
+
+	return 0;
+}
+
+static int read_bank(const struct ubi_flash *flash, size_t pnum, uint8_t *buf, size_t *len)
+{
+	__ASSERT_NO_MSG(flash);
+	__ASSERT_NO_MSG(buf);
+	__ASSERT_NO_MSG(len);
+
+	int ret = -EIO;
+	uint32_t crc = 0;
+
+	*len = 0;
+
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	ret = flash_area_open(flash->mtd.partition_id, &fa);
 
 	if (0 != ret)
-		goto exit;
+		return ret;
 
-	offset = UBI_DEV_HDR_RES_PEB_0 * mtd->erase_block_size;
-	ret = flash_area_erase(fa, offset, mtd->erase_block_size);
+	const size_t offset = pnum * flash->mtd.erase_block_size;
+	ret = flash_area_read(fa, offset, buf, UBI_DEV_HDR_SIZE);
 
 	if (0 != ret)
 		goto exit;
 
-	ret = flash_area_write(fa, offset, buf, len);
+	struct ubi_dev_hdr dev_hdr = { 0 };
+	memcpy(&dev_hdr, buf, sizeof(dev_hdr));
 
-	if (0 != ret)
+	crc = crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
+
+	if (UBI_DEV_HDR_MAGIC != dev_hdr.magic || crc != dev_hdr.hdr_crc ||
+	    dev_hdr.vol_count > CONFIG_UBI_MAX_NR_OF_VOLUMES) {
+		ret = -EBADMSG;
 		goto exit;
+	}
 
-	*db_state = BANK1_VALID;
+	const size_t vols_len = dev_hdr.vol_count * UBI_VOL_HDR_SIZE;
+
+	if (vols_len > 0) {
+		ret = flash_area_read(fa, offset + UBI_DEV_HDR_SIZE, &buf[UBI_DEV_HDR_SIZE],
+				      vols_len);
+
+		if (0 != ret)
+			goto exit;
+	}
+
+	/* Torn write leaves valid device header followed by erased or partial volume headers */
+	for (size_t vol_idx = 0; vol_idx < dev_hdr.vol_count; ++vol_idx) {
+		struct ubi_vol_hdr vol_hdr = { 0 };
+		memcpy(&vol_hdr, &buf[UBI_DEV_HDR_SIZE + (vol_idx * UBI_VOL_HDR_SIZE)],
+		       sizeof(vol_hdr));
+
+		crc = crc32_ieee((const uint8_t *)&vol_hdr,
+				 sizeof(vol_hdr) - sizeof(vol_hdr.hdr_crc));
+
+		if (UBI_VOL_HDR_MAGIC != vol_hdr.magic || crc != vol_hdr.hdr_crc) {
+			ret = -EBADMSG;
+			goto exit;
+		}
+	}
+
+	*len = UBI_DEV_HDR_SIZE + vols_len;
+
+exit:
+	flash_area_close(fa);
+	return ret;
+}
+
+static int write_bank(const struct ubi_flash *flash, size_t pnum, const uint8_t *buf, size_t len)
+{
+	__ASSERT_NO_MSG(flash);
+	__ASSERT_NO_MSG(buf);
+	__ASSERT_NO_MSG(0 != len);
 
-	offset = UBI_DEV_HDR_RES_PEB_1 * mtd->erase_block_size;
-	ret = flash_area_erase(fa, offset, mtd->erase_block_size);
+	int ret = -EIO;
+
+	const struct flash_area *fa = NULL;
+	ret = flash_area_open(flash->mtd.partition_id, &fa);
 
 	if (0 != ret)
-		goto exit;
+		return ret;
 
-	ret = flash_area_write(fa, offset, buf, len);
+	const size_t offset = pnum * flash->mtd.erase_block_size;
+	ret = flash_area_erase(fa, offset, flash->mtd.erase_block_size);
 
 	if (0 != ret)
 		goto exit;
 
-	*db_state = BANK2_VALID;
-	*db_state = BANKS_VALID;
+	ret = flash_area_write(fa, offset, buf, len);
 
 exit:
-	if (fa)
+	flash_area_close(fa);
+	return ret;
+}
+
+static int part_get_peb_count(const struct ubi_flash *flash, size_t idx, size_t *nr_of_pebs)
+{
+	__ASSERT_NO_MSG(flash);
+	__ASSERT_NO_MSG(nr_of_pebs);
+	__ASSERT_NO_MSG(idx <= flash->mtd.concat_count);
+
+	const uint8_t partition_id =
+		(0 == idx) ? flash->mtd.partition_id : flash->mtd.concat_ids[idx - 1];
+
+	const struct flash_area *fa = NULL;
+	int ret = flash_area_open(partition_id, &fa);
+
+	if (0 != ret)
+		return ret;
+
+	if (!flash_area_device_is_ready(fa)) {
 		flash_area_close(fa);
+		return -ENODEV;
+	}
 
-	return ret;
+	size_t count = fa->fa_size / flash->mtd.erase_block_size;
+	flash_area_close(fa);
+
+	/* Device headers are kept on the first partition only */
+	if (0 == idx) {
+		if (count < UBI_DEV_HDR_NR_OF_RES_PEBS)
+			return -EINVAL;
+
+		count -= UBI_DEV_HDR_NR_OF_RES_PEBS;
+	}
+
+	*nr_of_pebs = count;
+	return 0;
+}
+
+static int peb_open(const struct ubi_flash *flash, size_t pnum, const struct flash_area **fa,
+		    size_t *offset)
+{
+	__ASSERT_NO_MSG(flash);
+	__ASSERT_NO_MSG(fa);
+	__ASSERT_NO_MSG(offset);
+
+	if (UBI_DEV_HDR_RES_PEB_0 == pnum || UBI_DEV_HDR_RES_PEB_1 == pnum)
+		return -EINVAL;
+
+	int ret = 0;
+
+	/* Single partition is opened once, as PEB offset needs no lookup of partition sizes */
+	if (0 == flash->mtd.concat_count) {
+		ret = flash_area_open(flash->mtd.partition_id, fa);
+
+		if (0 != ret)
+			return ret;
+
+		if (pnum >= (*fa)->fa_size / flash->mtd.erase_block_size) {
+			flash_area_close(*fa);
+			*fa = NULL;
+			return -EINVAL;
+		}
+
+		*offset = pnum * flash->mtd.erase_block_size;
+		return 0;
+	}
+
+	uint8_t partition_id = 0;
+	ret = ubi_mtd_peb_locate(flash, pnum, &partition_id, offset);
+
+	if (0 != ret)
+		return ret;
+
+	return flash_area_open(partition_id, fa);
 }
 
 /* Module interface function definitions ------------------------------------------------------- */
 
-int ubi_dev_is_mounted(const struct ubi_mtd *mtd, bool *is_mounted)
+int ubi_mtd_layout_cache(struct ubi_flash *flash)
+{
+	if (!flash || flash->part_ends || (0 != flash->mtd.concat_count && !flash->mtd.concat_ids))
+		return -EINVAL;
+
+	const size_t nr_of_parts = 1 + flash->mtd.concat_count;
+	size_t stripe = SIZE_MAX;
+	size_t end = 0;
+
+	size_t *part_ends = k_malloc(nr_of_parts * sizeof(*part_ends));
+
+	if (!part_ends)
+		return -ENOMEM;
+
+	for (size_t idx = 0; idx < nr_of_parts; ++idx) {
+		size_t count = 0;
+		const int ret = part_get_peb_count(flash, idx, &count);
+
+		if (0 != ret) {
+			k_free(part_ends);
+			return ret;
+		}
+
+		end += count;
+		part_ends[idx] = end;
+		stripe = MIN(stripe, count);
+	}
+
+	/* Striped partitions contribute equally, PEBs beyond the smallest one stay unused */
+	if (flash->mtd.striped) {
+		for (size_t idx = 0; idx < nr_of_parts; ++idx)
+			part_ends[idx] = (idx + 1) * stripe;
+	}
+
+	flash->part_ends = part_ends;
+	return 0;
+}
+
+int ubi_mtd_get_peb_count(const struct ubi_flash *flash, size_t *nr_of_pebs)
+{
+	if (!flash || !flash->part_ends || !nr_of_pebs)
+		return -EINVAL;
+
+	const size_t nr_of_parts = 1 + flash->mtd.concat_count;
+
+	*nr_of_pebs = UBI_DEV_HDR_NR_OF_RES_PEBS + flash->part_ends[nr_of_parts - 1];
+	return 0;
+}
+
+int ubi_mtd_peb_locate(const struct ubi_flash *flash, size_t pnum, uint8_t *partition_id,
+		       size_t *offset)
 {
-	if (!mtd || !is_mounted)
+	if (!flash || !flash->part_ends || !partition_id || !offset)
+		return -EINVAL;
+
+	if (pnum < UBI_DEV_HDR_NR_OF_RES_PEBS) {
+		*partition_id = flash->mtd.partition_id;
+		*offset = pnum * flash->mtd.erase_block_size;
+		return 0;
+	}
+
+	const size_t nr_of_parts = 1 + flash->mtd.concat_count;
+	size_t local = pnum - UBI_DEV_HDR_NR_OF_RES_PEBS;
+	size_t idx = 0;
+
+	if (local >= flash->part_ends[nr_of_parts - 1])
+		return -EINVAL;
+
+	if (flash->mtd.striped) {
+		idx = local % nr_of_parts;
+		local /= nr_of_parts;
+	} else {
+		/* Binary search of the first partition ending past the PEB */
+		size_t high = nr_of_parts - 1;
+
+		while (idx < high) {
+			const size_t mid = idx + (high - idx) / 2;
+
+			if (local < flash->part_ends[mid])
+				high = mid;
+			else
+				idx = mid + 1;
+		}
+
+		local -= (0 == idx) ? 0 : flash->part_ends[idx - 1];
+	}
+
+	if (0 == idx) {
+		*partition_id = flash->mtd.partition_id;
+		local += UBI_DEV_HDR_NR_OF_RES_PEBS;
+	} else {
+		*partition_id = flash->mtd.concat_ids[idx - 1];
+	}
+
+	*offset = local * flash->mtd.erase_block_size;
+	return 0;
+}
+
+size_t ubi_mtd_peb_stripe(const struct ubi_flash *flash, size_t pnum)
+{
+	if (!flash || !flash->mtd.striped || pnum < UBI_DEV_HDR_NR_OF_RES_PEBS)
+		return 0;
+
+	return (pnum - UBI_DEV_HDR_NR_OF_RES_PEBS) % (1 + flash->mtd.concat_count);
+}
+
+int ubi_dev_is_mounted(const struct ubi_flash *flash, bool *is_mounted)
+{
+	if (!flash || !is_mounted)
 		return -EINVAL;
 
 	int ret = -EIO;
@@ -218,7 +517,7 @@ int ubi_dev_is_mounted(const struct ubi_mtd *mtd, bool *is_mounted)
 	struct ubi_dev_hdr dev_hdr_2 = { 0 };
 
 	/* 1. Read first device header */
-	ret = get_dev_hdr(mtd, &db_state, &dev_hdr_1, &dev_hdr_2);
+	ret = get_dev_hdr(flash, &db_state, &dev_hdr_1, &dev_hdr_2);
 
 	if (0 != ret)
 		return ret;
@@ -239,33 +538,41 @@ int ubi_dev_is_mounted(const struct ubi_mtd *mtd, bool *is_mounted)
 	return 0;
 }
 
-int ubi_dev_mount(const struct ubi_mtd *mtd)
+int ubi_dev_mount(const struct ubi_flash *flash)
 {
-	if (!mtd)
+	if (!flash)
 		return -EINVAL;
 
 	int ret = -EIO;
 
+	size_t nr_of_pebs = 0;
+	ret = ubi_mtd_get_peb_count(flash, &nr_of_pebs);
+
+	if (0 != ret)
+		return ret;
+
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	ret = flash_area_open(flash->mtd.partition_id, &fa);
 
 	if (0 != ret)
 		return ret;
 
+	/* Size of the whole PEB namespace and striping let attach reject a changed MTD list */
 	struct ubi_dev_hdr dev_hdr = { 0 };
 	dev_hdr.magic = UBI_DEV_HDR_MAGIC;
 	dev_hdr.version = UBI_DEV_HDR_VERSION;
 	dev_hdr.offset = fa->fa_off;
-	dev_hdr.size = fa->fa_size;
+	dev_hdr.size = nr_of_pebs * flash->mtd.erase_block_size;
 	dev_hdr.revision = 0;
 	dev_hdr.vol_count = 0;
+	dev_hdr.flags = flash->mtd.striped ? UBI_DEV_FLAG_STRIPED : 0;
 	dev_hdr.hdr_crc =
 		crc32_ieee((const uint8_t *)&dev_hdr, sizeof(dev_hdr) - sizeof(dev_hdr.hdr_crc));
 
 	flash_area_close(fa);
 
 	enum dual_bank_state db_state = BANKS_INVALID;
-	ret = overwrite_dev_and_vol_hdrs(mtd, &db_state, (const uint8_t *)&dev_hdr,
+	ret = overwrite_dev_and_vol_hdrs(flash, &db_state, (const uint8_t *)&dev_hdr,
 					 sizeof(dev_hdr));
 
 	switch (db_state) {
@@ -282,9 +589,70 @@ int ubi_dev_mount(const struct ubi_mtd *mtd)
 	return -EACCES;
 }
 
-int ubi_dev_hdr_read(const struct ubi_mtd *mtd, struct ubi_dev_hdr *hdr)
+int ubi_dev_hdr_recover(const struct ubi_flash *flash)
 {
-	if (!mtd || !hdr)
+	if (!flash)
+		return -EINVAL;
+
+	int ret = -EIO;
+
+	const size_t buf_size =
+		UBI_DEV_HDR_SIZE + (CONFIG_UBI_MAX_NR_OF_VOLUMES * UBI_VOL_HDR_SIZE);
+
+	uint8_t *buf_1 = k_malloc(buf_size);
+	uint8_t *buf_2 = k_malloc(buf_size);
+
+	if (!buf_1 || !buf_2) {
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	size_t len_1 = 0;
+	size_t len_2 = 0;
+
+	const int ret_1 = read_bank(flash, UBI_DEV_HDR_RES_PEB_0, buf_1, &len_1);
+	const int ret_2 = read_bank(flash, UBI_DEV_HDR_RES_PEB_1, buf_2, &len_2);
+
+	/* 1. No complete table, device is not mounted */
+	if (0 != ret_1 && 0 != ret_2) {
+		ret = 0;
+		goto exit;
+	}
+
+	/* 2. Both banks hold the same revision */
+	if (0 == ret_1 && 0 == ret_2 && len_1 == len_2 && 0 == memcmp(buf_1, buf_2, len_1)) {
+		ret = 0;
+		goto exit;
+	}
+
+	/* 3. Write was interrupted, copy the newest complete table over the other bank */
+	if (0 == ret_1 && 0 == ret_2) {
+		const struct ubi_dev_hdr *dev_hdr_1 = (const struct ubi_dev_hdr *)buf_1;
+		const struct ubi_dev_hdr *dev_hdr_2 = (const struct ubi_dev_hdr *)buf_2;
+
+		if (dev_hdr_1->revision >= dev_hdr_2->revision)
+			ret = write_bank(flash, UBI_DEV_HDR_RES_PEB_1, buf_1, len_1);
+		else
+			ret = write_bank(flash, UBI_DEV_HDR_RES_PEB_0, buf_2, len_2);
+	} else if (0 == ret_1) {
+		ret = write_bank(flash, UBI_DEV_HDR_RES_PEB_1, buf_1, len_1);
+	} else {
+		ret = write_bank(flash, UBI_DEV_HDR_RES_PEB_0, buf_2, len_2);
+	}
+
+exit:
+	if (buf_1)
+		k_free(buf_1);
+
+	if (buf_2)
+		k_free(buf_2);
+
+	return ret;
+}
+
+int ubi_dev_hdr_read(const struct ubi_flash *flash, struct ubi_dev_hdr *hdr)
+{
+	if (!flash || !hdr)
 		return -EINVAL;
 
 	int ret = -EIO;
@@ -293,7 +661,7 @@ int ubi_dev_hdr_read(const struct ubi_mtd *mtd, struct ubi_dev_hdr *hdr)
 	struct ubi_dev_hdr dev_hdr_1 = { 0 };
 	struct ubi_dev_hdr dev_hdr_2 = { 0 };
 
-	ret = get_dev_hdr(mtd, &db_state, &dev_hdr_1, &dev_hdr_2);
+	ret = get_dev_hdr(flash, &db_state, &dev_hdr_1, &dev_hdr_2);
 
 	if (0 != ret)
 		return ret;
@@ -313,9 +681,9 @@ int ubi_dev_hdr_read(const struct ubi_mtd *mtd, struct ubi_dev_hdr *hdr)
 	return -EACCES;
 }
 
-int ubi_vol_hdr_read(const struct ubi_mtd *mtd, const size_t index, struct ubi_vol_hdr *hdr)
+int ubi_vol_hdr_read(const struct ubi_flash *flash, const size_t index, struct ubi_vol_hdr *hdr)
 {
-	if (!mtd || index > CONFIG_UBI_MAX_NR_OF_VOLUMES || !hdr)
+	if (!flash || index > CONFIG_UBI_MAX_NR_OF_VOLUMES || !hdr)
 		return -EINVAL;
 
 	int ret = -EIO;
@@ -326,7 +694,7 @@ int ubi_vol_hdr_read(const struct ubi_mtd *mtd, const size_t index, struct ubi_v
 	struct ubi_dev_hdr dev_hdr_1 = { 0 };
 	struct ubi_dev_hdr dev_hdr_2 = { 0 };
 
-	ret = get_dev_hdr(mtd, &db_state, &dev_hdr_1, &dev_hdr_2);
+	ret = get_dev_hdr(flash, &db_state, &dev_hdr_1, &dev_hdr_2);
 
 	if (0 != ret)
 		return ret;
@@ -340,13 +708,13 @@ int ubi_vol_hdr_read(const struct ubi_mtd *mtd, const size_t index, struct ubi_v
 		struct ubi_vol_hdr vol_hdr_2 = { 0 };
 
 		const struct flash_area *fa = NULL;
-		ret = flash_area_open(mtd->partition_id, &fa);
+		ret = flash_area_open(flash->mtd.partition_id, &fa);
 
 		if (0 != ret)
 			return ret;
 
 		/* 3.1 Read VID header from first bank */
-		offset = (UBI_DEV_HDR_RES_PEB_0 * mtd->erase_block_size) + UBI_DEV_HDR_SIZE +
+		offset = (UBI_DEV_HDR_RES_PEB_0 * flash->mtd.erase_block_size) + UBI_DEV_HDR_SIZE +
 			 (UBI_VOL_HDR_SIZE * index);
 		ret = flash_area_read(fa, offset, &vol_hdr_1, sizeof(vol_hdr_1));
 
@@ -361,7 +729,7 @@ int ubi_vol_hdr_read(const struct ubi_mtd *mtd, const size_t index, struct ubi_v
 		}
 
 		/* 3.2 Read VID header from second bank */
-		offset = (UBI_DEV_HDR_RES_PEB_1 * mtd->erase_block_size) + UBI_DEV_HDR_SIZE +
+		offset = (UBI_DEV_HDR_RES_PEB_1 * flash->mtd.erase_block_size) + UBI_DEV_HDR_SIZE +
 			 (UBI_VOL_HDR_SIZE * index);
 		ret = flash_area_read(fa, offset, &vol_hdr_2, sizeof(vol_hdr_2));
 
@@ -406,10 +774,10 @@ int ubi_vol_hdr_read(const struct ubi_mtd *mtd, const size_t index, struct ubi_v
 	return -EACCES;
 }
 
-int ubi_vol_hdr_append(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_hdr,
+int ubi_vol_hdr_append(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
 		       const struct ubi_vol_hdr *vol_hdr)
 {
-	if (!mtd || !dev_hdr || !vol_hdr)
+	if (!flash || !dev_hdr || !vol_hdr)
 		return -EINVAL;
 
 	int ret = -EIO;
@@ -422,7 +790,7 @@ int ubi_vol_hdr_append(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 	struct ubi_dev_hdr dev_hdr_1 = { 0 };
 	struct ubi_dev_hdr dev_hdr_2 = { 0 };
 
-	ret = get_dev_hdr(mtd, &read_db_state, &dev_hdr_1, &dev_hdr_2);
+	ret = get_dev_hdr(flash, &read_db_state, &dev_hdr_1, &dev_hdr_2);
 
 	if (0 != ret)
 		goto exit;
@@ -451,12 +819,12 @@ int ubi_vol_hdr_append(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 			goto exit;
 		}
 
-		ret = flash_area_open(mtd->partition_id, &fa);
+		ret = flash_area_open(flash->mtd.partition_id, &fa);
 
 		if (0 != ret)
 			goto exit;
 
-		offset = UBI_DEV_HDR_RES_PEB_0 * mtd->erase_block_size;
+		offset = UBI_DEV_HDR_RES_PEB_0 * flash->mtd.erase_block_size;
 		ret = flash_area_read(fa, offset, buf, buf_size - UBI_VOL_HDR_SIZE);
 
 		if (0 != ret)
@@ -467,7 +835,7 @@ int ubi_vol_hdr_append(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 
 		/* 3.2 Overwrite first bank */
 		enum dual_bank_state write_db_state = BANKS_INVALID;
-		ret = overwrite_dev_and_vol_hdrs(mtd, &write_db_state, buf, buf_size);
+		ret = overwrite_dev_and_vol_hdrs(flash, &write_db_state, buf, buf_size);
 
 		switch (write_db_state) {
 		case BANKS_VALID:
@@ -502,10 +870,10 @@ exit:
 	return ret;
 }
 
-int ubi_vol_hdr_remove(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_hdr,
+int ubi_vol_hdr_remove(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
 		       const size_t index)
 {
-	if (!mtd || !dev_hdr)
+	if (!flash || !dev_hdr)
 		return -EINVAL;
 
 	int ret = -EIO;
@@ -516,7 +884,7 @@ int ubi_vol_hdr_remove(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 	struct ubi_dev_hdr dev_hdr_1 = { 0 };
 	struct ubi_dev_hdr dev_hdr_2 = { 0 };
 
-	ret = get_dev_hdr(mtd, &read_db_state, &dev_hdr_1, &dev_hdr_2);
+	ret = get_dev_hdr(flash, &read_db_state, &dev_hdr_1, &dev_hdr_2);
 
 	if (0 != ret)
 		goto exit;
@@ -562,7 +930,7 @@ int ubi_vol_hdr_remove(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 		for (size_t vol_idx = 0; vol_idx < dev_hdr_1.vol_count; ++vol_idx) {
 			if (vol_idx != index) {
 				struct ubi_vol_hdr exist_vol_hdr = { 0 };
-				ret = ubi_vol_hdr_read(mtd, vol_idx, &exist_vol_hdr);
+				ret = ubi_vol_hdr_read(flash, vol_idx, &exist_vol_hdr);
 
 				if (0 != ret)
 					goto exit;
@@ -574,7 +942,7 @@ int ubi_vol_hdr_remove(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 
 		/* 3.2 Overwrite first bank */
 		enum dual_bank_state write_db_state = BANKS_INVALID;
-		ret = overwrite_dev_and_vol_hdrs(mtd, &write_db_state, buf, buf_size);
+		ret = overwrite_dev_and_vol_hdrs(flash, &write_db_state, buf, buf_size);
 
 		switch (write_db_state) {
 		case BANKS_VALID:
@@ -606,10 +974,10 @@ exit:
 	return ret;
 }
 
-int ubi_vol_hdr_update(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_hdr,
+int ubi_vol_hdr_update(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
 		       const size_t index, const struct ubi_vol_hdr *vol_hdr)
 {
-	if (!mtd || !dev_hdr)
+	if (!flash || !dev_hdr)
 		return -EINVAL;
 
 	int ret = -EIO;
@@ -621,7 +989,7 @@ int ubi_vol_hdr_update(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 	struct ubi_dev_hdr dev_hdr_1 = { 0 };
 	struct ubi_dev_hdr dev_hdr_2 = { 0 };
 
-	ret = get_dev_hdr(mtd, &read_db_state, &dev_hdr_1, &dev_hdr_2);
+	ret = get_dev_hdr(flash, &read_db_state, &dev_hdr_1, &dev_hdr_2);
 
 	if (0 != ret)
 		goto exit;
@@ -662,7 +1030,7 @@ int ubi_vol_hdr_update(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 		for (size_t vol_idx = 0; vol_idx < dev_hdr_1.vol_count; ++vol_idx) {
 			if (vol_idx != index) {
 				struct ubi_vol_hdr exist_vol_hdr = { 0 };
-				ret = ubi_vol_hdr_read(mtd, vol_idx, &exist_vol_hdr);
+				ret = ubi_vol_hdr_read(flash, vol_idx, &exist_vol_hdr);
 
 				if (0 != ret)
 					goto exit;
@@ -682,7 +1050,7 @@ int ubi_vol_hdr_update(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 
 		/* 3.2 Overwrite first bank */
 		enum dual_bank_state write_db_state = BANKS_INVALID;
-		ret = overwrite_dev_and_vol_hdrs(mtd, &write_db_state, buf, buf_size);
+		ret = overwrite_dev_and_vol_hdrs(flash, &write_db_state, buf, buf_size);
 
 		switch (write_db_state) {
 		case BANKS_VALID:
@@ -713,28 +1081,100 @@ exit:
 	return ret;
 }
 
-int ubi_ec_hdr_read(const struct ubi_mtd *mtd, const size_t pnum, struct ubi_ec_hdr *hdr)
+int ubi_vol_table_write(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
+			const struct ubi_vol_hdr *vol_hdrs)
 {
+	if (!flash || !dev_hdr || (!vol_hdrs && 0 != dev_hdr->vol_count))
+		return -EINVAL;
+
+	if (dev_hdr->vol_count > CONFIG_UBI_MAX_NR_OF_VOLUMES)
+		return -ENOSPC;
+
 	int ret = -EIO;
 
-	if (!mtd)
-		return -EINVAL;
+	uint8_t *buf = NULL;
 
-	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	enum dual_bank_state read_db_state = BANKS_INVALID;
+	struct ubi_dev_hdr dev_hdr_1 = { 0 };
+	struct ubi_dev_hdr dev_hdr_2 = { 0 };
+
+	ret = get_dev_hdr(flash, &read_db_state, &dev_hdr_1, &dev_hdr_2);
 
 	if (0 != ret)
-		return ret;
+		goto exit;
+
+	switch (read_db_state) {
+	case BANKS_VALID: {
+		if (dev_hdr_1.revision + 1 != dev_hdr->revision) {
+			ret = -EINVAL;
+			goto exit;
+		}
 
-	const size_t nr_of_pebs = fa->fa_size / mtd->erase_block_size;
+		const size_t vols_len = dev_hdr->vol_count * UBI_VOL_HDR_SIZE;
+		const size_t buf_size = UBI_DEV_HDR_SIZE + vols_len;
 
-	if (nr_of_pebs < pnum || UBI_DEV_HDR_RES_PEB_0 == pnum || UBI_DEV_HDR_RES_PEB_1 == pnum) {
-		ret = -EINVAL;
-		goto exit;
+		buf = k_malloc(buf_size);
+
+		if (!buf) {
+			ret = -ENOMEM;
+			goto exit;
+		}
+
+		memcpy(&buf[0], dev_hdr, UBI_DEV_HDR_SIZE);
+
+		if (vols_len > 0)
+			memcpy(&buf[UBI_DEV_HDR_SIZE], vol_hdrs, vols_len);
+
+		enum dual_bank_state write_db_state = BANKS_INVALID;
+		ret = overwrite_dev_and_vol_hdrs(flash, &write_db_state, buf, buf_size);
+
+		switch (write_db_state) {
+		case BANKS_VALID:
+			break;
+
+		case BANKS_INVALID:
+		case BANK1_VALID:
+		case BANK2_VALID:
+			/* Newest complete bank is recovered on next attach */
+			if (0 == ret)
+				ret = -EIO;
+
+			goto exit;
+		}
+
+		break;
 	}
 
+	case BANKS_INVALID:
+	case BANK1_VALID:
+	case BANK2_VALID:
+		ret = -EACCES;
+		break;
+	}
+
+exit:
+	if (buf)
+		k_free(buf);
+
+	return ret;
+}
+
+int ubi_ec_hdr_read(const struct ubi_flash *flash, const size_t pnum, struct ubi_ec_hdr *hdr)
+{
+	int ret = -EIO;
+
+	if (!flash)
+		return -EINVAL;
+
+	const struct flash_area *fa = NULL;
+	size_t peb_offset = 0;
+	ret = peb_open(flash, pnum, &fa, &peb_offset);
+
+	if (0 != ret)
+		return ret;
+
 	struct ubi_ec_hdr ec_hdr = { 0 };
-	ret = flash_area_read(fa, pnum * mtd->erase_block_size, &ec_hdr, sizeof(ec_hdr));
+	ret = flash_area_read(fa, peb_offset, &ec_hdr, sizeof(ec_hdr));
 
 	if (ret != 0)
 		goto exit;
@@ -756,27 +1196,21 @@ exit:
 	return ret;
 }
 
-int ubi_ec_hdr_write(const struct ubi_mtd *mtd, const size_t pnum, const struct ubi_ec_hdr *hdr)
+int ubi_ec_hdr_write(const struct ubi_flash *flash, const size_t pnum, const struct ubi_ec_hdr *hdr)
 {
 	int ret = -EIO;
 
-	if (!mtd || !hdr)
+	if (!flash || !hdr)
 		return -EINVAL;
 
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	size_t peb_offset = 0;
+	ret = peb_open(flash, pnum, &fa, &peb_offset);
 
 	if (0 != ret)
 		goto exit;
 
-	const size_t nr_of_pebs = fa->fa_size / mtd->erase_block_size;
-
-	if (nr_of_pebs < pnum || UBI_DEV_HDR_RES_PEB_0 == pnum || UBI_DEV_HDR_RES_PEB_1 == pnum) {
-		ret = -EINVAL;
-		goto exit;
-	}
-
-	ret = flash_area_write(fa, pnum * mtd->erase_block_size, hdr, sizeof(*hdr));
+	ret = flash_area_write(fa, peb_offset, hdr, sizeof(*hdr));
 
 	if (ret != 0)
 		goto exit;
@@ -788,31 +1222,23 @@ exit:
 	return ret;
 }
 
-int ubi_vid_hdr_read(const struct ubi_mtd *mtd, const size_t pnum, struct ubi_vid_hdr *vid_hdr,
+int ubi_vid_hdr_read(const struct ubi_flash *flash, const size_t pnum, struct ubi_vid_hdr *vid_hdr,
 		     bool check)
 {
 	int ret = -EIO;
 
-	if (!mtd)
+	if (!flash)
 		return -EINVAL;
 
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	size_t peb_offset = 0;
+	ret = peb_open(flash, pnum, &fa, &peb_offset);
 
 	if (0 != ret)
 		return ret;
 
-	const size_t total_nr_of_pebs = fa->fa_size / mtd->erase_block_size;
-
-	if (pnum > total_nr_of_pebs || UBI_DEV_HDR_RES_PEB_0 == pnum ||
-	    UBI_DEV_HDR_RES_PEB_1 == pnum) {
-		ret = -EINVAL;
-		goto exit;
-	}
-
 	struct ubi_vid_hdr hdr = { 0 };
-	ret = flash_area_read(fa, (pnum * mtd->erase_block_size) + UBI_EC_HDR_SIZE, &hdr,
-			      sizeof(hdr));
+	ret = flash_area_read(fa, peb_offset + UBI_EC_HDR_SIZE, &hdr, sizeof(hdr));
 
 	if (ret != 0)
 		goto exit;
@@ -836,29 +1262,21 @@ exit:
 	return ret;
 }
 
-int ubi_vid_hdr_write(const struct ubi_mtd *mtd, const size_t pnum, struct ubi_vid_hdr *vid_hdr)
+int ubi_vid_hdr_write(const struct ubi_flash *flash, const size_t pnum, struct ubi_vid_hdr *vid_hdr)
 {
 	int ret = -EIO;
 
-	if (!mtd || !vid_hdr)
+	if (!flash || !vid_hdr)
 		return -EINVAL;
 
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	size_t peb_offset = 0;
+	ret = peb_open(flash, pnum, &fa, &peb_offset);
 
 	if (0 != ret)
 		goto exit;
 
-	const size_t total_nr_of_pebs = fa->fa_size / mtd->erase_block_size;
-
-	if (pnum > total_nr_of_pebs || UBI_DEV_HDR_RES_PEB_0 == pnum ||
-	    UBI_DEV_HDR_RES_PEB_1 == pnum) {
-		ret = -EINVAL;
-		goto exit;
-	}
-
-	ret = flash_area_write(fa, (pnum * mtd->erase_block_size) + UBI_EC_HDR_SIZE, vid_hdr,
-			       sizeof(*vid_hdr));
+	ret = flash_area_write(fa, peb_offset + UBI_EC_HDR_SIZE, vid_hdr, sizeof(*vid_hdr));
 
 	if (ret != 0)
 		goto exit;
@@ -870,33 +1288,27 @@ exit:
 	return ret;
 }
 
-int ubi_leb_data_write(const struct ubi_mtd *mtd, const size_t pnum, const uint8_t *buf, size_t len)
+int ubi_leb_data_write(const struct ubi_flash *flash, const size_t pnum, size_t offset,
+		       const uint8_t *buf, size_t len)
 {
 	int ret = -EIO;
 
-	if (!mtd || !buf || 0 == len)
+	if (!flash || !buf || 0 == len || 0 != offset % WRITE_BLOCK_SIZE_ALIGNMENT)
 		return -EINVAL;
 
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	size_t peb_offset = 0;
+	ret = peb_open(flash, pnum, &fa, &peb_offset);
 
 	if (0 != ret)
 		goto exit;
 
-	const size_t total_nr_of_pebs = fa->fa_size / mtd->erase_block_size;
-
-	if (pnum > total_nr_of_pebs || UBI_DEV_HDR_RES_PEB_0 == pnum ||
-	    UBI_DEV_HDR_RES_PEB_1 == pnum) {
-		ret = -EINVAL;
-		goto exit;
-	}
-
-	if (len > (mtd->erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE)) {
+	if ((offset + len) > (flash->mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE)) {
 		ret = -ENOSPC;
 		goto exit;
 	}
 
-	size_t offset = (pnum * mtd->erase_block_size) + UBI_EC_HDR_SIZE + UBI_VID_HDR_SIZE;
+	offset += peb_offset + UBI_EC_HDR_SIZE + UBI_VID_HDR_SIZE;
 
 	if (0 == len % WRITE_BLOCK_SIZE_ALIGNMENT) {
 		ret = flash_area_write(fa, offset, buf, len);
@@ -938,35 +1350,27 @@ exit:
 	return ret;
 }
 
-int ubi_leb_data_read(const struct ubi_mtd *mtd, const size_t pnum, size_t offset, uint8_t *buf,
+int ubi_leb_data_read(const struct ubi_flash *flash, const size_t pnum, size_t offset, uint8_t *buf,
 		      size_t len)
 {
 	int ret = -EIO;
 
-	if (!mtd || !buf || 0 == len)
+	if (!flash || !buf || 0 == len)
 		return -EINVAL;
 
 	const struct flash_area *fa = NULL;
-	ret = flash_area_open(mtd->partition_id, &fa);
+	size_t peb_offset = 0;
+	ret = peb_open(flash, pnum, &fa, &peb_offset);
 
 	if (0 != ret)
 		goto exit;
 
-	const size_t total_nr_of_pebs = fa->fa_size / mtd->erase_block_size;
-
-	if (pnum > total_nr_of_pebs || UBI_DEV_HDR_RES_PEB_0 == pnum ||
-	    UBI_DEV_HDR_RES_PEB_1 == pnum) {
-		ret = -EINVAL;
-		goto exit;
-	}
-
-	if ((offset + len) > (mtd->erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE)) {
+	if ((offset + len) > (flash->mtd.erase_block_size - UBI_EC_HDR_SIZE - UBI_VID_HDR_SIZE)) {
 		ret = -ENOSPC;
 		goto exit;
 	}
 
-	const size_t _offset =
-		(pnum * mtd->erase_block_size) + UBI_EC_HDR_SIZE + UBI_VID_HDR_SIZE + offset;
+	const size_t _offset = peb_offset + UBI_EC_HDR_SIZE + UBI_VID_HDR_SIZE + offset;
 
 	ret = flash_area_read(fa, _offset, buf, len);
 
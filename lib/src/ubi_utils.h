@@ -39,11 +39,18 @@
 #define UBI_DEV_HDR_NR_OF_RES_PEBS (2)
 #define UBI_DEV_HDR_RES_PEB_0 (0)
 #define UBI_DEV_HDR_RES_PEB_1 (1)
+#define UBI_DEV_FLAG_STRIPED (1 << 0)
 
 /* UBI volume header constants */
 #define UBI_VOL_HDR_MAGIC (0x55424926)
 #define UBI_VOL_HDR_SIZE (48)
 #define UBI_VOL_HDR_VERSION (1)
+#define UBI_VOL_FLAG_SNAPSHOT (1 << 0)
+#define UBI_VOL_FLAG_AUTORESIZE (1 << 1)
+#define UBI_VOL_FLAG_SEALED (1 << 2)
+#define UBI_VOL_FLAG_COMPRESSED (1 << 3)
+#define UBI_VOL_FLAG_ENCRYPTED (1 << 4)
+#define UBI_VOL_FLAG_DURABLE_UNMAP (1 << 5)
 
 /* UBI erase counter header constants */
 #define UBI_EC_HDR_MAGIC (0x55424923)
@@ -53,7 +60,14 @@
 /* UBI volume identifier header constants */
 #define UBI_VID_HDR_MAGIC (0x55424921)
 #define UBI_VID_HDR_SIZE (32)
-#define UBI_VID_HDR_VERSION (1)
+#define UBI_VID_HDR_VERSION (2)
+#define UBI_VID_FLAG_COMPRESSED (1 << 0)
+#define UBI_VID_FLAG_PATTERN (1 << 1)
+
+/* UBI unmap journal constants */
+#define UBI_UNMAP_JOURNAL_VOL_ID (0x7FFFEFFF)
+#define UBI_UNMAP_REC_MAGIC (0x55424927)
+#define UBI_UNMAP_REC_SIZE (32)
 
 /* Types and type definitions ------------------------------------------------------------------ */
 
@@ -68,7 +82,7 @@ struct ubi_dev_hdr {
 	uint32_t size; /*!< Device size */
 	uint32_t revision; /*!< Revision number */
 	uint32_t vol_count; /*!< Number of volumes */
-	uint32_t padding_2; /*!< Reserved */
+	uint32_t flags; /*!< Device flags */
 	uint32_t hdr_crc; /*!< CRC32 of header */
 };
 BUILD_ASSERT(sizeof(struct ubi_dev_hdr) == UBI_DEV_HDR_SIZE);
@@ -81,10 +95,13 @@ struct ubi_vol_hdr {
 	uint32_t magic; /*!< Magic number */
 	uint8_t version; /*!< Header version */
 	uint8_t vol_type; /*!< Volume type */
-	uint8_t padding_1[2]; /*!< Reserved */
+	uint8_t flags; /*!< Volume flags */
+	uint8_t padding_1; /*!< Reserved */
 	uint32_t vol_id; /*!< Volume ID */
 	uint32_t lebs_count; /*!< Number of logical erase blocks */
-	uint32_t padding_2[3]; /*!< Reserved */
+	uint64_t sqnum_bound; /*!< Snapshot holds LEBs with lower sequence number, other volume holds
+				 LEBs with equal or higher one */
+	uint32_t src_vol_id; /*!< Source volume ID of snapshot */
 	uint8_t name[UBI_VOLUME_NAME_MAX_LEN]; /*!< Volume name */
 	uint32_t hdr_crc; /*!< CRC32 of header */
 };
@@ -110,18 +127,104 @@ BUILD_ASSERT(sizeof(struct ubi_ec_hdr) % WRITE_BLOCK_SIZE_ALIGNMENT == 0);
 struct ubi_vid_hdr {
 	uint32_t magic; /*!< Magic number */
 	uint8_t version; /*!< Header version */
-	uint8_t padding[3]; /*!< Reserved */
+	uint8_t flags; /*!< LEB data flags, reserved before version 2 */
+	/** LEB data parameter, meaning depends on flags */
+	union {
+		uint16_t comp_blocks; /*!< Compressed data size in write blocks, if compressed */
+		uint16_t fill; /*!< Repeated byte of all data, if pattern */
+	};
 	uint32_t lnum; /*!< Logical block number */
 	uint32_t vol_id; /*!< Volume ID */
 	uint64_t sqnum; /*!< Sequence number */
-	uint32_t data_size; /*!< Data size in bytes */
+	uint32_t data_size; /*!< Data size in bytes, before compression */
 	uint32_t hdr_crc; /*!< CRC32 of header */
 };
 BUILD_ASSERT(sizeof(struct ubi_vid_hdr) == UBI_VID_HDR_SIZE);
 BUILD_ASSERT(sizeof(struct ubi_vid_hdr) % WRITE_BLOCK_SIZE_ALIGNMENT == 0);
 
+/**
+ * \brief UBI unmap record, programmed into LEB data of the unmap journal PEB.
+ *
+ * Record of the journal volume ID completes the journal, records following it are unmaps.
+ */
+struct ubi_unmap_rec {
+	uint32_t magic; /*!< Magic number */
+	uint32_t vol_id; /*!< Volume ID */
+	uint32_t lnum; /*!< First logical block number */
+	uint32_t count; /*!< Number of logical blocks */
+	uint64_t sqnum; /*!< Logical blocks hold no PEB with lower sequence number */
+	uint32_t padding; /*!< Reserved */
+	uint32_t rec_crc; /*!< CRC32 of record */
+};
+BUILD_ASSERT(sizeof(struct ubi_unmap_rec) == UBI_UNMAP_REC_SIZE);
+BUILD_ASSERT(sizeof(struct ubi_unmap_rec) % WRITE_BLOCK_SIZE_ALIGNMENT == 0);
+
+/**
+ * \brief Memory technology device together with its partition layout cached by UBI.
+ *
+ * Each UBI device and each sealed volume mapping owns one, filled by ubi_mtd_layout_cache().
+ */
+struct ubi_flash {
+	struct ubi_mtd mtd; /*!< Memory technology device as configured by the user */
+	size_t *part_ends; /*!< End of each partition in the PEB namespace */
+};
+
 /* Module interface function declarations ------------------------------------------------------ */
 
+/**
+ * \defgroup ubi_utils_mtd MTD Utilities
+ * \brief Functions for locating PEBs on concatenated partitions.
+ * \{
+ */
+
+/**
+ * \brief Cache partition layout of a memory technology device.
+ *
+ * PEBs are located by the cached end of each partition in the PEB namespace afterwards, without
+ * opening every partition on each access.
+ *
+ * \param[in,out] flash   	Pointer to memory technology device, its \p part_ends is set.
+ *
+ * \return 0 on success, -ENODEV if a partition is not ready, -ENOMEM if cache allocation fails,
+ *         or negative error code.
+ */
+int ubi_mtd_layout_cache(struct ubi_flash *flash);
+
+/**
+ * \brief Get number of PEBs in the PEB namespace of a memory technology device.
+ *
+ * \param[in] flash   		Pointer to memory technology device.
+ * \param[out] nr_of_pebs 	Number of PEBs, including reserved PEBs of device headers.
+ *
+ * \return 0 on success, -EINVAL if layout is not cached, or negative error code.
+ */
+int ubi_mtd_get_peb_count(const struct ubi_flash *flash, size_t *nr_of_pebs);
+
+/**
+ * \brief Locate a PEB of the PEB namespace on its partition.
+ *
+ * \param[in] flash   		Pointer to memory technology device.
+ * \param pnum    		Physical eraseblock number.
+ * \param[out] partition_id 	Partition holding the PEB.
+ * \param[out] offset 		Offset of the PEB within its partition.
+ *
+ * \return 0 on success, -EINVAL if PEB is out of range, or negative error code.
+ */
+int ubi_mtd_peb_locate(const struct ubi_flash *flash, size_t pnum, uint8_t *partition_id,
+		       size_t *offset);
+
+/**
+ * \brief Get stripe of a PEB, i.e. index of its partition on a striped memory technology device.
+ *
+ * \param[in] flash   		Pointer to memory technology device.
+ * \param pnum    		Physical eraseblock number, not reserved for device headers.
+ *
+ * \return Index of the partition, 0 if device is not striped.
+ */
+size_t ubi_mtd_peb_stripe(const struct ubi_flash *flash, size_t pnum);
+
+/** \} name ubi_utils_mtd */
+
 /**
  * \defgroup ubi_utils_device Device Utilities
  * \brief Functions for mounting and reading UBI device headers.
@@ -131,31 +234,44 @@ BUILD_ASSERT(sizeof(struct ubi_vid_hdr) % WRITE_BLOCK_SIZE_ALIGNMENT == 0);
 /**
  * \brief Check if a UBI device is mounted.
  *
- * \param[in] mtd        	Pointer to memory technology device.
+ * \param[in] flash      	Pointer to memory technology device.
  * \param[out] is_mounted 	Set to true if device is mounted.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_dev_is_mounted(const struct ubi_mtd *mtd, bool *is_mounted);
+int ubi_dev_is_mounted(const struct ubi_flash *flash, bool *is_mounted);
 
 /**
  * \brief Mount a UBI device.
  *
- * \param[in] mtd 		Pointer to memory technology device.
+ * \param[in] flash 		Pointer to memory technology device.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_dev_mount(const struct ubi_mtd *mtd);
+int ubi_dev_mount(const struct ubi_flash *flash);
 
 /**
  * \brief Read UBI device header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param[out] dev_hdr 		Pointer to device header structure.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_dev_hdr_read(const struct ubi_mtd *mtd, struct ubi_dev_hdr *dev_hdr);
+int ubi_dev_hdr_read(const struct ubi_flash *flash, struct ubi_dev_hdr *dev_hdr);
+
+/**
+ * \brief Recover UBI device headers after an interrupted volume table write.
+ *
+ * Both banks are compared and the complete table with the highest revision is copied over the
+ * other bank, so every table write is either fully applied or fully rolled back. Device without
+ * any complete table is left untouched.
+ *
+ * \param[in] flash   		Pointer to memory technology device.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_dev_hdr_recover(const struct ubi_flash *flash);
 
 /** \} name ubi_utils_device */
 
@@ -168,51 +284,64 @@ int ubi_dev_hdr_read(const struct ubi_mtd *mtd, struct ubi_dev_hdr *dev_hdr);
 /**
  * \brief Read a UBI volume header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param[in] index   		Volume index.
  * \param[out] vol_hdr 		Pointer to volume header structure.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_vol_hdr_read(const struct ubi_mtd *mtd, const size_t index, struct ubi_vol_hdr *vol_hdr);
+int ubi_vol_hdr_read(const struct ubi_flash *flash, const size_t index,
+		     struct ubi_vol_hdr *vol_hdr);
 
 /**
  * \brief Append a new UBI volume header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param[in] dev_hdr 		Pointer to device header.
  * \param[in] vol_hdr 		Pointer to volume header to append.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_vol_hdr_append(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_hdr,
+int ubi_vol_hdr_append(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
 		       const struct ubi_vol_hdr *vol_hdr);
 
 /**
  * \brief Remove an existing UBI volume header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param[in] dev_hdr 		Pointer to device header.
  * \param index   		Volume index to remove.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_vol_hdr_remove(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_hdr,
+int ubi_vol_hdr_remove(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
 		       const size_t index);
 
 /**
  * \brief Update an existing UBI volume header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param[in] dev_hdr 		Pointer to device header.
  * \param index   		Volume index to update.
  * \param[in] vol_hdr 		Pointer to new volume header values.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_vol_hdr_update(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_hdr,
+int ubi_vol_hdr_update(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
 		       const size_t index, const struct ubi_vol_hdr *vol_hdr);
 
+/**
+ * \brief Write a whole UBI volume table as a single new revision.
+ *
+ * \param[in] flash   		Pointer to memory technology device.
+ * \param[in] dev_hdr 		Pointer to device header with incremented revision.
+ * \param[in] vol_hdrs 		Array of \p dev_hdr vol_count volume headers.
+ *
+ * \return 0 on success, or negative error code.
+ */
+int ubi_vol_table_write(const struct ubi_flash *flash, const struct ubi_dev_hdr *dev_hdr,
+			const struct ubi_vol_hdr *vol_hdrs);
+
 /** \} name ubi_utils_volume */
 
 /**
@@ -224,24 +353,25 @@ int ubi_vol_hdr_update(const struct ubi_mtd *mtd, const struct ubi_dev_hdr *dev_
 /**
  * \brief Read an erase counter (EC) header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param pnum    		Physical eraseblock number.
  * \param[out] ec_hdr 		Pointer to EC header.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_ec_hdr_read(const struct ubi_mtd *mtd, const size_t pnum, struct ubi_ec_hdr *ec_hdr);
+int ubi_ec_hdr_read(const struct ubi_flash *flash, const size_t pnum, struct ubi_ec_hdr *ec_hdr);
 
 /**
  * \brief Write an erase counter (EC) header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param pnum    		Physical eraseblock number.
  * \param[in] ec_hdr  		Pointer to EC header.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_ec_hdr_write(const struct ubi_mtd *mtd, const size_t pnum, const struct ubi_ec_hdr *ec_hdr);
+int ubi_ec_hdr_write(const struct ubi_flash *flash, const size_t pnum,
+		     const struct ubi_ec_hdr *ec_hdr);
 
 /** \} name ubi_utils_ec */
 
@@ -254,26 +384,27 @@ int ubi_ec_hdr_write(const struct ubi_mtd *mtd, const size_t pnum, const struct
 /**
  * \brief Read a volume identifier (VID) header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param pnum    		Physical eraseblock number.
  * \param[out] vid_hdr 		Pointer to VID header.
  * \param check   		Validate header CRC if true.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_vid_hdr_read(const struct ubi_mtd *mtd, const size_t pnum, struct ubi_vid_hdr *vid_hdr,
+int ubi_vid_hdr_read(const struct ubi_flash *flash, const size_t pnum, struct ubi_vid_hdr *vid_hdr,
 		     bool check);
 
 /**
  * \brief Write a volume identifier (VID) header.
  *
- * \param[in] mtd     		Pointer to memory technology device.
+ * \param[in] flash   		Pointer to memory technology device.
  * \param pnum    		Physical eraseblock number.
  * \param[in] vid_hdr 		Pointer to VID header.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_vid_hdr_write(const struct ubi_mtd *mtd, const size_t pnum, struct ubi_vid_hdr *vid_hdr);
+int ubi_vid_hdr_write(const struct ubi_flash *flash, const size_t pnum,
+		      struct ubi_vid_hdr *vid_hdr);
 
 /** \} name ubi_utils_vid */
 
@@ -286,20 +417,22 @@ int ubi_vid_hdr_write(const struct ubi_mtd *mtd, const size_t pnum, struct ubi_v
 /**
  * \brief Write data to a logical erase block (LEB).
  *
- * \param[in] mtd  		Pointer to memory technology device.
+ * \param[in] flash  		Pointer to memory technology device.
  * \param pnum 			Physical eraseblock number.
+ * \param offset 		Offset in bytes within the block, aligned to
+ * 				\ref WRITE_BLOCK_SIZE_ALIGNMENT.
  * \param[in] buf  		Data buffer.
  * \param len  			Length of data in bytes.
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_leb_data_write(const struct ubi_mtd *mtd, const size_t pnum, const uint8_t *buf,
-		       size_t len);
+int ubi_leb_data_write(const struct ubi_flash *flash, const size_t pnum, size_t offset,
+		       const uint8_t *buf, size_t len);
 
 /**
  * \brief Read data from a logical erase block (LEB).
  *
- * \param[in] mtd  		Pointer to memory technology device.
+ * \param[in] flash  		Pointer to memory technology device.
  * \param pnum 			Physical eraseblock number.
  * \param offset 		Offset in bytes within the block.
  * \param[out] buf 		Output buffer.
@@ -307,7 +440,7 @@ int ubi_leb_data_write(const struct ubi_mtd *mtd, const size_t pnum, const uint8
  *
  * \return 0 on success, or negative error code.
  */
-int ubi_leb_data_read(const struct ubi_mtd *mtd, const size_t pnum, size_t offset, uint8_t *buf,
+int ubi_leb_data_read(const struct ubi_flash *flash, const size_t pnum, size_t offset, uint8_t *buf,
 		      size_t len);
 
 /** \} name ubi_utils_data */
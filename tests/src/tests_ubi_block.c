@@ -0,0 +1,370 @@
+/**
+ * \file    tests_ubi_block.c
+ *
+ * \author  Kamil Kielbasa
+ *
+ * \brief   Hardware tests for Unsorted Block Images (UBI) block device layer.
+ *
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* UBI header: */
+#include <ubi.h>
+#include <ubi_block.h>
+
+/* Zephyr headers: */
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/disk_access.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/toolchain/common.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define UBI_PARTITION_NAME ubi_partition
+#define UBI_PARTITION_DEVICE FIXED_PARTITION_DEVICE(UBI_PARTITION_NAME)
+#define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
+#define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
+
+#define UBI_DISK_NAME "UBI_BLK"
+#define SECTOR_SIZE (CONFIG_UBI_BLOCK_SECTOR_SIZE)
+
+/* Module types and type definitiones ---------------------------------------------------------- */
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+
+static struct ubi_mtd mtd = { 0 };
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+extern struct sys_heap _system_heap;
+#endif
+
+static struct sys_memory_stats before_init = { 0 };
+static struct sys_memory_stats after_init = { 0 };
+static struct sys_memory_stats after_deinit = { 0 };
+
+static uint8_t wsector[SECTOR_SIZE] = { 0 };
+static uint8_t rsector[SECTOR_SIZE] = { 0 };
+
+/* Static function declarations ---------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void);
+static void ztest_suite_after(void *ctx);
+
+static void ztest_testcase_before(void *ctx);
+static void ztest_testcase_teardown(void *ctx);
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit);
+
+static void sector_fill(uint8_t *buf, uint32_t sector);
+
+static uint32_t iops(size_t ops, int64_t start_ticks);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void)
+{
+	const struct device *flash_dev = UBI_PARTITION_DEVICE;
+	zassert_true(device_is_ready(flash_dev));
+
+	struct flash_pages_info page_info = { 0 };
+	zassert_ok(flash_get_page_info_by_offs(flash_dev, 0, &page_info));
+
+	const size_t write_block_size = flash_get_write_block_size(flash_dev);
+	const size_t erase_block_size = page_info.size;
+
+	mtd.partition_id = FIXED_PARTITION_ID(UBI_PARTITION_NAME);
+	mtd.erase_block_size = erase_block_size;
+	mtd.write_block_size = write_block_size;
+
+	return NULL;
+}
+
+static void ztest_suite_after(void *ctx)
+{
+	(void)ctx;
+
+	return;
+}
+
+static void ztest_testcase_before(void *ctx)
+{
+	(void)ctx;
+
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET, UBI_PARTITION_SIZE));
+
+	return;
+}
+
+static void ztest_testcase_teardown(void *ctx)
+{
+	(void)ctx;
+	return;
+}
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit)
+{
+	zassert_not_null(before_init);
+	zassert_not_null(after_init);
+	zassert_not_null(after_deinit);
+
+	zassert_equal(before_init->free_bytes, after_deinit->free_bytes);
+	zassert_equal(before_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	zassert_not_equal(after_init->free_bytes, after_deinit->free_bytes);
+	zassert_not_equal(after_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	memset(before_init, 0, sizeof(*before_init));
+	memset(after_init, 0, sizeof(*after_init));
+	memset(after_deinit, 0, sizeof(*after_deinit));
+}
+
+static void sector_fill(uint8_t *buf, uint32_t sector)
+{
+	for (size_t i = 0; i < SECTOR_SIZE; ++i)
+		buf[i] = (uint8_t)(sector * 31 + i);
+}
+
+static uint32_t iops(size_t ops, int64_t start_ticks)
+{
+	const uint64_t elapsed_us = MAX(1, k_ticks_to_us_floor64(k_uptime_ticks() - start_ticks));
+
+	return (uint32_t)((ops * 1000000ULL) / elapsed_us);
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+ZTEST_SUITE(ubi_block, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
+	    ztest_suite_after);
+
+ZTEST(ubi_block, write_read_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_block *block = NULL;
+	struct ubi_block_info info = { 0 };
+	int vol_id = -1;
+
+	/* 1. Initialize device, volume and block device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	zassert_ok(ubi_block_create(ubi, vol_id, UBI_DISK_NAME, &block));
+	zassert_not_null(block);
+
+	zassert_ok(disk_access_init(UBI_DISK_NAME));
+	zassert_equal(DISK_STATUS_OK, disk_access_status(UBI_DISK_NAME));
+
+	/* 2. Verify geometry */
+	uint32_t sector_count = 0;
+	uint32_t sector_size = 0;
+	uint32_t erase_size = 0;
+
+	zassert_ok(disk_access_ioctl(UBI_DISK_NAME, DISK_IOCTL_GET_SECTOR_COUNT, &sector_count));
+	zassert_ok(disk_access_ioctl(UBI_DISK_NAME, DISK_IOCTL_GET_SECTOR_SIZE, &sector_size));
+	zassert_ok(disk_access_ioctl(UBI_DISK_NAME, DISK_IOCTL_GET_ERASE_BLOCK_SZ, &erase_size));
+
+	zassert_ok(ubi_block_get_info(block, &info));
+	zassert_equal(SECTOR_SIZE, sector_size);
+	zassert_equal(info.sector_count, sector_count);
+	zassert_equal(info.sectors_per_leb, erase_size);
+	zassert_equal(vol_cfg.leb_count * info.sectors_per_leb, sector_count);
+
+	/* 3. Unwritten sectors read as erased */
+	zassert_ok(disk_access_read(UBI_DISK_NAME, rsector, 0, 1));
+	for (size_t i = 0; i < SECTOR_SIZE; ++i)
+		zassert_equal(0xff, rsector[i]);
+
+	/* 4. Write every sector in reverse order to force cache write backs */
+	for (uint32_t sector = sector_count; sector > 0; --sector) {
+		sector_fill(wsector, sector - 1);
+		zassert_ok(disk_access_write(UBI_DISK_NAME, wsector, sector - 1, 1));
+	}
+
+	zassert_ok(disk_access_ioctl(UBI_DISK_NAME, DISK_IOCTL_CTRL_SYNC, NULL));
+
+	for (uint32_t sector = 0; sector < sector_count; ++sector) {
+		sector_fill(wsector, sector);
+		zassert_ok(disk_access_read(UBI_DISK_NAME, rsector, sector, 1));
+		zassert_mem_equal(wsector, rsector, SECTOR_SIZE, "Memory blocks are not equal");
+	}
+
+	zassert_ok(ubi_block_get_info(block, &info));
+	zassert_equal(vol_cfg.leb_count, info.leb_writes);
+
+	/* 5. Out of range access is rejected */
+	zassert_equal(-EINVAL, disk_access_read(UBI_DISK_NAME, rsector, sector_count, 1));
+	zassert_equal(-EINVAL, disk_access_write(UBI_DISK_NAME, wsector, sector_count, 1));
+
+	/* 6. Deinitialize block device and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_block_destroy(block));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 7. Initialize device and block device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	block = NULL;
+	zassert_ok(ubi_block_create(ubi, vol_id, UBI_DISK_NAME, &block));
+	zassert_not_null(block);
+
+	zassert_ok(disk_access_init(UBI_DISK_NAME));
+
+	/* 8. Verify sectors after reboot */
+	for (uint32_t sector = 0; sector < sector_count; ++sector) {
+		sector_fill(wsector, sector);
+		zassert_ok(disk_access_read(UBI_DISK_NAME, rsector, sector, 1));
+		zassert_mem_equal(wsector, rsector, SECTOR_SIZE, "Memory blocks are not equal");
+	}
+
+	/* 9. Deinitialize block device and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_block_destroy(block));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_block, static_volume_is_write_protected)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_STATIC,
+		.leb_count = 2,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_block *block = NULL;
+	int vol_id = -1;
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(ubi_block_create(ubi, vol_id, UBI_DISK_NAME, &block));
+
+	zassert_ok(disk_access_init(UBI_DISK_NAME));
+	zassert_equal(DISK_STATUS_WR_PROTECT, disk_access_status(UBI_DISK_NAME));
+	zassert_equal(-EROFS, disk_access_write(UBI_DISK_NAME, wsector, 0, 1));
+
+	zassert_ok(ubi_block_destroy(block));
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_block, sector_iops)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_block *block = NULL;
+	struct ubi_block_info info = { 0 };
+	int vol_id = -1;
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(ubi_block_create(ubi, vol_id, UBI_DISK_NAME, &block));
+	zassert_ok(disk_access_init(UBI_DISK_NAME));
+	zassert_ok(ubi_block_get_info(block, &info));
+
+	const uint32_t sector_count = info.sector_count;
+
+	/* 1. Sequential single sector writes, write back included */
+	int64_t start = k_uptime_ticks();
+
+	for (uint32_t sector = 0; sector < sector_count; ++sector) {
+		sector_fill(wsector, sector);
+		zassert_ok(disk_access_write(UBI_DISK_NAME, wsector, sector, 1));
+	}
+
+	zassert_ok(disk_access_ioctl(UBI_DISK_NAME, DISK_IOCTL_CTRL_SYNC, NULL));
+
+	const uint32_t seq_write_iops = iops(sector_count, start);
+
+	/* 2. Sequential single sector reads, only the last LEB is served by the cache */
+	start = k_uptime_ticks();
+
+	for (uint32_t sector = 0; sector < sector_count; ++sector)
+		zassert_ok(disk_access_read(UBI_DISK_NAME, rsector, sector, 1));
+
+	const uint32_t seq_read_iops = iops(sector_count, start);
+
+	/* 3. Strided single sector writes, every write switches the cached LEB */
+	start = k_uptime_ticks();
+
+	size_t ops = 0;
+	for (uint32_t idx = 0; idx < info.sectors_per_leb; ++idx) {
+		for (uint32_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+			const uint32_t sector = lnum * info.sectors_per_leb + idx;
+
+			sector_fill(wsector, sector);
+			zassert_ok(disk_access_write(UBI_DISK_NAME, wsector, sector, 1));
+			ops += 1;
+
+			if (ops == 2 * vol_cfg.leb_count)
+				goto strided_done;
+		}
+	}
+
+strided_done:
+	zassert_ok(disk_access_ioctl(UBI_DISK_NAME, DISK_IOCTL_CTRL_SYNC, NULL));
+
+	const uint32_t strided_write_iops = iops(ops, start);
+
+	for (uint32_t sector = 0; sector < sector_count; ++sector) {
+		sector_fill(wsector, sector);
+		zassert_ok(disk_access_read(UBI_DISK_NAME, rsector, sector, 1));
+		zassert_mem_equal(wsector, rsector, SECTOR_SIZE, "Memory blocks are not equal");
+	}
+
+	TC_PRINT("ubi_block: sector size %u B, %u sectors per LEB\n", SECTOR_SIZE,
+		 (uint32_t)info.sectors_per_leb);
+	TC_PRINT("ubi_block: sequential write %u IOPS\n", seq_write_iops);
+	TC_PRINT("ubi_block: sequential read %u IOPS\n", seq_read_iops);
+	TC_PRINT("ubi_block: strided write %u IOPS\n", strided_write_iops);
+
+	zassert_true(seq_write_iops > 0);
+	zassert_true(seq_read_iops > 0);
+	zassert_true(strided_write_iops > 0);
+
+	zassert_ok(ubi_block_destroy(block));
+	zassert_ok(ubi_device_deinit(ubi));
+}
@@ -38,6 +38,14 @@
 #define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
 #define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
 
+#define RAW_PARTITION_NAME raw_partition
+#define RAW_PARTITION_ID FIXED_PARTITION_ID(RAW_PARTITION_NAME)
+#define RAW_PARTITION_DEVICE FIXED_PARTITION_DEVICE(RAW_PARTITION_NAME)
+#define RAW_PARTITION_OFFSET FIXED_PARTITION_OFFSET(RAW_PARTITION_NAME)
+#define RAW_PARTITION_SIZE FIXED_PARTITION_SIZE(RAW_PARTITION_NAME)
+
+#define MAX_PEB_SIZE (8192)
+
 /* Module types and type definitiones ---------------------------------------------------------- */
 /* Module interface variables and constants ---------------------------------------------------- */
 /* Static variables and constants -------------------------------------------------------------- */
@@ -52,6 +60,10 @@ static struct sys_memory_stats before_init = { 0 };
 static struct sys_memory_stats after_init = { 0 };
 static struct sys_memory_stats after_deinit = { 0 };
 
+static const uint8_t concat_ids[] = { RAW_PARTITION_ID };
+
+static uint8_t peb_buf[MAX_PEB_SIZE] = { 0 };
+
 /* Static function declarations ---------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void);
@@ -65,6 +77,9 @@ static void memory_check(struct sys_memory_stats *before_init, struct sys_memory
 
 static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec);
 
+static bool partition_holds(const struct device *flash_dev, size_t offset, size_t size,
+			    const uint8_t *data, size_t len);
+
 /* Static function definitions ----------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void)
@@ -144,6 +159,23 @@ static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec)
 	k_free(peb_ec);
 }
 
+static bool partition_holds(const struct device *flash_dev, size_t offset, size_t size,
+			    const uint8_t *data, size_t len)
+{
+	zassert_true(mtd.erase_block_size <= sizeof(peb_buf));
+
+	for (size_t peb = 0; peb < size; peb += mtd.erase_block_size) {
+		zassert_ok(flash_read(flash_dev, offset + peb, peb_buf, mtd.erase_block_size));
+
+		for (size_t pos = 0; pos + len <= mtd.erase_block_size; ++pos) {
+			if (0 == memcmp(&peb_buf[pos], data, len))
+				return true;
+		}
+	}
+
+	return false;
+}
+
 /* Module interface function definitions ------------------------------------------------------- */
 
 ZTEST_SUITE(ubi_device, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
@@ -247,3 +279,297 @@ ZTEST(ubi_device, init_deinit_reboot)
 
 	memory_check(&before_init, &after_init, &after_deinit);
 }
+
+ZTEST(ubi_device, init_failure_frees_memory)
+{
+	struct ubi_mtd bad_mtd = mtd;
+	struct ubi_device *ubi = NULL;
+
+	/* 1. Format device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 2. Failure before partition layout is cached frees the device */
+	bad_mtd.concat_count = 1;
+	bad_mtd.concat_ids = NULL;
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_equal(-EINVAL, ubi_device_init(&bad_mtd, &ubi));
+	zassert_is_null(ubi);
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	zassert_equal(before_init.free_bytes, after_deinit.free_bytes);
+	zassert_equal(before_init.allocated_bytes, after_deinit.allocated_bytes);
+
+	/* 3. Failure after partition layout is cached frees the device and the layout */
+	bad_mtd = mtd;
+	bad_mtd.striped = true;
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_equal(-EINVAL, ubi_device_init(&bad_mtd, &ubi));
+	zassert_is_null(ubi);
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	zassert_equal(before_init.free_bytes, after_deinit.free_bytes);
+	zassert_equal(before_init.allocated_bytes, after_deinit.allocated_bytes);
+
+	/* 4. Device is still attached with its formatted layout */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_device, reserved_pebs_and_on_demand_erase)
+{
+	const size_t total_nr_of_pebs = (UBI_PARTITION_SIZE / mtd.erase_block_size) - 2;
+	const size_t exp_rsvd_pebs =
+		DIV_ROUND_UP(total_nr_of_pebs * CONFIG_UBI_RESERVED_PEBS_PER1024, 1024);
+
+	struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 0,
+	};
+	int vol_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+
+	uint8_t data[64] = { 0 };
+	uint8_t buf[64] = { 0 };
+
+	/* Reserve is configured by overlay-reserved-pebs.conf */
+	if (0 == CONFIG_UBI_RESERVED_PEBS_PER1024)
+		ztest_test_skip();
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_true(exp_rsvd_pebs > 0);
+	zassert_equal(exp_rsvd_pebs, info.reserved_leb_count);
+
+	/* 2. Reserved PEBs are excluded from allocation */
+	vol_cfg.leb_count = total_nr_of_pebs - exp_rsvd_pebs + 1;
+	zassert_equal(-ENOSPC, ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	vol_cfg.leb_count = 1;
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	/* 3. Rewrites beyond free PEBs erase dirty PEBs on demand */
+	for (size_t i = 0; i < 2 * total_nr_of_pebs; ++i) {
+		memset(data, (uint8_t)i, sizeof(data));
+		zassert_ok(ubi_leb_write(ubi, vol_id, 0, data, sizeof(data)));
+	}
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.free_leb_count);
+	zassert_equal(total_nr_of_pebs - 1, info.dirty_leb_count);
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(data, buf, sizeof(buf));
+
+	/* 4. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_device, concatenated_and_striped_mtds_with_reboot)
+{
+	const size_t ubi_nr_of_pebs = (UBI_PARTITION_SIZE / mtd.erase_block_size) - 2;
+	const size_t raw_nr_of_pebs = RAW_PARTITION_SIZE / mtd.erase_block_size;
+
+	struct ubi_mtd concat_mtd = mtd;
+	concat_mtd.concat_ids = concat_ids;
+	concat_mtd.concat_count = ARRAY_SIZE(concat_ids);
+
+	struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 0,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	int vol_id = -1;
+
+	uint8_t data[32] = { 0 };
+	uint8_t buf[32] = { 0 };
+
+	zassert_ok(flash_erase(RAW_PARTITION_DEVICE, RAW_PARTITION_OFFSET, RAW_PARTITION_SIZE));
+
+	/* 1. Initialize device over both partitions and fill all LEBs */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&concat_mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(ubi_nr_of_pebs + raw_nr_of_pebs, info.leb_total_count);
+	zassert_equal(info.leb_total_count, info.free_leb_count);
+
+	vol_cfg.leb_count = info.leb_total_count - info.reserved_leb_count;
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		for (size_t i = 0; i < sizeof(data); ++i)
+			data[i] = (uint8_t)(lnum * sizeof(data) + i);
+
+		zassert_ok(ubi_leb_write(ubi, vol_id, lnum, data, sizeof(data)));
+	}
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	erase_counters_check(ubi, 0);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 2. Verify device cannot be attached with a different partition list */
+	ubi = NULL;
+	zassert_equal(-EINVAL, ubi_device_init(&mtd, &ubi));
+	zassert_is_null(ubi);
+
+	/* 3. Initialize device and verify all LEBs */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&concat_mtd, &ubi));
+	zassert_not_null(ubi);
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		for (size_t i = 0; i < sizeof(data); ++i)
+			data[i] = (uint8_t)(lnum * sizeof(data) + i);
+
+		zassert_ok(ubi_leb_read(ubi, vol_id, lnum, 0, buf, sizeof(buf)));
+		zassert_mem_equal(data, buf, sizeof(buf));
+	}
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 4. Initialize striped device over both partitions */
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET, UBI_PARTITION_SIZE));
+	zassert_ok(flash_erase(RAW_PARTITION_DEVICE, RAW_PARTITION_OFFSET, RAW_PARTITION_SIZE));
+
+	concat_mtd.striped = true;
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&concat_mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(2 * MIN(ubi_nr_of_pebs, raw_nr_of_pebs), info.leb_total_count);
+
+	/* 5. Write consecutive LEBs and verify they alternate between partitions */
+	vol_cfg.leb_count = 4;
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		for (size_t i = 0; i < sizeof(data); ++i)
+			data[i] = (uint8_t)(lnum * sizeof(data) + i);
+
+		zassert_ok(ubi_leb_write(ubi, vol_id, lnum, data, sizeof(data)));
+	}
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		for (size_t i = 0; i < sizeof(data); ++i)
+			data[i] = (uint8_t)(lnum * sizeof(data) + i);
+
+		zassert_equal(0 == lnum % 2,
+			      partition_holds(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET,
+					      UBI_PARTITION_SIZE, data, sizeof(data)));
+		zassert_equal(1 == lnum % 2,
+			      partition_holds(RAW_PARTITION_DEVICE, RAW_PARTITION_OFFSET,
+					      RAW_PARTITION_SIZE, data, sizeof(data)));
+	}
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 6. Verify striped device cannot be attached as concatenated one */
+	concat_mtd.striped = false;
+
+	ubi = NULL;
+	zassert_equal(-EINVAL, ubi_device_init(&concat_mtd, &ubi));
+	zassert_is_null(ubi);
+
+	/* 7. Initialize device and verify all LEBs */
+	concat_mtd.striped = true;
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&concat_mtd, &ubi));
+	zassert_not_null(ubi);
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		for (size_t i = 0; i < sizeof(data); ++i)
+			data[i] = (uint8_t)(lnum * sizeof(data) + i);
+
+		zassert_ok(ubi_leb_read(ubi, vol_id, lnum, 0, buf, sizeof(buf)));
+		zassert_mem_equal(data, buf, sizeof(buf));
+	}
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
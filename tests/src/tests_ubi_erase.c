@@ -24,6 +24,7 @@
 #include <zephyr/drivers/flash.h>
 #include <zephyr/kernel.h>
 #include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/toolchain/common.h>
 #include <zephyr/sys/sys_heap.h>
@@ -39,6 +40,9 @@
 #define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
 #define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
 
+#define RECLAIM_STACK_SIZE (2048)
+#define RECLAIM_PRIORITY (K_LOWEST_APPLICATION_THREAD_PRIO)
+
 /* Module types and type definitiones ---------------------------------------------------------- */
 /* Module interface variables and constants ---------------------------------------------------- */
 /* Static variables and constants -------------------------------------------------------------- */
@@ -53,6 +57,11 @@ static struct sys_memory_stats before_init = { 0 };
 static struct sys_memory_stats after_init = { 0 };
 static struct sys_memory_stats after_deinit = { 0 };
 
+K_THREAD_STACK_DEFINE(reclaim_stack, RECLAIM_STACK_SIZE);
+static struct k_thread reclaim_thread;
+static atomic_t reclaim_done;
+static int reclaim_ret;
+
 /* Static function declarations ---------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void);
@@ -66,6 +75,10 @@ static void memory_check(struct sys_memory_stats *before_init, struct sys_memory
 
 static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec);
 
+static void reclaim_entry(void *p1, void *p2, void *p3);
+
+static uint32_t timed_read(struct ubi_device *ubi, int vol_id, uint8_t *buf, size_t len);
+
 /* Static function definitions ----------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void)
@@ -145,6 +158,24 @@ static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec)
 	k_free(peb_ec);
 }
 
+static void reclaim_entry(void *p1, void *p2, void *p3)
+{
+	(void)p2;
+	(void)p3;
+
+	reclaim_ret = ubi_device_maintain(p1, K_FOREVER, NULL);
+	atomic_set(&reclaim_done, 1);
+}
+
+static uint32_t timed_read(struct ubi_device *ubi, int vol_id, uint8_t *buf, size_t len)
+{
+	const uint32_t start = k_cycle_get_32();
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, buf, len));
+
+	return k_cyc_to_us_floor32(k_cycle_get_32() - start);
+}
+
 /* Module interface function definitions ------------------------------------------------------- */
 
 ZTEST_SUITE(ubi_erase, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
@@ -339,6 +370,10 @@ ZTEST(ubi_erase, many_volumes_many_lebs_operations_with_reboot)
 		&vol_cfg_2,
 	};
 
+	/* Volumes allocate every PEB, which a reserved PEB pool does not allow */
+	if (CONFIG_UBI_RESERVED_PEBS_PER1024 > 0)
+		ztest_test_skip();
+
 	/* 1. Initialize device */
 	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
 
@@ -452,3 +487,313 @@ ZTEST(ubi_erase, many_volumes_many_lebs_operations_with_reboot)
 
 	memory_check(&before_init, &after_init, &after_deinit);
 }
+
+ZTEST(ubi_erase, batch_erase_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg_1 = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	int vol_id_1 = -1;
+	const size_t lnum = 0;
+	const size_t batch = 4;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	size_t erased = 0;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 2. Rewrite one LEB until every PEB is dirty, so dirty PEBs are adjacent */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_1, &vol_id_1));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	for (size_t i = 0; i < info.leb_total_count; ++i)
+		zassert_ok(ubi_leb_write(ubi, vol_id_1, lnum, array_256, ARRAY_SIZE(array_256)));
+
+	zassert_ok(ubi_leb_unmap(ubi, vol_id_1, lnum));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.free_leb_count);
+	zassert_equal(info.leb_total_count, info.dirty_leb_count);
+
+	/* 3. Erase limited batch */
+	zassert_equal(-EINVAL, ubi_device_erase_pebs(ubi, 0, &erased));
+	zassert_ok(ubi_device_erase_pebs(ubi, batch, &erased));
+	zassert_equal(batch, erased);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(batch, info.free_leb_count);
+	zassert_equal(info.leb_total_count - batch, info.dirty_leb_count);
+
+	/* 4. Erase remaining dirty PEBs, then nothing is left to erase */
+	zassert_ok(ubi_device_erase_pebs(ubi, SIZE_MAX, &erased));
+	zassert_equal(info.leb_total_count - batch, erased);
+
+	zassert_ok(ubi_device_erase_pebs(ubi, SIZE_MAX, &erased));
+	zassert_equal(0, erased);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info.leb_total_count, info.free_leb_count);
+	zassert_equal(0, info.dirty_leb_count);
+	zassert_equal(0, info.bad_leb_count);
+
+	/* 5. Written LEB is readable again on a freshly erased PEB */
+	zassert_ok(ubi_leb_write(ubi, vol_id_1, lnum, array_256, ARRAY_SIZE(array_256)));
+
+	uint8_t rdata[ARRAY_SIZE(array_256)] = { 0 };
+	zassert_ok(ubi_leb_read(ubi, vol_id_1, lnum, 0, rdata, sizeof(rdata)));
+	zassert_mem_equal(rdata, array_256, sizeof(rdata), "Memory blocks are not equal");
+
+	/* 6. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	erase_counters_check(ubi, 1);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 7. Initialize device and verify erase counters persisted */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info.leb_total_count - 1, info.free_leb_count);
+	zassert_equal(0, info.dirty_leb_count);
+
+	/* 8. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	erase_counters_check(ubi, 1);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_erase, maintain_within_budget)
+{
+	const struct ubi_volume_config vol_cfg_1 = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	int vol_id_1 = -1;
+	const size_t lnum = 0;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	size_t remaining = 0;
+	size_t erased = 0;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 2. Rewrite one LEB until every PEB is dirty */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_1, &vol_id_1));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	for (size_t i = 0; i < info.leb_total_count; ++i)
+		zassert_ok(ubi_leb_write(ubi, vol_id_1, lnum, array_256, ARRAY_SIZE(array_256)));
+
+	zassert_ok(ubi_leb_unmap(ubi, vol_id_1, lnum));
+
+	/* 3. No budget does no work */
+	zassert_ok(ubi_device_maintain(ubi, K_NO_WAIT, &remaining));
+	zassert_equal(info.leb_total_count, remaining);
+
+	/* 4. Budget shorter than worst case erase does no work before an erase was measured */
+	zassert_ok(ubi_device_maintain(ubi, K_USEC(CONFIG_UBI_ERASE_PEB_WORST_US / 2), &remaining));
+	zassert_equal(info.leb_total_count, remaining);
+
+	/* 5. Measure worst cost of one PEB erase call */
+	uint32_t start = 0;
+	uint32_t peb_us = 0;
+
+	for (size_t i = 0; i < 3; ++i) {
+		start = k_cycle_get_32();
+		zassert_ok(ubi_device_erase_pebs(ubi, 1, &erased));
+		peb_us = MAX(peb_us, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+		zassert_equal(1, erased);
+	}
+
+	/* 6. Small budget erases some PEBs and returns in time, timer noise may double it */
+	if (0 == peb_us) {
+		TC_PRINT("ubi_erase: timer stands still during flash work, budget not checked\n");
+	} else {
+		const k_timeout_t budget = K_USEC(4 * peb_us);
+		const uint32_t budget_us = k_ticks_to_us_floor64(budget.ticks);
+
+		start = k_cycle_get_32();
+		zassert_ok(ubi_device_maintain(ubi, budget, &remaining));
+		const uint32_t elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+		TC_PRINT("ubi_erase: PEB erase %u us, budget %u us, elapsed %u us, remaining %zu\n",
+			 peb_us, budget_us, elapsed_us, remaining);
+
+		zassert_true(remaining < info.leb_total_count - 3);
+		zassert_true(elapsed_us <= 2 * budget_us);
+	}
+
+	zassert_ok(ubi_device_maintain(ubi, K_NO_WAIT, &remaining));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(remaining, info.dirty_leb_count);
+	zassert_equal(info.leb_total_count - remaining, info.free_leb_count);
+
+	/* 7. Unbounded budget does all pending work */
+	zassert_ok(ubi_device_maintain(ubi, K_FOREVER, &remaining));
+	zassert_equal(0, remaining);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info.leb_total_count, info.free_leb_count);
+	zassert_equal(0, info.dirty_leb_count);
+
+	zassert_ok(ubi_device_maintain(ubi, K_MSEC(2), NULL));
+
+	/* 8. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	erase_counters_check(ubi, 1);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_erase, read_latency_during_reclaim)
+{
+	const struct ubi_volume_config vol_cfg_1 = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	const struct ubi_volume_config vol_cfg_2 = {
+		.name = { '/', 'u', 'b', 'i', '_', '1' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	int vol_id_1 = -1;
+	int vol_id_2 = -1;
+	const size_t lnum = 0;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	uint8_t rdata[ARRAY_SIZE(array_256)] = { 0 };
+
+	/* Whole ranges erased by one call bound no read latency */
+	if (0 == CONFIG_UBI_ERASE_CHUNK_SIZE)
+		ztest_test_skip();
+
+	/* 1. Measure erase of one chunk and initialize device */
+	const uint32_t chunk_start = k_cycle_get_32();
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET,
+			       CONFIG_UBI_ERASE_CHUNK_SIZE));
+	const uint32_t chunk_us = k_cyc_to_us_floor32(k_cycle_get_32() - chunk_start);
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 2. Write LEB read by latency critical thread, then make every other PEB dirty */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_1, &vol_id_1));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_2, &vol_id_2));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	zassert_ok(ubi_leb_write(ubi, vol_id_1, lnum, array_256, ARRAY_SIZE(array_256)));
+
+	for (size_t i = 0; i < info.leb_total_count - 1; ++i)
+		zassert_ok(ubi_leb_write(ubi, vol_id_2, lnum, array_256, ARRAY_SIZE(array_256)));
+
+	zassert_ok(ubi_leb_unmap(ubi, vol_id_2, lnum));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.free_leb_count);
+	zassert_equal(info.leb_total_count - 1, info.dirty_leb_count);
+
+	/* 3. Read latency of an idle device */
+	uint32_t idle_us = 0;
+	for (size_t i = 0; i < info.dirty_leb_count; ++i)
+		idle_us = MAX(idle_us, timed_read(ubi, vol_id_1, rdata, sizeof(rdata)));
+
+	/* 4. Read latency while a lower priority thread reclaims all dirty PEBs */
+	atomic_set(&reclaim_done, 0);
+	reclaim_ret = -EIO;
+
+	const uint32_t start = k_cycle_get_32();
+
+	k_thread_create(&reclaim_thread, reclaim_stack, K_THREAD_STACK_SIZEOF(reclaim_stack),
+			reclaim_entry, ubi, NULL, NULL, K_PRIO_PREEMPT(RECLAIM_PRIORITY), 0,
+			K_NO_WAIT);
+
+	uint32_t worst_us = 0;
+	size_t reads = 0;
+
+	do {
+		worst_us = MAX(worst_us, timed_read(ubi, vol_id_1, rdata, sizeof(rdata)));
+		zassert_mem_equal(rdata, array_256, sizeof(rdata), "Memory blocks are not equal");
+		reads += 1;
+
+		k_sleep(K_USEC(100));
+	} while (!atomic_get(&reclaim_done));
+
+	zassert_ok(k_thread_join(&reclaim_thread, K_FOREVER));
+	zassert_ok(reclaim_ret);
+
+	const uint32_t reclaim_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	TC_PRINT("ubi_erase: reclaim of %zu PEBs %u us, chunk erase %u us\n",
+		 info.dirty_leb_count, reclaim_us, chunk_us);
+	TC_PRINT("ubi_erase: %zu reads, worst read latency %u us, idle %u us\n", reads, worst_us,
+		 idle_us);
+
+	/* Read waits for the chunk erase in flight and a lock hand-over at most */
+	zassert_true(worst_us <= idle_us + 2 * chunk_us);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info.leb_total_count - 1, info.free_leb_count);
+	zassert_equal(0, info.dirty_leb_count);
+
+	/* 5. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
@@ -0,0 +1,517 @@
+/**
+ * \file    tests_ubi_flash_area.c
+ *
+ * \author  Kamil Kielbasa
+ *
+ * \brief   Hardware tests for Unsorted Block Images (UBI) virtual flash area.
+ *
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* UBI header: */
+#include <ubi.h>
+#include <ubi_flash_area.h>
+
+/* Zephyr headers: */
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/toolchain/common.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define UBI_PARTITION_NAME ubi_partition
+#define UBI_PARTITION_DEVICE FIXED_PARTITION_DEVICE(UBI_PARTITION_NAME)
+#define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
+#define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
+
+#define RAW_PARTITION_NAME raw_partition
+#define RAW_PARTITION_ID FIXED_PARTITION_ID(RAW_PARTITION_NAME)
+#define RAW_PARTITION_DEVICE FIXED_PARTITION_DEVICE(RAW_PARTITION_NAME)
+#define RAW_PARTITION_OFFSET FIXED_PARTITION_OFFSET(RAW_PARTITION_NAME)
+#define RAW_PARTITION_SIZE FIXED_PARTITION_SIZE(RAW_PARTITION_NAME)
+
+#define SLOT_SECTORS (3)
+#define CHUNK_SIZE (256)
+#define TRAILER_SIZE (16)
+#define MAX_SECTOR_SIZE (8192)
+
+/* Module types and type definitiones ---------------------------------------------------------- */
+
+/**
+ * \brief Image slot backed either by UBI virtual flash area or raw flash area.
+ */
+struct slot {
+	struct ubi_flash_area *ufa; /**< UBI virtual flash area, NULL for raw slot. */
+	const struct flash_area *fa; /**< Raw flash area. */
+	off_t base; /**< Slot offset within raw flash area. */
+	size_t sector_size; /**< Sector size in bytes. */
+};
+
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+
+static struct ubi_mtd mtd = { 0 };
+static size_t raw_sector_size = 0;
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+extern struct sys_heap _system_heap;
+#endif
+
+static struct sys_memory_stats before_init = { 0 };
+static struct sys_memory_stats after_init = { 0 };
+static struct sys_memory_stats after_deinit = { 0 };
+
+static const struct ubi_volume_config primary_vol_cfg = {
+	.name = { '/', 's', 'l', 'o', 't', '_', '0' },
+	.type = UBI_VOLUME_TYPE_STATIC,
+	.leb_count = SLOT_SECTORS,
+};
+
+static const struct ubi_volume_config secondary_vol_cfg = {
+	.name = { '/', 's', 'l', 'o', 't', '_', '1' },
+	.type = UBI_VOLUME_TYPE_STATIC,
+	.leb_count = SLOT_SECTORS,
+};
+
+static uint8_t chunk[CHUNK_SIZE] = { 0 };
+static uint8_t sector_buf[MAX_SECTOR_SIZE] = { 0 };
+
+/* Static function declarations ---------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void);
+static void ztest_suite_after(void *ctx);
+
+static void ztest_testcase_before(void *ctx);
+static void ztest_testcase_teardown(void *ctx);
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit);
+
+static uint8_t pattern(size_t off, uint8_t seed);
+static void image_write(struct ubi_flash_area *ufa, size_t size, uint8_t seed);
+static void image_verify(struct ubi_flash_area *ufa, size_t size, uint8_t seed);
+
+static int slot_read(const struct slot *slot, off_t off, void *dst, size_t len);
+static int slot_write(const struct slot *slot, off_t off, const void *src, size_t len);
+static int slot_erase(const struct slot *slot, off_t off, size_t len);
+
+static void slot_fill(const struct slot *slot, uint8_t seed);
+static void slot_verify(const struct slot *slot, uint8_t seed);
+static void slot_upgrade(const struct slot *dst, const struct slot *src);
+static void slot_swap(const struct slot *primary, const struct slot *secondary);
+
+static uint32_t elapsed_ms(int64_t start_ticks);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void)
+{
+	const struct device *flash_dev = UBI_PARTITION_DEVICE;
+	zassert_true(device_is_ready(flash_dev));
+
+	struct flash_pages_info page_info = { 0 };
+	zassert_ok(flash_get_page_info_by_offs(flash_dev, 0, &page_info));
+
+	const size_t write_block_size = flash_get_write_block_size(flash_dev);
+	const size_t erase_block_size = page_info.size;
+
+	mtd.partition_id = FIXED_PARTITION_ID(UBI_PARTITION_NAME);
+	mtd.erase_block_size = erase_block_size;
+	mtd.write_block_size = write_block_size;
+
+	zassert_ok(flash_get_page_info_by_offs(RAW_PARTITION_DEVICE, RAW_PARTITION_OFFSET,
+					       &page_info));
+	raw_sector_size = page_info.size;
+
+	return NULL;
+}
+
+static void ztest_suite_after(void *ctx)
+{
+	(void)ctx;
+
+	return;
+}
+
+static void ztest_testcase_before(void *ctx)
+{
+	(void)ctx;
+
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET, UBI_PARTITION_SIZE));
+	zassert_ok(flash_erase(RAW_PARTITION_DEVICE, RAW_PARTITION_OFFSET, RAW_PARTITION_SIZE));
+
+	return;
+}
+
+static void ztest_testcase_teardown(void *ctx)
+{
+	(void)ctx;
+	return;
+}
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit)
+{
+	zassert_not_null(before_init);
+	zassert_not_null(after_init);
+	zassert_not_null(after_deinit);
+
+	zassert_equal(before_init->free_bytes, after_deinit->free_bytes);
+	zassert_equal(before_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	zassert_not_equal(after_init->free_bytes, after_deinit->free_bytes);
+	zassert_not_equal(after_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	memset(before_init, 0, sizeof(*before_init));
+	memset(after_init, 0, sizeof(*after_init));
+	memset(after_deinit, 0, sizeof(*after_deinit));
+}
+
+static uint8_t pattern(size_t off, uint8_t seed)
+{
+	return (uint8_t)((off * 31) ^ (off >> 8) ^ seed);
+}
+
+static void image_write(struct ubi_flash_area *ufa, size_t size, uint8_t seed)
+{
+	for (size_t off = 0; off < size; off += CHUNK_SIZE) {
+		const size_t len = MIN(CHUNK_SIZE, size - off);
+
+		for (size_t i = 0; i < len; ++i)
+			chunk[i] = pattern(off + i, seed);
+
+		zassert_ok(ubi_flash_area_write(ufa, off, chunk, len));
+	}
+}
+
+static void image_verify(struct ubi_flash_area *ufa, size_t size, uint8_t seed)
+{
+	for (size_t off = 0; off < size; off += CHUNK_SIZE) {
+		const size_t len = MIN(CHUNK_SIZE, size - off);
+
+		zassert_ok(ubi_flash_area_read(ufa, off, chunk, len));
+
+		for (size_t i = 0; i < len; ++i)
+			zassert_equal(pattern(off + i, seed), chunk[i]);
+	}
+}
+
+static int slot_read(const struct slot *slot, off_t off, void *dst, size_t len)
+{
+	if (slot->ufa)
+		return ubi_flash_area_read(slot->ufa, off, dst, len);
+
+	return flash_area_read(slot->fa, slot->base + off, dst, len);
+}
+
+static int slot_write(const struct slot *slot, off_t off, const void *src, size_t len)
+{
+	if (slot->ufa)
+		return ubi_flash_area_write(slot->ufa, off, src, len);
+
+	return flash_area_write(slot->fa, slot->base + off, src, len);
+}
+
+static int slot_erase(const struct slot *slot, off_t off, size_t len)
+{
+	if (slot->ufa)
+		return ubi_flash_area_erase(slot->ufa, off, len);
+
+	return flash_area_erase(slot->fa, slot->base + off, len);
+}
+
+static void slot_fill(const struct slot *slot, uint8_t seed)
+{
+	const size_t size = SLOT_SECTORS * slot->sector_size;
+
+	zassert_ok(slot_erase(slot, 0, size));
+
+	for (size_t off = 0; off < size; off += CHUNK_SIZE) {
+		const size_t len = MIN(CHUNK_SIZE, size - off);
+
+		for (size_t i = 0; i < len; ++i)
+			chunk[i] = pattern(off + i, seed);
+
+		zassert_ok(slot_write(slot, off, chunk, len));
+	}
+}
+
+static void slot_verify(const struct slot *slot, uint8_t seed)
+{
+	const size_t size = SLOT_SECTORS * slot->sector_size;
+
+	for (size_t off = 0; off < size; off += CHUNK_SIZE) {
+		const size_t len = MIN(CHUNK_SIZE, size - off);
+
+		zassert_ok(slot_read(slot, off, chunk, len));
+
+		for (size_t i = 0; i < len; ++i)
+			zassert_equal(pattern(off + i, seed), chunk[i]);
+	}
+}
+
+static void slot_upgrade(const struct slot *dst, const struct slot *src)
+{
+	for (size_t sector = 0; sector < SLOT_SECTORS; ++sector) {
+		const off_t base = sector * dst->sector_size;
+
+		zassert_ok(slot_erase(dst, base, dst->sector_size));
+
+		for (size_t off = 0; off < dst->sector_size; off += CHUNK_SIZE) {
+			const size_t len = MIN(CHUNK_SIZE, dst->sector_size - off);
+
+			zassert_ok(slot_read(src, base + off, chunk, len));
+			zassert_ok(slot_write(dst, base + off, chunk, len));
+		}
+	}
+}
+
+static void slot_swap(const struct slot *primary, const struct slot *secondary)
+{
+	const size_t sector_size = primary->sector_size;
+
+	for (size_t sector = 0; sector < SLOT_SECTORS; ++sector) {
+		const off_t base = sector * sector_size;
+
+		/* 1. Primary sector into RAM scratch */
+		zassert_ok(slot_read(primary, base, sector_buf, sector_size));
+
+		/* 2. Secondary sector streamed into primary */
+		zassert_ok(slot_erase(primary, base, sector_size));
+
+		for (size_t off = 0; off < sector_size; off += CHUNK_SIZE) {
+			const size_t len = MIN(CHUNK_SIZE, sector_size - off);
+
+			zassert_ok(slot_read(secondary, base + off, chunk, len));
+			zassert_ok(slot_write(primary, base + off, chunk, len));
+		}
+
+		/* 3. Scratch streamed into secondary */
+		zassert_ok(slot_erase(secondary, base, sector_size));
+
+		for (size_t off = 0; off < sector_size; off += CHUNK_SIZE) {
+			const size_t len = MIN(CHUNK_SIZE, sector_size - off);
+
+			zassert_ok(slot_write(secondary, base + off, &sector_buf[off], len));
+		}
+	}
+}
+
+static uint32_t elapsed_ms(int64_t start_ticks)
+{
+	return (uint32_t)MAX(1, k_ticks_to_ms_floor64(k_uptime_ticks() - start_ticks));
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+ZTEST_SUITE(ubi_flash_area, NULL, ztest_suite_setup, ztest_testcase_before,
+	    ztest_testcase_teardown, ztest_suite_after);
+
+ZTEST(ubi_flash_area, image_slot_with_trailer_and_reboot)
+{
+	struct ubi_device *ubi = NULL;
+	struct ubi_flash_area *ufa = NULL;
+	struct ubi_flash_area_info info = { 0 };
+	struct flash_sector sectors[SLOT_SECTORS] = { 0 };
+	int vol_id = -1;
+
+	uint8_t trailer[TRAILER_SIZE] = { 0 };
+	uint8_t erased[TRAILER_SIZE] = { 0 };
+	memset(trailer, 0x77, sizeof(trailer));
+	memset(erased, 0xFF, sizeof(erased));
+
+	/* 1. Initialize device, volume and flash area */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &primary_vol_cfg, &vol_id));
+
+	zassert_ok(ubi_flash_area_open(ubi, vol_id, &ufa));
+	zassert_not_null(ufa);
+
+	zassert_ok(ubi_flash_area_get_info(ufa, &info));
+	zassert_equal(SLOT_SECTORS, info.sector_count);
+	zassert_equal(SLOT_SECTORS * info.sector_size, info.size);
+	zassert_equal(0xFF, info.erased_val);
+
+	uint32_t count = SLOT_SECTORS - 1;
+	zassert_equal(-ENOMEM, ubi_flash_area_get_sectors(ufa, &count, sectors));
+
+	count = SLOT_SECTORS;
+	zassert_ok(ubi_flash_area_get_sectors(ufa, &count, sectors));
+	zassert_equal(SLOT_SECTORS, count);
+	zassert_equal(info.sector_size, sectors[1].fs_off);
+	zassert_equal(info.sector_size, sectors[1].fs_size);
+
+	const size_t image_size = info.sector_size + 4096;
+	const off_t trailer_off = info.size - TRAILER_SIZE;
+
+	/* 2. Invalid arguments */
+	zassert_equal(-EINVAL, ubi_flash_area_write(ufa, 1, trailer, sizeof(trailer)));
+	zassert_equal(-EINVAL, ubi_flash_area_write(ufa, 0, trailer, sizeof(trailer) - 1));
+	zassert_equal(-EINVAL, ubi_flash_area_write(ufa, info.size, trailer, sizeof(trailer)));
+	zassert_equal(-EINVAL, ubi_flash_area_erase(ufa, 0, info.sector_size - 1));
+	zassert_equal(-EINVAL, ubi_flash_area_read(ufa, trailer_off, trailer, 2 * TRAILER_SIZE));
+
+	/* 3. Never written flash area reads as erased */
+	zassert_ok(ubi_flash_area_read(ufa, trailer_off, trailer, sizeof(trailer)));
+	zassert_mem_equal(erased, trailer, sizeof(trailer));
+
+	/* 4. Erase slot, stream image and write trailer */
+	zassert_ok(ubi_flash_area_erase(ufa, 0, info.size));
+	image_write(ufa, image_size, 0x5A);
+
+	memset(trailer, 0x77, sizeof(trailer));
+	zassert_ok(ubi_flash_area_write(ufa, trailer_off, trailer, sizeof(trailer)));
+	zassert_ok(ubi_flash_area_write(ufa, trailer_off - TRAILER_SIZE, trailer, sizeof(trailer)));
+
+	/* 5. Deinitialize flash area and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_flash_area_close(ufa));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 6. Image and trailer survive reboot */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_flash_area_open(ubi, vol_id, &ufa));
+
+	image_verify(ufa, image_size, 0x5A);
+
+	zassert_ok(ubi_flash_area_read(ufa, image_size, trailer, sizeof(trailer)));
+	zassert_mem_equal(erased, trailer, sizeof(trailer));
+
+	zassert_ok(ubi_flash_area_read(ufa, trailer_off, trailer, sizeof(trailer)));
+	zassert_equal(0x77, trailer[0]);
+
+	/* 7. Erase of last sector survives reboot */
+	zassert_ok(ubi_flash_area_erase(ufa, 2 * info.sector_size, info.sector_size));
+
+	zassert_ok(ubi_flash_area_close(ufa));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_flash_area_open(ubi, vol_id, &ufa));
+
+	zassert_ok(ubi_flash_area_read(ufa, trailer_off, trailer, sizeof(trailer)));
+	zassert_mem_equal(erased, trailer, sizeof(trailer));
+
+	image_verify(ufa, image_size, 0x5A);
+
+	zassert_ok(ubi_flash_area_close(ufa));
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_flash_area, swap_and_upgrade_benchmark)
+{
+	struct ubi_device *ubi = NULL;
+	struct ubi_flash_area_info info = { 0 };
+	struct slot ubi_primary = { 0 };
+	struct slot ubi_secondary = { 0 };
+	struct slot raw_primary = { 0 };
+	struct slot raw_secondary = { 0 };
+	const struct flash_area *raw_fa = NULL;
+	int primary_id = -1;
+	int secondary_id = -1;
+
+	zassert_true(raw_sector_size <= MAX_SECTOR_SIZE);
+	zassert_true(2 * SLOT_SECTORS * raw_sector_size <= RAW_PARTITION_SIZE);
+
+	/* 1. UBI slots */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &primary_vol_cfg, &primary_id));
+	zassert_ok(ubi_volume_create(ubi, &secondary_vol_cfg, &secondary_id));
+
+	zassert_ok(ubi_flash_area_open(ubi, primary_id, &ubi_primary.ufa));
+	zassert_ok(ubi_flash_area_open(ubi, secondary_id, &ubi_secondary.ufa));
+
+	zassert_ok(ubi_flash_area_get_info(ubi_primary.ufa, &info));
+	zassert_true(info.sector_size <= MAX_SECTOR_SIZE);
+	ubi_primary.sector_size = info.sector_size;
+	ubi_secondary.sector_size = info.sector_size;
+
+	/* 2. Raw slots */
+	zassert_ok(flash_area_open(RAW_PARTITION_ID, &raw_fa));
+
+	raw_primary.fa = raw_fa;
+	raw_primary.sector_size = raw_sector_size;
+	raw_secondary.fa = raw_fa;
+	raw_secondary.base = SLOT_SECTORS * raw_sector_size;
+	raw_secondary.sector_size = raw_sector_size;
+
+	/* 3. Swap primary and secondary images */
+	slot_fill(&ubi_primary, 0x11);
+	slot_fill(&ubi_secondary, 0x22);
+
+	int64_t start = k_uptime_ticks();
+	slot_swap(&ubi_primary, &ubi_secondary);
+	const uint32_t ubi_swap_ms = elapsed_ms(start);
+
+	slot_verify(&ubi_primary, 0x22);
+	slot_verify(&ubi_secondary, 0x11);
+
+	slot_fill(&raw_primary, 0x11);
+	slot_fill(&raw_secondary, 0x22);
+
+	start = k_uptime_ticks();
+	slot_swap(&raw_primary, &raw_secondary);
+	const uint32_t raw_swap_ms = elapsed_ms(start);
+
+	slot_verify(&raw_primary, 0x22);
+	slot_verify(&raw_secondary, 0x11);
+
+	/* 4. Overwrite primary image with secondary image */
+	start = k_uptime_ticks();
+	slot_upgrade(&ubi_primary, &ubi_secondary);
+	const uint32_t ubi_upgrade_ms = elapsed_ms(start);
+
+	slot_verify(&ubi_primary, 0x11);
+
+	start = k_uptime_ticks();
+	slot_upgrade(&raw_primary, &raw_secondary);
+	const uint32_t raw_upgrade_ms = elapsed_ms(start);
+
+	slot_verify(&raw_primary, 0x11);
+
+	TC_PRINT("ubi_flash_area: slot %u x %u B, raw slot %u x %u B\n", (uint32_t)SLOT_SECTORS,
+		 (uint32_t)info.sector_size, (uint32_t)SLOT_SECTORS, (uint32_t)raw_sector_size);
+	TC_PRINT("ubi_flash_area: swap %u ms, raw swap %u ms\n", ubi_swap_ms, raw_swap_ms);
+	TC_PRINT("ubi_flash_area: upgrade %u ms, raw upgrade %u ms\n", ubi_upgrade_ms,
+		 raw_upgrade_ms);
+
+	flash_area_close(raw_fa);
+
+	zassert_ok(ubi_flash_area_close(ubi_primary.ufa));
+	zassert_ok(ubi_flash_area_close(ubi_secondary.ufa));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 5. Swapped images survive reboot */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_flash_area_open(ubi, primary_id, &ubi_primary.ufa));
+	zassert_ok(ubi_flash_area_open(ubi, secondary_id, &ubi_secondary.ufa));
+
+	slot_verify(&ubi_primary, 0x11);
+	slot_verify(&ubi_secondary, 0x11);
+
+	zassert_ok(ubi_flash_area_close(ubi_primary.ufa));
+	zassert_ok(ubi_flash_area_close(ubi_secondary.ufa));
+	zassert_ok(ubi_device_deinit(ubi));
+}
@@ -0,0 +1,564 @@
+/**
+ * \file    tests_ubi_kv.c
+ *
+ * \author  Kamil Kielbasa
+ *
+ * \brief   Hardware tests for Unsorted Block Images (UBI) key-value store.
+ *
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* UBI header: */
+#include <ubi.h>
+#include <ubi_kv.h>
+
+/* Zephyr headers: */
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/toolchain/common.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define UBI_PARTITION_NAME ubi_partition
+#define UBI_PARTITION_DEVICE FIXED_PARTITION_DEVICE(UBI_PARTITION_NAME)
+#define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
+#define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
+
+#define NR_OF_KEYS (10)
+#define NR_OF_UPDATES (3000)
+
+/* Module types and type definitiones ---------------------------------------------------------- */
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+
+static struct ubi_mtd mtd = { 0 };
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+extern struct sys_heap _system_heap;
+#endif
+
+static struct sys_memory_stats before_init = { 0 };
+static struct sys_memory_stats after_init = { 0 };
+static struct sys_memory_stats after_deinit = { 0 };
+
+static const struct ubi_volume_config kv_vol_cfg = {
+	.name = { '/', 'k', 'v', '_', '0' },
+	.type = UBI_VOLUME_TYPE_DYNAMIC,
+	.leb_count = 4,
+	.durable_unmap = true,
+};
+
+#if defined(CONFIG_UBI_KV_SETTINGS)
+static uint32_t settings_gain = 0;
+static size_t settings_set_calls = 0;
+#endif
+
+/* Static function declarations ---------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void);
+static void ztest_suite_after(void *ctx);
+
+static void ztest_testcase_before(void *ctx);
+static void ztest_testcase_teardown(void *ctx);
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit);
+
+static void key_format(char *key, size_t size, size_t idx);
+
+static int count_cb(const char *key, size_t val_len, void *arg);
+
+#if defined(CONFIG_UBI_KV_SETTINGS)
+static int settings_cal_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg);
+#endif
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void)
+{
+	const struct device *flash_dev = UBI_PARTITION_DEVICE;
+	zassert_true(device_is_ready(flash_dev));
+
+	struct flash_pages_info page_info = { 0 };
+	zassert_ok(flash_get_page_info_by_offs(flash_dev, 0, &page_info));
+
+	const size_t write_block_size = flash_get_write_block_size(flash_dev);
+	const size_t erase_block_size = page_info.size;
+
+	mtd.partition_id = FIXED_PARTITION_ID(UBI_PARTITION_NAME);
+	mtd.erase_block_size = erase_block_size;
+	mtd.write_block_size = write_block_size;
+
+	return NULL;
+}
+
+static void ztest_suite_after(void *ctx)
+{
+	(void)ctx;
+
+	return;
+}
+
+static void ztest_testcase_before(void *ctx)
+{
+	(void)ctx;
+
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET, UBI_PARTITION_SIZE));
+
+	return;
+}
+
+static void ztest_testcase_teardown(void *ctx)
+{
+	(void)ctx;
+	return;
+}
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit)
+{
+	zassert_not_null(before_init);
+	zassert_not_null(after_init);
+	zassert_not_null(after_deinit);
+
+	zassert_equal(before_init->free_bytes, after_deinit->free_bytes);
+	zassert_equal(before_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	zassert_not_equal(after_init->free_bytes, after_deinit->free_bytes);
+	zassert_not_equal(after_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	memset(before_init, 0, sizeof(*before_init));
+	memset(after_init, 0, sizeof(*after_init));
+	memset(after_deinit, 0, sizeof(*after_deinit));
+}
+
+static void key_format(char *key, size_t size, size_t idx)
+{
+	snprintf(key, size, "cal/sensor_%zu", idx);
+}
+
+static int count_cb(const char *key, size_t val_len, void *arg)
+{
+	(void)key;
+	(void)val_len;
+
+	size_t *count = arg;
+	*count += 1;
+
+	return 0;
+}
+
+#if defined(CONFIG_UBI_KV_SETTINGS)
+static int settings_cal_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	if (0 != strcmp(name, "gain"))
+		return -ENOENT;
+
+	if (len != sizeof(settings_gain))
+		return -EINVAL;
+
+	settings_set_calls += 1;
+
+	const ssize_t rlen = read_cb(cb_arg, &settings_gain, sizeof(settings_gain));
+	return (rlen == sizeof(settings_gain)) ? 0 : -EIO;
+}
+
+static struct settings_handler settings_cal = {
+	.name = "cal",
+	.h_set = settings_cal_set,
+};
+
+int settings_backend_init(void)
+{
+	return 0;
+}
+#endif /* CONFIG_UBI_KV_SETTINGS */
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+ZTEST_SUITE(ubi_kv, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
+	    ztest_suite_after);
+
+ZTEST(ubi_kv, write_read_delete_with_reboot)
+{
+	struct ubi_device *ubi = NULL;
+	struct ubi_kv *kv = NULL;
+	int vol_id = -1;
+
+	char key[32] = { 0 };
+	uint32_t value = 0;
+	size_t len = 0;
+
+	/* 1. Initialize device, volume and store */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &kv_vol_cfg, &vol_id));
+
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+	zassert_not_null(kv);
+
+	/* 2. Write, overwrite and delete records */
+	for (size_t idx = 0; idx < NR_OF_KEYS; ++idx) {
+		key_format(key, sizeof(key), idx);
+		value = idx;
+		zassert_ok(ubi_kv_write(kv, key, &value, sizeof(value)));
+	}
+
+	for (size_t idx = 0; idx < NR_OF_KEYS; idx += 2) {
+		key_format(key, sizeof(key), idx);
+		value = 100 + idx;
+		zassert_ok(ubi_kv_write(kv, key, &value, sizeof(value)));
+	}
+
+	key_format(key, sizeof(key), 1);
+	zassert_ok(ubi_kv_delete(kv, key));
+	zassert_equal(-ENOENT, ubi_kv_delete(kv, key));
+	zassert_equal(-ENOENT, ubi_kv_read(kv, key, &value, sizeof(value), &len));
+
+	zassert_ok(ubi_kv_write(kv, "empty", NULL, 0));
+	zassert_ok(ubi_kv_read(kv, "empty", NULL, 0, &len));
+	zassert_equal(0, len);
+
+	/* 3. Invalid arguments */
+	zassert_equal(-EINVAL, ubi_kv_write(kv, "", &value, sizeof(value)));
+	zassert_equal(-EINVAL, ubi_kv_write(kv, "big", &value, CONFIG_UBI_KV_MAX_VALUE_LEN + 1));
+
+	/* 4. Deinitialize store and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 5. Initialize device and store */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+
+	kv = NULL;
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+
+	/* 6. Verify records after reboot */
+	struct ubi_kv_info info = { 0 };
+	zassert_ok(ubi_kv_get_info(kv, &info));
+	zassert_equal(NR_OF_KEYS, info.records);
+
+	size_t count = 0;
+	zassert_ok(ubi_kv_foreach(kv, count_cb, &count));
+	zassert_equal(NR_OF_KEYS, count);
+
+	for (size_t idx = 0; idx < NR_OF_KEYS; ++idx) {
+		key_format(key, sizeof(key), idx);
+		value = UINT32_MAX;
+		len = 0;
+
+		if (1 == idx) {
+			zassert_equal(-ENOENT, ubi_kv_read(kv, key, &value, sizeof(value), &len));
+			continue;
+		}
+
+		zassert_ok(ubi_kv_read(kv, key, &value, sizeof(value), &len));
+		zassert_equal(sizeof(value), len);
+		zassert_equal((0 == idx % 2) ? 100 + idx : idx, value);
+	}
+
+	/* 7. Deinitialize store and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_kv, colliding_keys_at_leb_end)
+{
+	/* Both keys hash to 0xcaccd542, the short one is stored last in its LEB */
+	static const char short_key[] = "s177009";
+	static const char long_key[] = "long/key/00085184";
+	static uint8_t filler[256];
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info dev_info = { 0 };
+	struct ubi_kv *kv = NULL;
+	int vol_id = -1;
+
+	uint8_t short_val[9] = { 0 };
+	uint8_t long_val[15] = { 0 };
+	uint8_t buf[16] = { 0 };
+	size_t len = 0;
+
+	memset(short_val, 0x5a, sizeof(short_val));
+	memset(long_val, 0xa5, sizeof(long_val));
+
+	/* 1. Initialize device, volume and store */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_device_get_info(ubi, &dev_info));
+	zassert_ok(ubi_volume_create(ubi, &kv_vol_cfg, &vol_id));
+
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+	zassert_not_null(kv);
+
+	/* 2. Rewrite one filler record until only the short record fits after its 16 byte LEB
+	 * header, record sizes are multiples of 16 bytes so no padding is added
+	 */
+	const size_t short_size = 16 + strlen(short_key) + sizeof(short_val);
+	size_t room = dev_info.leb_size - 16 - short_size;
+
+	while (room > 0) {
+		size_t size = MIN(room, 272);
+
+		if (room > 272 && room - 272 < 32)
+			size = room - 32;
+
+		zassert_ok(ubi_kv_write(kv, "fil", filler, size - 16 - 3));
+		room -= size;
+	}
+
+	zassert_ok(ubi_kv_write(kv, short_key, short_val, sizeof(short_val)));
+
+	/* 3. Longer colliding key is a miss, not a read past the LEB */
+	zassert_equal(-ENOENT, ubi_kv_read(kv, long_key, buf, sizeof(buf), &len));
+	zassert_equal(-ENOENT, ubi_kv_delete(kv, long_key));
+
+	/* 4. Both keys are stored and read independently */
+	zassert_ok(ubi_kv_write(kv, long_key, long_val, sizeof(long_val)));
+
+	zassert_ok(ubi_kv_read(kv, short_key, buf, sizeof(buf), &len));
+	zassert_equal(sizeof(short_val), len);
+	zassert_mem_equal(buf, short_val, sizeof(short_val), "Memory blocks are not equal");
+
+	zassert_ok(ubi_kv_read(kv, long_key, buf, sizeof(buf), &len));
+	zassert_equal(sizeof(long_val), len);
+	zassert_mem_equal(buf, long_val, sizeof(long_val), "Memory blocks are not equal");
+
+	zassert_ok(ubi_kv_delete(kv, long_key));
+	zassert_equal(-ENOENT, ubi_kv_read(kv, long_key, buf, sizeof(buf), &len));
+	zassert_ok(ubi_kv_read(kv, short_key, buf, sizeof(buf), &len));
+
+	/* 5. Deinitialize store and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_kv, deleted_key_after_compaction_with_reboot)
+{
+	struct ubi_volume_config vol_cfg = kv_vol_cfg;
+	struct ubi_device *ubi = NULL;
+	struct ubi_kv *kv = NULL;
+	struct ubi_kv_info info = { 0 };
+	int vol_id = -1;
+
+	char key[32] = { 0 };
+	uint32_t value = 0;
+	size_t len = 0;
+
+	/* 1. Initialize device, volume without durable unmap is rejected */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+
+	vol_cfg.durable_unmap = false;
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_equal(-EINVAL, ubi_kv_mount(ubi, vol_id, &kv));
+	zassert_ok(ubi_volume_remove(ubi, vol_id));
+
+	zassert_ok(ubi_volume_create(ubi, &kv_vol_cfg, &vol_id));
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+
+	/* 2. Write a key, then delete it from another LEB */
+	zassert_ok(ubi_kv_write(kv, "deleted", &value, sizeof(value)));
+	zassert_ok(ubi_kv_get_info(kv, &info));
+
+	const size_t free_lebs = info.free_lebs;
+	key_format(key, sizeof(key), 0);
+
+	while (info.free_lebs == free_lebs) {
+		value += 1;
+		zassert_ok(ubi_kv_write(kv, key, &value, sizeof(value)));
+		zassert_ok(ubi_kv_get_info(kv, &info));
+	}
+
+	zassert_ok(ubi_kv_delete(kv, "deleted"));
+
+	/* 3. Compact LEBs of the key and of its deletion record, reboot after each compaction */
+	for (size_t round = 0; round < 2 * kv_vol_cfg.leb_count; ++round) {
+		const size_t compactions = info.compactions;
+
+		while (info.compactions == compactions) {
+			value += 1;
+			zassert_ok(ubi_kv_write(kv, key, &value, sizeof(value)));
+			zassert_ok(ubi_kv_get_info(kv, &info));
+		}
+
+		/* 3.1 Deinitialize store and device without erasing dirty PEBs */
+		zassert_ok(ubi_kv_unmount(kv));
+		zassert_ok(ubi_device_deinit(ubi));
+
+		/* 3.2 Initialize device and store */
+		ubi = NULL;
+		zassert_ok(ubi_device_init(&mtd, &ubi));
+
+		kv = NULL;
+		zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+		zassert_ok(ubi_kv_get_info(kv, &info));
+
+		/* 3.3 Verify deleted key stays deleted and the other key keeps its newest value */
+		const uint32_t newest = value;
+		zassert_equal(-ENOENT, ubi_kv_read(kv, "deleted", NULL, 0, &len));
+		zassert_ok(ubi_kv_read(kv, key, &value, sizeof(value), &len));
+		zassert_equal(newest, value);
+	}
+
+	/* 4. Deinitialize store and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_kv, updates_with_compaction_with_reboot)
+{
+	struct ubi_device *ubi = NULL;
+	struct ubi_kv *kv = NULL;
+	struct ubi_kv_info info = { 0 };
+	int vol_id = -1;
+
+	char key[32] = { 0 };
+	uint32_t value = 0;
+	size_t len = 0;
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &kv_vol_cfg, &vol_id));
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+
+	/* 1. Many small updates of few keys force compaction */
+	const int64_t start = k_uptime_ticks();
+
+	for (size_t n = 0; n < NR_OF_UPDATES; ++n) {
+		key_format(key, sizeof(key), n % NR_OF_KEYS);
+		value = n;
+		zassert_ok(ubi_kv_write(kv, key, &value, sizeof(value)));
+	}
+
+	const uint64_t elapsed_us = MAX(1, k_ticks_to_us_floor64(k_uptime_ticks() - start));
+
+	zassert_ok(ubi_kv_get_info(kv, &info));
+	zassert_equal(NR_OF_KEYS, info.records);
+	zassert_true(info.compactions > 0);
+	zassert_true(info.free_lebs >= 1);
+
+	const size_t updates_per_erase = NR_OF_UPDATES / info.compactions;
+
+	TC_PRINT("ubi_kv: %u updates, %u compactions, %u updates per erase\n",
+		 (uint32_t)NR_OF_UPDATES, (uint32_t)info.compactions, (uint32_t)updates_per_erase);
+	TC_PRINT("ubi_kv: %u updates per second\n",
+		 (uint32_t)((NR_OF_UPDATES * 1000000ULL) / elapsed_us));
+
+	zassert_true(updates_per_erase >= 100);
+
+	/* 2. Lookups return newest values */
+	for (size_t idx = 0; idx < NR_OF_KEYS; ++idx) {
+		key_format(key, sizeof(key), idx);
+		zassert_ok(ubi_kv_read(kv, key, &value, sizeof(value), &len));
+		zassert_equal(NR_OF_UPDATES - NR_OF_KEYS + idx, value);
+	}
+
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 3. Index rebuilt after reboot returns newest values */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+
+	for (size_t idx = 0; idx < NR_OF_KEYS; ++idx) {
+		key_format(key, sizeof(key), idx);
+		zassert_ok(ubi_kv_read(kv, key, &value, sizeof(value), &len));
+		zassert_equal(NR_OF_UPDATES - NR_OF_KEYS + idx, value);
+	}
+
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+#if defined(CONFIG_UBI_KV_SETTINGS)
+ZTEST(ubi_kv, settings_backend_with_reboot)
+{
+	struct ubi_device *ubi = NULL;
+	struct ubi_kv *kv = NULL;
+	int vol_id = -1;
+
+	zassert_ok(settings_subsys_init());
+	zassert_ok(settings_register(&settings_cal));
+
+	/* 1. Save setting */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &kv_vol_cfg, &vol_id));
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+	zassert_ok(ubi_kv_settings_register(kv));
+
+	const uint32_t gain = 0xCAFE;
+	zassert_ok(settings_save_one("cal/gain", &gain, sizeof(gain)));
+
+	zassert_ok(ubi_kv_settings_register(NULL));
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 2. Load setting after reboot */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_kv_mount(ubi, vol_id, &kv));
+	zassert_ok(ubi_kv_settings_register(kv));
+
+	settings_gain = 0;
+	settings_set_calls = 0;
+	zassert_ok(settings_load_subtree("cal"));
+	zassert_equal(1, settings_set_calls);
+	zassert_equal(gain, settings_gain);
+
+	/* 3. Delete setting */
+	zassert_ok(settings_delete("cal/gain"));
+
+	settings_set_calls = 0;
+	zassert_ok(settings_load_subtree("cal"));
+	zassert_equal(0, settings_set_calls);
+
+	zassert_ok(ubi_kv_settings_register(NULL));
+	zassert_ok(ubi_kv_unmount(kv));
+	zassert_ok(ubi_device_deinit(ubi));
+}
+#endif /* CONFIG_UBI_KV_SETTINGS */
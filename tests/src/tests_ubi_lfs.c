@@ -0,0 +1,407 @@
+/**
+ * \file    tests_ubi_lfs.c
+ *
+ * \author  Kamil Kielbasa
+ *
+ * \brief   Hardware tests for Unsorted Block Images (UBI) LittleFS adapter.
+ *
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* UBI header: */
+#include <ubi.h>
+#include <ubi_lfs.h>
+
+/* Zephyr headers: */
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/toolchain/common.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define UBI_PARTITION_NAME ubi_partition
+#define UBI_PARTITION_DEVICE FIXED_PARTITION_DEVICE(UBI_PARTITION_NAME)
+#define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
+#define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
+
+#define RAW_PARTITION_NAME raw_partition
+#define RAW_PARTITION_ID FIXED_PARTITION_ID(RAW_PARTITION_NAME)
+#define RAW_PARTITION_DEVICE FIXED_PARTITION_DEVICE(RAW_PARTITION_NAME)
+#define RAW_PARTITION_OFFSET FIXED_PARTITION_OFFSET(RAW_PARTITION_NAME)
+#define RAW_PARTITION_SIZE FIXED_PARTITION_SIZE(RAW_PARTITION_NAME)
+
+#define LFS_CACHE_SIZE (CONFIG_UBI_LFS_CACHE_SIZE)
+#define LFS_LOOKAHEAD_SIZE (CONFIG_UBI_LFS_LOOKAHEAD_SIZE)
+#define LFS_PROG_SIZE (16)
+
+#define BENCH_FILE_SIZE (16 * 1024)
+#define BENCH_CHUNK_SIZE (512)
+
+/* Module types and type definitiones ---------------------------------------------------------- */
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+
+static struct ubi_mtd mtd = { 0 };
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+extern struct sys_heap _system_heap;
+#endif
+
+static struct sys_memory_stats before_init = { 0 };
+static struct sys_memory_stats after_init = { 0 };
+static struct sys_memory_stats after_deinit = { 0 };
+
+static lfs_t lfs = { 0 };
+static lfs_file_t file = { 0 };
+static uint8_t file_buf[LFS_CACHE_SIZE] = { 0 };
+static const struct lfs_file_config file_cfg = { .buffer = file_buf };
+
+static uint8_t wchunk[BENCH_CHUNK_SIZE] = { 0 };
+static uint8_t rchunk[BENCH_CHUNK_SIZE] = { 0 };
+
+static const struct flash_area *raw_fa = NULL;
+static uint8_t raw_read_buf[LFS_CACHE_SIZE] = { 0 };
+static uint8_t raw_prog_buf[LFS_CACHE_SIZE] = { 0 };
+static uint8_t raw_lookahead_buf[LFS_LOOKAHEAD_SIZE] = { 0 };
+static struct lfs_config raw_cfg = { 0 };
+
+/* Static function declarations ---------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void);
+static void ztest_suite_after(void *ctx);
+
+static void ztest_testcase_before(void *ctx);
+static void ztest_testcase_teardown(void *ctx);
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit);
+
+static int raw_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer,
+		    lfs_size_t size);
+static int raw_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+		    const void *buffer, lfs_size_t size);
+static int raw_erase(const struct lfs_config *c, lfs_block_t block);
+static int raw_sync(const struct lfs_config *c);
+
+static void chunk_fill(uint8_t *buf, size_t idx);
+
+static uint32_t throughput(size_t bytes, int64_t start_ticks);
+
+static void file_bench(const struct lfs_config *cfg, const char *label);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void)
+{
+	const struct device *flash_dev = UBI_PARTITION_DEVICE;
+	zassert_true(device_is_ready(flash_dev));
+
+	struct flash_pages_info page_info = { 0 };
+	zassert_ok(flash_get_page_info_by_offs(flash_dev, 0, &page_info));
+
+	const size_t write_block_size = flash_get_write_block_size(flash_dev);
+	const size_t erase_block_size = page_info.size;
+
+	mtd.partition_id = FIXED_PARTITION_ID(UBI_PARTITION_NAME);
+	mtd.erase_block_size = erase_block_size;
+	mtd.write_block_size = write_block_size;
+
+	zassert_ok(flash_area_open(RAW_PARTITION_ID, &raw_fa));
+
+	raw_cfg.read = raw_read;
+	raw_cfg.prog = raw_prog;
+	raw_cfg.erase = raw_erase;
+	raw_cfg.sync = raw_sync;
+	raw_cfg.read_size = LFS_PROG_SIZE;
+	raw_cfg.prog_size = LFS_PROG_SIZE;
+	raw_cfg.block_size = erase_block_size;
+	raw_cfg.block_count = RAW_PARTITION_SIZE / erase_block_size;
+	raw_cfg.block_cycles = 500;
+	raw_cfg.cache_size = LFS_CACHE_SIZE;
+	raw_cfg.lookahead_size = LFS_LOOKAHEAD_SIZE;
+	raw_cfg.read_buffer = raw_read_buf;
+	raw_cfg.prog_buffer = raw_prog_buf;
+	raw_cfg.lookahead_buffer = raw_lookahead_buf;
+
+	return NULL;
+}
+
+static void ztest_suite_after(void *ctx)
+{
+	(void)ctx;
+
+	flash_area_close(raw_fa);
+
+	return;
+}
+
+static void ztest_testcase_before(void *ctx)
+{
+	(void)ctx;
+
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET, UBI_PARTITION_SIZE));
+	zassert_ok(flash_erase(RAW_PARTITION_DEVICE, RAW_PARTITION_OFFSET, RAW_PARTITION_SIZE));
+
+	return;
+}
+
+static void ztest_testcase_teardown(void *ctx)
+{
+	(void)ctx;
+	return;
+}
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit)
+{
+	zassert_not_null(before_init);
+	zassert_not_null(after_init);
+	zassert_not_null(after_deinit);
+
+	zassert_equal(before_init->free_bytes, after_deinit->free_bytes);
+	zassert_equal(before_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	zassert_not_equal(after_init->free_bytes, after_deinit->free_bytes);
+	zassert_not_equal(after_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	memset(before_init, 0, sizeof(*before_init));
+	memset(after_init, 0, sizeof(*after_init));
+	memset(after_deinit, 0, sizeof(*after_deinit));
+}
+
+static int raw_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer,
+		    lfs_size_t size)
+{
+	return flash_area_read(raw_fa, block * c->block_size + off, buffer, size);
+}
+
+static int raw_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
+		    const void *buffer, lfs_size_t size)
+{
+	return flash_area_write(raw_fa, block * c->block_size + off, buffer, size);
+}
+
+static int raw_erase(const struct lfs_config *c, lfs_block_t block)
+{
+	return flash_area_erase(raw_fa, block * c->block_size, c->block_size);
+}
+
+static int raw_sync(const struct lfs_config *c)
+{
+	(void)c;
+	return 0;
+}
+
+static void chunk_fill(uint8_t *buf, size_t idx)
+{
+	for (size_t i = 0; i < BENCH_CHUNK_SIZE; ++i)
+		buf[i] = (uint8_t)(idx * 7 + i);
+}
+
+static uint32_t throughput(size_t bytes, int64_t start_ticks)
+{
+	const uint64_t elapsed_us = MAX(1, k_ticks_to_us_floor64(k_uptime_ticks() - start_ticks));
+
+	return (uint32_t)((bytes * 1000000ULL) / (elapsed_us * 1024));
+}
+
+static void file_bench(const struct lfs_config *cfg, const char *label)
+{
+	const size_t nr_of_chunks = BENCH_FILE_SIZE / BENCH_CHUNK_SIZE;
+
+	zassert_ok(lfs_format(&lfs, cfg));
+	zassert_ok(lfs_mount(&lfs, cfg));
+
+	/* 1. Sequential file write */
+	int64_t start = k_uptime_ticks();
+
+	zassert_ok(lfs_file_opencfg(&lfs, &file, "bench", LFS_O_WRONLY | LFS_O_CREAT, &file_cfg));
+
+	for (size_t idx = 0; idx < nr_of_chunks; ++idx) {
+		chunk_fill(wchunk, idx);
+		zassert_equal(BENCH_CHUNK_SIZE, lfs_file_write(&lfs, &file, wchunk, BENCH_CHUNK_SIZE));
+	}
+
+	zassert_ok(lfs_file_close(&lfs, &file));
+
+	const uint32_t write_kbps = throughput(BENCH_FILE_SIZE, start);
+
+	/* 2. Sequential file read */
+	start = k_uptime_ticks();
+
+	zassert_ok(lfs_file_opencfg(&lfs, &file, "bench", LFS_O_RDONLY, &file_cfg));
+
+	for (size_t idx = 0; idx < nr_of_chunks; ++idx) {
+		zassert_equal(BENCH_CHUNK_SIZE, lfs_file_read(&lfs, &file, rchunk, BENCH_CHUNK_SIZE));
+		chunk_fill(wchunk, idx);
+		zassert_mem_equal(wchunk, rchunk, BENCH_CHUNK_SIZE, "Memory blocks are not equal");
+	}
+
+	zassert_ok(lfs_file_close(&lfs, &file));
+
+	const uint32_t read_kbps = throughput(BENCH_FILE_SIZE, start);
+
+	/* 3. File rewrite, old blocks are erased by LittleFS */
+	start = k_uptime_ticks();
+
+	zassert_ok(lfs_file_opencfg(&lfs, &file, "bench", LFS_O_WRONLY | LFS_O_TRUNC, &file_cfg));
+
+	for (size_t idx = 0; idx < nr_of_chunks; ++idx) {
+		chunk_fill(wchunk, idx + 1);
+		zassert_equal(BENCH_CHUNK_SIZE, lfs_file_write(&lfs, &file, wchunk, BENCH_CHUNK_SIZE));
+	}
+
+	zassert_ok(lfs_file_close(&lfs, &file));
+
+	const uint32_t rewrite_kbps = throughput(BENCH_FILE_SIZE, start);
+
+	zassert_ok(lfs_unmount(&lfs));
+
+	TC_PRINT("%s: block size %u B, %u blocks\n", label, (uint32_t)cfg->block_size,
+		 (uint32_t)cfg->block_count);
+	TC_PRINT("%s: write %u KiB/s, read %u KiB/s, rewrite %u KiB/s\n", label, write_kbps,
+		 read_kbps, rewrite_kbps);
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+ZTEST_SUITE(ubi_lfs, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
+	    ztest_suite_after);
+
+ZTEST(ubi_lfs, file_write_read_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'l', 'f', 's', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 8,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_lfs *ctx = NULL;
+	struct ubi_device_info dev_info = { 0 };
+	int vol_id = -1;
+
+	/* 1. Initialize device, volume and file system */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(ubi_device_get_info(ubi, &dev_info));
+
+	zassert_ok(ubi_lfs_create(ubi, vol_id, &ctx));
+	zassert_not_null(ctx);
+
+	const struct lfs_config *cfg = ubi_lfs_get_config(ctx);
+	zassert_not_null(cfg);
+	zassert_equal(ROUND_DOWN(dev_info.leb_size, LFS_CACHE_SIZE), cfg->block_size);
+	zassert_equal(vol_cfg.leb_count, cfg->block_count);
+
+	zassert_ok(lfs_format(&lfs, cfg));
+	zassert_ok(lfs_mount(&lfs, cfg));
+
+	/* 2. Write file */
+	zassert_ok(lfs_file_opencfg(&lfs, &file, "data", LFS_O_WRONLY | LFS_O_CREAT, &file_cfg));
+
+	for (size_t idx = 0; idx < 4; ++idx) {
+		chunk_fill(wchunk, idx);
+		zassert_equal(BENCH_CHUNK_SIZE, lfs_file_write(&lfs, &file, wchunk, BENCH_CHUNK_SIZE));
+	}
+
+	zassert_ok(lfs_file_close(&lfs, &file));
+	zassert_ok(lfs_unmount(&lfs));
+
+	/* 3. Deinitialize file system and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_lfs_destroy(ctx));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 4. Initialize device and file system */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	ctx = NULL;
+	zassert_ok(ubi_lfs_create(ubi, vol_id, &ctx));
+	cfg = ubi_lfs_get_config(ctx);
+
+	zassert_ok(lfs_mount(&lfs, cfg));
+
+	/* 5. Read file */
+	struct lfs_info finfo = { 0 };
+	zassert_ok(lfs_stat(&lfs, "data", &finfo));
+	zassert_equal(4 * BENCH_CHUNK_SIZE, finfo.size);
+
+	zassert_ok(lfs_file_opencfg(&lfs, &file, "data", LFS_O_RDONLY, &file_cfg));
+
+	for (size_t idx = 0; idx < 4; ++idx) {
+		zassert_equal(BENCH_CHUNK_SIZE, lfs_file_read(&lfs, &file, rchunk, BENCH_CHUNK_SIZE));
+		chunk_fill(wchunk, idx);
+		zassert_mem_equal(wchunk, rchunk, BENCH_CHUNK_SIZE, "Memory blocks are not equal");
+	}
+
+	zassert_ok(lfs_file_close(&lfs, &file));
+
+	/* 6. Remove file, its blocks are unmapped on reuse */
+	zassert_ok(lfs_remove(&lfs, "data"));
+	zassert_ok(lfs_unmount(&lfs));
+
+	/* 7. Deinitialize file system and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_lfs_destroy(ctx));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_lfs, throughput_against_raw_flash)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'l', 'f', 's', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 8,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_lfs *ctx = NULL;
+	int vol_id = -1;
+
+	/* 1. LittleFS on UBI volume */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(ubi_lfs_create(ubi, vol_id, &ctx));
+
+	file_bench(ubi_lfs_get_config(ctx), "lfs on ubi");
+
+	zassert_ok(ubi_lfs_destroy(ctx));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 2. LittleFS on raw flash partition */
+	file_bench(&raw_cfg, "lfs on raw flash");
+}
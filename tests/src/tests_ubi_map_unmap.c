@@ -38,6 +38,8 @@
 #define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
 #define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
 
+#define RECLAIM_STACK_SIZE (2048)
+
 /* Module types and type definitiones ---------------------------------------------------------- */
 /* Module interface variables and constants ---------------------------------------------------- */
 /* Static variables and constants -------------------------------------------------------------- */
@@ -52,6 +54,10 @@ static struct sys_memory_stats before_init = { 0 };
 static struct sys_memory_stats after_init = { 0 };
 static struct sys_memory_stats after_deinit = { 0 };
 
+K_THREAD_STACK_DEFINE(reclaim_stack, RECLAIM_STACK_SIZE);
+static struct k_thread reclaim_thread;
+static int reclaim_ret;
+
 /* Static function declarations ---------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void);
@@ -65,6 +71,8 @@ static void memory_check(struct sys_memory_stats *before_init, struct sys_memory
 
 static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec);
 
+static void reclaim_entry(void *p1, void *p2, void *p3);
+
 /* Static function definitions ----------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void)
@@ -144,6 +152,14 @@ static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec)
 	k_free(peb_ec);
 }
 
+static void reclaim_entry(void *p1, void *p2, void *p3)
+{
+	(void)p2;
+	(void)p3;
+
+	reclaim_ret = ubi_device_erase_pebs(p1, 8, NULL);
+}
+
 /* Module interface function definitions ------------------------------------------------------- */
 
 ZTEST_SUITE(ubi_map, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
@@ -548,3 +564,480 @@ ZTEST(ubi_map, many_volumes_with_many_lebs_operations_with_reboot)
 
 	memory_check(&before_init, &after_init, &after_deinit);
 }
+
+ZTEST(ubi_map, one_volume_unmap_range_and_wipe_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 8,
+	};
+
+	struct ubi_device_info info_after_init = { 0 };
+	struct ubi_device_info info = { 0 };
+
+	struct ubi_device *ubi = NULL;
+	int vol_id = -1;
+
+	/* 1. Initialize device and create volume */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_device_get_info(ubi, &info_after_init));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	/* 2. Map all LEBs but the last two */
+	const size_t mapped = vol_cfg.leb_count - 2;
+
+	for (size_t lnum = 0; lnum < mapped; ++lnum)
+		zassert_ok(ubi_leb_map(ubi, vol_id, lnum));
+
+	/* 3. Verify invalid ranges are refused */
+	zassert_equal(-EINVAL, ubi_leb_unmap_range(ubi, vol_id, 0, 0));
+	zassert_equal(-EACCES, ubi_leb_unmap_range(ubi, vol_id, vol_cfg.leb_count, 1));
+	zassert_equal(-EACCES, ubi_leb_unmap_range(ubi, vol_id, 6, 3));
+	zassert_equal(-ENOENT, ubi_leb_unmap_range(ubi, vol_id + 1, 0, 1));
+
+	/* 4. Unmap range covering mapped and unmapped LEBs */
+	zassert_ok(ubi_leb_unmap_range(ubi, vol_id, 2, vol_cfg.leb_count - 2));
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		bool is_mapped = false;
+		zassert_ok(ubi_leb_is_mapped(ubi, vol_id, lnum, &is_mapped));
+		zassert_equal(lnum < 2, is_mapped);
+	}
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info_after_init.free_leb_count - mapped, info.free_leb_count);
+	zassert_equal(mapped - 2, info.dirty_leb_count);
+
+	/* 5. Erase released PEBs, their erase counters are read at erase */
+	size_t ec_sum_before = 0;
+	size_t ec_sum_after = 0;
+	size_t peb_ec_len = 0;
+	size_t *peb_ec = NULL;
+
+	zassert_ok(ubi_device_get_peb_ec(ubi, &peb_ec, &peb_ec_len));
+	for (size_t pnum = 0; pnum < peb_ec_len; ++pnum)
+		ec_sum_before += peb_ec[pnum];
+	k_free(peb_ec);
+
+	size_t erased = 0;
+	zassert_ok(ubi_device_erase_pebs(ubi, SIZE_MAX, &erased));
+	zassert_equal(mapped - 2, erased);
+
+	zassert_ok(ubi_device_get_peb_ec(ubi, &peb_ec, &peb_ec_len));
+	for (size_t pnum = 0; pnum < peb_ec_len; ++pnum)
+		ec_sum_after += peb_ec[pnum];
+	k_free(peb_ec);
+
+	zassert_equal(ec_sum_before + erased, ec_sum_after);
+
+	/* 6. Wipe volume and erase released PEBs */
+	zassert_ok(ubi_volume_wipe(ubi, vol_id));
+	zassert_ok(ubi_volume_wipe(ubi, vol_id));
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info_after_init.free_leb_count - 2, info.free_leb_count);
+	zassert_equal(2, info.dirty_leb_count);
+
+	zassert_ok(ubi_device_erase_pebs(ubi, SIZE_MAX, &erased));
+	zassert_equal(2, erased);
+
+	/* 7. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 8. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 9. Verify volume is empty but keeps its size */
+	struct ubi_volume_config cfg = { 0 };
+	size_t alloc_lebs = 0;
+	zassert_ok(ubi_volume_get_info(ubi, vol_id, &cfg, &alloc_lebs));
+	zassert_equal(vol_cfg.leb_count, cfg.leb_count);
+	zassert_equal(0, alloc_lebs);
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info_after_init.free_leb_count, info.free_leb_count);
+
+	/* 10. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_map, volume_wipe_and_remove_without_erase_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+	};
+
+	uint8_t old_data[32] = { 0 };
+	uint8_t new_data[32] = { 0 };
+	uint8_t buf[32] = { 0 };
+
+	for (size_t i = 0; i < sizeof(old_data); ++i) {
+		old_data[i] = (uint8_t)i;
+		new_data[i] = (uint8_t)~i;
+	}
+
+	struct ubi_device_info info = { 0 };
+	struct ubi_device *ubi = NULL;
+	int vol_id = -1;
+	int snap_id = -1;
+
+	/* 1. Initialize device, create volume and write all LEBs */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum)
+		zassert_ok(ubi_leb_write(ubi, vol_id, lnum, old_data, sizeof(old_data)));
+
+	/* 2. Verify volume with snapshot cannot be wiped */
+	zassert_ok(ubi_volume_snapshot(ubi, vol_id, "/snap", &snap_id));
+	zassert_equal(-EBUSY, ubi_volume_wipe(ubi, vol_id));
+	zassert_equal(-EROFS, ubi_volume_wipe(ubi, snap_id));
+	zassert_ok(ubi_volume_remove(ubi, snap_id));
+
+	/* 3. Wipe volume and write one LEB again, without erasing dirty PEBs */
+	zassert_ok(ubi_volume_wipe(ubi, vol_id));
+	zassert_ok(ubi_leb_write(ubi, vol_id, 1, new_data, sizeof(new_data)));
+
+	/* 4. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 5. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 6. Verify only LEB written after wipe is mapped, wiped PEBs are dirty */
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		bool is_mapped = false;
+		zassert_ok(ubi_leb_is_mapped(ubi, vol_id, lnum, &is_mapped));
+		zassert_equal(1 == lnum, is_mapped);
+	}
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, buf, sizeof(buf)));
+	zassert_mem_equal(new_data, buf, sizeof(new_data));
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(vol_cfg.leb_count, info.dirty_leb_count);
+
+	/* 7. Remove volume, still without erasing dirty PEBs */
+	zassert_ok(ubi_volume_remove(ubi, vol_id));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 8. Initialize device and create volume reusing the removed volume ID */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	int new_vol_id = -1;
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &new_vol_id));
+	zassert_equal(vol_id, new_vol_id);
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 9. Initialize device and verify stale PEBs of removed volume are not mapped */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		bool is_mapped = true;
+		zassert_ok(ubi_leb_is_mapped(ubi, new_vol_id, lnum, &is_mapped));
+		zassert_false(is_mapped);
+	}
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(vol_cfg.leb_count + 1, info.dirty_leb_count);
+
+	/* 10. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_map, durable_unmap_without_erase_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 6,
+		.durable_unmap = true,
+	};
+
+	uint8_t old_data[32] = { 0 };
+	uint8_t new_data[32] = { 0 };
+	uint8_t buf[32] = { 0 };
+
+	for (size_t i = 0; i < sizeof(old_data); ++i) {
+		old_data[i] = (uint8_t)i;
+		new_data[i] = (uint8_t)~i;
+	}
+
+	struct ubi_device_info info_after_init = { 0 };
+	struct ubi_device_info info = { 0 };
+	struct ubi_device *ubi = NULL;
+	int vol_id = -1;
+	int snap_id = -1;
+
+	/* 1. Initialize device, create volume and write all LEBs */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_device_get_info(ubi, &info_after_init));
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	struct ubi_volume_config cfg = { 0 };
+	size_t alloc_lebs = 0;
+	zassert_ok(ubi_volume_get_info(ubi, vol_id, &cfg, &alloc_lebs));
+	zassert_true(cfg.durable_unmap);
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum)
+		zassert_ok(ubi_leb_write(ubi, vol_id, lnum, old_data, sizeof(old_data)));
+
+	/* 2. Unmap one LEB and a range of LEBs, journal PEB is excluded from allocation */
+	zassert_ok(ubi_leb_unmap(ubi, vol_id, 0));
+	zassert_ok(ubi_leb_unmap_range(ubi, vol_id, 2, 2));
+
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info_after_init.reserved_leb_count + 1, info.reserved_leb_count);
+
+	/* 3. Deinitialize device without erasing dirty PEBs */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 4. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 5. Verify unmapped LEBs stay unmapped and remaining LEBs keep their data */
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		const bool exp_mapped = (1 == lnum || 4 == lnum || 5 == lnum);
+		bool is_mapped = !exp_mapped;
+		zassert_ok(ubi_leb_is_mapped(ubi, vol_id, lnum, &is_mapped));
+		zassert_equal(exp_mapped, is_mapped);
+
+		if (!exp_mapped)
+			continue;
+
+		zassert_ok(ubi_leb_read(ubi, vol_id, lnum, 0, buf, sizeof(buf)));
+		zassert_mem_equal(old_data, buf, sizeof(old_data));
+	}
+
+	/* 6. Write unmapped LEB again, its new PEB is newer than the unmap record */
+	zassert_ok(ubi_leb_write(ubi, vol_id, 2, new_data, sizeof(new_data)));
+
+	/* 7. Snapshot volume and unmap one of shared LEBs */
+	zassert_ok(ubi_volume_snapshot(ubi, vol_id, "/snap", &snap_id));
+	zassert_ok(ubi_leb_unmap(ubi, vol_id, 5));
+
+	/* 8. Map and unmap one LEB until the journal is full and renewed */
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	for (size_t i = 0; i <= info.leb_size / 32; ++i) {
+		zassert_ok(ubi_leb_write(ubi, vol_id, 0, new_data, sizeof(new_data)));
+		zassert_ok(ubi_leb_unmap(ubi, vol_id, 0));
+	}
+
+	/* 9. Deinitialize device without erasing dirty PEBs */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 10. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 11. Verify LEBs unmapped before renewal stay unmapped, snapshot keeps its data */
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		const bool exp_mapped = (1 == lnum || 2 == lnum || 4 == lnum);
+		bool is_mapped = !exp_mapped;
+		zassert_ok(ubi_leb_is_mapped(ubi, vol_id, lnum, &is_mapped));
+		zassert_equal(exp_mapped, is_mapped);
+	}
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, 0, buf, sizeof(buf)));
+	zassert_mem_equal(new_data, buf, sizeof(new_data));
+
+	zassert_ok(ubi_leb_read(ubi, snap_id, 5, 0, buf, sizeof(buf)));
+	zassert_mem_equal(old_data, buf, sizeof(old_data));
+
+	zassert_ok(ubi_leb_read(ubi, snap_id, 2, 0, buf, sizeof(buf)));
+	zassert_mem_equal(new_data, buf, sizeof(new_data));
+
+	/* 12. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_map, durable_unmap_in_transaction_with_full_journal_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+		.durable_unmap = true,
+	};
+
+	uint8_t data[32] = { 0 };
+	uint8_t buf[32] = { 0 };
+
+	for (size_t i = 0; i < sizeof(data); ++i)
+		data[i] = (uint8_t)i;
+
+	struct ubi_device_info info = { 0 };
+	struct ubi_device *ubi = NULL;
+	struct ubi_vol_txn *txn = NULL;
+	int vol_id = -1;
+
+	/* 1. Initialize device and create volume */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	/* 2. Map and unmap one LEB until the journal is full, next record renews it */
+	for (size_t i = 0; i < info.leb_size / 32 - 1; ++i) {
+		zassert_ok(ubi_leb_write(ubi, vol_id, 0, data, sizeof(data)));
+		zassert_ok(ubi_leb_unmap(ubi, vol_id, 0));
+	}
+
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, data, sizeof(data)));
+	zassert_ok(ubi_leb_write(ubi, vol_id, 1, data, sizeof(data)));
+
+	/* 3. Erase dirty PEBs on another thread, chunked erase yields back with erase in flight */
+	reclaim_ret = -EIO;
+
+	k_thread_create(&reclaim_thread, reclaim_stack, K_THREAD_STACK_SIZEOF(reclaim_stack),
+			reclaim_entry, ubi, NULL, NULL, k_thread_priority_get(k_current_get()), 0,
+			K_NO_WAIT);
+	k_yield();
+
+	/* 4. Unmap in a transaction renews the full journal while device is held */
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+	zassert_ok(ubi_leb_unmap(ubi, vol_id, 0));
+	zassert_ok(ubi_vol_txn_commit(txn));
+
+	zassert_ok(k_thread_join(&reclaim_thread, K_FOREVER));
+	zassert_ok(reclaim_ret);
+
+	/* 5. Deinitialize device without erasing dirty PEBs */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 6. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 7. Verify LEB unmapped in transaction stays unmapped, other LEB keeps its data */
+	bool is_mapped = true;
+	zassert_ok(ubi_leb_is_mapped(ubi, vol_id, 0, &is_mapped));
+	zassert_false(is_mapped);
+
+	zassert_ok(ubi_leb_is_mapped(ubi, vol_id, 1, &is_mapped));
+	zassert_true(is_mapped);
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, buf, sizeof(buf)));
+	zassert_mem_equal(data, buf, sizeof(data));
+
+	/* 8. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
@@ -0,0 +1,378 @@
+/**
+ * \file    tests_ubi_ring.c
+ *
+ * \author  Kamil Kielbasa
+ *
+ * \brief   Hardware tests for Unsorted Block Images (UBI) circular log.
+ *
+ * \version 0.6
+ * \date    2026-10-17
+ *
+ * \copyright Copyright (c) 2025
+ *
+ */
+
+/* Include files ------------------------------------------------------------------------------- */
+
+/* UBI header: */
+#include <ubi.h>
+#include <ubi_ring.h>
+
+/* Zephyr headers: */
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/toolchain/common.h>
+#include <zephyr/sys/sys_heap.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Module defines ------------------------------------------------------------------------------ */
+
+#define UBI_PARTITION_NAME ubi_partition
+#define UBI_PARTITION_DEVICE FIXED_PARTITION_DEVICE(UBI_PARTITION_NAME)
+#define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
+#define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
+
+#define RAW_PARTITION_NAME raw_partition
+#define RAW_PARTITION_ID FIXED_PARTITION_ID(RAW_PARTITION_NAME)
+#define RAW_PARTITION_DEVICE FIXED_PARTITION_DEVICE(RAW_PARTITION_NAME)
+#define RAW_PARTITION_OFFSET FIXED_PARTITION_OFFSET(RAW_PARTITION_NAME)
+#define RAW_PARTITION_SIZE FIXED_PARTITION_SIZE(RAW_PARTITION_NAME)
+
+#define RECORD_SIZE (64)
+#define FRAMED_RECORD_SIZE (80)
+
+#define NR_OF_RECORDS (150)
+#define NR_OF_WRAP_RECORDS (2000)
+
+/* Module types and type definitiones ---------------------------------------------------------- */
+/* Module interface variables and constants ---------------------------------------------------- */
+/* Static variables and constants -------------------------------------------------------------- */
+
+static struct ubi_mtd mtd = { 0 };
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS)
+extern struct sys_heap _system_heap;
+#endif
+
+static struct sys_memory_stats before_init = { 0 };
+static struct sys_memory_stats after_init = { 0 };
+static struct sys_memory_stats after_deinit = { 0 };
+
+static const struct ubi_volume_config ring_vol_cfg = {
+	.name = { '/', 'r', 'i', 'n', 'g', '_', '0' },
+	.type = UBI_VOLUME_TYPE_DYNAMIC,
+	.leb_count = 4,
+};
+
+static uint8_t record[RECORD_SIZE] = { 0 };
+
+/* Static function declarations ---------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void);
+static void ztest_suite_after(void *ctx);
+
+static void ztest_testcase_before(void *ctx);
+static void ztest_testcase_teardown(void *ctx);
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit);
+
+static void record_fill(uint32_t idx);
+static uint32_t record_index(void);
+
+static size_t peb_ec_sum(struct ubi_device *ubi);
+
+/* Static function definitions ----------------------------------------------------------------- */
+
+static void *ztest_suite_setup(void)
+{
+	const struct device *flash_dev = UBI_PARTITION_DEVICE;
+	zassert_true(device_is_ready(flash_dev));
+
+	struct flash_pages_info page_info = { 0 };
+	zassert_ok(flash_get_page_info_by_offs(flash_dev, 0, &page_info));
+
+	const size_t write_block_size = flash_get_write_block_size(flash_dev);
+	const size_t erase_block_size = page_info.size;
+
+	mtd.partition_id = FIXED_PARTITION_ID(UBI_PARTITION_NAME);
+	mtd.erase_block_size = erase_block_size;
+	mtd.write_block_size = write_block_size;
+
+	return NULL;
+}
+
+static void ztest_suite_after(void *ctx)
+{
+	(void)ctx;
+
+	return;
+}
+
+static void ztest_testcase_before(void *ctx)
+{
+	(void)ctx;
+
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET, UBI_PARTITION_SIZE));
+
+	return;
+}
+
+static void ztest_testcase_teardown(void *ctx)
+{
+	(void)ctx;
+	return;
+}
+
+static void memory_check(struct sys_memory_stats *before_init, struct sys_memory_stats *after_init,
+			 struct sys_memory_stats *after_deinit)
+{
+	zassert_not_null(before_init);
+	zassert_not_null(after_init);
+	zassert_not_null(after_deinit);
+
+	zassert_equal(before_init->free_bytes, after_deinit->free_bytes);
+	zassert_equal(before_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	zassert_not_equal(after_init->free_bytes, after_deinit->free_bytes);
+	zassert_not_equal(after_init->allocated_bytes, after_deinit->allocated_bytes);
+
+	memset(before_init, 0, sizeof(*before_init));
+	memset(after_init, 0, sizeof(*after_init));
+	memset(after_deinit, 0, sizeof(*after_deinit));
+}
+
+static void record_fill(uint32_t idx)
+{
+	memset(record, (uint8_t)idx, sizeof(record));
+	memcpy(record, &idx, sizeof(idx));
+}
+
+static uint32_t record_index(void)
+{
+	uint32_t idx = 0;
+	memcpy(&idx, record, sizeof(idx));
+
+	for (size_t i = sizeof(idx); i < sizeof(record); ++i)
+		zassert_equal((uint8_t)idx, record[i]);
+
+	return idx;
+}
+
+static size_t peb_ec_sum(struct ubi_device *ubi)
+{
+	size_t peb_ec_len = 0;
+	size_t *peb_ec = NULL;
+	zassert_ok(ubi_device_get_peb_ec(ubi, &peb_ec, &peb_ec_len));
+	zassert_not_null(peb_ec);
+
+	size_t sum = 0;
+	for (size_t pnum = 0; pnum < peb_ec_len; ++pnum)
+		sum += peb_ec[pnum];
+
+	k_free(peb_ec);
+
+	return sum;
+}
+
+/* Module interface function definitions ------------------------------------------------------- */
+
+ZTEST_SUITE(ubi_ring, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
+	    ztest_suite_after);
+
+ZTEST(ubi_ring, append_read_trim_with_reboot)
+{
+	struct ubi_device *ubi = NULL;
+	struct ubi_ring *ring = NULL;
+	struct ubi_ring_cursor cursor = { 0 };
+	struct ubi_ring_cursor trim_cursor = { 0 };
+	struct ubi_ring_cursor first_cursor = { 0 };
+	struct ubi_ring_info info = { 0 };
+	int vol_id = -1;
+	size_t len = 0;
+
+	/* 1. Initialize device, volume and log */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &ring_vol_cfg, &vol_id));
+
+	zassert_ok(ubi_ring_open(ubi, vol_id, &ring));
+	zassert_not_null(ring);
+
+	zassert_equal(-ENODATA, ubi_ring_get_tail(ring, &cursor));
+	zassert_equal(-ENODATA, ubi_ring_get_head(ring, &cursor));
+
+	/* 2. Append records spanning more than one LEB */
+	for (uint32_t idx = 0; idx < NR_OF_RECORDS; ++idx) {
+		record_fill(idx);
+		zassert_ok(ubi_ring_append(ring, record, sizeof(record)));
+	}
+
+	zassert_equal(-EINVAL, ubi_ring_append(ring, record, 0));
+	zassert_equal(-EINVAL, ubi_ring_append(ring, record, CONFIG_UBI_RING_MAX_RECORD_LEN + 1));
+
+	zassert_ok(ubi_ring_get_info(ring, &info));
+	zassert_equal(NR_OF_RECORDS, info.appends);
+	zassert_equal(2, info.used_lebs);
+	zassert_equal(0, info.reclaims);
+
+	/* 3. Deinitialize log and device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_ring_close(ring));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 4. Read all records after reboot, remember cursor in the second LEB */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_ring_open(ubi, vol_id, &ring));
+
+	zassert_ok(ubi_ring_get_tail(ring, &cursor));
+	first_cursor = cursor;
+
+	for (uint32_t idx = 0; idx < NR_OF_RECORDS; ++idx) {
+		if (NR_OF_RECORDS - 10 == idx)
+			trim_cursor = cursor;
+
+		memset(record, 0, sizeof(record));
+		zassert_ok(ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len));
+		zassert_equal(sizeof(record), len);
+		zassert_equal(idx, record_index());
+	}
+
+	zassert_equal(-ENODATA, ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len));
+	zassert_not_equal(first_cursor.sqnum, trim_cursor.sqnum);
+
+	/* 5. Release first LEB */
+	zassert_ok(ubi_ring_trim(ring, &trim_cursor));
+
+	zassert_ok(ubi_ring_get_info(ring, &info));
+	zassert_equal(1, info.used_lebs);
+
+	zassert_ok(ubi_ring_close(ring));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 6. Trimmed LEB stays released after reboot */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_ring_open(ubi, vol_id, &ring));
+
+	zassert_ok(ubi_ring_get_info(ring, &info));
+	zassert_equal(1, info.used_lebs);
+
+	cursor = first_cursor;
+	zassert_equal(-ENOENT, ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len));
+
+	zassert_ok(ubi_ring_get_tail(ring, &cursor));
+	zassert_equal(trim_cursor.sqnum, cursor.sqnum);
+
+	zassert_ok(ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len));
+	uint32_t expected = record_index() + 1;
+	zassert_true(expected <= NR_OF_RECORDS - 10);
+
+	while (0 == ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len))
+		zassert_equal(expected++, record_index());
+
+	zassert_equal(NR_OF_RECORDS, expected);
+
+	/* 7. Append continues after the newest record */
+	record_fill(NR_OF_RECORDS);
+	zassert_ok(ubi_ring_append(ring, record, sizeof(record)));
+
+	memset(record, 0, sizeof(record));
+	zassert_ok(ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len));
+	zassert_equal(NR_OF_RECORDS, record_index());
+
+	zassert_ok(ubi_ring_close(ring));
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_ring, wrap_around_with_reboot)
+{
+	struct ubi_device *ubi = NULL;
+	struct ubi_ring *ring = NULL;
+	struct ubi_ring_cursor cursor = { 0 };
+	struct ubi_ring_info info = { 0 };
+	const struct flash_area *raw_fa = NULL;
+	int vol_id = -1;
+	size_t len = 0;
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_create(ubi, &ring_vol_cfg, &vol_id));
+	zassert_ok(ubi_ring_open(ubi, vol_id, &ring));
+
+	/* 1. Append many times the volume capacity */
+	const size_t ec_before = peb_ec_sum(ubi);
+	const int64_t start = k_uptime_ticks();
+
+	for (uint32_t idx = 0; idx < NR_OF_WRAP_RECORDS; ++idx) {
+		record_fill(idx);
+		zassert_ok(ubi_ring_append(ring, record, sizeof(record)));
+	}
+
+	const uint64_t ring_us = MAX(1, k_ticks_to_us_floor64(k_uptime_ticks() - start));
+	const size_t erases = peb_ec_sum(ubi) - ec_before;
+
+	zassert_ok(ubi_ring_get_info(ring, &info));
+	zassert_equal(ring_vol_cfg.leb_count, info.used_lebs);
+	zassert_true(info.reclaims > 0);
+
+	/* Every reclaimed LEB costs at most one erase */
+	zassert_true(erases <= info.reclaims);
+
+	/* 2. Raw program bandwidth of the same record stream */
+	zassert_ok(flash_erase(RAW_PARTITION_DEVICE, RAW_PARTITION_OFFSET, RAW_PARTITION_SIZE));
+	zassert_ok(flash_area_open(RAW_PARTITION_ID, &raw_fa));
+
+	const size_t raw_records = RAW_PARTITION_SIZE / FRAMED_RECORD_SIZE;
+	uint8_t raw_record[FRAMED_RECORD_SIZE] = { 0 };
+	const int64_t raw_start = k_uptime_ticks();
+
+	for (size_t idx = 0; idx < raw_records; ++idx)
+		zassert_ok(flash_area_write(raw_fa, idx * FRAMED_RECORD_SIZE, raw_record,
+					    sizeof(raw_record)));
+
+	const uint64_t raw_us = MAX(1, k_ticks_to_us_floor64(k_uptime_ticks() - raw_start));
+	flash_area_close(raw_fa);
+
+	const uint32_t ring_kbps =
+		(uint32_t)(((uint64_t)NR_OF_WRAP_RECORDS * RECORD_SIZE * 1000000ULL) /
+			   (ring_us * 1024));
+	const uint32_t raw_kbps =
+		(uint32_t)(((uint64_t)raw_records * RECORD_SIZE * 1000000ULL) / (raw_us * 1024));
+
+	TC_PRINT("ubi_ring: %u appends, %u reclaims, %u erases\n", (uint32_t)info.appends,
+		 (uint32_t)info.reclaims, (uint32_t)erases);
+	TC_PRINT("ubi_ring: append %u KiB/s, raw program %u KiB/s\n", ring_kbps, raw_kbps);
+
+	zassert_ok(ubi_ring_close(ring));
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 3. Only the newest records survive reboot, in order */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_ring_open(ubi, vol_id, &ring));
+
+	zassert_ok(ubi_ring_get_tail(ring, &cursor));
+	zassert_ok(ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len));
+
+	uint32_t expected = record_index() + 1;
+	zassert_true(expected > 1);
+
+	while (0 == ubi_ring_read_from(ring, &cursor, record, sizeof(record), &len))
+		zassert_equal(expected++, record_index());
+
+	zassert_equal(NR_OF_WRAP_RECORDS, expected);
+
+	zassert_ok(ubi_ring_close(ring));
+	zassert_ok(ubi_device_deinit(ubi));
+}
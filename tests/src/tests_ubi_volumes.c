@@ -65,6 +65,8 @@ static void memory_check(struct sys_memory_stats *before_init, struct sys_memory
 
 static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec);
 
+static uint32_t dev_hdr_revision(void);
+
 /* Static function definitions ----------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void)
@@ -144,6 +146,16 @@ static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec)
 	k_free(peb_ec);
 }
 
+static uint32_t dev_hdr_revision(void)
+{
+	/* Revision field of device header stored at start of first bank */
+	uint32_t revision = 0;
+	zassert_ok(flash_read(UBI_PARTITION_DEVICE, UBI_PARTITION_OFFSET + 16, &revision,
+			      sizeof(revision)));
+
+	return revision;
+}
+
 /* Module interface function definitions ------------------------------------------------------- */
 
 ZTEST_SUITE(ubi_volumes, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
@@ -537,6 +549,10 @@ ZTEST(ubi_volumes, create_many_with_reboot)
 	struct ubi_device *ubi = NULL;
 	struct ubi_device_info info = { 0 };
 
+	/* Volumes allocate every PEB, which a reserved PEB pool does not allow */
+	if (CONFIG_UBI_RESERVED_PEBS_PER1024 > 0)
+		ztest_test_skip();
+
 	/* 1. Initialize device */
 	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
 
@@ -695,6 +711,10 @@ ZTEST(ubi_volumes, create_many_with_remove_with_reboot)
 	struct ubi_device *ubi = NULL;
 	struct ubi_device_info info = { 0 };
 
+	/* Volumes allocate every PEB, which a reserved PEB pool does not allow */
+	if (CONFIG_UBI_RESERVED_PEBS_PER1024 > 0)
+		ztest_test_skip();
+
 	/* 1. Initialize device */
 	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
 
@@ -1032,6 +1052,10 @@ ZTEST(ubi_volumes, create_many_with_resizes_lower_and_upper_with_reboot)
 	struct ubi_device *ubi = NULL;
 	struct ubi_device_info info = { 0 };
 
+	/* Volumes allocate every PEB, which a reserved PEB pool does not allow */
+	if (CONFIG_UBI_RESERVED_PEBS_PER1024 > 0)
+		ztest_test_skip();
+
 	/* 1. Initialize device */
 	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
 
@@ -1390,3 +1414,739 @@ ZTEST(ubi_volumes, create_many_with_resizes_lower_and_upper_with_reboot)
 
 	memory_check(&before_init, &after_init, &after_deinit);
 }
+
+ZTEST(ubi_volumes, create_snapshot_with_copy_on_write_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 3,
+	};
+	struct ubi_volume_config read_vol_cfg = { 0 };
+	size_t read_alloc_lebs = 0;
+	int vol_id = -1;
+	int snap_id = -1;
+	int tmp_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+
+	uint8_t old_data[64] = { 0 };
+	uint8_t new_data[64] = { 0 };
+	uint8_t erased[64] = { 0 };
+	uint8_t buf[64] = { 0 };
+
+	memset(old_data, 0xA5, sizeof(old_data));
+	memset(new_data, 0x5A, sizeof(new_data));
+	memset(erased, 0xFF, sizeof(erased));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	/* 1. Initialize device and write source volume */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, old_data, sizeof(old_data)));
+	zassert_ok(ubi_leb_write(ubi, vol_id, 1, old_data, sizeof(old_data)));
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id, 2, 0, old_data, sizeof(old_data)));
+
+	/* 2. Create snapshot */
+	zassert_ok(ubi_volume_snapshot(ubi, vol_id, "/snap_0", &snap_id));
+	zassert_not_equal(vol_id, snap_id);
+	zassert_equal(-EEXIST, ubi_volume_snapshot(ubi, vol_id, "/snap_0", &tmp_id));
+	zassert_equal(-EINVAL, ubi_volume_snapshot(ubi, snap_id, "/snap_1", &tmp_id));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(2 * vol_cfg.leb_count, info.allocated_leb_count);
+	zassert_equal(2, info.volumes_count);
+	zassert_equal(0, info.dirty_leb_count);
+
+	zassert_ok(ubi_volume_get_info(ubi, snap_id, &read_vol_cfg, &read_alloc_lebs));
+	zassert_equal(vol_cfg.leb_count, read_vol_cfg.leb_count);
+	zassert_equal(3, read_alloc_lebs);
+
+	/* 3. Snapshot is read-only */
+	zassert_equal(-EROFS, ubi_leb_write(ubi, snap_id, 0, new_data, sizeof(new_data)));
+	zassert_equal(-EROFS,
+		      ubi_leb_write_offset(ubi, snap_id, 2, 64, new_data, sizeof(new_data)));
+	zassert_equal(-EROFS, ubi_leb_unmap(ubi, snap_id, 0));
+
+	/* 4. Rewrite source, shared PEBs are copied on write */
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, new_data, sizeof(new_data)));
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id, 2, 64, new_data, sizeof(new_data)));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.dirty_leb_count);
+
+	zassert_equal(-EBUSY, ubi_volume_remove(ubi, vol_id));
+
+	/* 5. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 6. Initialize device and verify both volumes */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(2, info.volumes_count);
+	zassert_equal(0, info.dirty_leb_count);
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(new_data, buf, sizeof(buf));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, buf, sizeof(buf)));
+	zassert_mem_equal(old_data, buf, sizeof(buf));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, 0, buf, sizeof(buf)));
+	zassert_mem_equal(old_data, buf, sizeof(buf));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, 64, buf, sizeof(buf)));
+	zassert_mem_equal(new_data, buf, sizeof(buf));
+
+	for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+		zassert_ok(ubi_leb_read(ubi, snap_id, lnum, 0, buf, sizeof(buf)));
+		zassert_mem_equal(old_data, buf, sizeof(buf));
+	}
+
+	zassert_ok(ubi_leb_read(ubi, snap_id, 2, 64, buf, sizeof(buf)));
+	zassert_mem_equal(erased, buf, sizeof(buf));
+
+	/* 7. Remove snapshot, only its own PEBs become dirty */
+	zassert_ok(ubi_volume_remove(ubi, snap_id));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(1, info.volumes_count);
+	zassert_equal(2, info.dirty_leb_count);
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, buf, sizeof(buf)));
+	zassert_mem_equal(old_data, buf, sizeof(buf));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 8. Initialize device and verify source volume */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(1, info.volumes_count);
+	zassert_equal(2, info.dirty_leb_count);
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(new_data, buf, sizeof(buf));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, 64, buf, sizeof(buf)));
+	zassert_mem_equal(new_data, buf, sizeof(buf));
+
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_volumes, transaction_create_resize_rename_remove_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg_a = {
+		.name = { '/', 'u', 'b', 'i', '_', 'a' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+	const struct ubi_volume_config vol_cfg_b = {
+		.name = { '/', 'u', 'b', 'i', '_', 'b' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+	const struct ubi_volume_config vol_cfg_c = {
+		.name = { '/', 'u', 'b', 'i', '_', 'c' },
+		.type = UBI_VOLUME_TYPE_STATIC,
+		.leb_count = 3,
+	};
+	const struct ubi_volume_config vol_cfg_d = {
+		.name = { '/', 'u', 'b', 'i', '_', 'd' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+	const struct ubi_volume_config resize_cfg = {
+		.leb_count = 1,
+	};
+	const struct ubi_volume_config unnamed_cfg = {
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+	struct ubi_volume_config read_vol_cfg = { 0 };
+	size_t read_alloc_lebs = 0;
+	int vol_id_a = -1;
+	int vol_id_b = -1;
+	int vol_id_c = -1;
+	int vol_id_d = -1;
+	int tmp_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_vol_txn *txn = NULL;
+	struct ubi_device_info info = { 0 };
+
+	uint32_t revision = 0;
+	uint8_t data[64] = { 0 };
+	uint8_t buf[64] = { 0 };
+
+	memset(data, 0xA5, sizeof(data));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	/* 1. Initialize device and create volumes one by one */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_a, &vol_id_a));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_b, &vol_id_b));
+
+	zassert_ok(ubi_leb_write(ubi, vol_id_a, 0, data, sizeof(data)));
+	zassert_ok(ubi_leb_write(ubi, vol_id_a, 1, data, sizeof(data)));
+	zassert_ok(ubi_leb_write(ubi, vol_id_b, 0, data, sizeof(data)));
+
+	revision = dev_hdr_revision();
+
+	/* 2. Aborted transaction leaves device untouched */
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+	zassert_ok(ubi_vol_txn_create(txn, &vol_cfg_c, &vol_id_c));
+	zassert_ok(ubi_vol_txn_abort(txn));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(2, info.volumes_count);
+	zassert_equal(revision, dev_hdr_revision());
+
+	/* 3. Stage operations, nothing is visible before commit */
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+	zassert_ok(ubi_vol_txn_create(txn, &vol_cfg_c, &vol_id_c));
+	zassert_ok(ubi_vol_txn_create(txn, &vol_cfg_d, &vol_id_d));
+	zassert_ok(ubi_vol_txn_create(txn, &vol_cfg_c, &tmp_id));
+	zassert_equal(vol_id_c, tmp_id);
+	zassert_equal(-EINVAL, ubi_vol_txn_create(txn, &unnamed_cfg, &tmp_id));
+
+	zassert_ok(ubi_vol_txn_resize(txn, vol_id_a, &resize_cfg));
+	zassert_equal(-ECANCELED, ubi_vol_txn_resize(txn, vol_id_c, &resize_cfg));
+	zassert_ok(ubi_vol_txn_rename(txn, vol_id_b, "/ubi_e"));
+	zassert_equal(-EEXIST, ubi_vol_txn_rename(txn, vol_id_b, "/ubi_c"));
+	zassert_ok(ubi_vol_txn_remove(txn, vol_id_d));
+	zassert_equal(-ENOENT, ubi_vol_txn_remove(txn, vol_id_d));
+
+	zassert_equal(-ENOENT, ubi_volume_get_info(ubi, vol_id_c, &read_vol_cfg, &read_alloc_lebs));
+	zassert_equal(revision, dev_hdr_revision());
+
+	/* 4. Commit writes a single table revision */
+	zassert_ok(ubi_vol_txn_commit(txn));
+	zassert_equal(revision + 1, dev_hdr_revision());
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(3, info.volumes_count);
+	zassert_equal(1 + vol_cfg_b.leb_count + vol_cfg_c.leb_count, info.allocated_leb_count);
+	zassert_equal(1, info.dirty_leb_count);
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 5. Initialize device and verify committed table */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(3, info.volumes_count);
+	zassert_equal(1 + vol_cfg_b.leb_count + vol_cfg_c.leb_count, info.allocated_leb_count);
+
+	zassert_ok(ubi_volume_get_info(ubi, vol_id_a, &read_vol_cfg, &read_alloc_lebs));
+	zassert_equal(1, read_vol_cfg.leb_count);
+	zassert_equal(1, read_alloc_lebs);
+
+	zassert_ok(ubi_volume_get_info(ubi, vol_id_b, &read_vol_cfg, &read_alloc_lebs));
+	zassert_mem_equal("/ubi_e", read_vol_cfg.name, sizeof("/ubi_e"));
+	zassert_ok(ubi_leb_read(ubi, vol_id_b, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(data, buf, sizeof(buf));
+
+	zassert_ok(ubi_volume_get_info(ubi, vol_id_c, &read_vol_cfg, &read_alloc_lebs));
+	zassert_equal(UBI_VOLUME_TYPE_STATIC, read_vol_cfg.type);
+	zassert_equal(vol_cfg_c.leb_count, read_vol_cfg.leb_count);
+
+	zassert_equal(-ENOENT, ubi_volume_get_info(ubi, vol_id_d, &read_vol_cfg, &read_alloc_lebs));
+
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_volumes, transaction_interrupted_commit_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+	const size_t bank_0 = UBI_PARTITION_OFFSET;
+	const size_t bank_1 = UBI_PARTITION_OFFSET + mtd.erase_block_size;
+
+	struct ubi_volume_config new_vol_cfg = vol_cfg;
+	int vol_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_vol_txn *txn = NULL;
+	struct ubi_device_info info = { 0 };
+
+	static uint8_t old_table[256];
+	static uint8_t new_table[256];
+	static uint8_t buf[256];
+
+	/* 1. Initialize device with a single volume */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(flash_read(UBI_PARTITION_DEVICE, bank_1, old_table, sizeof(old_table)));
+
+	/* 2. Commit two more volumes at once */
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+	new_vol_cfg.name[5] = '1';
+	zassert_ok(ubi_vol_txn_create(txn, &new_vol_cfg, &vol_id));
+	new_vol_cfg.name[5] = '2';
+	zassert_ok(ubi_vol_txn_create(txn, &new_vol_cfg, &vol_id));
+	zassert_ok(ubi_vol_txn_commit(txn));
+
+	zassert_ok(ubi_device_deinit(ubi));
+	zassert_ok(flash_read(UBI_PARTITION_DEVICE, bank_0, new_table, sizeof(new_table)));
+
+	/* 3. Power cut after first bank, new revision is rolled forward */
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, bank_1, mtd.erase_block_size));
+	zassert_ok(flash_write(UBI_PARTITION_DEVICE, bank_1, old_table, sizeof(old_table)));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(3, info.volumes_count);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(flash_read(UBI_PARTITION_DEVICE, bank_1, buf, sizeof(buf)));
+	zassert_mem_equal(new_table, buf, sizeof(buf));
+
+	/* 4. Power cut within first bank, old revision is rolled back */
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, bank_1, mtd.erase_block_size));
+	zassert_ok(flash_write(UBI_PARTITION_DEVICE, bank_1, old_table, sizeof(old_table)));
+	zassert_ok(flash_erase(UBI_PARTITION_DEVICE, bank_0, mtd.erase_block_size));
+	zassert_ok(flash_write(UBI_PARTITION_DEVICE, bank_0, new_table, 80));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(1, info.volumes_count);
+	zassert_equal(vol_cfg.leb_count, info.allocated_leb_count);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(flash_read(UBI_PARTITION_DEVICE, bank_0, buf, sizeof(buf)));
+	zassert_mem_equal(old_table, buf, sizeof(buf));
+}
+
+ZTEST(ubi_volumes, rename_and_swap_names_with_reboot)
+{
+	const struct ubi_volume_config slot_a_cfg = {
+		.name = { '/', 's', 'l', 'o', 't', '_', 'a' },
+		.type = UBI_VOLUME_TYPE_STATIC,
+		.leb_count = 2,
+	};
+	const struct ubi_volume_config slot_b_cfg = {
+		.name = { '/', 's', 'l', 'o', 't', '_', 'b' },
+		.type = UBI_VOLUME_TYPE_STATIC,
+		.leb_count = 2,
+	};
+	struct ubi_volume_config read_vol_cfg = { 0 };
+	size_t read_alloc_lebs = 0;
+	int vol_id_1 = -1;
+	int vol_id_2 = -1;
+	int active_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+
+	uint32_t revision = 0;
+	uint8_t data_1[64] = { 0 };
+	uint8_t data_2[64] = { 0 };
+	uint8_t buf[64] = { 0 };
+
+	memset(data_1, 0x11, sizeof(data_1));
+	memset(data_2, 0x22, sizeof(data_2));
+
+	/* 1. Initialize device with two image slots */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &slot_a_cfg, &vol_id_1));
+	zassert_ok(ubi_volume_create(ubi, &slot_b_cfg, &vol_id_2));
+	zassert_ok(ubi_leb_write(ubi, vol_id_1, 0, data_1, sizeof(data_1)));
+	zassert_ok(ubi_leb_write(ubi, vol_id_2, 0, data_2, sizeof(data_2)));
+
+	/* 2. Swap names with a single table revision and no data movement */
+	revision = dev_hdr_revision();
+
+	zassert_ok(ubi_volume_swap_names(ubi, vol_id_1, vol_id_2));
+	zassert_equal(revision + 1, dev_hdr_revision());
+	zassert_equal(-EINVAL, ubi_volume_swap_names(ubi, vol_id_1, vol_id_1));
+	zassert_equal(-ENOENT, ubi_volume_swap_names(ubi, vol_id_1, vol_id_2 + 1));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.dirty_leb_count);
+
+	zassert_ok(ubi_volume_create(ubi, &slot_a_cfg, &active_id));
+	zassert_equal(vol_id_2, active_id);
+
+	/* 3. Rename keeps names unique */
+	zassert_equal(-EEXIST, ubi_volume_rename(ubi, vol_id_1, "/slot_a"));
+	zassert_ok(ubi_volume_rename(ubi, vol_id_1, "/slot_old"));
+	zassert_equal(revision + 2, dev_hdr_revision());
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 4. Initialize device and verify names and data */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_get_info(ubi, vol_id_1, &read_vol_cfg, &read_alloc_lebs));
+	zassert_mem_equal("/slot_old", read_vol_cfg.name, sizeof("/slot_old"));
+	zassert_ok(ubi_volume_get_info(ubi, vol_id_2, &read_vol_cfg, &read_alloc_lebs));
+	zassert_mem_equal("/slot_a", read_vol_cfg.name, sizeof("/slot_a"));
+
+	zassert_ok(ubi_leb_read(ubi, vol_id_1, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(data_1, buf, sizeof(buf));
+	zassert_ok(ubi_leb_read(ubi, vol_id_2, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(data_2, buf, sizeof(buf));
+
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_volumes, create_autoresize_with_reboot)
+{
+	const struct ubi_volume_config fixed_cfg = {
+		.name = { '/', 'f', 'i', 'x', 'e', 'd' },
+		.type = UBI_VOLUME_TYPE_STATIC,
+		.leb_count = 3,
+	};
+	const struct ubi_volume_config grow_cfg = {
+		.name = { '/', 'g', 'r', 'o', 'w' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.autoresize = true,
+		.leb_count = 1,
+	};
+	struct ubi_volume_config other_cfg = grow_cfg;
+	struct ubi_volume_config read_vol_cfg = { 0 };
+	size_t read_alloc_lebs = 0;
+	int fixed_id = -1;
+	int grow_id = -1;
+	int tmp_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+
+	uint8_t data[64] = { 0 };
+	uint8_t buf[64] = { 0 };
+
+	memset(data, 0xA5, sizeof(data));
+
+	/* 1. Initialize device and create volumes */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &fixed_cfg, &fixed_id));
+	zassert_ok(ubi_volume_create(ubi, &grow_cfg, &grow_id));
+	zassert_ok(ubi_leb_write(ubi, grow_id, 0, data, sizeof(data)));
+
+	other_cfg.name[1] = 'x';
+	zassert_equal(-EEXIST, ubi_volume_create(ubi, &other_cfg, &tmp_id));
+	other_cfg.type = UBI_VOLUME_TYPE_STATIC;
+	zassert_equal(-EINVAL, ubi_volume_create(ubi, &other_cfg, &tmp_id));
+
+	zassert_ok(ubi_volume_get_info(ubi, grow_id, &read_vol_cfg, &read_alloc_lebs));
+	zassert_true(read_vol_cfg.autoresize);
+	zassert_equal(grow_cfg.leb_count, read_vol_cfg.leb_count);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 2. Attach grows volume over all unallocated LEBs and clears the request */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(info.leb_total_count - info.reserved_leb_count, info.allocated_leb_count);
+
+	zassert_ok(ubi_volume_get_info(ubi, grow_id, &read_vol_cfg, &read_alloc_lebs));
+	zassert_false(read_vol_cfg.autoresize);
+	zassert_equal(info.leb_total_count - info.reserved_leb_count - fixed_cfg.leb_count,
+		      read_vol_cfg.leb_count);
+
+	zassert_ok(ubi_leb_read(ubi, grow_id, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(data, buf, sizeof(buf));
+	zassert_ok(ubi_leb_write(ubi, grow_id, read_vol_cfg.leb_count - 1, data, sizeof(data)));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 3. Initialize device and verify size is kept */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_get_info(ubi, grow_id, &read_vol_cfg, &read_alloc_lebs));
+	zassert_false(read_vol_cfg.autoresize);
+	zassert_equal(info.leb_total_count - info.reserved_leb_count - fixed_cfg.leb_count,
+		      read_vol_cfg.leb_count);
+	zassert_equal(2, read_alloc_lebs);
+
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_volumes, seal_static_volume_with_reboot)
+{
+	const struct ubi_volume_config assets_cfg = {
+		.name = { '/', 'a', 's', 's', 'e', 't', 's' },
+		.type = UBI_VOLUME_TYPE_STATIC,
+		.leb_count = 2,
+	};
+	const struct ubi_volume_config data_cfg = {
+		.name = { '/', 'd', 'a', 't', 'a' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+	int assets_id = -1;
+	int data_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_sealed_volume *sealed = NULL;
+	struct ubi_device_info info = { 0 };
+
+	uint32_t revision = 0;
+	uint8_t asset[64] = { 0 };
+	uint8_t buf[64] = { 0 };
+
+	memset(asset, 0x5a, sizeof(asset));
+
+	/* 1. Initialize device and commit static volume contents */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &assets_cfg, &assets_id));
+	zassert_ok(ubi_volume_create(ubi, &data_cfg, &data_id));
+	zassert_ok(ubi_leb_write(ubi, assets_id, 0, asset, sizeof(asset)));
+	zassert_equal(-EINVAL, ubi_sealed_open(ubi, assets_id, &sealed));
+
+	/* 2. Seal in one table revision, only static volumes qualify */
+	revision = dev_hdr_revision();
+
+	zassert_equal(-EINVAL, ubi_volume_seal(ubi, data_id));
+	zassert_equal(-ENOENT, ubi_volume_seal(ubi, data_id + 1));
+	zassert_ok(ubi_volume_seal(ubi, assets_id));
+	zassert_equal(revision + 1, dev_hdr_revision());
+	zassert_ok(ubi_volume_seal(ubi, assets_id));
+	zassert_equal(revision + 1, dev_hdr_revision());
+
+	/* 3. Sealed volume is read-only */
+	zassert_equal(-EROFS, ubi_leb_write(ubi, assets_id, 1, asset, sizeof(asset)));
+	zassert_equal(-EROFS, ubi_leb_write_offset(ubi, assets_id, 0, 64, asset, sizeof(asset)));
+	zassert_equal(-EROFS, ubi_leb_map(ubi, assets_id, 1));
+	zassert_equal(-EROFS, ubi_leb_unmap(ubi, assets_id, 0));
+
+	/* 4. Lock-free reads through handle */
+	zassert_ok(ubi_sealed_open(ubi, assets_id, &sealed));
+	zassert_not_null(sealed);
+
+	zassert_ok(ubi_sealed_read(sealed, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(buf, asset, sizeof(buf), "Memory blocks are not equal");
+	zassert_equal(-ENOENT, ubi_sealed_read(sealed, 1, 0, buf, sizeof(buf)));
+	zassert_equal(-EACCES, ubi_sealed_read(sealed, 2, 0, buf, sizeof(buf)));
+
+	/* 5. Other volumes change meanwhile, open handle pins sealed volume */
+	for (size_t i = 0; i < 4; ++i)
+		zassert_ok(ubi_leb_write(ubi, data_id, 0, asset, sizeof(asset)));
+
+	zassert_ok(ubi_device_erase_pebs(ubi, SIZE_MAX, NULL));
+	zassert_equal(-EBUSY, ubi_volume_remove(ubi, assets_id));
+
+	memset(buf, 0, sizeof(buf));
+	zassert_ok(ubi_sealed_read(sealed, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(buf, asset, sizeof(buf), "Memory blocks are not equal");
+	zassert_ok(ubi_sealed_close(sealed));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	/* 6. Seal survives reboot */
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_equal(-EROFS, ubi_leb_write(ubi, assets_id, 1, asset, sizeof(asset)));
+
+	sealed = NULL;
+	memset(buf, 0, sizeof(buf));
+	zassert_ok(ubi_sealed_open(ubi, assets_id, &sealed));
+	zassert_ok(ubi_sealed_read(sealed, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(buf, asset, sizeof(buf), "Memory blocks are not equal");
+	zassert_ok(ubi_sealed_close(sealed));
+
+	/* 7. Closed sealed volume may be removed */
+	zassert_ok(ubi_volume_remove(ubi, assets_id));
+
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(1, info.volumes_count);
+
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_volumes, volume_quota_rate_and_reservation)
+{
+	const struct ubi_volume_config log_cfg = {
+		.name = { '/', 'l', 'o', 'g' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+	};
+	const struct ubi_volume_config critical_cfg = {
+		.name = { '/', 'c', 'r', 'i', 't', 'i', 'c', 'a', 'l' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+	int log_id = -1;
+	int critical_id = -1;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	struct ubi_volume_quota quota = { 0 };
+	struct ubi_vol_txn *txn = NULL;
+
+	uint8_t buf[64] = { 0 };
+	int64_t start = 0;
+
+	memset(buf, 0xa5, sizeof(buf));
+
+	/* 1. Initialize device with two volumes */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &log_cfg, &log_id));
+	zassert_ok(ubi_volume_create(ubi, &critical_cfg, &critical_id));
+
+	/* 2. Over PEB quota writes fail fast, other volumes are not limited */
+	quota.pebs_per_sec = 1;
+	quota.peb_burst = 2;
+	zassert_ok(ubi_volume_set_quota(ubi, log_id, &quota));
+
+	zassert_ok(ubi_leb_write(ubi, log_id, 0, buf, sizeof(buf)));
+	zassert_ok(ubi_leb_map(ubi, log_id, 1));
+	zassert_equal(-EAGAIN, ubi_leb_write(ubi, log_id, 0, buf, sizeof(buf)));
+	zassert_equal(-EAGAIN, ubi_leb_write_offset(ubi, log_id, 2, 0, buf, sizeof(buf)));
+	zassert_ok(ubi_leb_write(ubi, critical_id, 0, buf, sizeof(buf)));
+
+	/* 3. Blocking byte quota delays writes until refill */
+	memset(&quota, 0, sizeof(quota));
+	quota.bytes_per_sec = 10 * sizeof(buf);
+	quota.byte_burst = sizeof(buf);
+	quota.is_blocking = true;
+	zassert_ok(ubi_volume_set_quota(ubi, log_id, &quota));
+
+	start = k_uptime_get();
+	zassert_ok(ubi_leb_write(ubi, log_id, 0, buf, sizeof(buf)));
+	zassert_true(k_uptime_get() - start < 90);
+
+	zassert_ok(ubi_leb_write_offset(ubi, log_id, 1, 0, buf, sizeof(buf)));
+	zassert_true(k_uptime_get() - start >= 90);
+
+	/* 4. Reserved free PEBs are kept for the reserving volume */
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	memset(&quota, 0, sizeof(quota));
+	quota.reserved_pebs = info.free_leb_count + info.dirty_leb_count + 1;
+	zassert_equal(-ENOSPC, ubi_volume_set_quota(ubi, critical_id, &quota));
+
+	quota.reserved_pebs -= 1;
+	zassert_ok(ubi_volume_set_quota(ubi, critical_id, &quota));
+	zassert_ok(ubi_volume_set_quota(ubi, log_id, NULL));
+
+	zassert_equal(-ENOSPC, ubi_leb_write(ubi, log_id, 2, buf, sizeof(buf)));
+	zassert_ok(ubi_leb_write(ubi, critical_id, 1, buf, sizeof(buf)));
+
+	zassert_ok(ubi_volume_set_quota(ubi, critical_id, NULL));
+	zassert_ok(ubi_leb_write(ubi, log_id, 2, buf, sizeof(buf)));
+
+	/* 5. Writes failing for lack of free PEBs keep their tokens, removed volume returns its
+	 * reservation
+	 */
+	memset(&info, 0, sizeof(info));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	quota.reserved_pebs = info.free_leb_count + info.dirty_leb_count;
+	zassert_ok(ubi_volume_set_quota(ubi, critical_id, &quota));
+
+	memset(&quota, 0, sizeof(quota));
+	quota.pebs_per_sec = 1;
+	quota.peb_burst = 1;
+	zassert_ok(ubi_volume_set_quota(ubi, log_id, &quota));
+
+	zassert_equal(-ENOSPC, ubi_leb_write(ubi, log_id, 3, buf, sizeof(buf)));
+	zassert_equal(-ENOSPC, ubi_leb_write_offset(ubi, log_id, 3, 0, buf, sizeof(buf)));
+	zassert_equal(-ENOSPC, ubi_leb_write(ubi, log_id, 3, buf, sizeof(buf)));
+	zassert_ok(ubi_volume_remove(ubi, critical_id));
+	zassert_ok(ubi_leb_write(ubi, log_id, 3, buf, sizeof(buf)));
+	zassert_equal(-EAGAIN, ubi_leb_write(ubi, log_id, 3, buf, sizeof(buf)));
+
+	/* 6. Transaction writes are charged and cannot wait for refill of blocking quota */
+	memset(&quota, 0, sizeof(quota));
+	quota.bytes_per_sec = 10 * sizeof(buf);
+	quota.byte_burst = sizeof(buf);
+	quota.is_blocking = true;
+	zassert_ok(ubi_volume_set_quota(ubi, log_id, &quota));
+	zassert_ok(ubi_leb_unmap(ubi, log_id, 2));
+
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+
+	zassert_ok(ubi_leb_write(ubi, log_id, 0, buf, sizeof(buf)));
+	zassert_equal(-EAGAIN, ubi_leb_write(ubi, log_id, 1, buf, sizeof(buf)));
+	zassert_equal(-EAGAIN, ubi_leb_write_offset(ubi, log_id, 2, 0, buf, sizeof(buf)));
+
+	zassert_ok(ubi_vol_txn_abort(txn));
+
+	zassert_ok(ubi_leb_write(ubi, log_id, 1, buf, sizeof(buf)));
+
+	/* 7. Invalid arguments */
+	zassert_equal(-EINVAL, ubi_volume_set_quota(NULL, log_id, &quota));
+	zassert_equal(-EINVAL, ubi_volume_set_quota(ubi, -1, &quota));
+	zassert_equal(-ENOENT, ubi_volume_set_quota(ubi, critical_id, &quota));
+
+	/* 8. Quota is kept in RAM only and released with device */
+	quota.reserved_pebs = 0;
+	quota.pebs_per_sec = 1;
+	zassert_ok(ubi_volume_set_quota(ubi, log_id, &quota));
+	zassert_ok(ubi_device_deinit(ubi));
+}
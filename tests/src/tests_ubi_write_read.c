@@ -24,6 +24,7 @@
 #include <zephyr/drivers/flash.h>
 #include <zephyr/kernel.h>
 #include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/toolchain/common.h>
 #include <zephyr/sys/sys_heap.h>
@@ -31,6 +32,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 /* Module defines ------------------------------------------------------------------------------ */
 
@@ -39,7 +41,45 @@
 #define UBI_PARTITION_OFFSET FIXED_PARTITION_OFFSET(UBI_PARTITION_NAME)
 #define UBI_PARTITION_SIZE FIXED_PARTITION_SIZE(UBI_PARTITION_NAME)
 
+#define WRITER_STACK_SIZE (2048)
+#define WRITER_PRIORITY (K_LOWEST_APPLICATION_THREAD_PRIO)
+#define WRITER_ROUNDS (64)
+
+#define KEY_STREAM_MAX_PEBS (32)
+#define KEY_STREAM_LEN (64)
+
 /* Module types and type definitiones ---------------------------------------------------------- */
+
+/**
+ * \brief Parameters of a concurrent LEB writer.
+ */
+struct writer_ctx {
+	struct ubi_device *ubi; /**< UBI device. */
+	int vol_id; /**< Written volume. */
+	size_t lnum; /**< Written LEB. */
+	int ret; /**< First write or read failure. */
+};
+
+/**
+ * \brief Parameters of a concurrent LEB reader.
+ */
+struct reader_ctx {
+	struct writer_ctx *writer; /**< Writer of the read LEB. */
+	size_t nr_of_reads; /**< Number of consistent reads. */
+	size_t last_round; /**< Round of the latest read, later reads never return an older one. */
+	int ret; /**< First read failure. */
+};
+
+/**
+ * \brief Parameters of a LEB writer of a given request class.
+ */
+struct class_writer_ctx {
+	struct ubi_device *ubi; /**< UBI device. */
+	int vol_id; /**< Written volume. */
+	enum ubi_io_class io_class; /**< Class of the write. */
+	uint8_t fill; /**< Written byte value. */
+	int ret; /**< Write result. */
+};
 /* Module interface variables and constants ---------------------------------------------------- */
 /* Static variables and constants -------------------------------------------------------------- */
 
@@ -53,6 +93,18 @@ static struct sys_memory_stats before_init = { 0 };
 static struct sys_memory_stats after_init = { 0 };
 static struct sys_memory_stats after_deinit = { 0 };
 
+K_THREAD_STACK_DEFINE(writer_stack_1, WRITER_STACK_SIZE);
+K_THREAD_STACK_DEFINE(writer_stack_2, WRITER_STACK_SIZE);
+static struct k_thread writer_thread_1;
+static struct k_thread writer_thread_2;
+
+static atomic_t writer_done;
+static atomic_t writer_round;
+
+static uint8_t window_before[KEY_STREAM_MAX_PEBS][KEY_STREAM_LEN];
+static uint8_t window_after[KEY_STREAM_MAX_PEBS][KEY_STREAM_LEN];
+static uint8_t key_streams[KEY_STREAM_MAX_PEBS][KEY_STREAM_LEN];
+
 /* Static function declarations ---------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void);
@@ -66,6 +118,20 @@ static void memory_check(struct sys_memory_stats *before_init, struct sys_memory
 
 static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec);
 
+static void writer_fill(uint8_t *buf, size_t len, const struct writer_ctx *ctx, size_t round);
+static void writer_entry(void *p1, void *p2, void *p3);
+static void reader_entry(void *p1, void *p2, void *p3);
+static void unmap_reader_entry(void *p1, void *p2, void *p3);
+static void class_writer_entry(void *p1, void *p2, void *p3);
+static void class_writer_start(struct k_thread *thread, k_thread_stack_t *stack, size_t stack_size,
+			       struct class_writer_ctx *ctx, int prio);
+
+static void log_fill(uint8_t *buf, size_t len, size_t round);
+static void noise_fill(uint8_t *buf, size_t len, uint32_t seed);
+static uint32_t kib_per_sec(size_t bytes, int64_t start_ticks);
+
+static void data_windows_read(uint8_t (*windows)[KEY_STREAM_LEN], size_t data_offset);
+
 /* Static function definitions ----------------------------------------------------------------- */
 
 static void *ztest_suite_setup(void)
@@ -145,8 +211,218 @@ static void erase_counters_check(struct ubi_device *ubi, size_t exp_ec)
 	k_free(peb_ec);
 }
 
+static void writer_fill(uint8_t *buf, size_t len, const struct writer_ctx *ctx, size_t round)
+{
+	for (size_t i = 0; i < len; ++i)
+		buf[i] = (uint8_t)(ctx->vol_id * 64 + ctx->lnum * 16 + round + i);
+}
+
+static void writer_entry(void *p1, void *p2, void *p3)
+{
+	(void)p2;
+	(void)p3;
+
+	struct writer_ctx *ctx = p1;
+	uint8_t wdata[64] = { 0 };
+	uint8_t rdata[64] = { 0 };
+
+	for (size_t round = 0; round < WRITER_ROUNDS && 0 == ctx->ret; ++round) {
+		writer_fill(wdata, sizeof(wdata), ctx, round);
+		ctx->ret = ubi_leb_write(ctx->ubi, ctx->vol_id, ctx->lnum, wdata, sizeof(wdata));
+
+		if (0 == ctx->ret)
+			ctx->ret = ubi_leb_read(ctx->ubi, ctx->vol_id, ctx->lnum, 0, rdata,
+						sizeof(rdata));
+
+		if (0 == ctx->ret && 0 != memcmp(wdata, rdata, sizeof(rdata)))
+			ctx->ret = -EBADMSG;
+	}
+}
+
+static void reader_entry(void *p1, void *p2, void *p3)
+{
+	(void)p2;
+	(void)p3;
+
+	struct reader_ctx *ctx = p1;
+	const struct writer_ctx *writer = ctx->writer;
+	uint8_t wdata[64] = { 0 };
+	uint8_t rdata[64] = { 0 };
+
+	while (!atomic_get(&writer_done) && 0 == ctx->ret) {
+		bool is_mapped = false;
+		size_t size = 0;
+		const size_t first = atomic_get(&writer_round);
+
+		ctx->ret = ubi_leb_is_mapped(writer->ubi, writer->vol_id, writer->lnum, &is_mapped);
+
+		if (0 == ctx->ret && !is_mapped)
+			ctx->ret = -ENOENT;
+
+		if (0 == ctx->ret)
+			ctx->ret =
+				ubi_leb_get_size(writer->ubi, writer->vol_id, writer->lnum, &size);
+
+		if (0 == ctx->ret && sizeof(rdata) != size)
+			ctx->ret = -EBADMSG;
+
+		if (0 == ctx->ret)
+			ctx->ret = ubi_leb_read(writer->ubi, writer->vol_id, writer->lnum, 0, rdata,
+						sizeof(rdata));
+
+		if (0 != ctx->ret)
+			break;
+
+		/* Whole LEB comes from one round, never from an erased or reused PEB */
+		const size_t round = (uint8_t)(rdata[0] - writer->vol_id * 64 - writer->lnum * 16);
+		writer_fill(wdata, sizeof(wdata), writer, round);
+
+		if (round >= WRITER_ROUNDS || 0 != memcmp(wdata, rdata, sizeof(rdata)))
+			ctx->ret = -EBADMSG;
+
+		/* Old data is the round committed before the read began, new data a started round */
+		if (round + 1 < first || round > (size_t)atomic_get(&writer_round) ||
+		    round < ctx->last_round)
+			ctx->ret = -EBADMSG;
+
+		ctx->last_round = round;
+		ctx->nr_of_reads += 1;
+
+		/* Equal priorities are not time sliced, so the other reader runs on a single CPU */
+		k_yield();
+	}
+}
+
+static void unmap_reader_entry(void *p1, void *p2, void *p3)
+{
+	(void)p2;
+	(void)p3;
+
+	struct reader_ctx *ctx = p1;
+	struct writer_ctx leb = *ctx->writer;
+	uint8_t wdata[64] = { 0 };
+	uint8_t rdata[64] = { 0 };
+
+	for (size_t idx = 0; !atomic_get(&writer_done) && 0 == ctx->ret; ++idx) {
+		bool is_mapped = false;
+
+		leb.lnum = idx % 2;
+		ctx->ret = ubi_leb_is_mapped(leb.ubi, leb.vol_id, leb.lnum, &is_mapped);
+
+		if (0 == ctx->ret && is_mapped)
+			ctx->ret = ubi_leb_read(leb.ubi, leb.vol_id, leb.lnum, 0, rdata,
+						sizeof(rdata));
+
+		/* LEB unmapped since the check is not found, a mapped one is never read erased */
+		if (-ENOENT == ctx->ret || (0 == ctx->ret && !is_mapped)) {
+			ctx->ret = 0;
+			k_yield();
+			continue;
+		}
+
+		if (0 != ctx->ret)
+			break;
+
+		const size_t round = (uint8_t)(rdata[0] - leb.vol_id * 64 - leb.lnum * 16);
+		writer_fill(wdata, sizeof(wdata), &leb, round);
+
+		if (round >= WRITER_ROUNDS || 0 != memcmp(wdata, rdata, sizeof(rdata)))
+			ctx->ret = -EBADMSG;
+
+		ctx->nr_of_reads += 1;
+
+		/* Equal priorities are not time sliced, so the other reader runs on a single CPU */
+		k_yield();
+	}
+}
+
+static void class_writer_entry(void *p1, void *p2, void *p3)
+{
+	(void)p2;
+	(void)p3;
+
+	struct class_writer_ctx *ctx = p1;
+	uint8_t wdata[64] = { 0 };
+
+	memset(wdata, ctx->fill, sizeof(wdata));
+	ctx->ret =
+		ubi_leb_write_class(ctx->ubi, ctx->vol_id, 0, wdata, sizeof(wdata), ctx->io_class);
+}
+
+static void class_writer_start(struct k_thread *thread, k_thread_stack_t *stack, size_t stack_size,
+			       struct class_writer_ctx *ctx, int prio)
+{
+	struct ubi_io_class_stats stats = { 0 };
+
+	k_thread_create(thread, stack, stack_size, class_writer_entry, ctx, NULL, NULL,
+			K_PRIO_PREEMPT(prio), 0, K_NO_WAIT);
+
+	/* Writer queues behind device lock held by test thread */
+	do {
+		k_sleep(K_MSEC(1));
+		zassert_ok(ubi_device_get_io_stats(ctx->ubi, ctx->io_class, &stats));
+	} while (0 == stats.queue_depth);
+}
+
 /* Module interface function definitions ------------------------------------------------------- */
 
+static void log_fill(uint8_t *buf, size_t len, size_t round)
+{
+	static const char record[] = "[00000] sensor=00 state=ok\n";
+	const size_t record_len = sizeof(record) - 1;
+
+	for (size_t i = 0; i < len; ++i) {
+		const size_t seq = i / record_len + round;
+		const size_t pos = i % record_len;
+
+		buf[i] = record[pos];
+
+		/* Sequence number in brackets and one of eight sensors vary between records */
+		if (pos >= 1 && pos <= 5) {
+			size_t div = 1;
+
+			for (size_t digit = pos; digit < 5; ++digit)
+				div *= 10;
+
+			buf[i] = '0' + (seq / div) % 10;
+		} else if (16 == pos) {
+			buf[i] = '0' + seq % 8;
+		}
+	}
+}
+
+static void noise_fill(uint8_t *buf, size_t len, uint32_t seed)
+{
+	uint32_t state = seed | 1;
+
+	for (size_t i = 0; i < len; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		buf[i] = (uint8_t)state;
+	}
+}
+
+static uint32_t kib_per_sec(size_t bytes, int64_t start_ticks)
+{
+	const uint64_t elapsed_us = MAX(1, k_ticks_to_us_floor64(k_uptime_ticks() - start_ticks));
+
+	return (uint32_t)((bytes * 1000000ULL) / (elapsed_us * 1024));
+}
+
+static void data_windows_read(uint8_t (*windows)[KEY_STREAM_LEN], size_t data_offset)
+{
+	const size_t nr_of_pebs = UBI_PARTITION_SIZE / mtd.erase_block_size;
+	zassert_true(nr_of_pebs <= KEY_STREAM_MAX_PEBS);
+
+	for (size_t peb = 0; peb < nr_of_pebs; ++peb) {
+		const size_t offset = UBI_PARTITION_OFFSET + peb * mtd.erase_block_size;
+
+		zassert_ok(flash_read(UBI_PARTITION_DEVICE, offset + data_offset, windows[peb],
+				      KEY_STREAM_LEN));
+	}
+}
+
 ZTEST_SUITE(ubi_write_read, NULL, ztest_suite_setup, ztest_testcase_before, ztest_testcase_teardown,
 	    ztest_suite_after);
 
@@ -380,6 +656,10 @@ ZTEST(ubi_write_read, many_volumes_many_leb_operations_with_reboot)
 	zassert_equal(ARRAY_SIZE(wdata_size),
 		      vol_cfg_1.leb_count + vol_cfg_2.leb_count + vol_cfg_3.leb_count);
 
+	/* Volumes allocate every PEB, which a reserved PEB pool does not allow */
+	if (CONFIG_UBI_RESERVED_PEBS_PER1024 > 0)
+		ztest_test_skip();
+
 	/* 1. Initialize device */
 	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
 
@@ -602,3 +882,1282 @@ ZTEST(ubi_write_read, one_volume_many_lebs_io_operations_not_aligned_with_reboot
 
 	memory_check(&before_init, &after_init, &after_deinit);
 }
+
+ZTEST(ubi_write_read, one_volume_offset_writes_with_reboot)
+{
+	const size_t exp_ec_avr = 0;
+
+	const struct ubi_volume_config vol_cfg_1 = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info_after_init = { 0 };
+	struct ubi_device_info info_after_write = { 0 };
+
+	int vol_id_1 = -1;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 2. Create volume */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_1, &vol_id_1));
+	zassert_ok(ubi_device_get_info(ubi, &info_after_init));
+
+	/* 3. Write data at offsets of unmapped LEB, it is mapped on first write */
+	const int lnum = 1;
+	const size_t offset_1 = 0;
+	const size_t offset_2 = info_after_init.leb_size - 2 * ARRAY_SIZE(array_256);
+	bool is_mapped = false;
+
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id_1, lnum, offset_2, array_256,
+					ARRAY_SIZE(array_256)));
+	zassert_ok(ubi_leb_is_mapped(ubi, vol_id_1, lnum, &is_mapped));
+	zassert_true(is_mapped);
+
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id_1, lnum, offset_1, array_256,
+					ARRAY_SIZE(array_256)));
+
+	/* 4. Invalid offset writes */
+	zassert_equal(-EINVAL, ubi_leb_write_offset(ubi, vol_id_1, lnum, 1, array_256, 16));
+	zassert_equal(-EINVAL, ubi_leb_write_offset(ubi, vol_id_1, lnum, 16, array_256, 15));
+	zassert_equal(-ENOSPC, ubi_leb_write_offset(ubi, vol_id_1, lnum,
+						    info_after_init.leb_size - 16, array_256, 32));
+	zassert_equal(-EACCES, ubi_leb_write_offset(ubi, vol_id_1, vol_cfg_1.leb_count, 0,
+						    array_256, 16));
+
+	/* 5. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	erase_counters_check(ubi, exp_ec_avr);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 6. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 7. Read device info, only one PEB was consumed */
+	zassert_ok(ubi_device_get_info(ubi, &info_after_write));
+	zassert_equal(info_after_init.free_leb_count - 1, info_after_write.free_leb_count);
+	zassert_equal(0, info_after_write.dirty_leb_count);
+
+	/* 8. Read data from LEB, gap between writes stays erased */
+	uint8_t rdata[ARRAY_SIZE(array_256)] = { 0 };
+
+	zassert_ok(ubi_leb_read(ubi, vol_id_1, lnum, offset_1, rdata, sizeof(rdata)));
+	zassert_mem_equal(rdata, array_256, ARRAY_SIZE(array_256), "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, vol_id_1, lnum, offset_2, rdata, sizeof(rdata)));
+	zassert_mem_equal(rdata, array_256, ARRAY_SIZE(array_256), "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, vol_id_1, lnum, offset_2 - sizeof(rdata), rdata,
+				sizeof(rdata)));
+
+	for (size_t i = 0; i < sizeof(rdata); ++i)
+		zassert_equal(0xff, rdata[i]);
+
+	/* 9. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	erase_counters_check(ubi, exp_ec_avr);
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, rewrites_with_reboot_keep_newest_leb)
+{
+	const struct ubi_volume_config vol_cfg_1 = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	struct ubi_device *ubi = NULL;
+	uint8_t wdata[64] = { 0 };
+	uint8_t rdata[64] = { 0 };
+	uint64_t sqnum = 0;
+	uint64_t prev_sqnum = 0;
+
+	int vol_id_1 = -1;
+	const size_t lnum = 0;
+
+	/* 1. Initialize device and create volume */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_1, &vol_id_1));
+
+	/* 2. Rewrite LEB once per boot, old PEBs stay on flash with their VID headers */
+	for (size_t round = 0; round < 4; ++round) {
+		for (size_t i = 0; i < sizeof(wdata); ++i)
+			wdata[i] = (uint8_t)(round * 16 + i);
+
+		zassert_ok(ubi_leb_write(ubi, vol_id_1, lnum, wdata, sizeof(wdata)));
+
+		/* Sequence number is never reused after attach */
+		zassert_ok(ubi_leb_get_sqnum(ubi, vol_id_1, lnum, &sqnum));
+		zassert_true(0 == round || sqnum > prev_sqnum);
+		prev_sqnum = sqnum;
+
+		zassert_ok(ubi_device_deinit(ubi));
+
+		ubi = NULL;
+		zassert_ok(ubi_device_init(&mtd, &ubi));
+		zassert_not_null(ubi);
+
+		/* Attach maps the newest of the PEBs holding the LEB */
+		zassert_ok(ubi_leb_get_sqnum(ubi, vol_id_1, lnum, &sqnum));
+		zassert_equal(prev_sqnum, sqnum);
+
+		zassert_ok(ubi_leb_read(ubi, vol_id_1, lnum, 0, rdata, sizeof(rdata)));
+		zassert_mem_equal(rdata, wdata, sizeof(rdata), "Memory blocks are not equal");
+	}
+
+	/* 3. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, concurrent_writers_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg_1 = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+
+	const struct ubi_volume_config vol_cfg_2 = {
+		.name = { '/', 'u', 'b', 'i', '_', '1' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+
+	int vol_id_1 = -1;
+	int vol_id_2 = -1;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 2. Create volumes */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_1, &vol_id_1));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg_2, &vol_id_2));
+
+	/* 3. Two threads and test thread rewrite LEBs of the same and of another volume */
+	struct writer_ctx writers[] = {
+		{ .ubi = ubi, .vol_id = vol_id_1, .lnum = 0 },
+		{ .ubi = ubi, .vol_id = vol_id_1, .lnum = 1 },
+		{ .ubi = ubi, .vol_id = vol_id_2, .lnum = 0 },
+	};
+
+	k_thread_create(&writer_thread_1, writer_stack_1, K_THREAD_STACK_SIZEOF(writer_stack_1),
+			writer_entry, &writers[1], NULL, NULL, K_PRIO_PREEMPT(WRITER_PRIORITY), 0,
+			K_NO_WAIT);
+	k_thread_create(&writer_thread_2, writer_stack_2, K_THREAD_STACK_SIZEOF(writer_stack_2),
+			writer_entry, &writers[2], NULL, NULL, K_PRIO_PREEMPT(WRITER_PRIORITY), 0,
+			K_NO_WAIT);
+
+	writer_entry(&writers[0], NULL, NULL);
+
+	zassert_ok(k_thread_join(&writer_thread_1, K_FOREVER));
+	zassert_ok(k_thread_join(&writer_thread_2, K_FOREVER));
+
+	for (size_t idx = 0; idx < ARRAY_SIZE(writers); ++idx)
+		zassert_ok(writers[idx].ret);
+
+	/* 4. Every PEB is accounted for, none was lost by an in-flight write */
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.bad_leb_count);
+	zassert_equal(info.leb_total_count - ARRAY_SIZE(writers),
+		      info.free_leb_count + info.dirty_leb_count);
+
+	/* 5. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 6. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 7. Last write of every writer survived reboot */
+	for (size_t idx = 0; idx < ARRAY_SIZE(writers); ++idx) {
+		uint8_t wdata[64] = { 0 };
+		uint8_t rdata[64] = { 0 };
+
+		writer_fill(wdata, sizeof(wdata), &writers[idx], WRITER_ROUNDS - 1);
+		zassert_ok(ubi_leb_read(ubi, writers[idx].vol_id, writers[idx].lnum, 0, rdata,
+					sizeof(rdata)));
+		zassert_mem_equal(rdata, wdata, sizeof(rdata), "Memory blocks are not equal");
+	}
+
+	/* 8. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, concurrent_readers_during_rewrite)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	uint8_t wdata[64] = { 0 };
+
+	int vol_id = -1;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	/* 2. Create volume and write first round */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	struct writer_ctx writer = { .ubi = ubi, .vol_id = vol_id, .lnum = 0 };
+
+	writer_fill(wdata, sizeof(wdata), &writer, 0);
+	zassert_ok(ubi_leb_write(ubi, vol_id, writer.lnum, wdata, sizeof(wdata)));
+
+	/* 3. Two threads read the LEB while test thread rewrites it and erases old PEBs */
+	struct reader_ctx readers[] = {
+		{ .writer = &writer },
+		{ .writer = &writer },
+	};
+
+	atomic_set(&writer_done, 0);
+	atomic_set(&writer_round, 0);
+
+	k_thread_create(&writer_thread_1, writer_stack_1, K_THREAD_STACK_SIZEOF(writer_stack_1),
+			reader_entry, &readers[0], NULL, NULL, K_PRIO_PREEMPT(WRITER_PRIORITY), 0,
+			K_NO_WAIT);
+	k_thread_create(&writer_thread_2, writer_stack_2, K_THREAD_STACK_SIZEOF(writer_stack_2),
+			reader_entry, &readers[1], NULL, NULL, K_PRIO_PREEMPT(WRITER_PRIORITY), 0,
+			K_NO_WAIT);
+
+	const uint32_t start = k_cycle_get_32();
+
+	for (size_t round = 1; round < WRITER_ROUNDS; ++round) {
+		writer_fill(wdata, sizeof(wdata), &writer, round);
+		atomic_set(&writer_round, round);
+		zassert_ok(ubi_leb_write(ubi, vol_id, writer.lnum, wdata, sizeof(wdata)));
+		zassert_ok(ubi_device_erase_peb(ubi));
+
+		/* Readers of equal priority run meanwhile on a single CPU too */
+		k_sleep(K_USEC(100));
+	}
+
+	atomic_set(&writer_done, 1);
+
+	zassert_ok(k_thread_join(&writer_thread_1, K_FOREVER));
+	zassert_ok(k_thread_join(&writer_thread_2, K_FOREVER));
+
+	const uint32_t elapsed_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	TC_PRINT("ubi_write_read: %zu + %zu reads in %u us during %u rewrites\n",
+		 readers[0].nr_of_reads, readers[1].nr_of_reads, elapsed_us, WRITER_ROUNDS - 1);
+
+	/* Every reader made progress and read old or new data only */
+	for (size_t idx = 0; idx < ARRAY_SIZE(readers); ++idx) {
+		zassert_ok(readers[idx].ret);
+		zassert_true(readers[idx].nr_of_reads > 0);
+	}
+
+	/* 4. Every PEB is accounted for, none was lost by an erase under a reader */
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.bad_leb_count);
+	zassert_equal(0, info.dirty_leb_count);
+	zassert_equal(info.leb_total_count - 1, info.free_leb_count);
+
+	/* 5. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, concurrent_readers_during_unmaps)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	uint8_t wdata[64] = { 0 };
+
+	int vol_id = -1;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	/* 2. Two threads read both LEBs while test thread maps them and ends two grace periods
+	 * back to back, each by an unmap followed by an erase of the unmapped PEB
+	 */
+	struct writer_ctx writer = { .ubi = ubi, .vol_id = vol_id, .lnum = 0 };
+	struct reader_ctx readers[] = {
+		{ .writer = &writer },
+		{ .writer = &writer },
+	};
+
+	atomic_set(&writer_done, 0);
+	atomic_set(&writer_round, 0);
+
+	k_thread_create(&writer_thread_1, writer_stack_1, K_THREAD_STACK_SIZEOF(writer_stack_1),
+			unmap_reader_entry, &readers[0], NULL, NULL,
+			K_PRIO_PREEMPT(WRITER_PRIORITY), 0, K_NO_WAIT);
+	k_thread_create(&writer_thread_2, writer_stack_2, K_THREAD_STACK_SIZEOF(writer_stack_2),
+			unmap_reader_entry, &readers[1], NULL, NULL,
+			K_PRIO_PREEMPT(WRITER_PRIORITY), 0, K_NO_WAIT);
+
+	for (size_t round = 0; round < WRITER_ROUNDS; ++round) {
+		atomic_set(&writer_round, round);
+
+		for (size_t lnum = 0; lnum < vol_cfg.leb_count; ++lnum) {
+			writer.lnum = lnum;
+			writer_fill(wdata, sizeof(wdata), &writer, round);
+			zassert_ok(ubi_leb_write(ubi, vol_id, lnum, wdata, sizeof(wdata)));
+		}
+
+		/* Readers of equal priority run meanwhile and are preempted anywhere by wakeup */
+		k_sleep(K_USEC(100));
+
+		zassert_ok(ubi_leb_unmap(ubi, vol_id, 0));
+		zassert_ok(ubi_device_erase_peb(ubi));
+		zassert_ok(ubi_leb_unmap(ubi, vol_id, 1));
+		zassert_ok(ubi_device_erase_peb(ubi));
+
+		k_sleep(K_USEC(100));
+	}
+
+	atomic_set(&writer_done, 1);
+
+	zassert_ok(k_thread_join(&writer_thread_1, K_FOREVER));
+	zassert_ok(k_thread_join(&writer_thread_2, K_FOREVER));
+
+	/* Every reader made progress and never read an erased or reused PEB */
+	for (size_t idx = 0; idx < ARRAY_SIZE(readers); ++idx) {
+		zassert_ok(readers[idx].ret);
+		zassert_true(readers[idx].nr_of_reads > 0);
+	}
+
+	/* 3. Every PEB is accounted for */
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_equal(0, info.bad_leb_count);
+	zassert_equal(0, info.dirty_leb_count);
+	zassert_equal(info.leb_total_count, info.free_leb_count);
+
+	/* 4. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, class_dispatch_order_and_aging)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_vol_txn *txn = NULL;
+	struct ubi_io_class_stats stats = { 0 };
+	uint8_t rdata[64] = { 0 };
+	uint8_t exp[64] = { 0 };
+
+	int vol_id = -1;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_equal(-EINVAL, ubi_volume_set_io_class(ubi, vol_id, UBI_IO_CLASS_COUNT));
+	zassert_equal(-EINVAL, ubi_device_get_io_stats(ubi, UBI_IO_CLASS_COUNT, &stats));
+
+	/* 2. Urgent write queued after scrub write is dispatched first, so scrub data stays */
+	struct class_writer_ctx scrub = { .ubi = ubi, .vol_id = vol_id, .fill = 0x5C };
+	struct class_writer_ctx urgent = { .ubi = ubi, .vol_id = vol_id, .fill = 0xA3 };
+
+	scrub.io_class = UBI_IO_CLASS_SCRUB;
+	urgent.io_class = UBI_IO_CLASS_URGENT;
+
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+
+	class_writer_start(&writer_thread_1, writer_stack_1, K_THREAD_STACK_SIZEOF(writer_stack_1),
+			   &scrub, WRITER_PRIORITY);
+	class_writer_start(&writer_thread_2, writer_stack_2, K_THREAD_STACK_SIZEOF(writer_stack_2),
+			   &urgent, WRITER_PRIORITY);
+
+	zassert_ok(ubi_vol_txn_abort(txn));
+
+	zassert_ok(k_thread_join(&writer_thread_1, K_FOREVER));
+	zassert_ok(k_thread_join(&writer_thread_2, K_FOREVER));
+	zassert_ok(scrub.ret);
+	zassert_ok(urgent.ret);
+
+	memset(exp, scrub.fill, sizeof(exp));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, sizeof(rdata)));
+	zassert_mem_equal(rdata, exp, sizeof(rdata), "Memory blocks are not equal");
+
+	/* 3. Erase write waiting past its target ages ahead of a later normal write */
+	struct class_writer_ctx erase = { .ubi = ubi, .vol_id = vol_id, .fill = 0x3E };
+	struct class_writer_ctx normal = { .ubi = ubi, .vol_id = vol_id, .fill = 0xE7 };
+
+	erase.io_class = UBI_IO_CLASS_ERASE;
+	normal.io_class = UBI_IO_CLASS_NORMAL;
+
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+
+	class_writer_start(&writer_thread_1, writer_stack_1, K_THREAD_STACK_SIZEOF(writer_stack_1),
+			   &erase, WRITER_PRIORITY);
+	k_sleep(K_MSEC(150));
+	class_writer_start(&writer_thread_2, writer_stack_2, K_THREAD_STACK_SIZEOF(writer_stack_2),
+			   &normal, WRITER_PRIORITY);
+
+	zassert_ok(ubi_vol_txn_abort(txn));
+
+	zassert_ok(k_thread_join(&writer_thread_1, K_FOREVER));
+	zassert_ok(k_thread_join(&writer_thread_2, K_FOREVER));
+	zassert_ok(erase.ret);
+	zassert_ok(normal.ret);
+
+	memset(exp, normal.fill, sizeof(exp));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, sizeof(rdata)));
+	zassert_mem_equal(rdata, exp, sizeof(rdata), "Memory blocks are not equal");
+
+	/* 4. Statistics show the queued requests and their waiting */
+	zassert_ok(ubi_device_get_io_stats(ubi, UBI_IO_CLASS_ERASE, &stats));
+	zassert_equal(0, stats.queue_depth);
+	zassert_equal(1, stats.max_queue_depth);
+	zassert_true(stats.nr_of_dispatches >= 1);
+	zassert_true(stats.max_wait_us >= 150 * USEC_PER_MSEC);
+	zassert_true(stats.total_wait_us >= stats.max_wait_us);
+
+	zassert_ok(ubi_device_get_io_stats(ubi, UBI_IO_CLASS_URGENT, &stats));
+	zassert_equal(0, stats.queue_depth);
+	zassert_equal(1, stats.max_queue_depth);
+
+	/* 5. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, owner_priority_raised_by_waiter)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'u', 'b', 'i', '_', '0' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_vol_txn *txn = NULL;
+	uint8_t rdata[64] = { 0 };
+	uint8_t exp[64] = { 0 };
+
+	const int test_prio = k_thread_priority_get(k_current_get());
+	int vol_id = -1;
+
+	/* 1. Initialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	/* 2. Test thread owns device at lowest priority */
+	k_thread_priority_set(k_current_get(), K_PRIO_PREEMPT(WRITER_PRIORITY));
+
+	zassert_ok(ubi_vol_txn_begin(ubi, &txn));
+	zassert_equal(K_PRIO_PREEMPT(WRITER_PRIORITY), k_thread_priority_get(k_current_get()));
+
+	/* 3. Waiting higher priority writer raises priority of the owner */
+	struct class_writer_ctx urgent = { .ubi = ubi, .vol_id = vol_id, .fill = 0xA3 };
+
+	urgent.io_class = UBI_IO_CLASS_URGENT;
+
+	class_writer_start(&writer_thread_1, writer_stack_1, K_THREAD_STACK_SIZEOF(writer_stack_1),
+			   &urgent, WRITER_PRIORITY - 1);
+
+	zassert_equal(K_PRIO_PREEMPT(WRITER_PRIORITY - 1), k_thread_priority_get(k_current_get()));
+
+	/* 4. Releasing device restores priority of the owner */
+	zassert_ok(ubi_vol_txn_abort(txn));
+	zassert_equal(K_PRIO_PREEMPT(WRITER_PRIORITY), k_thread_priority_get(k_current_get()));
+
+	zassert_ok(k_thread_join(&writer_thread_1, K_FOREVER));
+	zassert_ok(urgent.ret);
+
+	k_thread_priority_set(k_current_get(), test_prio);
+
+	memset(exp, urgent.fill, sizeof(exp));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, sizeof(rdata)));
+	zassert_mem_equal(rdata, exp, sizeof(rdata), "Memory blocks are not equal");
+
+	/* 5. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, compressed_volume_write_read_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'l', 'o', 'g' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+		.compressed = true,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	struct ubi_volume_config cfg = { 0 };
+	size_t alloc_lebs = 0;
+	size_t data_size = 0;
+	size_t stored_size = 0;
+	size_t size = 0;
+	uint8_t small[64] = { 0 };
+
+	int vol_id = -1;
+
+	/* 1. Initialize device */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	uint8_t *wdata = k_malloc(info.leb_size);
+	uint8_t *rdata = k_malloc(info.leb_size);
+	zassert_not_null(wdata);
+	zassert_not_null(rdata);
+
+	/* 2. Log records are stored compressed, size reports uncompressed data */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	log_fill(wdata, info.leb_size, 0);
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, wdata, info.leb_size));
+	zassert_ok(ubi_leb_get_size(ubi, vol_id, 0, &size));
+	zassert_equal(info.leb_size, size);
+
+	zassert_ok(ubi_volume_get_compression(ubi, vol_id, &data_size, &stored_size));
+	zassert_equal(info.leb_size, data_size);
+	zassert_true(stored_size < info.leb_size / 2);
+
+	/* 3. Whole LEB and ranges in the middle and past the data read back */
+	memset(rdata, 0, info.leb_size);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, info.leb_size / 2 + 3, small, sizeof(small)));
+	zassert_mem_equal(small, &wdata[info.leb_size / 2 + 3], sizeof(small),
+			  "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_write(ubi, vol_id, 3, wdata, sizeof(small)));
+	memset(rdata, 0, info.leb_size);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 3, 0, rdata, 2 * sizeof(small)));
+	zassert_mem_equal(rdata, wdata, sizeof(small), "Memory blocks are not equal");
+
+	memset(small, 0xff, sizeof(small));
+	zassert_mem_equal(&rdata[sizeof(small)], small, sizeof(small),
+			  "Memory blocks are not equal");
+
+	/* 4. Incompressible data is stored as is */
+	noise_fill(wdata, info.leb_size, 0x5eed);
+	zassert_ok(ubi_leb_write(ubi, vol_id, 1, wdata, info.leb_size));
+
+	size_t noise_data_size = 0;
+	size_t noise_stored_size = 0;
+	zassert_ok(ubi_volume_get_compression(ubi, vol_id, &noise_data_size, &noise_stored_size));
+	zassert_equal(noise_data_size - data_size - sizeof(small), info.leb_size);
+	zassert_true(noise_stored_size - stored_size >= info.leb_size);
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	/* 5. Compressed LEB cannot be written in place, an unmapped one is written raw */
+	memset(small, 0xa5, sizeof(small));
+	zassert_equal(-ENOTSUP, ubi_leb_write_offset(ubi, vol_id, 0, 0, small, sizeof(small)));
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id, 2, sizeof(small), small, sizeof(small)));
+
+	memset(rdata, 0, info.leb_size);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, sizeof(small), rdata, sizeof(small)));
+	zassert_mem_equal(rdata, small, sizeof(small), "Memory blocks are not equal");
+
+	/* 6. Compression flag and data survive reboot */
+	zassert_ok(ubi_device_deinit(ubi));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_get_info(ubi, vol_id, &cfg, &alloc_lebs));
+	zassert_true(cfg.compressed);
+	zassert_equal(4, alloc_lebs);
+
+	log_fill(wdata, info.leb_size, 0);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	zassert_ok(ubi_volume_get_compression(ubi, vol_id, &data_size, &stored_size));
+	zassert_equal(noise_data_size, data_size);
+	zassert_equal(noise_stored_size, stored_size);
+
+	/* 7. Deinitialize device */
+	k_free(wdata);
+	k_free(rdata);
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_write_read, compressed_and_raw_read_past_data)
+{
+	const struct ubi_volume_config comp_cfg = {
+		.name = { '/', 'c', 'o', 'm', 'p' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+		.compressed = true,
+	};
+	const struct ubi_volume_config raw_cfg = {
+		.name = { '/', 'r', 'a', 'w' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+	};
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	size_t data_size = 0;
+	size_t stored_size = 0;
+	uint8_t comp_tail[64] = { 0 };
+	uint8_t raw_tail[64] = { 0 };
+	uint8_t exp_tail[64] = { 0 };
+
+	int comp_id = -1;
+	int raw_id = -1;
+
+	/* 1. Initialize device with a compressed and a raw volume */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	zassert_ok(ubi_volume_create(ubi, &comp_cfg, &comp_id));
+	zassert_ok(ubi_volume_create(ubi, &raw_cfg, &raw_id));
+
+	/* 2. Same data, not a multiple of write block size, goes to both */
+	const size_t len = info.leb_size - 40;
+	uint8_t *wdata = k_malloc(len);
+	zassert_not_null(wdata);
+
+	log_fill(wdata, len, 0);
+	zassert_ok(ubi_leb_write(ubi, comp_id, 0, wdata, len));
+	zassert_ok(ubi_leb_write(ubi, raw_id, 0, wdata, len));
+
+	zassert_ok(ubi_volume_get_compression(ubi, comp_id, &data_size, &stored_size));
+	zassert_equal(len, data_size);
+	zassert_true(stored_size < len);
+
+	/* 3. Range over the end of data reads data, zero padding, then erased bytes */
+	const size_t offset = len - 24;
+
+	memcpy(exp_tail, &wdata[offset], 24);
+	memset(&exp_tail[32], 0xff, sizeof(exp_tail) - 32);
+
+	zassert_ok(ubi_leb_read(ubi, comp_id, 0, offset, comp_tail, sizeof(comp_tail)));
+	zassert_ok(ubi_leb_read(ubi, raw_id, 0, offset, raw_tail, sizeof(raw_tail)));
+	zassert_mem_equal(raw_tail, exp_tail, sizeof(exp_tail), "Memory blocks are not equal");
+	zassert_mem_equal(comp_tail, raw_tail, sizeof(raw_tail), "Memory blocks are not equal");
+
+	/* 4. Range entirely past data reads the same too */
+	zassert_ok(ubi_leb_read(ubi, comp_id, 0, len, comp_tail, 40));
+	zassert_ok(ubi_leb_read(ubi, raw_id, 0, len, raw_tail, 40));
+	zassert_mem_equal(comp_tail, raw_tail, 40, "Memory blocks are not equal");
+
+	/* 5. Deinitialize device */
+	k_free(wdata);
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_write_read, compressed_volume_throughput)
+{
+	const struct ubi_volume_config raw_cfg = {
+		.name = { '/', 'r', 'a', 'w' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+	const struct ubi_volume_config lz_cfg = {
+		.name = { '/', 'l', 'z' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+		.compressed = true,
+	};
+	const size_t rounds = 16;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	size_t data_size = 0;
+	size_t stored_size = 0;
+
+	int vol_ids[2] = { -1, -1 };
+	uint32_t write_kibps[2] = { 0 };
+	uint32_t read_kibps[2] = { 0 };
+
+	/* 1. Initialize device with a raw and a compressed volume */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	zassert_ok(ubi_volume_create(ubi, &raw_cfg, &vol_ids[0]));
+	zassert_ok(ubi_volume_create(ubi, &lz_cfg, &vol_ids[1]));
+
+	uint8_t *wdata = k_malloc(info.leb_size);
+	uint8_t *rdata = k_malloc(info.leb_size);
+	zassert_not_null(wdata);
+	zassert_not_null(rdata);
+
+	/* 2. Same log records are written and read back through both volumes */
+	for (size_t vol = 0; vol < ARRAY_SIZE(vol_ids); ++vol) {
+		const int vol_id = vol_ids[vol];
+		int64_t start = k_uptime_ticks();
+
+		for (size_t round = 0; round < rounds; ++round) {
+			log_fill(wdata, info.leb_size, round * info.leb_size);
+			zassert_ok(ubi_leb_write(ubi, vol_id, round % 2, wdata, info.leb_size));
+		}
+
+		write_kibps[vol] = kib_per_sec(rounds * info.leb_size, start);
+		start = k_uptime_ticks();
+
+		for (size_t round = 0; round < rounds; ++round)
+			zassert_ok(ubi_leb_read(ubi, vol_id, round % 2, 0, rdata, info.leb_size));
+
+		read_kibps[vol] = kib_per_sec(rounds * info.leb_size, start);
+
+		zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+	}
+
+	zassert_ok(ubi_volume_get_compression(ubi, vol_ids[1], &data_size, &stored_size));
+	zassert_true(stored_size > 0 && stored_size < data_size);
+
+	TC_PRINT("ubi_lz: LEB size %zu B, compression ratio %zu.%02zu\n", info.leb_size,
+		 data_size / stored_size, (data_size * 100 / stored_size) % 100);
+	TC_PRINT("ubi_lz: raw write %u KiB/s, read %u KiB/s\n", write_kibps[0], read_kibps[0]);
+	TC_PRINT("ubi_lz: compressed write %u KiB/s, read %u KiB/s\n", write_kibps[1],
+		 read_kibps[1]);
+
+	/* 3. Deinitialize device */
+	k_free(wdata);
+	k_free(rdata);
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_write_read, encrypted_volume_write_read_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 's', 'e', 'c', 'r', 'e', 't' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+		.encrypted = true,
+	};
+	const struct ubi_volume_config lz_cfg = {
+		.name = { '/', 'l', 'o', 'g' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 1,
+		.compressed = true,
+		.encrypted = true,
+	};
+	const uint8_t key[32] = { 0x1f, 0x2e, 0x3d, 0x4c, 0x5b, 0x6a, 0x79, 0x88,
+				  0x97, 0xa6, 0xb5, 0xc4, 0xd3, 0xe2, 0xf1, 0x00 };
+	const uint8_t other_key[16] = { 0xde, 0xad, 0xbe, 0xef };
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	struct ubi_volume_config cfg = { 0 };
+	size_t alloc_lebs = 0;
+	size_t data_size = 0;
+	size_t stored_size = 0;
+	uint8_t small[64] = { 0 };
+	uint8_t erased[64] = { 0 };
+
+	int vol_id = -1;
+	int snap_id = -1;
+	int lz_id = -1;
+
+	memset(erased, 0xff, sizeof(erased));
+
+	/* 1. Initialize device */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	uint8_t *wdata = k_malloc(info.leb_size);
+	uint8_t *rdata = k_malloc(info.leb_size);
+	zassert_not_null(wdata);
+	zassert_not_null(rdata);
+
+	/* 2. Encrypted volume is not written without its key */
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	noise_fill(wdata, info.leb_size, 0xc0de);
+	zassert_equal(-EPERM, ubi_leb_write(ubi, vol_id, 0, wdata, info.leb_size));
+	zassert_equal(-EINVAL, ubi_volume_set_key(ubi, vol_id, key, 24));
+	zassert_ok(ubi_volume_set_key(ubi, vol_id, key, sizeof(key)));
+
+	/* 3. Whole LEB, unaligned ranges and padded tail read back */
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, wdata, info.leb_size));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 7, small, 45));
+	zassert_mem_equal(small, &wdata[7], 45, "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, info.leb_size / 2 + 3, small, sizeof(small)));
+	zassert_mem_equal(small, &wdata[info.leb_size / 2 + 3], sizeof(small),
+			  "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_write(ubi, vol_id, 1, wdata, 100));
+	memset(rdata, 0, info.leb_size);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, rdata, 2 * sizeof(small)));
+	zassert_mem_equal(rdata, wdata, 100, "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[112], erased, 16, "Memory blocks are not equal");
+
+	/* 4. Data written in place keeps unwritten blocks erased */
+	memset(small, 0xa5, sizeof(small));
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id, 2, 32, small, sizeof(small)));
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, 0, rdata, 4 * sizeof(small)));
+	zassert_mem_equal(rdata, erased, 32, "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[32], small, sizeof(small), "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[96], erased, sizeof(erased), "Memory blocks are not equal");
+
+	/* 5. Snapshot needs the key, copy on write encrypts the copy under its own counter */
+	zassert_ok(ubi_volume_snapshot(ubi, vol_id, "/snap", &snap_id));
+	zassert_equal(-EPERM, ubi_leb_read(ubi, snap_id, 0, 0, rdata, info.leb_size));
+	zassert_ok(ubi_volume_set_key(ubi, snap_id, key, sizeof(key)));
+
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id, 2, 128, small, sizeof(small)));
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, 0, rdata, 4 * sizeof(small)));
+	zassert_mem_equal(&rdata[32], small, sizeof(small), "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[128], small, sizeof(small), "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, snap_id, 2, 0, rdata, 4 * sizeof(small)));
+	zassert_mem_equal(&rdata[32], small, sizeof(small), "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[128], erased, sizeof(erased), "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, snap_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	/* 6. Compressed data is encrypted after compression */
+	zassert_ok(ubi_volume_create(ubi, &lz_cfg, &lz_id));
+	zassert_ok(ubi_volume_set_key(ubi, lz_id, other_key, sizeof(other_key)));
+
+	log_fill(wdata, info.leb_size, 0);
+	zassert_ok(ubi_leb_write(ubi, lz_id, 0, wdata, info.leb_size));
+	zassert_ok(ubi_leb_read(ubi, lz_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	zassert_ok(ubi_volume_get_compression(ubi, lz_id, &data_size, &stored_size));
+	zassert_true(stored_size < info.leb_size / 2);
+
+	/* 7. Key is not stored, wrong key reads other data */
+	zassert_ok(ubi_device_deinit(ubi));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	zassert_ok(ubi_volume_get_info(ubi, vol_id, &cfg, &alloc_lebs));
+	zassert_true(cfg.encrypted);
+	zassert_equal(3, alloc_lebs);
+
+	noise_fill(wdata, info.leb_size, 0xc0de);
+	zassert_equal(-EPERM, ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+
+	zassert_ok(ubi_volume_set_key(ubi, vol_id, other_key, sizeof(other_key)));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+	zassert_true(0 != memcmp(rdata, wdata, info.leb_size));
+
+	zassert_ok(ubi_volume_set_key(ubi, vol_id, key, sizeof(key)));
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	/* 8. Forgotten or removed key locks data out */
+	zassert_ok(ubi_volume_set_key(ubi, vol_id, NULL, 0));
+	zassert_equal(-EPERM, ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+
+	zassert_ok(ubi_volume_remove(ubi, snap_id));
+	zassert_ok(ubi_volume_remove(ubi, vol_id));
+	zassert_ok(ubi_volume_remove(ubi, lz_id));
+	zassert_equal(-ENOENT, ubi_volume_set_key(ubi, vol_id, key, sizeof(key)));
+
+	/* 9. Deinitialize device */
+	k_free(wdata);
+	k_free(rdata);
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_write_read, encrypted_volume_key_stream_after_erase_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 's', 'e', 'c', 'r', 'e', 't' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+		.encrypted = true,
+	};
+	const uint8_t key[16] = { 0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78 };
+	const uint8_t zeros[KEY_STREAM_LEN] = { 0 };
+	uint8_t erased[KEY_STREAM_LEN] = { 0 };
+	uint8_t buf[KEY_STREAM_LEN] = { 0 };
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	int vol_id = -1;
+
+	const size_t nr_of_pebs = UBI_PARTITION_SIZE / mtd.erase_block_size;
+	size_t nr_of_streams = 0;
+
+	memset(erased, 0xff, sizeof(erased));
+
+	/* 1. Initialize device and encrypted volume */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+	zassert_ok(ubi_volume_set_key(ubi, vol_id, key, sizeof(key)));
+
+	const size_t data_offset = mtd.erase_block_size - info.leb_size;
+
+	/* 2. Zeros encrypt to the key stream, keep data windows changed by the write */
+	data_windows_read(window_before, data_offset);
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, zeros, sizeof(zeros)));
+	data_windows_read(window_after, data_offset);
+
+	for (size_t peb = 0; peb < nr_of_pebs; ++peb) {
+		if (0 != memcmp(window_before[peb], window_after[peb], KEY_STREAM_LEN))
+			memcpy(key_streams[nr_of_streams++], window_after[peb], KEY_STREAM_LEN);
+	}
+
+	zassert_true(nr_of_streams > 0);
+
+	/* 3. Unmap LEB and erase its PEB, so its sequence number is left nowhere on flash */
+	zassert_ok(ubi_leb_unmap(ubi, vol_id, 0));
+	zassert_ok(ubi_device_erase_pebs(ubi, SIZE_MAX, NULL));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+
+	/* 4. Initialize device and write zeros into the same LEB again */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &before_init));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_ok(ubi_volume_set_key(ubi, vol_id, key, sizeof(key)));
+
+	data_windows_read(window_before, data_offset);
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, zeros, sizeof(zeros)));
+	data_windows_read(window_after, data_offset);
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, buf, sizeof(buf)));
+	zassert_mem_equal(buf, zeros, sizeof(zeros), "Memory blocks are not equal");
+
+	/* 5. Verify new data does not reuse the key stream of the erased PEB */
+	size_t nr_of_changed = 0;
+
+	for (size_t peb = 0; peb < nr_of_pebs; ++peb) {
+		if (0 == memcmp(window_before[peb], window_after[peb], KEY_STREAM_LEN) ||
+		    0 == memcmp(window_after[peb], erased, KEY_STREAM_LEN))
+			continue;
+
+		nr_of_changed += 1;
+
+		for (size_t idx = 0; idx < nr_of_streams; ++idx) {
+			const int cmp = memcmp(window_after[peb], key_streams[idx], KEY_STREAM_LEN);
+			zassert_true(0 != cmp);
+		}
+	}
+
+	zassert_true(nr_of_changed > 0);
+
+	/* 6. Deinitialize device */
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_init));
+
+	zassert_ok(ubi_device_deinit(ubi));
+
+	zassert_ok(sys_heap_runtime_stats_get(&_system_heap, &after_deinit));
+
+	memory_check(&before_init, &after_init, &after_deinit);
+}
+
+ZTEST(ubi_write_read, encrypted_volume_throughput)
+{
+	const struct ubi_volume_config raw_cfg = {
+		.name = { '/', 'r', 'a', 'w' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+	};
+	const struct ubi_volume_config aes_cfg = {
+		.name = { '/', 'a', 'e', 's' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 2,
+		.encrypted = true,
+	};
+	const uint8_t key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+				  0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+	const size_t rounds = 16;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+
+	int vol_ids[2] = { -1, -1 };
+	uint32_t write_kibps[2] = { 0 };
+	uint32_t read_kibps[2] = { 0 };
+
+	/* 1. Initialize device with a raw and an encrypted volume */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+	zassert_ok(ubi_device_get_info(ubi, &info));
+
+	zassert_ok(ubi_volume_create(ubi, &raw_cfg, &vol_ids[0]));
+	zassert_ok(ubi_volume_create(ubi, &aes_cfg, &vol_ids[1]));
+	zassert_ok(ubi_volume_set_key(ubi, vol_ids[1], key, sizeof(key)));
+
+	uint8_t *wdata = k_malloc(info.leb_size);
+	uint8_t *rdata = k_malloc(info.leb_size);
+	zassert_not_null(wdata);
+	zassert_not_null(rdata);
+
+	/* 2. Same data is written and read back through both volumes */
+	for (size_t vol = 0; vol < ARRAY_SIZE(vol_ids); ++vol) {
+		const int vol_id = vol_ids[vol];
+		int64_t start = k_uptime_ticks();
+
+		for (size_t round = 0; round < rounds; ++round) {
+			noise_fill(wdata, info.leb_size, round);
+			zassert_ok(ubi_leb_write(ubi, vol_id, round % 2, wdata, info.leb_size));
+		}
+
+		write_kibps[vol] = kib_per_sec(rounds * info.leb_size, start);
+		start = k_uptime_ticks();
+
+		for (size_t round = 0; round < rounds; ++round)
+			zassert_ok(ubi_leb_read(ubi, vol_id, round % 2, 0, rdata, info.leb_size));
+
+		read_kibps[vol] = kib_per_sec(rounds * info.leb_size, start);
+
+		zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+	}
+
+	TC_PRINT("ubi_crypto: driver %s, LEB size %zu B\n", CONFIG_UBI_CRYPTO_DRV_NAME,
+		 info.leb_size);
+	TC_PRINT("ubi_crypto: raw write %u KiB/s, read %u KiB/s\n", write_kibps[0],
+		 read_kibps[0]);
+	TC_PRINT("ubi_crypto: encrypted write %u KiB/s, read %u KiB/s\n", write_kibps[1],
+		 read_kibps[1]);
+
+	/* 3. Deinitialize device */
+	k_free(wdata);
+	k_free(rdata);
+	zassert_ok(ubi_device_deinit(ubi));
+}
+
+ZTEST(ubi_write_read, pattern_leb_write_read_with_reboot)
+{
+	const struct ubi_volume_config vol_cfg = {
+		.name = { '/', 'd', 'b' },
+		.type = UBI_VOLUME_TYPE_DYNAMIC,
+		.leb_count = 4,
+	};
+	const size_t rounds = 8;
+
+	struct ubi_device *ubi = NULL;
+	struct ubi_device_info info = { 0 };
+	size_t data_size = 0;
+	size_t stored_size = 0;
+	size_t size = 0;
+	uint8_t small[64] = { 0 };
+	uint8_t erased[64] = { 0 };
+
+	int vol_id = -1;
+
+	memset(erased, 0xff, sizeof(erased));
+
+	/* 1. Initialize device */
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+	zassert_ok(ubi_device_get_info(ubi, &info));
+	zassert_ok(ubi_volume_create(ubi, &vol_cfg, &vol_id));
+
+	uint8_t *wdata = k_malloc(info.leb_size);
+	uint8_t *rdata = k_malloc(info.leb_size);
+	zassert_not_null(wdata);
+	zassert_not_null(rdata);
+
+	/* 2. Zeroed LEB is recorded in VID header only */
+	memset(wdata, 0, info.leb_size);
+	zassert_ok(ubi_leb_write(ubi, vol_id, 0, wdata, info.leb_size));
+	zassert_ok(ubi_leb_get_size(ubi, vol_id, 0, &size));
+	zassert_equal(info.leb_size, size);
+
+	zassert_ok(ubi_volume_get_compression(ubi, vol_id, &data_size, &stored_size));
+	zassert_equal(info.leb_size, data_size);
+	zassert_equal(0, stored_size);
+
+	memset(rdata, 0xa5, info.leb_size);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	/* 3. Short pattern reads back with padding and erased rest */
+	memset(wdata, 0x5a, 100);
+	zassert_ok(ubi_leb_write(ubi, vol_id, 1, wdata, 100));
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, rdata, 2 * sizeof(small)));
+	zassert_mem_equal(rdata, wdata, 100, "Memory blocks are not equal");
+	memset(small, 0, sizeof(small));
+	zassert_mem_equal(&rdata[100], small, 12, "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[112], erased, 16, "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 50, small, 10));
+	zassert_mem_equal(small, wdata, 10, "Memory blocks are not equal");
+
+	/* 4. Erased pattern is left unprogrammed and stays writable in place */
+	memset(wdata, 0xff, info.leb_size);
+	zassert_ok(ubi_leb_write(ubi, vol_id, 2, wdata, info.leb_size));
+
+	memset(small, 0x3c, sizeof(small));
+	zassert_ok(ubi_leb_write_offset(ubi, vol_id, 2, 64, small, sizeof(small)));
+	zassert_equal(-ENOTSUP, ubi_leb_write_offset(ubi, vol_id, 0, 64, small, sizeof(small)));
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 2, 0, rdata, 3 * sizeof(small)));
+	zassert_mem_equal(rdata, erased, sizeof(erased), "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[64], small, sizeof(small), "Memory blocks are not equal");
+	zassert_mem_equal(&rdata[128], erased, sizeof(erased), "Memory blocks are not equal");
+
+	/* 5. Zeroing a LEB costs no data programming */
+	int64_t start = k_uptime_ticks();
+
+	for (size_t round = 0; round < rounds; ++round) {
+		noise_fill(wdata, info.leb_size, round);
+		zassert_ok(ubi_leb_write(ubi, vol_id, 3, wdata, info.leb_size));
+	}
+
+	const uint32_t data_kibps = kib_per_sec(rounds * info.leb_size, start);
+
+	memset(wdata, 0, info.leb_size);
+	start = k_uptime_ticks();
+
+	for (size_t round = 0; round < rounds; ++round)
+		zassert_ok(ubi_leb_write(ubi, vol_id, 3, wdata, info.leb_size));
+
+	const uint32_t zero_kibps = kib_per_sec(rounds * info.leb_size, start);
+
+	TC_PRINT("ubi_pattern: data write %u KiB/s, zero write %u KiB/s\n", data_kibps,
+		 zero_kibps);
+
+	/* 6. Patterns survive reboot */
+	zassert_ok(ubi_device_deinit(ubi));
+
+	ubi = NULL;
+	zassert_ok(ubi_device_init(&mtd, &ubi));
+	zassert_not_null(ubi);
+
+	memset(rdata, 0xa5, info.leb_size);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 0, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	zassert_ok(ubi_leb_read(ubi, vol_id, 3, 0, rdata, info.leb_size));
+	zassert_mem_equal(rdata, wdata, info.leb_size, "Memory blocks are not equal");
+
+	memset(wdata, 0x5a, 100);
+	zassert_ok(ubi_leb_read(ubi, vol_id, 1, 0, rdata, 100));
+	zassert_mem_equal(rdata, wdata, 100, "Memory blocks are not equal");
+
+	/* 7. Deinitialize device */
+	k_free(wdata);
+	k_free(rdata);
+	zassert_ok(ubi_device_deinit(ubi));
+}